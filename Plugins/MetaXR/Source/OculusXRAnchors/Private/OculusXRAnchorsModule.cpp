@@ -31,8 +31,26 @@ void FOculusXRAnchorsModule::StartupModule()
 		return;
 	}
 
-	HMD->AddEventPollingDelegate(OculusXRHMD::FOculusXRHMDEventPollingDelegate::CreateStatic(&OculusXRAnchors::FOculusXRAnchorManager::OnPollEvent));
-	HMD->AddEventPollingDelegate(OculusXRHMD::FOculusXRHMDEventPollingDelegate::CreateStatic(&OculusXRAnchors::FOculusXRRoomLayoutManager::OnPollEvent));
+	const ovrpEventType AnchorEventTypes[] = {
+		ovrpEventType_SpatialAnchorCreateComplete,
+		ovrpEventType_SpaceSetComponentStatusComplete,
+		ovrpEventType_SpaceQueryResults,
+		ovrpEventType_SpaceQueryComplete,
+		ovrpEventType_SpaceSaveComplete,
+		ovrpEventType_SpaceListSaveResult,
+		ovrpEventType_SpaceEraseComplete,
+		ovrpEventType_SpaceShareResult,
+	};
+	for (ovrpEventType EventType : AnchorEventTypes)
+	{
+		HMD->AddEventPollingDelegate(EventType, OculusXRHMD::FOculusXRHMDEventPollingDelegate::CreateStatic(&OculusXRAnchors::FOculusXRAnchorManager::OnPollEvent));
+	}
+	HMD->AddEventPollingDelegate(ovrpEventType_SceneCaptureComplete, OculusXRHMD::FOculusXRHMDEventPollingDelegate::CreateStatic(&OculusXRAnchors::FOculusXRRoomLayoutManager::OnPollEvent));
+
+	// Space queries deliver their results in bursts; handle a frame's worth after polling, with the completions
+	// batched too so they still follow their results
+	HMD->SetEventPollingBatched(ovrpEventType_SpaceQueryResults, true);
+	HMD->SetEventPollingBatched(ovrpEventType_SpaceQueryComplete, true);
 
 	Anchors.Initialize();
 }
@@ -35,6 +35,7 @@
 #include "DataDrivenShaderPlatformInfo.h"
 #include "GenericPlatform/GenericPlatformMath.h"
 #include "LegacyScreenPercentageDriver.h"
+#include "Algo/BinarySearch.h"
 
 #if PLATFORM_ANDROID
 #include "Android/AndroidJNI.h"
@@ -126,6 +127,30 @@ static TAutoConsoleVariable<float> CVarOculusDynamicResolutionPixelDensity(
 		TEXT(">0 Manual Pixel Density Override\n"),
 	ECVF_Scalability | ECVF_RenderThreadSafe);
 
+static TAutoConsoleVariable<int32> CVarOculusDynamicResolutionController(
+	TEXT("r.Oculus.DynamicResolution.Controller"),
+	1,
+	TEXT("0 Follow the runtime's recommended eye buffer resolution\n")
+		TEXT("1 Pick the pixel density from the measured GPU frame time, falling back to the runtime's recommendation when the GPU time isn't reported (default)\n"),
+	ECVF_Scalability);
+
+// Bumped by the console variable sink after any console variable changed
+static uint32 GOculusConsoleVariablesGeneration = 0;
+
+static void OnOculusConsoleVariablesChanged()
+{
+	GOculusConsoleVariablesGeneration++;
+}
+
+static FAutoConsoleVariableSink CVarOculusConsoleVariablesSink(FConsoleCommandDelegate::CreateStatic(&OnOculusConsoleVariablesChanged));
+
+static TAutoConsoleVariable<int32> CVarOculusFixedEyeBuffer(
+	TEXT("r.Oculus.FixedEyeBuffer"),
+	0,
+	TEXT("0 Reallocate the eye buffers when the pixel density changes (default)\n")
+		TEXT("1 Allocate the eye buffers once for vr.oculus.PixelDensity.max and render pixel densities up to it into a smaller viewport\n"),
+	ECVF_Scalability);
+
 #define OCULUS_PAUSED_IDLE_FPS 10
 
 static const FString USE_SCENE_PERMISSION_NAME("com.oculus.permission.USE_SCENE");
@@ -942,6 +967,7 @@ namespace OculusXRHMD
 		}
 
 		CachedWorldToMetersScale = InWorldContext.World()->GetWorldSettings()->WorldToMeters;
+		DynamicResolutionController->SetScene(InWorldContext.World()->GetOutermost()->GetFName());
 
 		// this should have already happened in FOculusXRInput, so this is usually a no-op.
 		StartGameFrame_GameThread();
@@ -1108,6 +1134,10 @@ namespace OculusXRHMD
 
 	void FOculusXRHMD::DoSessionShutdown()
 	{
+		// Drop the game thread's references first, so the final flush below releases every layer
+		LayerSources.Reset();
+		LayerSnapshot.Reset();
+
 		// Release resources
 		ExecuteOnRenderThread([this]() {
 			ExecuteOnRHIThread([this]() {
@@ -1134,13 +1164,19 @@ namespace OculusXRHMD
 				Settings_RHIThread.Reset();
 				Frame_RHIThread.Reset();
 				Layers_RHIThread.Reset();
+				LayerList_RHIThread.Reset();
+				SubmitLayers_RHIThread.Reset();
+				LayerSubmits_RHIThread.Reset();
 			});
 
 			Settings_RenderThread.Reset();
 			Frame_RenderThread.Reset();
 			Layers_RenderThread.Reset();
+			LayerList_RenderThread.Reset();
+			LayerSnapshot_RenderThread.Reset();
 			EyeLayer_RenderThread.Reset();
 
+			SwapChainPool.Close_RenderThread();
 			DeferredDeletion.HandleLayerDeferredDeletionQueue_RenderThread(true);
 		});
 
@@ -1958,16 +1994,16 @@ namespace OculusXRHMD
 			{
 				ovrpEventDisplayRefreshRateChange* rateChangedEvent = (ovrpEventDisplayRefreshRateChange*)&buf;
 				FOculusEventDelegates::OculusDisplayRefreshRateChanged.Broadcast(rateChangedEvent->FromRefreshRate, rateChangedEvent->ToRefreshRate);
+				// The dynamic resolution controller's frame budget follows the refresh rate
+				UpdateHmdRenderInfo();
 			}
 			else
 			{
-				for (auto& it : EventPollingDelegates)
-				{
-					bool HandledEvent = false;
-					it.ExecuteIfBound(&buf, HandledEvent);
-				}
+				EventDispatcher.Dispatch(buf);
 			}
 		}
+
+		EventDispatcher.Flush();
 	}
 
 	uint32 FOculusXRHMD::CreateLayer(const IStereoLayers::FLayerDesc& InLayerDesc)
@@ -1977,6 +2013,7 @@ namespace OculusXRHMD
 		uint32 LayerId = NextLayerId++;
 		FLayerPtr Layer = MakeShareable(new FLayer(LayerId));
 		LayerMap.Add(LayerId, Layer);
+		SortedLayerIds.Insert(LayerId, Algo::LowerBound(SortedLayerIds, LayerId));
 		Layer->SetDesc(Settings.Get(), InLayerDesc);
 		return LayerId;
 	}
@@ -1990,6 +2027,12 @@ namespace OculusXRHMD
 			(*LayerFound)->DestroyLayer();
 		}
 		LayerMap.Remove(LayerId);
+
+		const int32 SortedIndex = Algo::BinarySearch(SortedLayerIds, LayerId);
+		if (SortedIndex != INDEX_NONE)
+		{
+			SortedLayerIds.RemoveAt(SortedIndex);
+		}
 	}
 
 	void FOculusXRHMD::SetLayerDesc(uint32 LayerId, const IStereoLayers::FLayerDesc& InLayerDesc)
@@ -2168,7 +2211,12 @@ namespace OculusXRHMD
 			// This should already have been set by UpdateStereoRenderingParams().
 			// It must still match the value used there.
 			check(Settings->CurrentShaderPlatform == InViewFamily.Scene->GetShaderPlatform());
-			Settings->Flags.bsRGBEyeBuffer = IsMobilePlatform(Settings->CurrentShaderPlatform) && IsMobileColorsRGB();
+			const bool bsRGBEyeBuffer = IsMobilePlatform(Settings->CurrentShaderPlatform) && IsMobileColorsRGB();
+			if (Settings->Flags.bsRGBEyeBuffer != bsRGBEyeBuffer)
+			{
+				Settings->Flags.bsRGBEyeBuffer = bsRGBEyeBuffer;
+				Settings->MarkStereoParamsDirty();
+			}
 
 			if (NextFrameToRender.IsValid())
 			{
@@ -2408,6 +2456,7 @@ namespace OculusXRHMD
 		: FHeadMountedDisplayBase(nullptr)
 		, FHMDSceneViewExtension(AutoRegister)
 		, ConsoleCommands(this)
+		, SwapChainPool(&DeferredDeletion)
 		, InsightInitStatus(FInsightInitStatus::NotInitialized)
 		, bShutdownRequestQueued(false)
 	{
@@ -2426,11 +2475,18 @@ namespace OculusXRHMD
 		NextLayerId = 0;
 
 		Settings = CreateNewSettings();
+		DynamicResolutionController = MakeShareable(new FDynamicResolutionController());
 
 		RendererModule = nullptr;
 
 		SplashLayerHandle = -1;
 
+		StereoParamsGeneration = MAX_uint32;
+		StereoParamsCVarGeneration = MAX_uint32;
+		AppliedPixelDensityCVar = -1.0f;
+		NumStereoParamsUpdates = 0;
+		NumStereoParamsRecomputes = 0;
+
 		SplashRotation = FRotator();
 
 		bIsStandaloneStereoOnlyDevice = IHeadMountedDisplayModule::IsAvailable() && IHeadMountedDisplayModule::Get().IsStandaloneStereoOnlyDevice();
@@ -2545,6 +2601,9 @@ namespace OculusXRHMD
 
 		Settings.Reset();
 		LayerMap.Reset();
+		SortedLayerIds.Reset();
+		LayerSources.Reset();
+		LayerSnapshot.Reset();
 	}
 
 	void FOculusXRHMD::ApplicationPauseDelegate()
@@ -2761,10 +2820,11 @@ namespace OculusXRHMD
 			{
 				DynamicResOperationCVar->Set(2);
 			}
-			GEngine->ChangeDynamicResolutionStateAtNextFrame(MakeShareable(new FDynamicResolutionState(Settings)));
+			GEngine->ChangeDynamicResolutionStateAtNextFrame(MakeShareable(new FDynamicResolutionState(Settings, DynamicResolutionController)));
 		}
 
 		UpdateHmdRenderInfo();
+		Settings->MarkStereoParamsDirty();
 		UpdateStereoRenderingParams();
 
 		ExecuteOnRenderThread([this](FRHICommandListImmediate& RHICmdList) {
@@ -2957,14 +3017,24 @@ namespace OculusXRHMD
 	{
 		CheckInGameThread();
 
-		// Update PixelDensity
-		bool bSupportsDepth = true;
+		NumStereoParamsUpdates++;
 
+		// Console variables are only read again after one of them changed
+		const bool bCVarsChanged = StereoParamsCVarGeneration != GOculusConsoleVariablesGeneration;
+		if (bCVarsChanged)
+		{
+			StereoParamsCVarGeneration = GOculusConsoleVariablesGeneration;
+			Settings->Flags.bFixedEyeBuffer = CVarOculusFixedEyeBuffer.GetValueOnGameThread() != 0;
+			Settings->MarkStereoParamsDirty();
+		}
+
+		// Update PixelDensity
 		if (Settings->Flags.bPixelDensityAdaptive)
 		{
 			FLayer* EyeLayer = EyeLayer_RenderThread.Get();
 			float NewPixelDensity = 1.0;
-			if (EyeLayer && EyeLayer->GetOvrpId())
+			const bool bFromGpuTime = CVarOculusDynamicResolutionController.GetValueOnGameThread() != 0 && DynamicResolutionController->Update_GameThread(*Settings, NewPixelDensity);
+			if (!bFromGpuTime && EyeLayer && EyeLayer->GetOvrpId())
 			{
 				ovrpSizei RecommendedResolution = { 0, 0 };
 				FOculusXRHMDModule::GetPluginWrapper().GetLayerRecommendedResolution(EyeLayer->GetOvrpId(), &RecommendedResolution);
@@ -2980,12 +3050,52 @@ namespace OculusXRHMD
 				NewPixelDensity = PixelDensityCVarOverride;
 			}
 			Settings->SetPixelDensitySmooth(NewPixelDensity);
+
+			// Leaving adaptive mode goes back to vr.PixelDensity
+			AppliedPixelDensityCVar = -1.0f;
 		}
-		else
+		else if (bCVarsChanged || AppliedPixelDensityCVar < 0.0f)
 		{
+			// Only a change of vr.PixelDensity itself replaces a pixel density set through SetPixelDensity
 			static const auto PixelDensityCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("vr.PixelDensity"));
-			Settings->SetPixelDensity(PixelDensityCVar ? PixelDensityCVar->GetFloat() : 1.0f);
+			const float PixelDensityCVarValue = PixelDensityCVar ? PixelDensityCVar->GetFloat() : 1.0f;
+			if (PixelDensityCVarValue != AppliedPixelDensityCVar)
+			{
+				AppliedPixelDensityCVar = PixelDensityCVarValue;
+				Settings->SetPixelDensity(PixelDensityCVarValue);
+			}
+		}
+
+		if (GEngine && GEngine->GetDefaultWorldFeatureLevel() != Settings->CurrentFeatureLevel)
+		{
+			Settings->MarkStereoParamsDirty();
+		}
+
+		if (Settings->StereoParamsGeneration != StereoParamsGeneration)
+		{
+			NumStereoParamsRecomputes++;
+			ComputeStereoRenderingParams();
+			StereoParamsGeneration = Settings->StereoParamsGeneration;
+		}
+
+		// given that we send a subrect in vpRectSubmit, the FOV is the default asym one in EyeLayerDesc, not FrameFov
+		if (Frame.IsValid())
+		{
+			Frame->Fov[0] = Settings->EyeFov[0];
+			Frame->Fov[1] = Settings->EyeFov[1];
+			Frame->SymmetricFov[0] = Settings->SymmetricEyeFov[0];
+			Frame->SymmetricFov[1] = Settings->SymmetricEyeFov[1];
+		}
+	}
 
+	void FOculusXRHMD::ComputeStereoRenderingParams()
+	{
+		CheckInGameThread();
+
+		bool bSupportsDepth = true;
+
+		if (!Settings->Flags.bPixelDensityAdaptive)
+		{
 			// Due to hijacking the depth target directly from the scene context, we can't support depth compositing if it's being scaled by screen percentage since it wont match our color render target dimensions.
 			static const auto ScreenPercentageCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.ScreenPercentage"));
 			float ScreenPercentage = (!ScreenPercentageCVar) ? 100.0f : ScreenPercentageCVar->GetFloat();
@@ -3064,9 +3174,12 @@ namespace OculusXRHMD
 
 		const bool bCompositeDepth = Settings->Flags.bCompositeDepth;
 
+		// Adaptive and fixed eye buffers are sized for the highest pixel density, the viewport follows the current one
+		const bool bEyeBufferAtPixelDensityMax = Settings->Flags.bPixelDensityAdaptive || Settings->Flags.bFixedEyeBuffer;
+
 		if (OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().CalculateEyeLayerDesc3(
 				Layout,
-				Settings->Flags.bPixelDensityAdaptive ? Settings->PixelDensityMax : Settings->PixelDensity,
+				bEyeBufferAtPixelDensityMax ? Settings->PixelDensityMax : Settings->PixelDensity,
 				Settings->Flags.bHQDistortion ? 0 : 1,
 				1, // UNDONE
 				CustomPresent->GetOvrpTextureFormat(CustomPresent->GetDefaultPixelFormat(), Settings->Flags.bsRGBEyeBuffer),
@@ -3112,6 +3225,15 @@ namespace OculusXRHMD
 				EyeLayerDesc.MaxViewportSize.w = TextureSize.X;
 				EyeLayerDesc.MaxViewportSize.h = TextureSize.Y;
 			}
+			else if (Settings->Flags.bFixedEyeBuffer)
+			{
+				// The texture, and the depth and foveation textures allocated with it, keep the size for PixelDensityMax.
+				// The viewport submitted to the compositor shrinks instead.
+				const float ViewportScale = Settings->PixelDensity / Settings->PixelDensityMax;
+				UnscaledViewportSize = FIntPoint(
+					FMath::Min(FMath::CeilToInt(EyeLayerDesc.MaxViewportSize.w * ViewportScale), EyeLayerDesc.MaxViewportSize.w),
+					FMath::Min(FMath::CeilToInt(EyeLayerDesc.MaxViewportSize.h * ViewportScale), EyeLayerDesc.MaxViewportSize.h));
+			}
 
 			// Unreal assumes no gutter between eyes
 			EyeLayerDesc.TextureSize.w = EyeLayerDesc.MaxViewportSize.w;
@@ -3143,14 +3265,10 @@ namespace OculusXRHMD
 			Settings->EyeProjectionMatrices[1] = ovrpMatrix4f_Projection(frustumRight, true);
 			Settings->MonoProjectionMatrix = ovrpMatrix4f_Projection(frustumCenter, true);
 
-			// given that we send a subrect in vpRectSubmit, the FOV is the default asym one in EyeLayerDesc, not FrameFov
-			if (Frame.IsValid())
-			{
-				Frame->Fov[0] = EyeLayerDesc.Fov[0];
-				Frame->Fov[1] = EyeLayerDesc.Fov[1];
-				Frame->SymmetricFov[0] = FrameFov[0];
-				Frame->SymmetricFov[1] = FrameFov[1];
-			}
+			Settings->EyeFov[0] = EyeLayerDesc.Fov[0];
+			Settings->EyeFov[1] = EyeLayerDesc.Fov[1];
+			Settings->SymmetricEyeFov[0] = FrameFov[0];
+			Settings->SymmetricEyeFov[1] = FrameFov[1];
 
 			// Flag if need to recreate render targets
 			if (!EyeLayer->CanReuseResources(EyeLayer_RenderThread.Get()))
@@ -3174,7 +3292,7 @@ namespace OculusXRHMD
 		if (LayerMap[0].IsValid())
 		{
 			FLayerPtr EyeLayer = LayerMap[0]->Clone();
-			EyeLayer->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, RHICmdList, EyeLayer_RenderThread.Get());
+			EyeLayer->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, &SwapChainPool, RHICmdList, EyeLayer_RenderThread.Get());
 
 			if (Layers_RenderThread.Num() > 0)
 			{
@@ -4352,6 +4470,7 @@ namespace OculusXRHMD
 				NextFrameToRender = Frame;
 
 				UE_LOG(LogHMD, VeryVerbose, TEXT("StartGameFrame %u"), Frame->FrameNumber);
+				FrameTimeline.BeginFrame(Frame->FrameNumber);
 
 				if (!Splash->IsShown())
 				{
@@ -4364,7 +4483,10 @@ namespace OculusXRHMD
 						UE_LOG(LogHMD, Verbose, TEXT("FOculusXRHMDModule::GetPluginWrapper().WaitToBeginFrame %u"), Frame->FrameNumber);
 
 						ovrpResult Result;
-						if (OVRP_FAILURE(Result = FOculusXRHMDModule::GetPluginWrapper().WaitToBeginFrame(Frame->FrameNumber)))
+						FrameTimeline.Mark(Frame->FrameNumber, EFrameTimelineStage::WaitFrameBegin);
+						Result = FOculusXRHMDModule::GetPluginWrapper().WaitToBeginFrame(Frame->FrameNumber);
+						FrameTimeline.Mark(Frame->FrameNumber, EFrameTimelineStage::WaitFrameEnd);
+						if (OVRP_FAILURE(Result))
 						{
 							UE_LOG(LogHMD, Error, TEXT("FOculusXRHMDModule::GetPluginWrapper().WaitToBeginFrame %u failed (%d)"), Frame->FrameNumber, Result);
 						}
@@ -4379,6 +4501,7 @@ namespace OculusXRHMD
 			}
 
 			UpdateStereoRenderingParams();
+			FrameTimeline.UpdateCSV_GameThread();
 		}
 	}
 
@@ -4401,6 +4524,7 @@ namespace OculusXRHMD
 		if (NextFrameToRender.IsValid() && NextFrameToRender != LastFrameToRender)
 		{
 			UE_LOG(LogHMD, VeryVerbose, TEXT("StartRenderFrame %u"), NextFrameToRender->FrameNumber);
+			FrameTimeline.Mark(NextFrameToRender->FrameNumber, EFrameTimelineStage::RenderFrameStart);
 
 			LastFrameToRender = NextFrameToRender;
 			NextFrameToRender->Flags.bSplashIsShown = Splash->IsShown();
@@ -4414,71 +4538,109 @@ namespace OculusXRHMD
 
 			FSettingsPtr XSettings = Settings->Clone();
 			FGameFramePtr XFrame = NextFrameToRender->Clone();
-			TArray<FLayerPtr> XLayers;
-
-			XLayers.Empty(LayerMap.Num());
 
-			for (auto Pair : LayerMap)
+			// Only layers that changed since the last frame are cloned; the others are shared with the render thread
+			LayerSources.Reset();
+			for (uint32 LayerId : SortedLayerIds)
 			{
-				XLayers.Emplace(Pair.Value->Clone());
+				LayerSources.Add(LayerMap.FindChecked(LayerId));
 			}
-
-			XLayers.Sort(FLayerPtr_CompareId());
+			FLayerListPtr XLayers = LayerSnapshot.Update(LayerSources);
 
 			ExecuteOnRenderThread_DoNotWait([this, XSettings, XFrame, XLayers](FRHICommandListImmediate& RHICmdList) {
 				if (XFrame.IsValid())
 				{
+					FrameTimeline.Mark(XFrame->FrameNumber, EFrameTimelineStage::RenderThreadStart);
+
 					Settings_RenderThread = XSettings;
 					Frame_RenderThread = XFrame;
 
-					int32 XLayerIndex = 0;
-					int32 LayerIndex_RenderThread = 0;
-					TArray<FLayerPtr> ValidXLayers;
+					bool bSameLayers = XLayers == LayerList_RenderThread && XLayers->Num() == Layers_RenderThread.Num();
+					for (int32 LayerIndex = 0; bSameLayers && LayerIndex < Layers_RenderThread.Num(); LayerIndex++)
+					{
+						bSameLayers = Layers_RenderThread[LayerIndex]->IsInitialized_RenderThread();
+					}
 
-					while (XLayerIndex < XLayers.Num() && LayerIndex_RenderThread < Layers_RenderThread.Num())
+					if (bSameLayers)
+					{
+						// Same layers as last frame, all of them initialized
+						for (int32 LayerIndex = 0; LayerIndex < Layers_RenderThread.Num(); LayerIndex++)
+						{
+							Layers_RenderThread[LayerIndex]->RequestContinuousUpdate_RenderThread();
+						}
+					}
+					else
 					{
-						uint32 LayerIdA = XLayers[XLayerIndex]->GetId();
-						uint32 LayerIdB = Layers_RenderThread[LayerIndex_RenderThread]->GetId();
+						int32 XLayerIndex = 0;
+						int32 LayerIndex_RenderThread = 0;
+						TArray<FLayerPtr> ValidXLayers;
+						ValidXLayers.Reserve(XLayers->Num());
 
-						if (LayerIdA < LayerIdB)
+						while (XLayerIndex < XLayers->Num() && LayerIndex_RenderThread < Layers_RenderThread.Num())
 						{
-							if (XLayers[XLayerIndex]->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, RHICmdList))
+							const FLayerPtr& XLayer = (*XLayers)[XLayerIndex];
+							uint32 LayerIdA = XLayer->GetId();
+							uint32 LayerIdB = Layers_RenderThread[LayerIndex_RenderThread]->GetId();
+
+							if (LayerIdA < LayerIdB)
 							{
-								ValidXLayers.Add(XLayers[XLayerIndex]);
+								if (XLayer->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, &SwapChainPool, RHICmdList))
+								{
+									ValidXLayers.Add(XLayer);
+								}
+								XLayerIndex++;
+							}
+							else if (LayerIdA > LayerIdB)
+							{
+								DeferredDeletion.AddLayerToDeferredDeletionQueue(Layers_RenderThread[LayerIndex_RenderThread++]);
+							}
+							else if (XLayer == Layers_RenderThread[LayerIndex_RenderThread])
+							{
+								if (XLayer->IsInitialized_RenderThread())
+								{
+									// Unchanged layer shared with the previous list, already initialized
+									XLayer->RequestContinuousUpdate_RenderThread();
+									ValidXLayers.Add(XLayer);
+								}
+								else if (XLayer->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, &SwapChainPool, RHICmdList))
+								{
+									// Unchanged layer whose setup failed last frame, retried without reusing its own resources
+									ValidXLayers.Add(XLayer);
+								}
+								LayerIndex_RenderThread++;
+								XLayerIndex++;
+							}
+							else
+							{
+								if (XLayer->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, &SwapChainPool, RHICmdList, Layers_RenderThread[LayerIndex_RenderThread].Get()))
+								{
+									LayerIndex_RenderThread++;
+									ValidXLayers.Add(XLayer);
+								}
+								XLayerIndex++;
 							}
-							XLayerIndex++;
-						}
-						else if (LayerIdA > LayerIdB)
-						{
-							DeferredDeletion.AddLayerToDeferredDeletionQueue(Layers_RenderThread[LayerIndex_RenderThread++]);
 						}
-						else
+
+						while (XLayerIndex < XLayers->Num())
 						{
-							if (XLayers[XLayerIndex]->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, RHICmdList, Layers_RenderThread[LayerIndex_RenderThread].Get()))
+							const FLayerPtr& XLayer = (*XLayers)[XLayerIndex];
+							if (XLayer->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, &SwapChainPool, RHICmdList))
 							{
-								LayerIndex_RenderThread++;
-								ValidXLayers.Add(XLayers[XLayerIndex]);
+								ValidXLayers.Add(XLayer);
 							}
 							XLayerIndex++;
 						}
-					}
 
-					while (XLayerIndex < XLayers.Num())
-					{
-						if (XLayers[XLayerIndex]->Initialize_RenderThread(Settings_RenderThread.Get(), CustomPresent, &DeferredDeletion, RHICmdList))
+						while (LayerIndex_RenderThread < Layers_RenderThread.Num())
 						{
-							ValidXLayers.Add(XLayers[XLayerIndex]);
+							DeferredDeletion.AddLayerToDeferredDeletionQueue(Layers_RenderThread[LayerIndex_RenderThread++]);
 						}
-						XLayerIndex++;
-					}
 
-					while (LayerIndex_RenderThread < Layers_RenderThread.Num())
-					{
-						DeferredDeletion.AddLayerToDeferredDeletionQueue(Layers_RenderThread[LayerIndex_RenderThread++]);
+						Layers_RenderThread = MoveTemp(ValidXLayers);
+						LayerList_RenderThread = XLayers;
 					}
 
-					Layers_RenderThread = ValidXLayers;
-
+					SwapChainPool.Tick_RenderThread();
 					DeferredDeletion.HandleLayerDeferredDeletionQueue_RenderThread();
 				}
 			});
@@ -4514,22 +4676,28 @@ namespace OculusXRHMD
 		if (Frame_RenderThread.IsValid())
 		{
 			UE_LOG(LogHMD, VeryVerbose, TEXT("StartRHIFrame %u"), Frame_RenderThread->FrameNumber);
+			FrameTimeline.Mark(Frame_RenderThread->FrameNumber, EFrameTimelineStage::RHIFrameStart);
 
 			FSettingsPtr XSettings = Settings_RenderThread->Clone();
 			FGameFramePtr XFrame = Frame_RenderThread->Clone();
-			TArray<FLayerPtr> XLayers = Layers_RenderThread;
-
-			for (int32 XLayerIndex = 0; XLayerIndex < XLayers.Num(); XLayerIndex++)
-			{
-				XLayers[XLayerIndex] = XLayers[XLayerIndex]->Clone();
-			}
+			FLayerListPtr XLayers = LayerSnapshot_RenderThread.Update(Layers_RenderThread);
 
 			ExecuteOnRHIThread_DoNotWait([this, XSettings, XFrame, XLayers]() {
 				if (XFrame.IsValid())
 				{
 					Settings_RHIThread = XSettings;
 					Frame_RHIThread = XFrame;
-					Layers_RHIThread = XLayers;
+
+					if (XLayers != LayerList_RHIThread)
+					{
+						Layers_RHIThread = *XLayers;
+						LayerList_RHIThread = XLayers;
+
+						// Layers are added, removed or re-prioritized only through a new list
+						SubmitLayers_RHIThread = Layers_RHIThread;
+						SubmitLayers_RHIThread.Sort(FLayerPtr_CompareTotal());
+						LayerSubmits_RHIThread.Reserve(SubmitLayers_RHIThread.Num());
+					}
 
 					ovrpXrApi NativeXrApi;
 					FOculusXRHMDModule::GetPluginWrapper().GetNativeXrApiType(&NativeXrApi);
@@ -4540,7 +4708,10 @@ namespace OculusXRHMD
 						UE_LOG(LogHMD, Verbose, TEXT("FOculusXRHMDModule::GetPluginWrapper().BeginFrame4 %u"), Frame_RHIThread->FrameNumber);
 
 						ovrpResult Result;
-						if (OVRP_FAILURE(Result = FOculusXRHMDModule::GetPluginWrapper().BeginFrame4(Frame_RHIThread->FrameNumber, CustomPresent->GetOvrpCommandQueue())))
+						FrameTimeline.Mark(Frame_RHIThread->FrameNumber, EFrameTimelineStage::BeginFrameBegin);
+						Result = FOculusXRHMDModule::GetPluginWrapper().BeginFrame4(Frame_RHIThread->FrameNumber, CustomPresent->GetOvrpCommandQueue());
+						FrameTimeline.Mark(Frame_RHIThread->FrameNumber, EFrameTimelineStage::BeginFrameEnd);
+						if (OVRP_FAILURE(Result))
 						{
 							UE_LOG(LogHMD, Error, TEXT("FOculusXRHMDModule::GetPluginWrapper().BeginFrame4 %u failed (%d)"), Frame_RHIThread->FrameNumber, Result);
 							Frame_RHIThread->ShowFlags.Rendering = false;
@@ -4584,20 +4755,13 @@ namespace OculusXRHMD
 			{
 				SCOPED_NAMED_EVENT(EndFrame, FColor::Red);
 
-				TArray<FLayerPtr> Layers = Layers_RHIThread;
-				Layers.Sort(FLayerPtr_CompareTotal());
-				TArray<const ovrpLayerSubmit*> LayerSubmitPtr;
+				LayerSubmits_RHIThread.Reset();
 
-				int32 LayerNum = Layers.Num();
-
-				LayerSubmitPtr.SetNum(LayerNum);
-
-				int32 FinalLayerNumber = 0;
-				for (int32 LayerIndex = 0; LayerIndex < LayerNum; LayerIndex++)
+				for (int32 LayerIndex = 0; LayerIndex < SubmitLayers_RHIThread.Num(); LayerIndex++)
 				{
-					if (Layers[LayerIndex]->IsVisible())
+					if (SubmitLayers_RHIThread[LayerIndex]->IsVisible())
 					{
-						LayerSubmitPtr[FinalLayerNumber++] = Layers[LayerIndex]->UpdateLayer_RHIThread(Settings_RHIThread.Get(), Frame_RHIThread.Get(), LayerIndex);
+						LayerSubmits_RHIThread.Add(SubmitLayers_RHIThread[LayerIndex]->UpdateLayer_RHIThread(Settings_RHIThread.Get(), Frame_RHIThread.Get(), LayerIndex));
 					}
 				}
 
@@ -4605,15 +4769,18 @@ namespace OculusXRHMD
 				FOculusXRHMDModule::GetPluginWrapper().SetEyeFovPremultipliedAlphaMode(false);
 
 				ovrpResult Result;
-				if (OVRP_FAILURE(Result = FOculusXRHMDModule::GetPluginWrapper().EndFrame4(Frame_RHIThread->FrameNumber, LayerSubmitPtr.GetData(), FinalLayerNumber, CustomPresent->GetOvrpCommandQueue())))
+				FrameTimeline.Mark(Frame_RHIThread->FrameNumber, EFrameTimelineStage::EndFrameBegin);
+				Result = FOculusXRHMDModule::GetPluginWrapper().EndFrame4(Frame_RHIThread->FrameNumber, LayerSubmits_RHIThread.GetData(), LayerSubmits_RHIThread.Num(), CustomPresent->GetOvrpCommandQueue());
+				FrameTimeline.Mark(Frame_RHIThread->FrameNumber, EFrameTimelineStage::EndFrameEnd);
+				if (OVRP_FAILURE(Result))
 				{
 					UE_LOG(LogHMD, Error, TEXT("FOculusXRHMDModule::GetPluginWrapper().EndFrame4 %u failed (%d)"), Frame_RHIThread->FrameNumber, Result);
 				}
 				else
 				{
-					for (int32 LayerIndex = 0; LayerIndex < Layers.Num(); LayerIndex++)
+					for (int32 LayerIndex = 0; LayerIndex < SubmitLayers_RHIThread.Num(); LayerIndex++)
 					{
-						Layers[LayerIndex]->IncrementSwapChainIndex_RHIThread(CustomPresent);
+						SubmitLayers_RHIThread[LayerIndex]->IncrementSwapChainIndex_RHIThread(CustomPresent);
 					}
 				}
 			}
@@ -4624,7 +4791,46 @@ namespace OculusXRHMD
 
 	void FOculusXRHMD::AddEventPollingDelegate(const FOculusXRHMDEventPollingDelegate& NewDelegate)
 	{
-		EventPollingDelegates.Add(NewDelegate);
+		EventDispatcher.AddDelegate(NewDelegate);
+	}
+
+	void FOculusXRHMD::AddEventPollingDelegate(ovrpEventType EventType, const FOculusXRHMDEventPollingDelegate& NewDelegate)
+	{
+		EventDispatcher.AddDelegate(EventType, NewDelegate);
+	}
+
+	void FOculusXRHMD::SetEventPollingBatched(ovrpEventType EventType, bool bBatched)
+	{
+		EventDispatcher.SetBatched(EventType, bBatched);
+	}
+
+	void FOculusXRHMD::PrewarmLayerSwapChains(const IStereoLayers::FLayerDesc& LayerDesc, int32 Count)
+	{
+		CheckInGameThread();
+
+		if (!CustomPresent || !FOculusXRHMDModule::GetPluginWrapper().GetInitialized() || Count <= 0)
+		{
+			return;
+		}
+
+		// Layers that are never submitted, so their ovrp layers go to the pool as soon as they are dropped. Each of them
+		// rents what the pool already has before allocating, so the pool ends up with at least Count of them.
+		TArray<FLayerPtr> XLayers;
+		for (int32 LayerIndex = 0; LayerIndex < Count; LayerIndex++)
+		{
+			FLayerPtr Layer = MakeShareable(new FLayer(MAX_uint32)); // any id but the eye layer's
+			Layer->SetDesc(Settings.Get(), LayerDesc);
+			XLayers.Add(Layer);
+		}
+
+		FSettingsPtr XSettings = Settings->Clone();
+		ExecuteOnRenderThread([this, &XLayers, &XSettings](FRHICommandListImmediate& RHICmdList) {
+			for (const FLayerPtr& Layer : XLayers)
+			{
+				Layer->Initialize_RenderThread(XSettings.Get(), CustomPresent, &DeferredDeletion, &SwapChainPool, RHICmdList);
+			}
+			XLayers.Reset();
+		});
 	}
 
 	/// @cond DOXYGEN_WARNINGS
@@ -4688,6 +4894,7 @@ namespace OculusXRHMD
 		CheckInGameThread();
 
 		BOOLEAN_COMMAND_HANDLER_BODY(TEXT("vr.oculus.bHQDistortion"), Settings->Flags.bHQDistortion);
+		Settings->MarkStereoParamsDirty();
 	}
 
 	void FOculusXRHMD::ShowGlobalMenuCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
@@ -4721,6 +4928,17 @@ namespace OculusXRHMD
 	void FOculusXRHMD::ShowSettingsCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
 	{
 		Ar.Logf(TEXT("stereo ipd=%.4f\n nearPlane=%.4f"), GetInterpupillaryDistance(), GNearClippingPlane);
+
+		FDeferredDeletionQueue::FStats DeletionStats;
+		ExecuteOnRenderThread([this, &DeletionStats]() {
+			DeletionStats = DeferredDeletion.GetStats_RenderThread();
+		});
+		Ar.Logf(TEXT("deferred deletion: pending layers=%u, pending ovrp layers=%u, layers deleted=%llu, ovrp layers destroyed=%llu in %llu RHI commands"),
+			DeletionStats.NumPendingLayers, DeletionStats.NumPendingOvrpLayers, DeletionStats.NumLayersDeleted, DeletionStats.NumOvrpLayersDestroyed, DeletionStats.NumDestroyCommands);
+
+		SwapChainPoolCommandHandler(TArray<FString>(), World, Ar);
+
+		Ar.Logf(TEXT("stereo rendering params: recomputed %llu times in %llu updates"), NumStereoParamsRecomputes, NumStereoParamsUpdates);
 	}
 
 	void FOculusXRHMD::IPDCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
@@ -4732,6 +4950,54 @@ namespace OculusXRHMD
 		Ar.Logf(TEXT("vr.oculus.Debug.IPD = %f"), GetInterpupillaryDistance());
 	}
 
+	void FOculusXRHMD::TimelineCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		CheckInGameThread();
+
+		FrameTimeline.Dump(Ar);
+	}
+
+	void FOculusXRHMD::EventsCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		CheckInGameThread();
+
+		EventDispatcher.DumpStats(Ar);
+	}
+
+	void FOculusXRHMD::DynamicResolutionCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		CheckInGameThread();
+
+		if (Args.Num() >= 2 && Args[0].Equals(TEXT("replay"), ESearchCase::IgnoreCase))
+		{
+			FDynamicResolutionController::Replay(Args[1], Settings->PixelDensityMin, Settings->PixelDensityMax, Args.Num() >= 3 ? Args[2] : FString(), Ar);
+		}
+		else
+		{
+			DynamicResolutionController->Dump(Ar);
+		}
+	}
+
+	void FOculusXRHMD::SwapChainPoolCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		CheckInGameThread();
+
+		if (Args.Num() >= 3 && Args[0].Equals(TEXT("prewarm"), ESearchCase::IgnoreCase))
+		{
+			IStereoLayers::FLayerDesc LayerDesc;
+			LayerDesc.SetShape<FQuadLayer>();
+			LayerDesc.LayerSize = FIntPoint(FCString::Atoi(*Args[1]), FCString::Atoi(*Args[2]));
+			PrewarmLayerSwapChains(LayerDesc, Args.Num() >= 4 ? FCString::Atoi(*Args[3]) : 1);
+		}
+
+		FSwapChainPool::FStats PoolStats;
+		ExecuteOnRenderThread([this, &PoolStats]() {
+			PoolStats = SwapChainPool.GetStats_RenderThread();
+		});
+		Ar.Logf(TEXT("swapchain pool: pooled ovrp layers=%u (%.1f MB), rented=%llu, missed=%llu, returned=%llu, evicted=%llu"),
+			PoolStats.NumPooled, PoolStats.PooledBytes / (1024.0 * 1024.0), PoolStats.NumRented, PoolStats.NumMissed, PoolStats.NumReturned, PoolStats.NumEvicted);
+	}
+
 #endif // !UE_BUILD_SHIPPING
 
 	void FOculusXRHMD::LoadFromSettings()
@@ -4768,6 +5034,8 @@ namespace OculusXRHMD
 
 		Settings->FaceTrackingDataSource.Empty(ovrpFaceConstants_FaceTrackingDataSourcesCount);
 		Settings->FaceTrackingDataSource.Append(HMDSettings->FaceTrackingDataSource);
+
+		Settings->MarkStereoParamsDirty();
 	}
 
 	/// @endcond
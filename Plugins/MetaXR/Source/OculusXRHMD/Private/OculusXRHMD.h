@@ -15,6 +15,9 @@
 #include "OculusXRHMD_SpectatorScreenController.h"
 #include "OculusXRHMD_DynamicResolutionState.h"
 #include "OculusXRHMD_DeferredDeletionQueue.h"
+#include "OculusXRHMD_SwapChainPool.h"
+#include "OculusXRHMD_FrameTimeline.h"
+#include "OculusXRHMD_EventDispatcher.h"
 
 #include "OculusXRAssetManager.h"
 
@@ -36,8 +39,6 @@
 namespace OculusXRHMD
 {
 
-	DECLARE_DELEGATE_TwoParams(FOculusXRHMDEventPollingDelegate, ovrpEventDataBuffer*, bool&);
-
 	//-------------------------------------------------------------------------------------------------
 	// FPerformanceStats
 	//-------------------------------------------------------------------------------------------------
@@ -277,6 +278,7 @@ namespace OculusXRHMD
 		bool CheckEyeTrackingPermission(EOculusXRFoveatedRenderingMethod FoveatedRenderingMethod);
 		void SetupOcclusionMeshes();
 		void UpdateStereoRenderingParams();
+		void ComputeStereoRenderingParams();
 		void UpdateHmdRenderInfo();
 		void InitializeEyeLayer_RenderThread(FRHICommandListImmediate& RHICmdList);
 		void ApplySystemOverridesOnStereo(bool force = false);
@@ -438,6 +440,7 @@ namespace OculusXRHMD
 		}
 
 		const int GetNextFrameNumber() const { return NextFrameNumber; }
+		const FFrameTimeline& GetFrameTimeline() const { return FrameTimeline; }
 
 		const FRotator GetSplashRotation() const { return SplashRotation; }
 		void SetSplashRotationToForward();
@@ -464,7 +467,14 @@ namespace OculusXRHMD
 		OCULUSXRHMD_API void UpdateRTPoses();
 
 		FTransform GetLastTrackingToWorld() const { return LastTrackingToWorld; }
+		// The delegate sees every polled event; prefer registering for the event types it handles
 		OCULUSXRHMD_API void AddEventPollingDelegate(const FOculusXRHMDEventPollingDelegate& NewDelegate);
+		OCULUSXRHMD_API void AddEventPollingDelegate(ovrpEventType EventType, const FOculusXRHMDEventPollingDelegate& NewDelegate);
+		// Events of a batched type are dispatched together after the frame's polling instead of as they are polled
+		OCULUSXRHMD_API void SetEventPollingBatched(ovrpEventType EventType, bool bBatched);
+		// Allocates the swapchains of Count layers described by LayerDesc into the swapchain pool, so creating such
+		// layers later, e.g. during gameplay after a level load, doesn't allocate
+		OCULUSXRHMD_API void PrewarmLayerSwapChains(const IStereoLayers::FLayerDesc& LayerDesc, int32 Count = 1);
 
 	protected:
 		FConsoleCommands ConsoleCommands;
@@ -479,6 +489,10 @@ namespace OculusXRHMD
 		void StatsCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar);
 		void ShowSettingsCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar);
 		void IPDCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar);
+		void TimelineCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar);
+		void EventsCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar);
+		void DynamicResolutionCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar);
+		void SwapChainPoolCommandHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar);
 #endif
 
 		void LoadFromSettings();
@@ -543,6 +557,9 @@ namespace OculusXRHMD
 		IRendererModule* RendererModule;
 
 		FDeferredDeletionQueue DeferredDeletion;
+		FSwapChainPool SwapChainPool;
+		FFrameTimeline FrameTimeline;
+		FDynamicResolutionControllerPtr DynamicResolutionController;
 
 		EHMDTrackingOrigin::Type TrackingOrigin;
 		// Stores difference between ViewRotation and EyeOrientation from previous frame
@@ -576,12 +593,22 @@ namespace OculusXRHMD
 		FGameFramePtr LastFrameToRender; // Valid from OnStartGameFrame to BeginRenderViewFamily
 		uint32 NextLayerId;
 		TMap<uint32, FLayerPtr> LayerMap;
+		TArray<uint32> SortedLayerIds;		   // Keys of LayerMap in ascending order, kept up to date by CreateLayer/DestroyLayer
+		TArray<FLayerPtr> LayerSources;		   // Scratch list of LayerMap's layers in id order, reused every frame
+		FLayerSnapshot LayerSnapshot;		   // Layers handed over to the render thread
 		bool bNeedReAllocateViewportRenderTarget;
+		uint32 StereoParamsGeneration;		   // Settings->StereoParamsGeneration the eye layer was last computed for
+		uint32 StereoParamsCVarGeneration;	   // Console variable changes seen by UpdateStereoRenderingParams
+		float AppliedPixelDensityCVar;		   // vr.PixelDensity last applied to Settings, negative to apply it again
+		uint64 NumStereoParamsUpdates;		   // Calls to UpdateStereoRenderingParams
+		uint64 NumStereoParamsRecomputes;	   // ... that recomputed the eye layer
 
 		// Render thread
 		FSettingsPtr Settings_RenderThread;
 		FGameFramePtr Frame_RenderThread; // Valid from BeginRenderViewFamily to PostRenderViewFamily_RenderThread
 		TArray<FLayerPtr> Layers_RenderThread;
+		FLayerListPtr LayerList_RenderThread; // Last list received from the game thread, Layers_RenderThread was built from it
+		FLayerSnapshot LayerSnapshot_RenderThread; // Layers handed over to the RHI thread
 		FLayerPtr EyeLayer_RenderThread; // Valid to be accessed from game thread, since updated only when game thread is waiting
 		bool bNeedReAllocateDepthTexture_RenderThread;
 		bool bNeedReAllocateFoveationTexture_RenderThread;
@@ -594,6 +621,9 @@ namespace OculusXRHMD
 		FSettingsPtr Settings_RHIThread;
 		FGameFramePtr Frame_RHIThread; // Valid from PreRenderViewFamily_RenderThread to FinishRendering_RHIThread
 		TArray<FLayerPtr> Layers_RHIThread;
+		FLayerListPtr LayerList_RHIThread; // Last list received from the render thread, Layers_RHIThread is a copy of it
+		TArray<FLayerPtr> SubmitLayers_RHIThread;			 // Layers_RHIThread in submission order, sorted only when the layers change
+		TArray<const ovrpLayerSubmit*> LayerSubmits_RHIThread; // Passed to EndFrame4, its allocation is kept between frames
 
 		FHMDViewMesh HiddenAreaMeshes[2];
 		FHMDViewMesh VisibleAreaMeshes[2];
@@ -620,7 +650,7 @@ namespace OculusXRHMD
 		bool bShutdownRequestQueued;
 		bool bEyeTrackedFoveatedRenderingSupported;
 
-		TArray<FOculusXRHMDEventPollingDelegate> EventPollingDelegates;
+		FEventDispatcher EventDispatcher;
 	};
 
 	typedef TSharedPtr<FOculusXRHMD, ESPMode::ThreadSafe> FOculusXRHMDPtr;
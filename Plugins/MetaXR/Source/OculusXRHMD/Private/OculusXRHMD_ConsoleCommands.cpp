@@ -51,6 +51,18 @@ namespace OculusXRHMD
 		, IPDCommand(TEXT("vr.oculus.Debug.IPD"),
 			  *NSLOCTEXT("OculusRift", "CCommandText_IPD", "Oculus Rift specific extension.\nShows or changes the current interpupillary distance in meters.").ToString(),
 			  FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateRaw(InHMDPtr, &FOculusXRHMD::IPDCommandHandler))
+		, TimelineCommand(TEXT("vr.oculus.Debug.Timeline"),
+			  *NSLOCTEXT("OculusRift", "CCommandText_Timeline", "Oculus Rift specific extension.\nShows percentiles of where the last frames spent their time between the game thread and the compositor.\nSet vr.oculus.Debug.Timeline.CSV to 1 to record every frame to a CSV file.").ToString(),
+			  FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateRaw(InHMDPtr, &FOculusXRHMD::TimelineCommandHandler))
+		, EventsCommand(TEXT("vr.oculus.Debug.Events"),
+			  *NSLOCTEXT("OculusRift", "CCommandText_Events", "Oculus Rift specific extension.\nShows how many OVRPlugin events of each type were polled and dispatched.").ToString(),
+			  FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateRaw(InHMDPtr, &FOculusXRHMD::EventsCommandHandler))
+		, DynamicResolutionCommand(TEXT("vr.oculus.Debug.DynamicResolution"),
+			  *NSLOCTEXT("OculusRift", "CCommandText_DynamicResolution", "Oculus Rift specific extension.\nShows the dynamic resolution controller's state and what it learned per scene.\n'replay <trace.csv> [out.csv]' runs the controller over a trace recorded with vr.oculus.Debug.DynamicResolution.CSV set to 1.").ToString(),
+			  FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateRaw(InHMDPtr, &FOculusXRHMD::DynamicResolutionCommandHandler))
+		, SwapChainPoolCommand(TEXT("vr.oculus.Debug.SwapChainPool"),
+			  *NSLOCTEXT("OculusRift", "CCommandText_SwapChainPool", "Oculus Rift specific extension.\nShows how often stereo layers reused pooled swapchains instead of allocating.\n'prewarm <width> <height> [count]' adds swapchains for quad layers of that size to the pool.").ToString(),
+			  FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateRaw(InHMDPtr, &FOculusXRHMD::SwapChainPoolCommandHandler))
 #endif // !UE_BUILD_SHIPPING
 	{
 	}
@@ -37,6 +37,10 @@ namespace OculusXRHMD
 		FAutoConsoleCommand CubemapCommand;
 		FAutoConsoleCommand ShowSettingsCommand;
 		FAutoConsoleCommand IPDCommand;
+		FAutoConsoleCommand TimelineCommand;
+		FAutoConsoleCommand EventsCommand;
+		FAutoConsoleCommand DynamicResolutionCommand;
+		FAutoConsoleCommand SwapChainPoolCommand;
 #endif // !UE_BUILD_SHIPPING
 	};
 
@@ -7,6 +7,7 @@
 #include "OculusXRHMDPrivate.h"
 #include "XRThreadUtils.h"
 #include "OculusXRHMDModule.h"
+#include "Misc/ScopeLock.h"
 
 namespace OculusXRHMD
 {
@@ -14,56 +15,83 @@ namespace OculusXRHMD
 	//-------------------------------------------------------------------------------------------------
 	// FDeferredDeletionQueue
 	//-------------------------------------------------------------------------------------------------
-	uint32 GOculusXRHMDLayerDeletionFrameNumber = 0;
-	const uint32 NUM_FRAMES_TO_WAIT_FOR_LAYER_DELETE = 3;
-	const uint32 NUM_FRAMES_TO_WAIT_FOR_OVRP_LAYER_DELETE = 7;
-
 	void FDeferredDeletionQueue::AddLayerToDeferredDeletionQueue(const FLayerPtr& ptr)
 	{
-		DeferredDeletionEntry Entry;
-		Entry.Layer = ptr;
-		Entry.FrameEnqueued = GOculusXRHMDLayerDeletionFrameNumber;
-		Entry.EntryType = DeferredDeletionEntry::DeferredDeletionEntryType::Layer;
-		DeferredDeletionArray.Add(Entry);
+		FScopeLock Lock(&CriticalSection);
+		Buckets[(FrameNumber + NUM_FRAMES_TO_WAIT_FOR_LAYER_DELETE + 1) % NumBuckets].Layers.Add(ptr);
+		Stats.NumPendingLayers++;
 	}
 
 	void FDeferredDeletionQueue::AddOVRPLayerToDeferredDeletionQueue(const uint32 layerID)
 	{
-		DeferredDeletionEntry Entry;
-		Entry.OvrpLayerId = layerID;
-		Entry.FrameEnqueued = GOculusXRHMDLayerDeletionFrameNumber;
-		Entry.EntryType = DeferredDeletionEntry::DeferredDeletionEntryType::OvrpLayer;
-		DeferredDeletionArray.Add(Entry);
+		FScopeLock Lock(&CriticalSection);
+		Buckets[(FrameNumber + NUM_FRAMES_TO_WAIT_FOR_OVRP_LAYER_DELETE + 1) % NumBuckets].OvrpLayerIds.Add(layerID);
+		Stats.NumPendingOvrpLayers++;
 	}
 
 	void FDeferredDeletionQueue::HandleLayerDeferredDeletionQueue_RenderThread(bool bDeleteImmediately)
 	{
-		// Traverse list backwards so the swap switches to elements already tested
-		for (int32 Index = DeferredDeletionArray.Num() - 1; Index >= 0; --Index)
+		if (bDeleteImmediately)
 		{
-			DeferredDeletionEntry* Entry = &DeferredDeletionArray[Index];
-			if (Entry->EntryType == DeferredDeletionEntry::DeferredDeletionEntryType::Layer)
+			// Deleting a layer can queue its ovrp layer, so go around until everything is gone
+			while (HasPending())
 			{
-				if (bDeleteImmediately || GOculusXRHMDLayerDeletionFrameNumber > Entry->FrameEnqueued + NUM_FRAMES_TO_WAIT_FOR_LAYER_DELETE)
+				for (uint32 BucketIndex = 0; BucketIndex < NumBuckets; BucketIndex++)
 				{
-					DeferredDeletionArray.RemoveAtSwap(Index, 1, false);
+					ExpireBucket();
 				}
 			}
-			else if (Entry->EntryType == DeferredDeletionEntry::DeferredDeletionEntryType::OvrpLayer)
-			{
-				if (bDeleteImmediately || GOculusXRHMDLayerDeletionFrameNumber > Entry->FrameEnqueued + NUM_FRAMES_TO_WAIT_FOR_OVRP_LAYER_DELETE)
+		}
+		else
+		{
+			// if the function is to be called multiple times, move this somewhere unique!
+			ExpireBucket();
+		}
+	}
+
+	FDeferredDeletionQueue::FStats FDeferredDeletionQueue::GetStats_RenderThread() const
+	{
+		FScopeLock Lock(&CriticalSection);
+		return Stats;
+	}
+
+	bool FDeferredDeletionQueue::HasPending() const
+	{
+		FScopeLock Lock(&CriticalSection);
+		return Stats.NumPendingLayers || Stats.NumPendingOvrpLayers;
+	}
+
+	void FDeferredDeletionQueue::ExpireBucket()
+	{
+		// Expiring is only touched here, on the render thread, so the layers are released outside the lock. Anything
+		// queued while releasing them goes to a later bucket.
+		{
+			FScopeLock Lock(&CriticalSection);
+			FBucket& Bucket = Buckets[FrameNumber % NumBuckets];
+			Swap(Expiring.Layers, Bucket.Layers);
+			Swap(Expiring.OvrpLayerIds, Bucket.OvrpLayerIds);
+
+			Stats.NumPendingLayers -= Expiring.Layers.Num();
+			Stats.NumLayersDeleted += Expiring.Layers.Num();
+			Stats.NumPendingOvrpLayers -= Expiring.OvrpLayerIds.Num();
+			Stats.NumOvrpLayersDestroyed += Expiring.OvrpLayerIds.Num();
+			Stats.NumDestroyCommands += Expiring.OvrpLayerIds.Num() ? 1 : 0;
+			++FrameNumber;
+		}
+
+		Expiring.Layers.Reset();
+
+		if (Expiring.OvrpLayerIds.Num())
+		{
+			ExecuteOnRHIThread_DoNotWait([OvrpLayerIds = TArray<uint32>(Expiring.OvrpLayerIds)]() {
+				UE_LOG(LogHMD, Verbose, TEXT("Destroying %d layers"), OvrpLayerIds.Num());
+				for (uint32 OvrpLayerId : OvrpLayerIds)
 				{
-					ExecuteOnRHIThread_DoNotWait([OvrpLayerId = Entry->OvrpLayerId]() {
-						UE_LOG(LogHMD, Warning, TEXT("Destroying layer %d"), OvrpLayerId);
-						FOculusXRHMDModule::GetPluginWrapper().DestroyLayer(OvrpLayerId);
-					});
-					DeferredDeletionArray.RemoveAtSwap(Index, 1, false);
+					FOculusXRHMDModule::GetPluginWrapper().DestroyLayer(OvrpLayerId);
 				}
-			}
+			});
+			Expiring.OvrpLayerIds.Reset();
 		}
-
-		// if the function is to be called multiple times, move this increment somewhere unique!
-		++GOculusXRHMDLayerDeletionFrameNumber;
 	}
 
 } // namespace OculusXRHMD
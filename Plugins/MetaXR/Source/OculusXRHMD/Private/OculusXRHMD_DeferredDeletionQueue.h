@@ -17,27 +17,45 @@ namespace OculusXRHMD
 	class FDeferredDeletionQueue
 	{
 	public:
+		struct FStats
+		{
+			uint64 NumLayersDeleted = 0;
+			uint64 NumOvrpLayersDestroyed = 0;
+			uint64 NumDestroyCommands = 0; // RHI commands that destroyed ovrp layers
+			uint32 NumPendingLayers = 0;
+			uint32 NumPendingOvrpLayers = 0;
+		};
+
+		// Any thread: ovrp layers released by the swapchain pool can be queued from the RHI thread
 		void AddLayerToDeferredDeletionQueue(const FLayerPtr& ptr);
 		void AddOVRPLayerToDeferredDeletionQueue(const uint32 layerID);
 		void HandleLayerDeferredDeletionQueue_RenderThread(bool bDeleteImmediately = false);
 
+		FStats GetStats_RenderThread() const;
+
 	private:
-		struct DeferredDeletionEntry
-		{
-			enum class DeferredDeletionEntryType
-			{
-				Layer,
-				OvrpLayer
-			};
+		static constexpr uint32 NUM_FRAMES_TO_WAIT_FOR_LAYER_DELETE = 3;
+		static constexpr uint32 NUM_FRAMES_TO_WAIT_FOR_OVRP_LAYER_DELETE = 7;
 
-			FLayerPtr Layer;
-			uint32 OvrpLayerId;
+		// One bucket per frame, holding what expires in that frame. Entries are added up to the longest wait plus one
+		// frames ahead of the bucket being emptied, so that many buckets plus one never alias.
+		static constexpr uint32 NumBuckets = FMath::Max(NUM_FRAMES_TO_WAIT_FOR_LAYER_DELETE, NUM_FRAMES_TO_WAIT_FOR_OVRP_LAYER_DELETE) + 2;
 
-			uint32 FrameEnqueued;
-			DeferredDeletionEntryType EntryType;
+		struct FBucket
+		{
+			TArray<FLayerPtr> Layers;
+			TArray<uint32> OvrpLayerIds;
 		};
 
-		TArray<DeferredDeletionEntry> DeferredDeletionArray;
+		// Empties the bucket of the current frame and moves on to the next
+		void ExpireBucket();
+		bool HasPending() const;
+
+		mutable FCriticalSection CriticalSection; // Guards everything below
+		FBucket Buckets[NumBuckets];
+		FBucket Expiring; // Keeps its allocations between frames
+		uint32 FrameNumber = 0;
+		FStats Stats;
 	};
 
 } // namespace OculusXRHMD
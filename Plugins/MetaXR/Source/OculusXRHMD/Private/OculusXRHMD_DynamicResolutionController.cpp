@@ -0,0 +1,423 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "OculusXRHMD_DynamicResolutionController.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+#include "OculusXRHMDModule.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<float> CVarOculusDynamicResolutionTargetGpuUtilization(
+	TEXT("r.Oculus.DynamicResolution.TargetGpuUtilization"),
+	0.85f,
+	TEXT("Share of the frame the app's GPU work may take before the dynamic resolution controller lowers the pixel density (default 0.85)\n"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarOculusDynamicResolutionCSV(
+	TEXT("vr.oculus.Debug.DynamicResolution.CSV"),
+	0,
+	TEXT("0 Off (default)\n")
+		TEXT("1 Write the dynamic resolution controller's input and output of every frame to Saved/Profiling/OculusXR/DynamicResolution-<date>.csv\n"),
+	ECVF_Default);
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// FDynamicResolutionController
+	//-------------------------------------------------------------------------------------------------
+
+	// Weight of a new sample in the smoothed GPU cost
+	static const float GpuCostSmoothing = 0.2f;
+	// Relative distance to the sustainable pixel density within which the target doesn't move
+	static const float HeadroomBand = 0.03f;
+	static const float ProportionalGain = 0.25f;
+	static const float IntegralGain = 0.02f;
+	static const float MaxIntegral = 2.0f;
+	// Frames of steady headroom before raising the pixel density
+	static const int32 IncreaseDelayFrames = 30;
+	// Share of the pixel density given up on a dropped frame, and the frames without increase that follow
+	static const float DroppedFrameBackoff = 0.1f;
+	static const int32 DroppedFrameHoldFrames = 90;
+
+	static const int32 TraceBufferLength = 16 * 1024;
+	static const TCHAR* const TraceHeader = TEXT("Scene,GpuTimeMs,FrameBudgetMs,DroppedFrames,PixelDensity,TargetPixelDensity");
+
+	static FString FormatTraceLine(FName Scene, const FDynamicResolutionController::FSample& Sample, float TargetPixelDensity)
+	{
+		return FString::Printf(TEXT("%s,%.3f,%.3f,%u,%.4f,%.4f"), *Scene.ToString(), Sample.GpuTimeMs, Sample.FrameBudgetMs, Sample.NumDroppedFrames, Sample.PixelDensity, TargetPixelDensity);
+	}
+
+	FDynamicResolutionController::FDynamicResolutionController()
+		: bHasTarget(false)
+		, TargetPixelDensity(1.0f)
+		, CostPerDensitySq(0.0f)
+		, Integral(0.0f)
+		, FramesWithHeadroom(0)
+		, HoldFrames(0)
+		, LastDirection(0)
+		, NumDecisions(0)
+		, bLogDecisions(true)
+		, LastDroppedFrameCount(-1)
+		, CSVWriter(nullptr)
+	{
+	}
+
+	FDynamicResolutionController::~FDynamicResolutionController()
+	{
+		CloseCSV();
+	}
+
+	float FDynamicResolutionController::Step(const FSample& Sample, float MinPixelDensity, float MaxPixelDensity)
+	{
+		const float PixelDensity = FMath::Max(Sample.PixelDensity, KINDA_SMALL_NUMBER);
+
+		if (!bHasTarget)
+		{
+			TargetPixelDensity = PixelDensity;
+			bHasTarget = true;
+		}
+		TargetPixelDensity = FMath::Clamp(TargetPixelDensity, MinPixelDensity, MaxPixelDensity);
+
+		// GPU cost follows the pixel count, i.e. the square of the pixel density
+		const float Cost = Sample.GpuTimeMs / FMath::Square(PixelDensity);
+		CostPerDensitySq = CostPerDensitySq > 0.0f ? FMath::Lerp(CostPerDensitySq, Cost, GpuCostSmoothing) : Cost;
+
+		const float TargetGpuTimeMs = Sample.FrameBudgetMs * FMath::Clamp(CVarOculusDynamicResolutionTargetGpuUtilization.GetValueOnGameThread(), 0.1f, 1.0f);
+		const float SustainablePixelDensity = CostPerDensitySq > 0.0f ? FMath::Sqrt(TargetGpuTimeMs / CostPerDensitySq) : MaxPixelDensity;
+		const float Error = SustainablePixelDensity / TargetPixelDensity - 1.0f;
+
+		const float OldPixelDensity = TargetPixelDensity;
+		HoldFrames = FMath::Max(HoldFrames - 1, 0);
+
+		if (Sample.NumDroppedFrames > 0)
+		{
+			// Back off from what was actually rendered and stay there for a moment
+			TargetPixelDensity = FMath::Max(FMath::Min(TargetPixelDensity, PixelDensity) * (1.0f - DroppedFrameBackoff), MinPixelDensity);
+			Integral = FMath::Min(Integral, 0.0f);
+			FramesWithHeadroom = 0;
+			HoldFrames = DroppedFrameHoldFrames;
+			LastDirection = -1;
+			NumDecisions++;
+			LogDecision(TEXT("dropped frame, lowering"), OldPixelDensity, Sample, SustainablePixelDensity);
+		}
+		else if (Error < -HeadroomBand)
+		{
+			FramesWithHeadroom = 0;
+			ApplyError(Error, MinPixelDensity, MaxPixelDensity);
+		}
+		else if (Error > HeadroomBand)
+		{
+			// A single light frame says little, only raise once the headroom lasts
+			if (HoldFrames == 0 && ++FramesWithHeadroom >= IncreaseDelayFrames)
+			{
+				ApplyError(Error, MinPixelDensity, MaxPixelDensity);
+			}
+		}
+		else
+		{
+			FramesWithHeadroom = 0;
+			Integral *= 0.9f;
+			LastDirection = 0;
+		}
+
+		const int32 Direction = TargetPixelDensity > OldPixelDensity ? 1 : (TargetPixelDensity < OldPixelDensity ? -1 : 0);
+		if (Direction != 0 && Direction != LastDirection)
+		{
+			LastDirection = Direction;
+			NumDecisions++;
+			LogDecision(Direction > 0 ? TEXT("raising") : TEXT("lowering"), OldPixelDensity, Sample, SustainablePixelDensity);
+		}
+		else
+		{
+			UE_LOG(LogHMD, VeryVerbose, TEXT("Dynamic resolution: pixel density %.3f, GPU %.2f ms of %.2f ms, sustainable %.3f"), TargetPixelDensity, Sample.GpuTimeMs, Sample.FrameBudgetMs, SustainablePixelDensity);
+		}
+
+		FSceneHistory& History = SceneHistory.FindOrAdd(Scene);
+		History.PixelDensity = TargetPixelDensity;
+		History.CostPerDensitySq = CostPerDensitySq;
+		History.NumSamples++;
+		History.NumDroppedFrames += Sample.NumDroppedFrames;
+
+		return TargetPixelDensity;
+	}
+
+	bool FDynamicResolutionController::Update_GameThread(const FSettings& InSettings, float& OutPixelDensity)
+	{
+		CheckInGameThread();
+
+		ovrpBool bIsSupported = ovrpBool_False;
+		float GpuTime = 0.0f;
+
+		// VsyncToNextVsync holds the display frequency
+		if (InSettings.VsyncToNextVsync <= 0.0f
+			|| OVRP_FAILURE(FOculusXRHMDModule::GetPluginWrapper().IsPerfMetricsSupported(ovrpPerfMetrics_App_GpuTime_Float, &bIsSupported)) || bIsSupported == ovrpBool_False
+			|| OVRP_FAILURE(FOculusXRHMDModule::GetPluginWrapper().GetPerfMetricsFloat(ovrpPerfMetrics_App_GpuTime_Float, &GpuTime)) || GpuTime <= 0.0f)
+		{
+			return false;
+		}
+
+		// The runtime reports a running count of dropped frames
+		uint32 NumDroppedFrames = 0;
+		int DroppedFrameCount = 0;
+		if (OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().IsPerfMetricsSupported(ovrpPerfMetrics_Compositor_DroppedFrameCount_Int, &bIsSupported)) && bIsSupported == ovrpBool_True
+			&& OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().GetPerfMetricsInt(ovrpPerfMetrics_Compositor_DroppedFrameCount_Int, &DroppedFrameCount)))
+		{
+			if (LastDroppedFrameCount >= 0 && DroppedFrameCount > LastDroppedFrameCount)
+			{
+				NumDroppedFrames = DroppedFrameCount - LastDroppedFrameCount;
+			}
+			LastDroppedFrameCount = DroppedFrameCount;
+		}
+
+		FSample Sample;
+		Sample.GpuTimeMs = GpuTime * 1000.0f;
+		Sample.FrameBudgetMs = 1000.0f / InSettings.VsyncToNextVsync;
+		Sample.NumDroppedFrames = NumDroppedFrames;
+		Sample.PixelDensity = InSettings.PixelDensity;
+
+		OutPixelDensity = Step(Sample, InSettings.PixelDensityMin, InSettings.PixelDensityMax);
+		UpdateCSV_GameThread(Sample);
+		return true;
+	}
+
+	void FDynamicResolutionController::SetScene(FName InScene)
+	{
+		if (InScene == Scene)
+		{
+			return;
+		}
+
+		Scene = InScene;
+		Integral = 0.0f;
+		FramesWithHeadroom = 0;
+		HoldFrames = 0;
+		LastDirection = 0;
+
+		if (const FSceneHistory* History = SceneHistory.Find(Scene))
+		{
+			TargetPixelDensity = History->PixelDensity;
+			CostPerDensitySq = History->CostPerDensitySq;
+			bHasTarget = true;
+
+			if (bLogDecisions)
+			{
+				UE_LOG(LogHMD, Log, TEXT("Dynamic resolution: entering %s, resuming at pixel density %.3f"), *Scene.ToString(), TargetPixelDensity);
+			}
+		}
+		else
+		{
+			// Learn the new scene's cost from scratch, starting from the current pixel density
+			CostPerDensitySq = 0.0f;
+		}
+	}
+
+	void FDynamicResolutionController::Reset()
+	{
+		bHasTarget = false;
+		CostPerDensitySq = 0.0f;
+		Integral = 0.0f;
+		FramesWithHeadroom = 0;
+		HoldFrames = 0;
+		LastDirection = 0;
+	}
+
+	void FDynamicResolutionController::Dump(FOutputDevice& Ar) const
+	{
+		Ar.Logf(TEXT("Dynamic resolution controller: scene %s, target pixel density %.3f, %.3f GPU ms per squared pixel density, integral %.3f, %llu decisions"),
+			*Scene.ToString(), TargetPixelDensity, CostPerDensitySq, Integral, NumDecisions);
+		Ar.Logf(TEXT("%-48s %8s %8s %10s %8s"), TEXT("Scene"), TEXT("density"), TEXT("cost"), TEXT("samples"), TEXT("dropped"));
+
+		for (const TPair<FName, FSceneHistory>& Pair : SceneHistory)
+		{
+			Ar.Logf(TEXT("%-48s %8.3f %8.3f %10llu %8llu"), *Pair.Key.ToString(), Pair.Value.PixelDensity, Pair.Value.CostPerDensitySq, Pair.Value.NumSamples, Pair.Value.NumDroppedFrames);
+		}
+	}
+
+	bool FDynamicResolutionController::Replay(const FString& TraceFileName, float MinPixelDensity, float MaxPixelDensity, const FString& OutFileName, FOutputDevice& Ar)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *TraceFileName))
+		{
+			Ar.Logf(TEXT("Could not read %s"), *TraceFileName);
+			return false;
+		}
+
+		FDynamicResolutionController Controller;
+		Controller.bLogDecisions = false;
+
+		FSettings SimSettings;
+		SimSettings.Flags.bPixelDensityAdaptive = true;
+		SimSettings.PixelDensityMin = MinPixelDensity;
+		SimSettings.PixelDensityMax = MaxPixelDensity;
+
+		FString OutLines = FString(TraceHeader) + LINE_TERMINATOR;
+		int32 NumFrames = 0;
+		int32 NumFramesOverBudget = 0;
+		uint64 NumDroppedFrames = 0;
+		uint64 NumRecordedDroppedFrames = 0;
+		double PixelDensitySum = 0.0;
+		double RecordedPixelDensitySum = 0.0;
+		float LowestPixelDensity = MaxPixelDensity;
+
+		// The first line is the header
+		for (int32 LineIndex = 1; LineIndex < Lines.Num(); LineIndex++)
+		{
+			TArray<FString> Columns;
+			if (Lines[LineIndex].ParseIntoArray(Columns, TEXT(","), false) < 5)
+			{
+				continue;
+			}
+
+			const float RecordedGpuTimeMs = FCString::Atof(*Columns[1]);
+			const float FrameBudgetMs = FCString::Atof(*Columns[2]);
+			const uint32 RecordedDroppedFrames = (uint32)FMath::Max(FCString::Atoi(*Columns[3]), 0);
+			const float RecordedPixelDensity = FCString::Atof(*Columns[4]);
+			if (RecordedPixelDensity <= 0.0f || FrameBudgetMs <= 0.0f)
+			{
+				continue;
+			}
+
+			if (NumFrames == 0)
+			{
+				SimSettings.PixelDensity = FMath::Clamp(RecordedPixelDensity, MinPixelDensity, MaxPixelDensity);
+			}
+			Controller.SetScene(FName(*Columns[0]));
+
+			FSample Sample;
+			Sample.GpuTimeMs = RecordedGpuTimeMs * FMath::Square(SimSettings.PixelDensity / RecordedPixelDensity);
+			Sample.FrameBudgetMs = FrameBudgetMs;
+			Sample.PixelDensity = SimSettings.PixelDensity;
+
+			// Drops the GPU didn't cause happen at any pixel density
+			if (Sample.GpuTimeMs > FrameBudgetMs)
+			{
+				Sample.NumDroppedFrames = FMath::Max(RecordedDroppedFrames, 1u);
+				NumFramesOverBudget++;
+			}
+			else
+			{
+				Sample.NumDroppedFrames = RecordedGpuTimeMs <= FrameBudgetMs ? RecordedDroppedFrames : 0;
+			}
+
+			const float Target = Controller.Step(Sample, MinPixelDensity, MaxPixelDensity);
+			SimSettings.SetPixelDensitySmooth(Target);
+
+			NumFrames++;
+			NumDroppedFrames += Sample.NumDroppedFrames;
+			NumRecordedDroppedFrames += RecordedDroppedFrames;
+			PixelDensitySum += Sample.PixelDensity;
+			RecordedPixelDensitySum += RecordedPixelDensity;
+			LowestPixelDensity = FMath::Min(LowestPixelDensity, Sample.PixelDensity);
+
+			if (!OutFileName.IsEmpty())
+			{
+				OutLines += FormatTraceLine(Controller.Scene, Sample, Target);
+				OutLines += LINE_TERMINATOR;
+			}
+		}
+
+		if (NumFrames == 0)
+		{
+			Ar.Logf(TEXT("%s has no frames to replay"), *TraceFileName);
+			return false;
+		}
+
+		Ar.Logf(TEXT("Replayed %d frames of %s with pixel density in [%.2f, %.2f]"), NumFrames, *TraceFileName, MinPixelDensity, MaxPixelDensity);
+		Ar.Logf(TEXT("  mean pixel density %.3f (recorded %.3f), lowest %.3f"), PixelDensitySum / NumFrames, RecordedPixelDensitySum / NumFrames, LowestPixelDensity);
+		Ar.Logf(TEXT("  %d frames over GPU budget, %llu dropped frames (recorded %llu), %llu decisions"), NumFramesOverBudget, NumDroppedFrames, NumRecordedDroppedFrames, Controller.NumDecisions);
+		Controller.Dump(Ar);
+
+		if (!OutFileName.IsEmpty())
+		{
+			if (!FFileHelper::SaveStringToFile(OutLines, *OutFileName))
+			{
+				Ar.Logf(TEXT("Could not write %s"), *OutFileName);
+				return false;
+			}
+			Ar.Logf(TEXT("Wrote the replayed frames to %s"), *OutFileName);
+		}
+
+		return true;
+	}
+
+	void FDynamicResolutionController::ApplyError(float Error, float MinPixelDensity, float MaxPixelDensity)
+	{
+		const float PrevIntegral = Integral;
+		Integral = FMath::Clamp(Integral + Error, -MaxIntegral, MaxIntegral);
+
+		const float NewPixelDensity = TargetPixelDensity * (1.0f + ProportionalGain * Error + IntegralGain * Integral);
+		TargetPixelDensity = FMath::Clamp(NewPixelDensity, MinPixelDensity, MaxPixelDensity);
+
+		// Don't wind up against a bound
+		if (TargetPixelDensity != NewPixelDensity)
+		{
+			Integral = PrevIntegral;
+		}
+	}
+
+	void FDynamicResolutionController::LogDecision(const TCHAR* Decision, float OldPixelDensity, const FSample& Sample, float SustainablePixelDensity) const
+	{
+		if (bLogDecisions)
+		{
+			UE_LOG(LogHMD, Log, TEXT("Dynamic resolution: %s pixel density %.3f -> %.3f (GPU %.2f ms of %.2f ms, %u dropped, sustainable %.3f, %s)"),
+				Decision, OldPixelDensity, TargetPixelDensity, Sample.GpuTimeMs, Sample.FrameBudgetMs, Sample.NumDroppedFrames, SustainablePixelDensity, *Scene.ToString());
+		}
+	}
+
+	void FDynamicResolutionController::UpdateCSV_GameThread(const FSample& Sample)
+	{
+		if (CVarOculusDynamicResolutionCSV.GetValueOnGameThread() == 0)
+		{
+			CloseCSV();
+			return;
+		}
+
+		if (!CSVWriter)
+		{
+			const FString FileName = FPaths::ProfilingDir() / TEXT("OculusXR") / FString::Printf(TEXT("DynamicResolution-%s.csv"), *FDateTime::Now().ToString());
+			CSVWriter = IFileManager::Get().CreateFileWriter(*FileName);
+			if (!CSVWriter)
+			{
+				UE_LOG(LogHMD, Warning, TEXT("Could not open %s, disabling vr.oculus.Debug.DynamicResolution.CSV"), *FileName);
+				CVarOculusDynamicResolutionCSV->Set(0, ECVF_SetByCode);
+				return;
+			}
+
+			UE_LOG(LogHMD, Log, TEXT("Writing the dynamic resolution trace to %s"), *FileName);
+			PendingCSVLines = TraceHeader;
+			PendingCSVLines += LINE_TERMINATOR;
+		}
+
+		PendingCSVLines += FormatTraceLine(Scene, Sample, TargetPixelDensity);
+		PendingCSVLines += LINE_TERMINATOR;
+
+		if (PendingCSVLines.Len() >= TraceBufferLength)
+		{
+			FTCHARToUTF8 Converted(*PendingCSVLines, PendingCSVLines.Len());
+			CSVWriter->Serialize((void*)Converted.Get(), Converted.Length());
+			PendingCSVLines.Reset();
+		}
+	}
+
+	void FDynamicResolutionController::CloseCSV()
+	{
+		if (CSVWriter)
+		{
+			FTCHARToUTF8 Converted(*PendingCSVLines, PendingCSVLines.Len());
+			CSVWriter->Serialize((void*)Converted.Get(), Converted.Length());
+			CSVWriter->Close();
+			delete CSVWriter;
+			CSVWriter = nullptr;
+		}
+
+		PendingCSVLines.Reset();
+	}
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
@@ -0,0 +1,95 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+#include "OculusXRHMDPrivate.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+#include "OculusXRHMD_Settings.h"
+
+class FArchive;
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// FDynamicResolutionController
+	//-------------------------------------------------------------------------------------------------
+
+	// Picks the adaptive pixel density from the measured GPU frame time. GPU cost is modelled as proportional to the
+	// pixel count (the square of the pixel density), which gives the highest density that fits the GPU time budget;
+	// a PI loop on the relative distance to that density moves the target. Decreases happen right away, increases
+	// only after the headroom has lasted a while, and a compositor frame drop backs off and holds increases for a
+	// moment. What was learned is kept per scene so coming back to a map starts from where it settled. Game thread.
+	class FDynamicResolutionController
+	{
+	public:
+		struct FSample
+		{
+			float GpuTimeMs;		 // app GPU time of the last frame
+			float FrameBudgetMs;	 // display refresh interval
+			uint32 NumDroppedFrames; // compositor frames dropped since the previous sample
+			float PixelDensity;		 // pixel density the frame was rendered at
+		};
+
+		FDynamicResolutionController();
+		~FDynamicResolutionController();
+
+		// Returns the pixel density to aim for, within [MinPixelDensity, MaxPixelDensity]
+		float Step(const FSample& Sample, float MinPixelDensity, float MaxPixelDensity);
+
+		// Samples the runtime's GPU timings and steps the controller. Returns false when the runtime doesn't report
+		// the app's GPU time.
+		bool Update_GameThread(const FSettings& InSettings, float& OutPixelDensity);
+
+		void SetScene(FName InScene);
+		// Forgets the live filter state, keeps the per-scene history
+		void Reset();
+
+		void Dump(FOutputDevice& Ar) const;
+
+		// Runs a new controller over a trace written with vr.oculus.Debug.DynamicResolution.CSV, scaling the recorded
+		// GPU times to the replayed pixel density, and prints how it would have done. Optionally writes the replayed
+		// frames to OutFileName.
+		static bool Replay(const FString& TraceFileName, float MinPixelDensity, float MaxPixelDensity, const FString& OutFileName, FOutputDevice& Ar);
+
+	private:
+		struct FSceneHistory
+		{
+			float PixelDensity = 0.0f;
+			float CostPerDensitySq = 0.0f;
+			uint64 NumSamples = 0;
+			uint64 NumDroppedFrames = 0;
+		};
+
+		void ApplyError(float Error, float MinPixelDensity, float MaxPixelDensity);
+		void LogDecision(const TCHAR* Decision, float OldPixelDensity, const FSample& Sample, float SustainablePixelDensity) const;
+		void UpdateCSV_GameThread(const FSample& Sample);
+		void CloseCSV();
+
+		FName Scene;
+		TMap<FName, FSceneHistory> SceneHistory;
+
+		bool bHasTarget;
+		float TargetPixelDensity;
+		float CostPerDensitySq; // smoothed GPU milliseconds per squared pixel density, 0 until the first sample
+		float Integral;
+		int32 FramesWithHeadroom;
+		int32 HoldFrames;
+		int32 LastDirection;
+		uint64 NumDecisions;
+		bool bLogDecisions;
+
+		// Runtime sampling
+		int32 LastDroppedFrameCount;
+
+		// Trace writer
+		FArchive* CSVWriter;
+		FString PendingCSVLines;
+	};
+
+	typedef TSharedPtr<FDynamicResolutionController, ESPMode::ThreadSafe> FDynamicResolutionControllerPtr;
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
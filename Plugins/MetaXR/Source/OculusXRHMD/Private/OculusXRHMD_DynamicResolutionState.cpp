@@ -14,17 +14,21 @@ namespace OculusXRHMD
 	// FDynamicResolutionState implementation
 	//-------------------------------------------------------------------------------------------------
 
-	FDynamicResolutionState::FDynamicResolutionState(const OculusXRHMD::FSettingsPtr InSettings)
+	FDynamicResolutionState::FDynamicResolutionState(const OculusXRHMD::FSettingsPtr InSettings, const FDynamicResolutionControllerPtr InController)
 		: Settings(InSettings)
+		, Controller(InController)
 		, ResolutionFraction(-1.0f)
 		, ResolutionFractionUpperBound(-1.0f)
 	{
 		check(Settings.IsValid());
+		check(Controller.IsValid());
 	}
 
-	void FDynamicResolutionState::ResetHistory(){
-		// Empty - Oculus drives resolution fraction externally
-	};
+	void FDynamicResolutionState::ResetHistory()
+	{
+		// Oculus drives resolution fraction externally, from FDynamicResolutionController
+		Controller->Reset();
+	}
 
 	bool FDynamicResolutionState::IsSupported() const
 	{
@@ -66,13 +70,14 @@ namespace OculusXRHMD
 		DynamicRenderScaling::TMap<float> ResolutionFractions;
 		ResolutionFractions.SetAll(1.0f);
 		ResolutionFractions[GDynamicPrimaryResolutionFraction] = ResolutionFractionUpperBound;
-		return ResolutionFractionUpperBound;
+		return ResolutionFractions;
 	}
 
 	void FDynamicResolutionState::SetEnabled(bool bEnable)
 	{
 		check(IsInGameThread());
 		Settings->Flags.bPixelDensityAdaptive = bEnable;
+		Settings->MarkStereoParamsDirty();
 	}
 
 	bool FDynamicResolutionState::IsEnabled() const
@@ -6,6 +6,7 @@
 
 #if OCULUS_HMD_SUPPORTED_PLATFORMS
 #include "OculusXRHMD_Settings.h"
+#include "OculusXRHMD_DynamicResolutionController.h"
 #include "DynamicResolutionState.h"
 
 namespace OculusXRHMD
@@ -18,7 +19,7 @@ namespace OculusXRHMD
 	class FDynamicResolutionState : public IDynamicResolutionState
 	{
 	public:
-		FDynamicResolutionState(const OculusXRHMD::FSettingsPtr InSettings);
+		FDynamicResolutionState(const OculusXRHMD::FSettingsPtr InSettings, const FDynamicResolutionControllerPtr InController);
 
 		// ISceneViewFamilyScreenPercentage
 		virtual void ResetHistory() override;
@@ -37,6 +38,7 @@ namespace OculusXRHMD
 
 	private:
 		const OculusXRHMD::FSettingsPtr Settings;
+		const FDynamicResolutionControllerPtr Controller;
 		float ResolutionFraction;
 		float ResolutionFractionUpperBound;
 	};
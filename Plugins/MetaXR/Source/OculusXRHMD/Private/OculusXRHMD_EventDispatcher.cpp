@@ -0,0 +1,152 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "OculusXRHMD_EventDispatcher.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// FEventDispatcher
+	//-------------------------------------------------------------------------------------------------
+
+	void FEventDispatcher::AddDelegate(ovrpEventType EventType, const FOculusXRHMDEventPollingDelegate& Delegate)
+	{
+		CheckInGameThread();
+
+		GetEventType(EventType).Delegates.Add(Delegate);
+	}
+
+	void FEventDispatcher::AddDelegate(const FOculusXRHMDEventPollingDelegate& Delegate)
+	{
+		CheckInGameThread();
+
+		AllEventsDelegates.Add(Delegate);
+	}
+
+	void FEventDispatcher::SetBatched(ovrpEventType EventType, bool bBatched)
+	{
+		CheckInGameThread();
+
+		GetEventType(EventType).Stats.bBatched = bBatched;
+	}
+
+	void FEventDispatcher::Dispatch(ovrpEventDataBuffer& Event)
+	{
+		const int32 Index = FMath::Clamp((int32)Event.EventType, 0, MaxEventType);
+		FEventType& Type = GetEventType(Index);
+
+		Type.Stats.NumReceived++;
+		if (Type.NumThisFrame++ == 0)
+		{
+			EventTypesThisFrame.Add(Index);
+		}
+
+		if (Type.Stats.bBatched)
+		{
+			BatchedEvents.Add(Event);
+		}
+		else
+		{
+			DispatchToDelegates(Type, Event);
+		}
+	}
+
+	void FEventDispatcher::Flush()
+	{
+		for (int32 EventIndex = 0; EventIndex < BatchedEvents.Num(); EventIndex++)
+		{
+			DispatchToDelegates(GetEventType(BatchedEvents[EventIndex].EventType), BatchedEvents[EventIndex]);
+		}
+		BatchedEvents.Reset();
+
+		for (int32 Index : EventTypesThisFrame)
+		{
+			FEventType& Type = *EventTypes[Index];
+			Type.Stats.MaxPerFrame = FMath::Max(Type.Stats.MaxPerFrame, Type.NumThisFrame);
+			Type.NumThisFrame = 0;
+		}
+
+		EventTypesThisFrame.Reset();
+	}
+
+	bool FEventDispatcher::GetStats(ovrpEventType EventType, FEventTypeStats& OutStats) const
+	{
+		const FEventType* Type = FindEventType(EventType);
+		if (!Type)
+		{
+			return false;
+		}
+
+		OutStats = Type->Stats;
+		return true;
+	}
+
+	void FEventDispatcher::DumpStats(FOutputDevice& Ar) const
+	{
+		Ar.Logf(TEXT("%-10s %10s %10s %10s %8s  %s"), TEXT("EventType"), TEXT("received"), TEXT("unhandled"), TEXT("max/frame"), TEXT("batched"), TEXT("delegates"));
+
+		for (int32 Index = 0; Index < EventTypes.Num(); Index++)
+		{
+			const FEventType* Type = EventTypes[Index].Get();
+			if (Type && (Type->Stats.NumReceived || Type->Delegates.Num()))
+			{
+				const FString Name = Index < MaxEventType ? FString::FromInt(Index) : FString(TEXT("other"));
+				Ar.Logf(TEXT("%-10s %10llu %10llu %10u %8s  %d"), *Name, Type->Stats.NumReceived, Type->Stats.NumUnhandled, Type->Stats.MaxPerFrame,
+					Type->Stats.bBatched ? TEXT("yes") : TEXT("no"), Type->Delegates.Num() + AllEventsDelegates.Num());
+			}
+		}
+	}
+
+	FEventDispatcher::FEventType& FEventDispatcher::GetEventType(int32 EventType)
+	{
+		const int32 Index = FMath::Clamp(EventType, 0, MaxEventType);
+
+		if (Index >= EventTypes.Num())
+		{
+			EventTypes.SetNum(Index + 1);
+		}
+
+		if (!EventTypes[Index].IsValid())
+		{
+			EventTypes[Index] = MakeUnique<FEventType>();
+		}
+
+		return *EventTypes[Index];
+	}
+
+	const FEventDispatcher::FEventType* FEventDispatcher::FindEventType(int32 EventType) const
+	{
+		const int32 Index = FMath::Clamp(EventType, 0, MaxEventType);
+		return EventTypes.IsValidIndex(Index) ? EventTypes[Index].Get() : nullptr;
+	}
+
+	void FEventDispatcher::DispatchToDelegates(FEventType& Type, ovrpEventDataBuffer& Event)
+	{
+		bool bHandled = false;
+
+		for (int32 DelegateIndex = 0; DelegateIndex < Type.Delegates.Num(); DelegateIndex++)
+		{
+			bool bHandledByDelegate = false;
+			Type.Delegates[DelegateIndex].ExecuteIfBound(&Event, bHandledByDelegate);
+			bHandled |= bHandledByDelegate;
+		}
+
+		for (int32 DelegateIndex = 0; DelegateIndex < AllEventsDelegates.Num(); DelegateIndex++)
+		{
+			bool bHandledByDelegate = false;
+			AllEventsDelegates[DelegateIndex].ExecuteIfBound(&Event, bHandledByDelegate);
+			bHandled |= bHandledByDelegate;
+		}
+
+		if (!bHandled)
+		{
+			Type.Stats.NumUnhandled++;
+		}
+	}
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
@@ -0,0 +1,69 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+#include "OculusXRHMDPrivate.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+
+namespace OculusXRHMD
+{
+
+	DECLARE_DELEGATE_TwoParams(FOculusXRHMDEventPollingDelegate, ovrpEventDataBuffer*, bool&);
+
+	//-------------------------------------------------------------------------------------------------
+	// FEventDispatcher
+	//-------------------------------------------------------------------------------------------------
+
+	// Hands the events polled from OVRPlugin to the delegates registered for their type, through a table indexed by
+	// ovrpEventType. Events of batched types are queued while polling and dispatched, in the order they arrived, once
+	// the frame's polling is done; events that must follow them (e.g. a query's completion after its results) need to
+	// be batched too. Game thread.
+	class FEventDispatcher
+	{
+	public:
+		struct FEventTypeStats
+		{
+			uint64 NumReceived = 0;
+			uint64 NumUnhandled = 0; // no delegate reported the event as handled
+			uint32 MaxPerFrame = 0;
+			bool bBatched = false;
+		};
+
+		void AddDelegate(ovrpEventType EventType, const FOculusXRHMDEventPollingDelegate& Delegate);
+		// Delegates without a type see every event
+		void AddDelegate(const FOculusXRHMDEventPollingDelegate& Delegate);
+		void SetBatched(ovrpEventType EventType, bool bBatched);
+
+		void Dispatch(ovrpEventDataBuffer& Event);
+		// Dispatches the queued events and closes the frame's counters; call once per frame after polling
+		void Flush();
+
+		bool GetStats(ovrpEventType EventType, FEventTypeStats& OutStats) const;
+		void DumpStats(FOutputDevice& Ar) const;
+
+	private:
+		struct FEventType
+		{
+			TArray<FOculusXRHMDEventPollingDelegate, TInlineAllocator<1>> Delegates;
+			uint32 NumThisFrame = 0;
+			FEventTypeStats Stats;
+		};
+
+		// Event types are small numbers; anything above this shares one entry
+		static constexpr int32 MaxEventType = 4096;
+
+		FEventType& GetEventType(int32 EventType);
+		const FEventType* FindEventType(int32 EventType) const;
+		void DispatchToDelegates(FEventType& Type, ovrpEventDataBuffer& Event);
+
+		// Entries are allocated separately so delegates can register new types while an event is dispatched
+		TArray<TUniquePtr<FEventType>> EventTypes;
+		TArray<FOculusXRHMDEventPollingDelegate> AllEventsDelegates;
+		TArray<ovrpEventDataBuffer> BatchedEvents;
+		TArray<int32> EventTypesThisFrame;
+	};
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
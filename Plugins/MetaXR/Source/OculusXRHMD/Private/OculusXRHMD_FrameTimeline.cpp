@@ -0,0 +1,300 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "OculusXRHMD_FrameTimeline.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/ThreadManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<int32> CVarOculusTimelineCSV(
+	TEXT("vr.oculus.Debug.Timeline.CSV"),
+	0,
+	TEXT("0 Off (default)\n")
+		TEXT("1 Write the XR frame timeline of every frame to Saved/Profiling/OculusXR/FrameTimeline-<date>.csv\n"),
+	ECVF_Default);
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// FFrameTimeline
+	//-------------------------------------------------------------------------------------------------
+
+	static const uint32 InvalidFrameNumber = MAX_uint32;
+
+	// Frames still in flight are at most this many frames behind the game thread; older unfinished frames never finish
+	static const uint32 CSVFrameLag = 8;
+	static const int32 CSVBufferLength = 16 * 1024;
+
+	static const TCHAR* const StageNames[] = {
+		TEXT("GameFrameStart"),
+		TEXT("WaitFrameBegin"),
+		TEXT("WaitFrameEnd"),
+		TEXT("RenderFrameStart"),
+		TEXT("RenderThreadStart"),
+		TEXT("RHIFrameStart"),
+		TEXT("BeginFrameBegin"),
+		TEXT("BeginFrameEnd"),
+		TEXT("EndFrameBegin"),
+		TEXT("EndFrameEnd"),
+	};
+	static_assert(UE_ARRAY_COUNT(StageNames) == (int32)EFrameTimelineStage::Count, "StageNames out of date");
+
+	// Intervals reported by Dump, named after what the frame was waiting on or doing
+	struct FFrameTimelineInterval
+	{
+		const TCHAR* Name;
+		EFrameTimelineStage From;
+		EFrameTimelineStage To;
+	};
+
+	static const FFrameTimelineInterval Intervals[] = {
+		{ TEXT("WaitFrame (compositor)"), EFrameTimelineStage::WaitFrameBegin, EFrameTimelineStage::WaitFrameEnd },
+		{ TEXT("Game"), EFrameTimelineStage::WaitFrameEnd, EFrameTimelineStage::RenderFrameStart },
+		{ TEXT("RenderThreadLatency"), EFrameTimelineStage::RenderFrameStart, EFrameTimelineStage::RenderThreadStart },
+		{ TEXT("Render"), EFrameTimelineStage::RenderThreadStart, EFrameTimelineStage::RHIFrameStart },
+		{ TEXT("RHIThreadLatency"), EFrameTimelineStage::RHIFrameStart, EFrameTimelineStage::BeginFrameBegin },
+		{ TEXT("BeginFrame"), EFrameTimelineStage::BeginFrameBegin, EFrameTimelineStage::BeginFrameEnd },
+		{ TEXT("RHI"), EFrameTimelineStage::BeginFrameEnd, EFrameTimelineStage::EndFrameBegin },
+		{ TEXT("EndFrame (submission)"), EFrameTimelineStage::EndFrameBegin, EFrameTimelineStage::EndFrameEnd },
+		{ TEXT("Total"), EFrameTimelineStage::GameFrameStart, EFrameTimelineStage::EndFrameEnd },
+	};
+	static const int32 NumIntervals = UE_ARRAY_COUNT(Intervals);
+
+	FFrameTimeline::FFrameTimeline()
+		: LastFrameNumber(InvalidFrameNumber)
+		, CSVWriter(nullptr)
+		, NextCSVFrameNumber(0)
+	{
+		for (FRecord& Record : Records)
+		{
+			Record.FrameNumber.store(InvalidFrameNumber, std::memory_order_relaxed);
+		}
+	}
+
+	FFrameTimeline::~FFrameTimeline()
+	{
+		CloseCSV();
+	}
+
+	void FFrameTimeline::BeginFrame(uint32 FrameNumber)
+	{
+		FRecord& Record = Records[FrameNumber % NumRecords];
+
+		// Splash frames repeat the frame number, keep what was already recorded for it
+		if (Record.FrameNumber.load(std::memory_order_relaxed) != FrameNumber)
+		{
+			Record.FrameNumber.store(InvalidFrameNumber, std::memory_order_release);
+			for (int32 Stage = 0; Stage < (int32)EFrameTimelineStage::Count; Stage++)
+			{
+				Record.Cycles[Stage].store(0, std::memory_order_relaxed);
+			}
+			Record.FrameNumber.store(FrameNumber, std::memory_order_release);
+		}
+
+		LastFrameNumber = FrameNumber;
+		Mark(FrameNumber, EFrameTimelineStage::GameFrameStart);
+	}
+
+	void FFrameTimeline::Mark(uint32 FrameNumber, EFrameTimelineStage Stage)
+	{
+		FRecord& Record = Records[FrameNumber % NumRecords];
+
+		if (Record.FrameNumber.load(std::memory_order_acquire) == FrameNumber)
+		{
+			Record.ThreadId[(int32)Stage].store(FPlatformTLS::GetCurrentThreadId(), std::memory_order_relaxed);
+			Record.Cycles[(int32)Stage].store(FPlatformTime::Cycles64(), std::memory_order_release);
+		}
+	}
+
+	bool FFrameTimeline::GetFinishedFrame(uint32 FrameNumber, FFrameSample& OutSample) const
+	{
+		const FRecord& Record = Records[FrameNumber % NumRecords];
+
+		if (Record.FrameNumber.load(std::memory_order_acquire) != FrameNumber)
+		{
+			return false;
+		}
+
+		OutSample.FrameNumber = FrameNumber;
+		for (int32 Stage = 0; Stage < (int32)EFrameTimelineStage::Count; Stage++)
+		{
+			OutSample.Cycles[Stage] = Record.Cycles[Stage].load(std::memory_order_acquire);
+			OutSample.ThreadId[Stage] = Record.ThreadId[Stage].load(std::memory_order_relaxed);
+		}
+
+		// The slot may have been claimed by a newer frame while copying
+		if (Record.FrameNumber.load(std::memory_order_acquire) != FrameNumber)
+		{
+			return false;
+		}
+
+		return OutSample.Cycles[(int32)EFrameTimelineStage::GameFrameStart] && OutSample.Cycles[(int32)EFrameTimelineStage::EndFrameEnd];
+	}
+
+	bool FFrameTimeline::GetFrameInterval(uint32 FrameNumber, EFrameTimelineStage From, EFrameTimelineStage To, float& OutMilliseconds) const
+	{
+		FFrameSample Sample;
+		if (!GetFinishedFrame(FrameNumber, Sample))
+		{
+			return false;
+		}
+
+		const uint64 FromCycles = Sample.Cycles[(int32)From];
+		const uint64 ToCycles = Sample.Cycles[(int32)To];
+		if (!FromCycles || ToCycles < FromCycles)
+		{
+			return false;
+		}
+
+		OutMilliseconds = (float)FPlatformTime::ToMilliseconds64(ToCycles - FromCycles);
+		return true;
+	}
+
+	void FFrameTimeline::Dump(FOutputDevice& Ar) const
+	{
+		TArray<float> Durations[NumIntervals];
+		uint32 ThreadIds[NumIntervals] = {};
+		int32 NumFrames = 0;
+
+		for (uint32 RecordIndex = 0; RecordIndex < NumRecords; RecordIndex++)
+		{
+			FFrameSample Sample;
+			if (!GetFinishedFrame(Records[RecordIndex].FrameNumber.load(std::memory_order_relaxed), Sample))
+			{
+				continue;
+			}
+
+			NumFrames++;
+			for (int32 IntervalIndex = 0; IntervalIndex < NumIntervals; IntervalIndex++)
+			{
+				// Stages are skipped while the splash is shown or when the session isn't running
+				const uint64 From = Sample.Cycles[(int32)Intervals[IntervalIndex].From];
+				const uint64 To = Sample.Cycles[(int32)Intervals[IntervalIndex].To];
+				if (From && To >= From)
+				{
+					Durations[IntervalIndex].Add((float)FPlatformTime::ToMilliseconds64(To - From));
+					ThreadIds[IntervalIndex] = Sample.ThreadId[(int32)Intervals[IntervalIndex].To];
+				}
+			}
+		}
+
+		Ar.Logf(TEXT("XR frame timeline, %d finished frames (ms)"), NumFrames);
+		Ar.Logf(TEXT("%-24s %8s %8s %8s %8s %6s  %s"), TEXT("Interval"), TEXT("p50"), TEXT("p90"), TEXT("p99"), TEXT("max"), TEXT("count"), TEXT("thread"));
+
+		for (int32 IntervalIndex = 0; IntervalIndex < NumIntervals; IntervalIndex++)
+		{
+			TArray<float>& Values = Durations[IntervalIndex];
+			if (Values.IsEmpty())
+			{
+				continue;
+			}
+
+			Values.Sort();
+			auto Percentile = [&Values](float P) {
+				return Values[FMath::Clamp(FMath::CeilToInt(P * Values.Num()) - 1, 0, Values.Num() - 1)];
+			};
+
+			const FString& ThreadName = FThreadManager::GetThreadName(ThreadIds[IntervalIndex]);
+			Ar.Logf(TEXT("%-24s %8.2f %8.2f %8.2f %8.2f %6d  %s"), Intervals[IntervalIndex].Name, Percentile(0.5f), Percentile(0.9f), Percentile(0.99f), Values.Last(), Values.Num(), ThreadName.IsEmpty() ? TEXT("-") : *ThreadName);
+		}
+	}
+
+	void FFrameTimeline::UpdateCSV_GameThread()
+	{
+		if (CVarOculusTimelineCSV.GetValueOnGameThread() == 0 || LastFrameNumber == InvalidFrameNumber)
+		{
+			CloseCSV();
+			return;
+		}
+
+		if (!CSVWriter)
+		{
+			const FString FileName = FPaths::ProfilingDir() / TEXT("OculusXR") / FString::Printf(TEXT("FrameTimeline-%s.csv"), *FDateTime::Now().ToString());
+			CSVWriter = IFileManager::Get().CreateFileWriter(*FileName);
+			if (!CSVWriter)
+			{
+				UE_LOG(LogHMD, Warning, TEXT("Could not open %s, disabling vr.oculus.Debug.Timeline.CSV"), *FileName);
+				CVarOculusTimelineCSV->Set(0, ECVF_SetByCode);
+				return;
+			}
+
+			UE_LOG(LogHMD, Log, TEXT("Writing the XR frame timeline to %s"), *FileName);
+
+			// Stage columns are milliseconds since GameFrameStart, empty when the stage was skipped
+			PendingCSVLines = TEXT("FrameNumber");
+			for (int32 Stage = 1; Stage < (int32)EFrameTimelineStage::Count; Stage++)
+			{
+				PendingCSVLines += TEXT(",");
+				PendingCSVLines += StageNames[Stage];
+			}
+			PendingCSVLines += LINE_TERMINATOR;
+			NextCSVFrameNumber = LastFrameNumber;
+		}
+
+		// The frame counter restarts when the device is reinitialized
+		if ((int32)(LastFrameNumber - NextCSVFrameNumber) < 0)
+		{
+			NextCSVFrameNumber = LastFrameNumber;
+		}
+
+		// Frames older than the ring are lost. Frame numbers wrap, so this is fine early in the session too.
+		if (LastFrameNumber - NextCSVFrameNumber >= NumRecords)
+		{
+			NextCSVFrameNumber = LastFrameNumber - NumRecords + CSVFrameLag;
+		}
+
+		for (; LastFrameNumber - NextCSVFrameNumber > CSVFrameLag; NextCSVFrameNumber++)
+		{
+			FFrameSample Sample;
+			if (!GetFinishedFrame(NextCSVFrameNumber, Sample))
+			{
+				continue;
+			}
+
+			const uint64 Start = Sample.Cycles[(int32)EFrameTimelineStage::GameFrameStart];
+			PendingCSVLines += FString::Printf(TEXT("%u"), Sample.FrameNumber);
+			for (int32 Stage = 1; Stage < (int32)EFrameTimelineStage::Count; Stage++)
+			{
+				if (Sample.Cycles[Stage] >= Start)
+				{
+					PendingCSVLines += FString::Printf(TEXT(",%.3f"), FPlatformTime::ToMilliseconds64(Sample.Cycles[Stage] - Start));
+				}
+				else
+				{
+					PendingCSVLines += TEXT(",");
+				}
+			}
+			PendingCSVLines += LINE_TERMINATOR;
+		}
+
+		if (PendingCSVLines.Len() >= CSVBufferLength)
+		{
+			FTCHARToUTF8 Converted(*PendingCSVLines, PendingCSVLines.Len());
+			CSVWriter->Serialize((void*)Converted.Get(), Converted.Length());
+			PendingCSVLines.Reset();
+		}
+	}
+
+	void FFrameTimeline::CloseCSV()
+	{
+		if (CSVWriter)
+		{
+			FTCHARToUTF8 Converted(*PendingCSVLines, PendingCSVLines.Len());
+			CSVWriter->Serialize((void*)Converted.Get(), Converted.Length());
+			CSVWriter->Close();
+			delete CSVWriter;
+			CSVWriter = nullptr;
+		}
+
+		PendingCSVLines.Reset();
+	}
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
@@ -0,0 +1,97 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+#include "OculusXRHMDPrivate.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+#include <atomic>
+
+class FArchive;
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// EFrameTimelineStage
+	//-------------------------------------------------------------------------------------------------
+
+	// Points of a frame's way from the game thread to the compositor, in the order they happen
+	enum class EFrameTimelineStage : uint8
+	{
+		GameFrameStart,		// StartGameFrame_GameThread, game thread
+		WaitFrameBegin,		// WaitToBeginFrame called, game thread
+		WaitFrameEnd,		// WaitToBeginFrame returned, game thread
+		RenderFrameStart,	// StartRenderFrame_GameThread, game thread
+		RenderThreadStart,	// the frame's settings and layers reach the render thread
+		RHIFrameStart,		// StartRHIFrame_RenderThread, render thread
+		BeginFrameBegin,	// BeginFrame4 called, RHI thread
+		BeginFrameEnd,		// BeginFrame4 returned, RHI thread
+		EndFrameBegin,		// EndFrame4 called, RHI thread
+		EndFrameEnd,		// EndFrame4 returned, RHI thread
+
+		Count
+	};
+
+	//-------------------------------------------------------------------------------------------------
+	// FFrameTimeline
+	//-------------------------------------------------------------------------------------------------
+
+	// Timestamps of the last frames' stages, keyed by FGameFrame::FrameNumber. Every thread writes its own stages
+	// without locking; a record belongs to the frame that claimed its slot in GameFrameStart, and stamps for a frame
+	// that no longer owns its slot (more than NumRecords frames behind) are dropped.
+	class FFrameTimeline
+	{
+	public:
+		static constexpr uint32 NumRecords = 256;
+
+		FFrameTimeline();
+		~FFrameTimeline();
+
+		// Claims the frame's record. Game thread.
+		void BeginFrame(uint32 FrameNumber);
+		// Any thread
+		void Mark(uint32 FrameNumber, EFrameTimelineStage Stage);
+
+		// Last frame claimed by BeginFrame, MAX_uint32 before the first one
+		uint32 GetLastFrameNumber() const { return LastFrameNumber; }
+		// Time between two stages of a frame whose stages were all stamped, while its record is still in the ring
+		bool GetFrameInterval(uint32 FrameNumber, EFrameTimelineStage From, EFrameTimelineStage To, float& OutMilliseconds) const;
+
+		// Percentiles of every stage interval over the recorded frames
+		void Dump(FOutputDevice& Ar) const;
+
+		// Appends finished frames to the CSV file while vr.oculus.Debug.Timeline.CSV is set. Game thread, once a frame.
+		void UpdateCSV_GameThread();
+
+	private:
+		struct FRecord
+		{
+			std::atomic<uint32> FrameNumber;
+			std::atomic<uint64> Cycles[(int32)EFrameTimelineStage::Count];
+			std::atomic<uint32> ThreadId[(int32)EFrameTimelineStage::Count];
+		};
+
+		struct FFrameSample
+		{
+			uint32 FrameNumber;
+			uint64 Cycles[(int32)EFrameTimelineStage::Count];
+			uint32 ThreadId[(int32)EFrameTimelineStage::Count];
+		};
+
+		// Copies the record of FrameNumber if all of its stages were stamped
+		bool GetFinishedFrame(uint32 FrameNumber, FFrameSample& OutSample) const;
+		void CloseCSV();
+
+		FRecord Records[NumRecords];
+		uint32 LastFrameNumber;
+
+		// CSV writer, game thread
+		FArchive* CSVWriter;
+		uint32 NextCSVFrameNumber;
+		FString PendingCSVLines;
+	};
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
@@ -23,6 +23,7 @@
 #include "OculusXRHMDPrivate.h"
 #include "OculusXRHMDModule.h"
 #include "OculusXRHMD_DeferredDeletionQueue.h"
+#include "RenderUtils.h"
 
 namespace OculusXRHMD
 {
@@ -32,7 +33,12 @@ namespace OculusXRHMD
 	//-------------------------------------------------------------------------------------------------
 
 	FOvrpLayer::FOvrpLayer(uint32 InOvrpLayerId, FDeferredDeletionQueue* InDeferredDeletion)
-		: OvrpLayerId(InOvrpLayerId), DeferredDeletion(InDeferredDeletion)
+		: OvrpLayerId(InOvrpLayerId), DeferredDeletion(InDeferredDeletion), SwapChainPool(nullptr), PoolKey()
+	{
+	}
+
+	FOvrpLayer::FOvrpLayer(const FSwapChainPoolKey& InPoolKey, const FPooledSwapChains& InPooledSwapChains, FDeferredDeletionQueue* InDeferredDeletion, FSwapChainPool* InSwapChainPool)
+		: OvrpLayerId(InPooledSwapChains.OvrpLayerId), DeferredDeletion(InDeferredDeletion), SwapChainPool(InSwapChainPool), PoolKey(InPoolKey), PooledSwapChains(InPooledSwapChains)
 	{
 	}
 
@@ -40,11 +46,23 @@ namespace OculusXRHMD
 	{
 		if (IsInGameThread())
 		{
-			ExecuteOnRenderThread([OvrpLayerId = this->OvrpLayerId, DeferredDeletion = this->DeferredDeletion]() {
-				DeferredDeletion->AddOVRPLayerToDeferredDeletionQueue(OvrpLayerId);
+			ExecuteOnRenderThread([this]() {
+				Release();
 			});
 		}
 		else
+		{
+			Release();
+		}
+	}
+
+	void FOvrpLayer::Release()
+	{
+		if (SwapChainPool)
+		{
+			SwapChainPool->Return(PoolKey, MoveTemp(PooledSwapChains));
+		}
+		else
 		{
 			DeferredDeletion->AddOVRPLayerToDeferredDeletionQueue(OvrpLayerId);
 		}
@@ -57,7 +75,10 @@ namespace OculusXRHMD
 	FLayer::FLayer(uint32 InId)
 		: bNeedsTexSrgbCreate(false)
 		, Id(InId)
+		, Generation(0)
 		, OvrpLayerId(0)
+		, bSubmitShapeValid(false)
+		, SubmitWorldToMetersScale(0.0f)
 		, bUpdateTexture(false)
 		, bInvertY(false)
 		, bHasDepth(false)
@@ -72,8 +93,11 @@ namespace OculusXRHMD
 	FLayer::FLayer(const FLayer& Layer)
 		: bNeedsTexSrgbCreate(Layer.bNeedsTexSrgbCreate)
 		, Id(Layer.Id)
+		, Generation(Layer.Generation)
 		, Desc(Layer.Desc)
 		, OvrpLayerId(Layer.OvrpLayerId)
+		, bSubmitShapeValid(false)
+		, SubmitWorldToMetersScale(0.0f)
 		, OvrpLayer(Layer.OvrpLayer)
 		, SwapChain(Layer.SwapChain)
 		, DepthSwapChain(Layer.DepthSwapChain)
@@ -108,6 +132,7 @@ namespace OculusXRHMD
 		}
 
 		Desc = InDesc;
+		Generation++;
 
 		if (!UserDefinedGeometryMap)
 		{
@@ -420,7 +445,7 @@ namespace OculusXRHMD
 		}
 	}
 
-	bool FLayer::ShapeNeedsTextures(ovrpShape shape)
+	bool FLayer::ShapeNeedsTextures(ovrpShape shape) const
 	{
 		return ((shape != ovrpShape_ReconstructionPassthrough) && (shape != ovrpShape_SurfaceProjectedPassthrough));
 	}
@@ -430,6 +455,7 @@ namespace OculusXRHMD
 		OvrpLayerDesc.EyeFov = InEyeLayerDesc;
 
 		bHasDepth = InEyeLayerDesc.DepthFormat != ovrpTextureFormat_None;
+		Generation++;
 	}
 
 	TSharedPtr<FLayer, ESPMode::ThreadSafe> FLayer::Clone() const
@@ -460,10 +486,29 @@ namespace OculusXRHMD
 		return true;
 	}
 
-	bool FLayer::Initialize_RenderThread(const FSettings* Settings, FCustomPresent* CustomPresent, FDeferredDeletionQueue* DeferredDeletion, FRHICommandListImmediate& RHICmdList, const FLayer* InLayer)
+	FSwapChainPoolKey FLayer::MakeSwapChainPoolKey() const
+	{
+		FSwapChainPoolKey Key;
+		Key.Shape = OvrpLayerDesc.Shape;
+		Key.Layout = OvrpLayerDesc.Layout;
+		Key.TextureSize = OvrpLayerDesc.TextureSize;
+		Key.MipLevels = OvrpLayerDesc.MipLevels;
+		Key.SampleCount = OvrpLayerDesc.SampleCount;
+		Key.Format = OvrpLayerDesc.Format;
+		Key.LayerFlags = OvrpLayerDesc.LayerFlags;
+		Key.bSRGB = bNeedsTexSrgbCreate || (Desc.Texture.IsValid() && EnumHasAnyFlags(Desc.Texture->GetFlags(), TexCreate_SRGB));
+		Key.bHasDepth = bHasDepth;
+		Key.bSupportDepthComposite = bSupportDepthComposite;
+		return Key;
+	}
+
+	bool FLayer::Initialize_RenderThread(const FSettings* Settings, FCustomPresent* CustomPresent, FDeferredDeletionQueue* DeferredDeletion, FSwapChainPool* SwapChainPool, FRHICommandListImmediate& RHICmdList, const FLayer* InLayer)
 	{
 		CheckInRenderThread();
 
+		// Whatever happens below, the RHI thread's copy of this layer is out of date
+		Generation++;
+
 		if (Id == 0)
 		{
 			// OvrpLayerDesc and OvrpViewportRects already initialized, as this is the eyeFOV layer. The only necessary modification is to take into account MSAA level, that can only be accurately determined on the RT.
@@ -572,7 +617,10 @@ namespace OculusXRHMD
 			}
 		}
 
-		// Reuse/Create texture set
+		// Reuse/Rent/Create texture set
+		const FSwapChainPoolKey PoolKey = MakeSwapChainPoolKey();
+		FPooledSwapChains PooledSwapChains;
+
 		if (CanReuseResources(InLayer))
 		{
 			OvrpLayerId = InLayer->OvrpLayerId;
@@ -589,8 +637,23 @@ namespace OculusXRHMD
 			bNeedsTexSrgbCreate = InLayer->bNeedsTexSrgbCreate;
 			UserDefinedGeometryMap = InLayer->UserDefinedGeometryMap;
 		}
+		else if (SwapChainPool && FSwapChainPool::IsPoolable(PoolKey) && SwapChainPool->Rent_RenderThread(PoolKey, PooledSwapChains))
+		{
+			OvrpLayerId = PooledSwapChains.OvrpLayerId;
+			OvrpLayer = MakeShareable<FOvrpLayer>(new FOvrpLayer(PoolKey, PooledSwapChains, DeferredDeletion, SwapChainPool));
+			SwapChain = PooledSwapChains.SwapChain;
+			DepthSwapChain = PooledSwapChains.DepthSwapChain;
+			FoveationSwapChain.Reset();
+			RightSwapChain = PooledSwapChains.RightSwapChain;
+			RightDepthSwapChain = PooledSwapChains.RightDepthSwapChain;
+			MotionVectorSwapChain.Reset();
+			MotionVectorDepthSwapChain.Reset();
+			InvAlphaTexture = PooledSwapChains.InvAlphaTexture;
+			bUpdateTexture = true;
+		}
 		else
 		{
+			const bool bPooled = SwapChainPool && FSwapChainPool::IsPoolable(PoolKey);
 			bool bLayerCreated = false;
 			bool bValidFoveationTextures = true;
 			TArray<ovrpTextureHandle> ColorTextures;
@@ -606,9 +669,10 @@ namespace OculusXRHMD
 			TArray<ovrpTextureHandle> MotionVectorDepthTextures;
 			ovrpSizei MotionVectorDepthTextureSize;
 
+			int32 TextureCount = 0;
+
 			ExecuteOnRHIThread([&]() {
 				// UNDONE Do this in RenderThread once OVRPlugin allows FOculusXRHMDModule::GetPluginWrapper().SetupLayer to be called asynchronously
-				int32 TextureCount;
 				if (OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().SetupLayer(CustomPresent->GetOvrpDevice(), OvrpLayerDesc.Base, (int*)&OvrpLayerId)) && OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().GetLayerTextureStageCount(OvrpLayerId, &TextureCount)))
 				{
 					if (ShapeNeedsTextures(OvrpLayerDesc.Shape))
@@ -698,7 +762,10 @@ namespace OculusXRHMD
 
 			if (bLayerCreated)
 			{
-				OvrpLayer = MakeShareable<FOvrpLayer>(new FOvrpLayer(OvrpLayerId, DeferredDeletion));
+				if (!bPooled)
+				{
+					OvrpLayer = MakeShareable<FOvrpLayer>(new FOvrpLayer(OvrpLayerId, DeferredDeletion));
+				}
 
 				if (ShapeNeedsTextures(OvrpLayerDesc.Shape))
 				{
@@ -810,6 +877,28 @@ namespace OculusXRHMD
 						}
 					}
 
+					if (bPooled)
+					{
+						const uint64 NumFaces = ResourceType == RRT_TextureCube ? 6 : 1;
+						const uint64 ColorBytes = CalcTextureSize(SizeX, SizeY, ColorFormat, FMath::Max(NumMips, 1u)) * NumFaces;
+						const uint64 DepthBytes = bHasDepth ? CalcTextureSize(SizeX, SizeY, DepthFormat, 1) * NumFaces : 0;
+
+						PooledSwapChains.OvrpLayerId = OvrpLayerId;
+						PooledSwapChains.SwapChain = SwapChain;
+						if (bHasDepth)
+						{
+							PooledSwapChains.DepthSwapChain = DepthSwapChain;
+						}
+						if (OvrpLayerDesc.Layout == ovrpLayout_Stereo)
+						{
+							PooledSwapChains.RightSwapChain = RightSwapChain;
+							PooledSwapChains.RightDepthSwapChain = bHasDepth ? RightDepthSwapChain : nullptr;
+						}
+						PooledSwapChains.InvAlphaTexture = InvAlphaTexture;
+						PooledSwapChains.SizeInBytes = (ColorBytes + DepthBytes) * TextureCount * (OvrpLayerDesc.Layout == ovrpLayout_Stereo ? 2 : 1) + (InvAlphaTexture.IsValid() ? ColorBytes : 0);
+						OvrpLayer = MakeShareable<FOvrpLayer>(new FOvrpLayer(PoolKey, PooledSwapChains, DeferredDeletion, SwapChainPool));
+					}
+
 					bUpdateTexture = true;
 				}
 				else
@@ -831,12 +920,26 @@ namespace OculusXRHMD
 			}
 		}
 
+		RequestContinuousUpdate_RenderThread();
+
+		return true;
+	}
+
+	void FLayer::RequestContinuousUpdate_RenderThread()
+	{
+		CheckInRenderThread();
+
 		if ((Desc.Flags & IStereoLayers::LAYER_FLAG_TEX_CONTINUOUS_UPDATE) && Desc.Texture.IsValid() && IsVisible())
 		{
 			bUpdateTexture = true;
 		}
+	}
 
-		return true;
+	bool FLayer::IsInitialized_RenderThread() const
+	{
+		CheckInRenderThread();
+
+		return OvrpLayer.IsValid() && (SwapChain.IsValid() || !ShapeNeedsTextures(OvrpLayerDesc.Shape));
 	}
 
 	void FLayer::UpdatePassthroughStyle_RenderThread(const FEdgeStyleParameters& EdgeStyleParameters)
@@ -1103,6 +1206,76 @@ namespace OculusXRHMD
 		TrackingSpaceDeltaPose = SettingBasePose.Inverse() * TrackingSpaceDeltaPose * SettingBasePose;
 	}
 
+	void FLayer::UpdateLayerShape_RHIThread(const FVector& LocationScale)
+	{
+		int SizeX = OvrpLayerDesc.TextureSize.w;
+		int SizeY = OvrpLayerDesc.TextureSize.h;
+
+		float AspectRatio = SizeX ? (float)SizeY / (float)SizeX : 3.0f / 4.0f;
+		ovrpVector3f Scale = ToOvrpVector3f(Desc.Transform.GetScale3D() * LocationScale);
+
+		switch (OvrpLayerDesc.Shape)
+		{
+			case ovrpShape_ReconstructionPassthrough:
+			{
+				float QuadSizeY = (Desc.Flags & IStereoLayers::LAYER_FLAG_QUAD_PRESERVE_TEX_RATIO) ? Desc.QuadSize.X * AspectRatio : Desc.QuadSize.Y;
+				OvrpLayerSubmit.Quad.Size = ovrpSizef{ static_cast<float>(Desc.QuadSize.X * Scale.x), static_cast<float>(QuadSizeY * Scale.y) };
+			}
+			break;
+
+			case ovrpShape_Quad:
+			{
+				float QuadSizeY = (Desc.Flags & IStereoLayers::LAYER_FLAG_QUAD_PRESERVE_TEX_RATIO) ? Desc.QuadSize.X * AspectRatio : Desc.QuadSize.Y;
+				OvrpLayerSubmit.Quad.Size = ovrpSizef{ static_cast<float>(Desc.QuadSize.X * Scale.x), static_cast<float>(QuadSizeY * Scale.y) };
+			}
+			break;
+			case ovrpShape_Cylinder:
+			{
+				const FCylinderLayer& CylinderProps = Desc.GetShape<FCylinderLayer>();
+				float CylinderHeight = (Desc.Flags & IStereoLayers::LAYER_FLAG_QUAD_PRESERVE_TEX_RATIO) ? CylinderProps.OverlayArc * AspectRatio : CylinderProps.Height;
+				OvrpLayerSubmit.Cylinder.ArcWidth = CylinderProps.OverlayArc * Scale.x;
+				OvrpLayerSubmit.Cylinder.Height = CylinderHeight * Scale.x;
+				OvrpLayerSubmit.Cylinder.Radius = CylinderProps.Radius * Scale.x;
+			}
+			break;
+		}
+
+		OvrpLayerSubmit.LayerSubmitFlags = 0;
+
+		if (Desc.PositionType == IStereoLayers::FaceLocked)
+		{
+			OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_HeadLocked;
+		}
+
+		if (!(Desc.Flags & IStereoLayers::LAYER_FLAG_SUPPORT_DEPTH))
+		{
+			OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_NoDepth;
+		}
+
+#ifdef WITH_OCULUS_BRANCH
+		if (Desc.Flags & IStereoLayers::LAYER_FLAG_AUTO_FILTERING)
+		{
+			OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_AutoLayerFilter;
+		}
+		if (Desc.Flags & IStereoLayers::LAYER_FLAG_NORMAL_SUPERSAMPLE)
+		{
+			OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_EfficientSuperSample;
+		}
+		if (Desc.Flags & IStereoLayers::LAYER_FLAG_QUALITY_SUPERSAMPLE)
+		{
+			OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_ExpensiveSuperSample;
+		}
+		if (Desc.Flags & IStereoLayers::LAYER_FLAG_NORMAL_SHARPEN)
+		{
+			OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_EfficientSharpen;
+		}
+		if (Desc.Flags & IStereoLayers::LAYER_FLAG_QUALITY_SHARPEN)
+		{
+			OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_QualitySharpen;
+		}
+#endif
+	}
+
 	const ovrpLayerSubmit* FLayer::UpdateLayer_RHIThread(const FSettings* Settings, const FGameFrame* Frame, const int LayerIndex)
 	{
 		OvrpLayerSubmit.LayerId = OvrpLayerId;
@@ -1112,7 +1285,13 @@ namespace OculusXRHMD
 		OvrpLayerSubmit.ColorOffset = injectColorScale ? Settings->ColorOffset : ovrpVector4f{ 0, 0, 0, 0 };
 		OvrpLayerSubmit.ColorScale = injectColorScale ? Settings->ColorScale : ovrpVector4f{ 1, 1, 1, 1 };
 
-		if (OvrpLayerDesc.Shape == ovrpShape_Equirect)
+		// The RHI thread keeps its copy of a layer for as long as the layer doesn't change, so the fields that only
+		// depend on Desc are written once and patched afterwards only when the world scale changes
+		const bool bUpdateShape = !bSubmitShapeValid || SubmitWorldToMetersScale != Frame->WorldToMetersScale;
+		bSubmitShapeValid = true;
+		SubmitWorldToMetersScale = Frame->WorldToMetersScale;
+
+		if (bUpdateShape && OvrpLayerDesc.Shape == ovrpShape_Equirect)
 		{
 			const FEquirectLayer& EquirectProps = Desc.GetShape<FEquirectLayer>();
 
@@ -1144,38 +1323,12 @@ namespace OculusXRHMD
 
 		if (Id != 0)
 		{
-			int SizeX = OvrpLayerDesc.TextureSize.w;
-			int SizeY = OvrpLayerDesc.TextureSize.h;
-
-			float AspectRatio = SizeX ? (float)SizeY / (float)SizeX : 3.0f / 4.0f;
 			FVector LocationScaleInv(Frame->WorldToMetersScale);
 			FVector LocationScale = LocationScaleInv.Reciprocal();
-			ovrpVector3f Scale = ToOvrpVector3f(Desc.Transform.GetScale3D() * LocationScale);
 
-			switch (OvrpLayerDesc.Shape)
+			if (bUpdateShape)
 			{
-				case ovrpShape_ReconstructionPassthrough:
-				{
-					float QuadSizeY = (Desc.Flags & IStereoLayers::LAYER_FLAG_QUAD_PRESERVE_TEX_RATIO) ? Desc.QuadSize.X * AspectRatio : Desc.QuadSize.Y;
-					OvrpLayerSubmit.Quad.Size = ovrpSizef{ static_cast<float>(Desc.QuadSize.X * Scale.x), static_cast<float>(QuadSizeY * Scale.y) };
-				}
-				break;
-
-				case ovrpShape_Quad:
-				{
-					float QuadSizeY = (Desc.Flags & IStereoLayers::LAYER_FLAG_QUAD_PRESERVE_TEX_RATIO) ? Desc.QuadSize.X * AspectRatio : Desc.QuadSize.Y;
-					OvrpLayerSubmit.Quad.Size = ovrpSizef{ static_cast<float>(Desc.QuadSize.X * Scale.x), static_cast<float>(QuadSizeY * Scale.y) };
-				}
-				break;
-				case ovrpShape_Cylinder:
-				{
-					const FCylinderLayer& CylinderProps = Desc.GetShape<FCylinderLayer>();
-					float CylinderHeight = (Desc.Flags & IStereoLayers::LAYER_FLAG_QUAD_PRESERVE_TEX_RATIO) ? CylinderProps.OverlayArc * AspectRatio : CylinderProps.Height;
-					OvrpLayerSubmit.Cylinder.ArcWidth = CylinderProps.OverlayArc * Scale.x;
-					OvrpLayerSubmit.Cylinder.Height = CylinderHeight * Scale.x;
-					OvrpLayerSubmit.Cylinder.Radius = CylinderProps.Radius * Scale.x;
-				}
-				break;
+				UpdateLayerShape_RHIThread(LocationScale);
 			}
 
 			FQuat BaseOrientation;
@@ -1209,40 +1362,6 @@ namespace OculusXRHMD
 
 			OvrpLayerSubmit.Pose.Orientation = ToOvrpQuatf(OutLayerPose.Orientation);
 			OvrpLayerSubmit.Pose.Position = ToOvrpVector3f(OutLayerPose.Position * LocationScale);
-			OvrpLayerSubmit.LayerSubmitFlags = 0;
-
-			if (Desc.PositionType == IStereoLayers::FaceLocked)
-			{
-				OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_HeadLocked;
-			}
-
-			if (!(Desc.Flags & IStereoLayers::LAYER_FLAG_SUPPORT_DEPTH))
-			{
-				OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_NoDepth;
-			}
-
-#ifdef WITH_OCULUS_BRANCH
-			if (Desc.Flags & IStereoLayers::LAYER_FLAG_AUTO_FILTERING)
-			{
-				OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_AutoLayerFilter;
-			}
-			if (Desc.Flags & IStereoLayers::LAYER_FLAG_NORMAL_SUPERSAMPLE)
-			{
-				OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_EfficientSuperSample;
-			}
-			if (Desc.Flags & IStereoLayers::LAYER_FLAG_QUALITY_SUPERSAMPLE)
-			{
-				OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_ExpensiveSuperSample;
-			}
-			if (Desc.Flags & IStereoLayers::LAYER_FLAG_NORMAL_SHARPEN)
-			{
-				OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_EfficientSharpen;
-			}
-			if (Desc.Flags & IStereoLayers::LAYER_FLAG_QUALITY_SHARPEN)
-			{
-				OvrpLayerSubmit.LayerSubmitFlags |= ovrpLayerSubmitFlag_QualitySharpen;
-			}
-#endif
 		}
 		else
 		{
@@ -1454,6 +1573,53 @@ namespace OculusXRHMD
 		}
 	}
 
+	//-------------------------------------------------------------------------------------------------
+	// FLayerSnapshot
+	//-------------------------------------------------------------------------------------------------
+
+	const FLayerListPtr& FLayerSnapshot::Update(TConstArrayView<FLayerPtr> Layers)
+	{
+		bool bChanged = !List.IsValid() || Sources.Num() != Layers.Num();
+		for (int32 LayerIndex = 0; LayerIndex < Layers.Num() && !bChanged; LayerIndex++)
+		{
+			bChanged = Sources[LayerIndex].Layer != Layers[LayerIndex] || Sources[LayerIndex].Generation != Layers[LayerIndex]->GetGeneration();
+		}
+
+		if (!bChanged)
+		{
+			return List;
+		}
+
+		TArray<FLayerPtr>* NewList = new TArray<FLayerPtr>();
+		TArray<FSource> NewSources;
+		NewList->Reserve(Layers.Num());
+		NewSources.Reserve(Layers.Num());
+
+		// Both sides are sorted by id, so the clones that can be kept are found in a single merge walk
+		int32 SourceIndex = 0;
+		for (const FLayerPtr& Layer : Layers)
+		{
+			while (SourceIndex < Sources.Num() && Sources[SourceIndex].Layer->GetId() < Layer->GetId())
+			{
+				SourceIndex++;
+			}
+
+			const bool bUnchanged = SourceIndex < Sources.Num() && Sources[SourceIndex].Layer == Layer && Sources[SourceIndex].Generation == Layer->GetGeneration();
+			NewList->Add(bUnchanged ? (*List)[SourceIndex] : Layer->Clone());
+			NewSources.Add(FSource{ Layer, Layer->GetGeneration() });
+		}
+
+		Sources = MoveTemp(NewSources);
+		List = MakeShareable(NewList);
+		return List;
+	}
+
+	void FLayerSnapshot::Reset()
+	{
+		Sources.Reset();
+		List.Reset();
+	}
+
 } // namespace OculusXRHMD
 
 #endif //OCULUS_HMD_SUPPORTED_PLATFORMS
@@ -9,6 +9,7 @@
 #include "OculusXRHMD_CustomPresent.h"
 #include "XRSwapChain.h"
 #include "OculusXRPassthroughLayerShapes.h"
+#include "OculusXRHMD_SwapChainPool.h"
 
 namespace OculusXRHMD
 {
@@ -22,13 +23,20 @@ namespace OculusXRHMD
 	{
 	public:
 		FOvrpLayer(uint32 InOvrpLayerId, FDeferredDeletionQueue* InDeferredDeletion);
+		// An ovrp layer that goes back to the swapchain pool with its swapchains instead of being destroyed
+		FOvrpLayer(const FSwapChainPoolKey& InPoolKey, const FPooledSwapChains& InPooledSwapChains, FDeferredDeletionQueue* InDeferredDeletion, FSwapChainPool* InSwapChainPool);
 		~FOvrpLayer();
 
 	protected:
 		uint32 OvrpLayerId;
 
 	private:
+		void Release();
+
 		FDeferredDeletionQueue* DeferredDeletion; // necessary for deferred deletion queue of the actual OvrpLayer
+		FSwapChainPool* SwapChainPool;			  // null when the ovrp layer isn't pooled
+		FSwapChainPoolKey PoolKey;
+		FPooledSwapChains PooledSwapChains;
 	};
 
 	typedef TSharedPtr<FOvrpLayer, ESPMode::ThreadSafe> FOvrpLayerPtr;
@@ -56,20 +64,31 @@ namespace OculusXRHMD
 		const FXRSwapChainPtr& GetFoveationSwapChain() const { return FoveationSwapChain; }
 		const FXRSwapChainPtr& GetMotionVectorSwapChain() const { return MotionVectorSwapChain; }
 		const FXRSwapChainPtr& GetMotionVectorDepthSwapChain() const { return MotionVectorDepthSwapChain; }
-		void MarkTextureForUpdate() { bUpdateTexture = true; }
+		void MarkTextureForUpdate()
+		{
+			bUpdateTexture = true;
+			Generation++;
+		}
+		// Bumped by every change a snapshot of this layer would see, so unchanged layers can be shared between frames
+		uint32 GetGeneration() const { return Generation; }
 		bool NeedsPokeAHole();
 		void HandlePokeAHoleComponent();
 		void BuildPokeAHoleMesh(TArray<FVector>& Vertices, TArray<int32>& Triangles, TArray<FVector2D>& UV0);
 		bool NeedsPassthroughPokeAHole();
 
-		bool ShapeNeedsTextures(ovrpShape shape);
+		bool ShapeNeedsTextures(ovrpShape shape) const;
 
 		FTextureRHIRef GetTexture() { return Desc.Texture; }
 
 		TSharedPtr<FLayer, ESPMode::ThreadSafe> Clone() const;
 
 		bool CanReuseResources(const FLayer* InLayer) const;
-		bool Initialize_RenderThread(const FSettings* Settings, FCustomPresent* CustomPresent, FDeferredDeletionQueue* DeferredDeletion, FRHICommandListImmediate& RHICmdList, const FLayer* InLayer = nullptr);
+		// Resources that can't be reused from InLayer are rented from SwapChainPool, or allocated when it has none
+		bool Initialize_RenderThread(const FSettings* Settings, FCustomPresent* CustomPresent, FDeferredDeletionQueue* DeferredDeletion, FSwapChainPool* SwapChainPool, FRHICommandListImmediate& RHICmdList, const FLayer* InLayer = nullptr);
+		// The per-frame part of Initialize_RenderThread, for a layer that is already initialized and did not change
+		void RequestContinuousUpdate_RenderThread();
+		// Whether Initialize_RenderThread managed to set up the ovrp layer and its swapchain; Initialize_RenderThread still succeeds when SetupLayer fails
+		bool IsInitialized_RenderThread() const;
 		void UpdateTexture_RenderThread(const FSettings* Settings, FCustomPresent* CustomPresent, FRHICommandListImmediate& RHICmdList);
 		void UpdatePassthrough_RenderThread(FCustomPresent* CustomPresent, FRHICommandListImmediate& RHICmdList, const FGameFrame* Frame);
 
@@ -116,12 +135,18 @@ namespace OculusXRHMD
 
 		bool BuildPassthroughPokeActor(FOculusPassthroughMeshRef PassthroughMesh, FPassthroughPokeActor& OutPassthroughPokeActor);
 		void UpdatePassthroughPokeActors_GameThread();
+		// Writes the parts of OvrpLayerSubmit derived from Desc and the world scale: shape size and submit flags
+		void UpdateLayerShape_RHIThread(const FVector& LocationScale);
+		FSwapChainPoolKey MakeSwapChainPoolKey() const;
 
 		uint32 Id;
+		uint32 Generation;
 		IStereoLayers::FLayerDesc Desc;
 		int OvrpLayerId;
 		ovrpLayerDescUnion OvrpLayerDesc;
 		ovrpLayerSubmitUnion OvrpLayerSubmit;
+		bool bSubmitShapeValid; // Not copied: clones start with a stale OvrpLayerSubmit
+		float SubmitWorldToMetersScale;
 		FOvrpLayerPtr OvrpLayer;
 		FXRSwapChainPtr SwapChain;
 		FXRSwapChainPtr DepthSwapChain;
@@ -144,6 +169,34 @@ namespace OculusXRHMD
 	};
 
 	typedef TSharedPtr<FLayer, ESPMode::ThreadSafe> FLayerPtr;
+	typedef TSharedPtr<const TArray<FLayerPtr>, ESPMode::ThreadSafe> FLayerListPtr;
+
+	//-------------------------------------------------------------------------------------------------
+	// FLayerSnapshot
+	//-------------------------------------------------------------------------------------------------
+
+	// Copy-on-write hand-off of one thread's layers to the next stage of the frame (game -> render -> RHI).
+	// A layer is cloned only when it is new or its generation changed since the previous update; unchanged layers
+	// keep the clone the next thread already owns. Published lists are never modified, so a frame without layer
+	// changes hands over the same list without allocating or copying anything.
+	class FLayerSnapshot
+	{
+	public:
+		// Layers must be sorted by id. Returns the list to hand over, which is the previous one if nothing changed.
+		const FLayerListPtr& Update(TConstArrayView<FLayerPtr> Layers);
+		void Reset();
+
+	private:
+		struct FSource
+		{
+			FLayerPtr Layer;
+			uint32 Generation;
+		};
+
+		// Parallel to List: the layer each clone was made from, and its generation at the time
+		TArray<FSource> Sources;
+		FLayerListPtr List;
+	};
 
 	//-------------------------------------------------------------------------------------------------
 	// FLayerPtr_CompareId
@@ -19,6 +19,7 @@ namespace OculusXRHMD
 		, PixelDensity(1.0f)
 		, PixelDensityMin(0.8f)
 		, PixelDensityMax(1.2f)
+		, StereoParamsGeneration(0)
 		, SystemHeadset(ovrpSystemHeadset_None)
 		, SuggestedCpuPerfLevel(EOculusXRProcessorPerformanceLevel::SustainedLow)
 		, SuggestedGpuPerfLevel(EOculusXRProcessorPerformanceLevel::SustainedHigh)
@@ -70,6 +71,7 @@ namespace OculusXRHMD
 		Flags.bEyeTrackingEnabled = false;
 		Flags.bFaceTrackingEnabled = false;
 		EyeRenderViewport[0] = EyeRenderViewport[1] = FIntRect(0, 0, 0, 0);
+		EyeFov[0] = EyeFov[1] = SymmetricEyeFov[0] = SymmetricEyeFov[1] = ovrpFovf{ 0, 0, 0, 0 };
 
 		RenderTargetSize = FIntPoint(0, 0);
 
@@ -88,14 +90,26 @@ namespace OculusXRHMD
 
 	void FSettings::SetPixelDensity(float NewPixelDensity)
 	{
+		const float OldPixelDensity = PixelDensity;
+
 		if (Flags.bPixelDensityAdaptive)
 		{
 			PixelDensity = FMath::Clamp(NewPixelDensity, PixelDensityMin, PixelDensityMax);
 		}
+		else if (Flags.bFixedEyeBuffer)
+		{
+			PixelDensity = FMath::Clamp(NewPixelDensity, ClampPixelDensityMin, PixelDensityMax);
+		}
 		else
 		{
 			PixelDensity = FMath::Clamp(NewPixelDensity, ClampPixelDensityMin, ClampPixelDensityMax);
 		}
+
+		// Adaptive pixel density only scales the view rect through the engine's dynamic resolution
+		if (PixelDensity != OldPixelDensity && !Flags.bPixelDensityAdaptive)
+		{
+			MarkStereoParamsDirty();
+		}
 	}
 
 	void FSettings::SetPixelDensitySmooth(float NewPixelDensity)
@@ -105,15 +119,25 @@ namespace OculusXRHMD
 		constexpr float MaxPerFrameIncrease = 0.010;
 		constexpr float MaxPerFrameDecrease = 0.045;
 
+		const float OldPixelDensity = PixelDensity;
 		float NewClampedPixelDensity = FMath::Clamp(NewPixelDensity, PixelDensity - MaxPerFrameDecrease, PixelDensity + MaxPerFrameIncrease);
 		if (Flags.bPixelDensityAdaptive)
 		{
 			PixelDensity = FMath::Clamp(NewClampedPixelDensity, PixelDensityMin, PixelDensityMax);
 		}
+		else if (Flags.bFixedEyeBuffer)
+		{
+			PixelDensity = FMath::Clamp(NewClampedPixelDensity, ClampPixelDensityMin, PixelDensityMax);
+		}
 		else
 		{
 			PixelDensity = FMath::Clamp(NewClampedPixelDensity, ClampPixelDensityMin, ClampPixelDensityMax);
 		}
+
+		if (PixelDensity != OldPixelDensity && !Flags.bPixelDensityAdaptive)
+		{
+			MarkStereoParamsDirty();
+		}
 	}
 
 	void FSettings::SetPixelDensityMin(float NewPixelDensityMin)
@@ -121,6 +145,7 @@ namespace OculusXRHMD
 		PixelDensityMin = FMath::Clamp(NewPixelDensityMin, ClampPixelDensityMin, ClampPixelDensityMax);
 		PixelDensityMax = FMath::Max(PixelDensityMin, PixelDensityMax);
 		SetPixelDensity(PixelDensity);
+		MarkStereoParamsDirty();
 	}
 
 	void FSettings::SetPixelDensityMax(float NewPixelDensityMax)
@@ -128,6 +153,7 @@ namespace OculusXRHMD
 		PixelDensityMax = FMath::Clamp(NewPixelDensityMax, ClampPixelDensityMin, ClampPixelDensityMax);
 		PixelDensityMin = FMath::Min(PixelDensityMin, PixelDensityMax);
 		SetPixelDensity(PixelDensity);
+		MarkStereoParamsDirty();
 	}
 
 } // namespace OculusXRHMD
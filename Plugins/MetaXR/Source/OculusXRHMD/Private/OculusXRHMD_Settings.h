@@ -60,6 +60,9 @@ namespace OculusXRHMD
 				/** Dynamically update pixel density to maintain framerate */
 				uint64 bPixelDensityAdaptive : 1;
 
+				/** Eye buffers are allocated once for PixelDensityMax, pixel density changes only resize the viewport */
+				uint64 bFixedEyeBuffer : 1;
+
 				/** All future eye buffers will need to be created with TexSRGB_Create flag due to the current feature level (ES31) */
 				uint64 bsRGBEyeBuffer : 1;
 
@@ -115,6 +118,12 @@ namespace OculusXRHMD
 		float PixelDensityMin;
 		float PixelDensityMax;
 
+		/** Bumped by every change UpdateStereoRenderingParams has to recompute the eye layer for, see MarkStereoParamsDirty */
+		uint32 StereoParamsGeneration;
+		/** Eye FOVs of the last computed eye layer, handed to every game frame */
+		ovrpFovf EyeFov[ovrpEye_Count];
+		ovrpFovf SymmetricEyeFov[ovrpEye_Count];
+
 		ovrpSystemHeadset SystemHeadset;
 
 		float VsyncToNextVsync;
@@ -163,6 +172,8 @@ namespace OculusXRHMD
 		void SetPixelDensitySmooth(float NewPixelDensity);
 		void SetPixelDensityMin(float NewPixelDensityMin);
 		void SetPixelDensityMax(float NewPixelDensityMax);
+		// To be called after changing a flag or field the eye layer description depends on directly
+		void MarkStereoParamsDirty() { StereoParamsGeneration++; }
 
 		TSharedPtr<FSettings, ESPMode::ThreadSafe> Clone() const;
 	};
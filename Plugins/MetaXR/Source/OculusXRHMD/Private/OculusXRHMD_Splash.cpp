@@ -264,7 +264,7 @@ namespace OculusXRHMD
 
 				if (LayerIdA < LayerIdB)
 				{
-					XLayers[LayerIndex++]->Initialize_RenderThread(XSettings.Get(), CustomPresent, &OculusXRHMD->DeferredDeletion, RHICmdList);
+					XLayers[LayerIndex++]->Initialize_RenderThread(XSettings.Get(), CustomPresent, &OculusXRHMD->DeferredDeletion, &OculusXRHMD->SwapChainPool, RHICmdList);
 				}
 				else if (LayerIdA > LayerIdB)
 				{
@@ -272,13 +272,13 @@ namespace OculusXRHMD
 				}
 				else
 				{
-					XLayers[LayerIndex++]->Initialize_RenderThread(XSettings.Get(), CustomPresent, &OculusXRHMD->DeferredDeletion, RHICmdList, Layers_RenderThread[LayerIndex_RenderThread++].Get());
+					XLayers[LayerIndex++]->Initialize_RenderThread(XSettings.Get(), CustomPresent, &OculusXRHMD->DeferredDeletion, &OculusXRHMD->SwapChainPool, RHICmdList, Layers_RenderThread[LayerIndex_RenderThread++].Get());
 				}
 			}
 
 			while (LayerIndex < XLayers.Num())
 			{
-				XLayers[LayerIndex++]->Initialize_RenderThread(XSettings.Get(), CustomPresent, &OculusXRHMD->DeferredDeletion, RHICmdList);
+				XLayers[LayerIndex++]->Initialize_RenderThread(XSettings.Get(), CustomPresent, &OculusXRHMD->DeferredDeletion, &OculusXRHMD->SwapChainPool, RHICmdList);
 			}
 
 			while (LayerIndex_RenderThread < Layers_RenderThread.Num())
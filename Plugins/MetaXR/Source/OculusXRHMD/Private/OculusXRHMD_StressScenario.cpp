@@ -0,0 +1,534 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "OculusXRHMD_StressScenario.h"
+
+#if OCULUS_STRESS_TESTS_ENABLED
+#include "OculusXRHMD.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<float> CVarOculusStressScenarioTolerance(
+	TEXT("vr.oculus.Stress.Scenario.Tolerance"),
+	0.1f,
+	TEXT("Relative increase of a segment's p99 frame time, p99 latency or mean GPU time over the baseline that counts as a regression (default 0.1)\n"),
+	ECVF_Default);
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// FStressScenario
+	//-------------------------------------------------------------------------------------------------
+
+	// Frames reach EndFrame at most this many frames after their game frame started
+	static const uint32 ScenarioFrameLag = 8;
+	// Dropped frames above the baseline that are put down to noise
+	static const uint32 DroppedFramesSlack = 2;
+	// Refresh rate assumed until the runtime reports one
+	static const float DefaultFrameBudgetMs = 1000.0f / 72.0f;
+
+	static const TCHAR* const ReportHeader = TEXT("Segment,StartSeconds,PixelDensity,FoveationLevel,Layers,CPUSpinMs,GPULoad,Frames,FrameMsP50,FrameMsP99,LatencyMsP50,LatencyMsP99,GpuMsMean,DroppedFrames,Result");
+
+	static float Percentile(const TArray<float>& SortedValues, float P)
+	{
+		if (SortedValues.IsEmpty())
+		{
+			return 0.0f;
+		}
+		return SortedValues[FMath::Clamp(FMath::CeilToInt(P * SortedValues.Num()) - 1, 0, SortedValues.Num() - 1)];
+	}
+
+	FStressScenario::FStressScenario(const FString& InName, bool bInSimulated)
+		: Name(InName)
+		, bSimulated(bInSimulated)
+		, bStarted(false)
+		, StartTime(0.0)
+		, NextStep(0)
+		, PixelDensityCVar(nullptr)
+		, SavedPixelDensity(0.0f)
+		, SavedFoveationLevel(0)
+		, bSavedDynamicFoveation(false)
+		, NextFrameNumber(0)
+		, LastDroppedFrameCount(-1)
+		, NumSimulatedFrames(0)
+		, SimulationNoise(0x4f56)
+	{
+	}
+
+	bool FStressScenario::LoadScript(const FString& ScriptFileName, FOutputDevice& Ar)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *ScriptFileName))
+		{
+			Ar.Logf(TEXT("Could not read %s"), *ScriptFileName);
+			return false;
+		}
+
+		Steps.Reset();
+		for (int32 LineIndex = 0; LineIndex < Lines.Num(); LineIndex++)
+		{
+			FString Line = Lines[LineIndex];
+			int32 CommentStart;
+			if (Line.FindChar(TEXT('#'), CommentStart))
+			{
+				Line.LeftInline(CommentStart);
+			}
+
+			TArray<FString> Tokens;
+			if (Line.ParseIntoArrayWS(Tokens) == 0)
+			{
+				continue;
+			}
+
+			FStep Step;
+			Step.Time = FCString::Atod(*Tokens[0]);
+			Step.Value = Tokens.Num() > 2 ? FCString::Atof(*Tokens[2]) : 0.0f;
+
+			const FString Setting = Tokens.Num() > 1 ? Tokens[1] : FString();
+			if (Setting == TEXT("pd"))
+			{
+				Step.Setting = ESetting::PixelDensity;
+			}
+			else if (Setting == TEXT("foveation"))
+			{
+				Step.Setting = ESetting::FoveationLevel;
+			}
+			else if (Setting == TEXT("layers"))
+			{
+				Step.Setting = ESetting::NumLayers;
+			}
+			else if (Setting == TEXT("cpu"))
+			{
+				Step.Setting = ESetting::CPUSpinMs;
+			}
+			else if (Setting == TEXT("gpu"))
+			{
+				Step.Setting = ESetting::GPULoad;
+			}
+			else if (Setting == TEXT("end"))
+			{
+				Step.Setting = ESetting::End;
+			}
+			else
+			{
+				Ar.Logf(TEXT("%s(%d): unknown setting '%s'"), *ScriptFileName, LineIndex + 1, *Setting);
+				return false;
+			}
+
+			if (Step.Time < 0.0)
+			{
+				Ar.Logf(TEXT("%s(%d): negative time"), *ScriptFileName, LineIndex + 1);
+				return false;
+			}
+
+			Steps.Add(Step);
+		}
+
+		if (Steps.IsEmpty())
+		{
+			Ar.Logf(TEXT("%s has no steps"), *ScriptFileName);
+			return false;
+		}
+
+		Steps.StableSort([](const FStep& A, const FStep& B) { return A.Time < B.Time; });
+
+		if (Steps.Last().Setting != ESetting::End)
+		{
+			Ar.Logf(TEXT("%s doesn't end with 'end', running the last segment for 10 seconds"), *ScriptFileName);
+			Steps.Add({ Steps.Last().Time + 10.0, ESetting::End, 0.0f });
+		}
+
+		return true;
+	}
+
+	bool FStressScenario::LoadBaseline(const FString& ReportFileName, FOutputDevice& Ar)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *ReportFileName) || Lines.IsEmpty())
+		{
+			Ar.Logf(TEXT("Could not read %s"), *ReportFileName);
+			return false;
+		}
+
+		TArray<FString> Header;
+		Lines[0].ParseIntoArray(Header, TEXT(","), false);
+
+		const int32 FrameMsP50Column = Header.IndexOfByKey(TEXT("FrameMsP50"));
+		const int32 FrameMsP99Column = Header.IndexOfByKey(TEXT("FrameMsP99"));
+		const int32 LatencyMsP50Column = Header.IndexOfByKey(TEXT("LatencyMsP50"));
+		const int32 LatencyMsP99Column = Header.IndexOfByKey(TEXT("LatencyMsP99"));
+		const int32 GpuMsMeanColumn = Header.IndexOfByKey(TEXT("GpuMsMean"));
+		const int32 DroppedFramesColumn = Header.IndexOfByKey(TEXT("DroppedFrames"));
+		if (FrameMsP50Column == INDEX_NONE || FrameMsP99Column == INDEX_NONE || LatencyMsP50Column == INDEX_NONE || LatencyMsP99Column == INDEX_NONE || GpuMsMeanColumn == INDEX_NONE || DroppedFramesColumn == INDEX_NONE)
+		{
+			Ar.Logf(TEXT("%s is not a stress scenario report"), *ReportFileName);
+			return false;
+		}
+
+		Baseline.Reset();
+		for (int32 LineIndex = 1; LineIndex < Lines.Num(); LineIndex++)
+		{
+			TArray<FString> Columns;
+			if (Lines[LineIndex].ParseIntoArray(Columns, TEXT(","), false) < Header.Num())
+			{
+				continue;
+			}
+
+			FSegmentReport& Row = Baseline.AddDefaulted_GetRef();
+			Row.FrameMsP50 = FCString::Atof(*Columns[FrameMsP50Column]);
+			Row.FrameMsP99 = FCString::Atof(*Columns[FrameMsP99Column]);
+			Row.LatencyMsP50 = FCString::Atof(*Columns[LatencyMsP50Column]);
+			Row.LatencyMsP99 = FCString::Atof(*Columns[LatencyMsP99Column]);
+			Row.GpuMsMean = FCString::Atof(*Columns[GpuMsMeanColumn]);
+			Row.NumDroppedFrames = (uint32)FMath::Max(FCString::Atoi(*Columns[DroppedFramesColumn]), 0);
+		}
+
+		return true;
+	}
+
+	bool FStressScenario::Tick_GameThread(FOculusXRHMD* pPlugin, FStressTester& StressTester)
+	{
+		CheckInGameThread();
+
+		const FSettings* HMDSettings = pPlugin->GetSettings();
+		// VsyncToNextVsync holds the display frequency
+		const float FrameBudgetMs = HMDSettings->VsyncToNextVsync > 0.0f ? 1000.0f / HMDSettings->VsyncToNextVsync : DefaultFrameBudgetMs;
+
+		if (!bStarted)
+		{
+			bStarted = true;
+			StartTime = FPlatformTime::Seconds();
+			// UpdateStereoRenderingParams overwrites the HMD's pixel density every frame from one of these
+			PixelDensityCVar = IConsoleManager::Get().FindConsoleVariable(HMDSettings->Flags.bPixelDensityAdaptive ? TEXT("r.Oculus.DynamicResolution.PixelDensity") : TEXT("vr.PixelDensity"));
+			SavedPixelDensity = PixelDensityCVar ? PixelDensityCVar->GetFloat() : 0.0f;
+			SavedFoveationLevel = (int32)HMDSettings->FoveatedRenderingLevel;
+			bSavedDynamicFoveation = HMDSettings->bDynamicFoveatedRendering;
+			NextFrameNumber = pPlugin->GetNextFrameNumber();
+			UE_LOG(LogHMD, Log, TEXT("Stress scenario %s started%s"), *Name, bSimulated ? TEXT(", simulated") : TEXT(""));
+		}
+		else if (bSimulated)
+		{
+			SimulateFrame(FrameBudgetMs);
+		}
+		else
+		{
+			GatherFrames(pPlugin);
+		}
+
+		const double Elapsed = bSimulated ? NumSimulatedFrames * FrameBudgetMs / 1000.0 : FPlatformTime::Seconds() - StartTime;
+		if (NextStep >= Steps.Num() || Steps[NextStep].Time > Elapsed)
+		{
+			return true;
+		}
+
+		// Steps sharing a time make up one segment; one segment starts per tick so segments line up with the baseline
+		FScenarioSettings NewSettings = Current;
+		const double StepTime = Steps[NextStep].Time;
+		for (; NextStep < Steps.Num() && Steps[NextStep].Time == StepTime; NextStep++)
+		{
+			const FStep& Step = Steps[NextStep];
+			switch (Step.Setting)
+			{
+				case ESetting::PixelDensity:
+					NewSettings.PixelDensity = Step.Value;
+					break;
+				case ESetting::FoveationLevel:
+					NewSettings.FoveationLevel = FMath::Clamp(FMath::RoundToInt(Step.Value), 0, (int32)EOculusXRFoveatedRenderingLevel::HighTop);
+					break;
+				case ESetting::NumLayers:
+					NewSettings.NumLayers = FMath::Max(FMath::RoundToInt(Step.Value), 0);
+					break;
+				case ESetting::CPUSpinMs:
+					NewSettings.CPUSpinMs = FMath::Max(Step.Value, 0.0f);
+					break;
+				case ESetting::GPULoad:
+					NewSettings.GPULoad = FMath::Max(FMath::RoundToInt(Step.Value), 0);
+					break;
+				case ESetting::End:
+					UE_LOG(LogHMD, Log, TEXT("Stress scenario %s finished after %.1f seconds"), *Name, Elapsed);
+					return false;
+			}
+		}
+
+		ApplySettings(pPlugin, StressTester, NewSettings);
+
+		FSegment& Segment = Segments.AddDefaulted_GetRef();
+		Segment.StartTime = StepTime;
+		Segment.FirstFrameNumber = pPlugin->GetNextFrameNumber();
+		Segment.Settings = NewSettings;
+
+		UE_LOG(LogHMD, Log, TEXT("Stress scenario %s: segment %d at %.1fs, pixel density %.2f, foveation %d, %d layers, CPU %.1f ms, GPU load %d"),
+			*Name, Segments.Num() - 1, StepTime, NewSettings.PixelDensity, NewSettings.FoveationLevel, NewSettings.NumLayers, NewSettings.CPUSpinMs, NewSettings.GPULoad);
+		return true;
+	}
+
+	void FStressScenario::Stop_GameThread(FOculusXRHMD* pPlugin, FStressTester& StressTester)
+	{
+		CheckInGameThread();
+
+		if (bStarted && !bSimulated)
+		{
+			SetNumLayers(pPlugin, 0);
+			if (Current.PixelDensity > 0.0f && PixelDensityCVar)
+			{
+				PixelDensityCVar->Set(SavedPixelDensity, ECVF_SetByConsole);
+			}
+			if (Current.FoveationLevel >= 0)
+			{
+				pPlugin->SetFoveatedRenderingLevel((EOculusXRFoveatedRenderingLevel)SavedFoveationLevel, bSavedDynamicFoveation);
+			}
+			StressTester.SetStressMode(StressTester.GetStressMode() & ~(FStressTester::STM_CPUSpin | FStressTester::STM_GPU));
+		}
+
+		Current = FScenarioSettings();
+	}
+
+	bool FStressScenario::Report(FOutputDevice& Ar)
+	{
+		const float Tolerance = FMath::Max(CVarOculusStressScenarioTolerance.GetValueOnGameThread(), 0.0f);
+		const FString FileName = FPaths::ProfilingDir() / TEXT("OculusXR") / FString::Printf(TEXT("StressScenario-%s-%s.csv"), *Name, *FDateTime::Now().ToString());
+
+		FString Lines = FString(ReportHeader) + LINE_TERMINATOR;
+		int32 NumRegressed = 0;
+
+		Ar.Logf(TEXT("Stress scenario %s%s"), *Name, Baseline.IsEmpty() ? TEXT(", no baseline") : TEXT(""));
+		Ar.Logf(TEXT("%-8s %8s %10s %10s %10s %8s %8s  %s"), TEXT("Segment"), TEXT("frames"), TEXT("frame p99"), TEXT("lat. p99"), TEXT("GPU mean"), TEXT("dropped"), TEXT("baseline"), TEXT("result"));
+
+		for (int32 SegmentIndex = 0; SegmentIndex < Segments.Num(); SegmentIndex++)
+		{
+			FSegment& Segment = Segments[SegmentIndex];
+			const FSegmentReport Row = MakeReport(Segment);
+
+			const TCHAR* Result = TEXT("no baseline");
+			float BaselineFrameMsP99 = 0.0f;
+			if (Baseline.IsValidIndex(SegmentIndex) && Segment.FrameMs.Num())
+			{
+				const FSegmentReport& Base = Baseline[SegmentIndex];
+				BaselineFrameMsP99 = Base.FrameMsP99;
+
+				auto Exceeds = [Tolerance](float Value, float BaseValue) { return BaseValue > 0.0f && Value > BaseValue * (1.0f + Tolerance); };
+				auto Undercuts = [Tolerance](float Value, float BaseValue) { return Value < BaseValue * (1.0f - Tolerance); };
+
+				const uint32 MaxDroppedFrames = Base.NumDroppedFrames + FMath::Max(DroppedFramesSlack, (uint32)FMath::CeilToInt(Base.NumDroppedFrames * Tolerance));
+				if (Exceeds(Row.FrameMsP99, Base.FrameMsP99) || Exceeds(Row.LatencyMsP99, Base.LatencyMsP99) || Exceeds(Row.GpuMsMean, Base.GpuMsMean) || Row.NumDroppedFrames > MaxDroppedFrames)
+				{
+					Result = TEXT("regressed");
+					NumRegressed++;
+				}
+				else if (Undercuts(Row.FrameMsP99, Base.FrameMsP99) || Undercuts(Row.GpuMsMean, Base.GpuMsMean) || Row.NumDroppedFrames + DroppedFramesSlack < Base.NumDroppedFrames)
+				{
+					Result = TEXT("improved");
+				}
+				else
+				{
+					Result = TEXT("pass");
+				}
+			}
+
+			Ar.Logf(TEXT("%-8d %8d %10.2f %10.2f %10.2f %8u %8.2f  %s"), SegmentIndex, Segment.FrameMs.Num(), Row.FrameMsP99, Row.LatencyMsP99, Row.GpuMsMean, Row.NumDroppedFrames, BaselineFrameMsP99, Result);
+
+			const FScenarioSettings& Settings = Segment.Settings;
+			Lines += FString::Printf(TEXT("%d,%.2f,%.3f,%d,%d,%.2f,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%u,%s"), SegmentIndex, Segment.StartTime, Settings.PixelDensity, Settings.FoveationLevel, Settings.NumLayers, Settings.CPUSpinMs, Settings.GPULoad,
+				Segment.FrameMs.Num(), Row.FrameMsP50, Row.FrameMsP99, Row.LatencyMsP50, Row.LatencyMsP99, Row.GpuMsMean, Row.NumDroppedFrames, Result);
+			Lines += LINE_TERMINATOR;
+		}
+
+		if (!Baseline.IsEmpty() && Baseline.Num() != Segments.Num())
+		{
+			Ar.Logf(TEXT("The baseline has %d segments, this run %d; was the script changed?"), Baseline.Num(), Segments.Num());
+		}
+
+		if (FFileHelper::SaveStringToFile(Lines, *FileName))
+		{
+			Ar.Logf(TEXT("Stress scenario %s: %d segments, %d regressed, report written to %s"), *Name, Segments.Num(), NumRegressed, *FileName);
+		}
+		else
+		{
+			Ar.Logf(TEXT("Stress scenario %s: %d segments, %d regressed, could not write %s"), *Name, Segments.Num(), NumRegressed, *FileName);
+		}
+
+		return NumRegressed == 0;
+	}
+
+	void FStressScenario::ApplySettings(FOculusXRHMD* pPlugin, FStressTester& StressTester, const FScenarioSettings& NewSettings)
+	{
+		if (!bSimulated)
+		{
+			if (NewSettings.PixelDensity > 0.0f && NewSettings.PixelDensity != Current.PixelDensity && PixelDensityCVar)
+			{
+				PixelDensityCVar->Set(NewSettings.PixelDensity, ECVF_SetByConsole);
+			}
+
+			if (NewSettings.FoveationLevel >= 0 && NewSettings.FoveationLevel != Current.FoveationLevel)
+			{
+				pPlugin->SetFoveatedRenderingLevel((EOculusXRFoveatedRenderingLevel)NewSettings.FoveationLevel, false);
+			}
+
+			SetNumLayers(pPlugin, NewSettings.NumLayers);
+
+			if (NewSettings.CPUSpinMs != Current.CPUSpinMs)
+			{
+				const uint32 Mode = StressTester.GetStressMode() & ~FStressTester::STM_CPUSpin;
+				if (NewSettings.CPUSpinMs > 0.0f)
+				{
+					StressTester.SetCPUSpinOffPerFrameInSeconds(NewSettings.CPUSpinMs / 1000.0);
+					StressTester.SetCPUsTimeLimitInSeconds(0.0);
+					StressTester.SetStressMode(Mode | FStressTester::STM_CPUSpin);
+				}
+				else
+				{
+					StressTester.SetStressMode(Mode);
+				}
+			}
+
+			if (NewSettings.GPULoad != Current.GPULoad)
+			{
+				const uint32 Mode = StressTester.GetStressMode() & ~FStressTester::STM_GPU;
+				if (NewSettings.GPULoad > 0)
+				{
+					StressTester.SetGPULoadMultiplier(NewSettings.GPULoad);
+					StressTester.SetGPUsTimeLimitInSeconds(0.0);
+					StressTester.SetStressMode(Mode | FStressTester::STM_GPU);
+				}
+				else
+				{
+					StressTester.SetStressMode(Mode);
+				}
+			}
+		}
+
+		Current = NewSettings;
+	}
+
+	void FStressScenario::SetNumLayers(FOculusXRHMD* pPlugin, int32 NumLayers)
+	{
+		while (LayerIds.Num() < NumLayers)
+		{
+			// Small face locked quads in a row in front of the viewer, without a texture so nothing is copied
+			IStereoLayers::FLayerDesc LayerDesc;
+			LayerDesc.PositionType = IStereoLayers::FaceLocked;
+			LayerDesc.Transform = FTransform(FVector(100.0f, (LayerIds.Num() % 8 - 3.5f) * 6.0f, (LayerIds.Num() / 8 % 4 - 1.5f) * 6.0f));
+			LayerDesc.QuadSize = FVector2D(5.0f, 5.0f);
+			LayerDesc.LayerSize = FIntPoint(256, 256);
+			LayerDesc.Priority = 1;
+			LayerIds.Add(pPlugin->CreateLayer(LayerDesc));
+		}
+
+		while (LayerIds.Num() > NumLayers)
+		{
+			pPlugin->DestroyLayer(LayerIds.Pop());
+		}
+	}
+
+	void FStressScenario::GatherFrames(FOculusXRHMD* pPlugin)
+	{
+		FSegment* Segment = Segments.Num() ? &Segments.Last() : nullptr;
+
+		if (Segment)
+		{
+			Segment->FrameMs.Add(FApp::GetDeltaTime() * 1000.0f);
+
+			ovrpBool bIsSupported = ovrpBool_False;
+			float GpuTime = 0.0f;
+			if (OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().IsPerfMetricsSupported(ovrpPerfMetrics_App_GpuTime_Float, &bIsSupported)) && bIsSupported == ovrpBool_True
+				&& OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().GetPerfMetricsFloat(ovrpPerfMetrics_App_GpuTime_Float, &GpuTime)))
+			{
+				Segment->GpuMsSum += GpuTime * 1000.0f;
+				Segment->NumGpuSamples++;
+			}
+
+			// The runtime reports a running count of dropped frames
+			int DroppedFrameCount = 0;
+			if (OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().IsPerfMetricsSupported(ovrpPerfMetrics_Compositor_DroppedFrameCount_Int, &bIsSupported)) && bIsSupported == ovrpBool_True
+				&& OVRP_SUCCESS(FOculusXRHMDModule::GetPluginWrapper().GetPerfMetricsInt(ovrpPerfMetrics_Compositor_DroppedFrameCount_Int, &DroppedFrameCount)))
+			{
+				if (LastDroppedFrameCount >= 0 && DroppedFrameCount > LastDroppedFrameCount)
+				{
+					Segment->NumDroppedFrames += DroppedFrameCount - LastDroppedFrameCount;
+				}
+				LastDroppedFrameCount = DroppedFrameCount;
+			}
+		}
+
+		// Latency comes from the frame timeline once the frame has reached the compositor
+		const FFrameTimeline& Timeline = pPlugin->GetFrameTimeline();
+		const uint32 LastFrameNumber = Timeline.GetLastFrameNumber();
+		if (LastFrameNumber == MAX_uint32 || !Segment || (int32)(LastFrameNumber - NextFrameNumber) < 0)
+		{
+			return;
+		}
+
+		if (LastFrameNumber - NextFrameNumber >= FFrameTimeline::NumRecords)
+		{
+			NextFrameNumber = LastFrameNumber - FFrameTimeline::NumRecords + ScenarioFrameLag;
+		}
+
+		for (; LastFrameNumber - NextFrameNumber > ScenarioFrameLag; NextFrameNumber++)
+		{
+			float LatencyMs;
+			if (!Timeline.GetFrameInterval(NextFrameNumber, EFrameTimelineStage::GameFrameStart, EFrameTimelineStage::EndFrameEnd, LatencyMs))
+			{
+				continue;
+			}
+
+			for (int32 SegmentIndex = Segments.Num() - 1; SegmentIndex >= 0; SegmentIndex--)
+			{
+				if (Segments[SegmentIndex].FirstFrameNumber <= NextFrameNumber)
+				{
+					Segments[SegmentIndex].LatencyMs.Add(LatencyMs);
+					break;
+				}
+			}
+		}
+	}
+
+	void FStressScenario::SimulateFrame(float FrameBudgetMs)
+	{
+		if (Segments.IsEmpty())
+		{
+			NumSimulatedFrames++;
+			return;
+		}
+
+		// A fixed formula, not a device model: GPU time follows the pixel count and drops with foveation, layers cost
+		// both sides. Nothing here depends on the plugin's code, so it can't regress.
+		const float PixelDensity = Current.PixelDensity > 0.0f ? Current.PixelDensity : 1.0f;
+		const float Noise = 1.0f + SimulationNoise.FRandRange(-0.05f, 0.05f);
+		const float GpuMs = (6.0f * FMath::Square(PixelDensity) * (1.0f - 0.08f * FMath::Max(Current.FoveationLevel, 0)) + 0.15f * Current.NumLayers + 0.5f * Current.GPULoad) * Noise;
+		const float CpuMs = (4.0f + 0.05f * Current.NumLayers) * Noise + Current.CPUSpinMs;
+
+		// A frame that misses its vsync waits for the next one
+		const int32 NumVsyncs = FMath::Max(1, FMath::CeilToInt(FMath::Max(CpuMs, GpuMs) / FrameBudgetMs));
+
+		FSegment& Segment = Segments.Last();
+		Segment.FrameMs.Add(NumVsyncs * FrameBudgetMs);
+		Segment.LatencyMs.Add(CpuMs + GpuMs + FrameBudgetMs);
+		Segment.GpuMsSum += GpuMs;
+		Segment.NumGpuSamples++;
+		Segment.NumDroppedFrames += NumVsyncs - 1;
+
+		NumSimulatedFrames += NumVsyncs;
+	}
+
+	FStressScenario::FSegmentReport FStressScenario::MakeReport(FSegment& Segment)
+	{
+		Segment.FrameMs.Sort();
+		Segment.LatencyMs.Sort();
+
+		FSegmentReport Row;
+		Row.FrameMsP50 = Percentile(Segment.FrameMs, 0.5f);
+		Row.FrameMsP99 = Percentile(Segment.FrameMs, 0.99f);
+		Row.LatencyMsP50 = Percentile(Segment.LatencyMs, 0.5f);
+		Row.LatencyMsP99 = Percentile(Segment.LatencyMs, 0.99f);
+		Row.GpuMsMean = Segment.NumGpuSamples ? (float)(Segment.GpuMsSum / Segment.NumGpuSamples) : 0.0f;
+		Row.NumDroppedFrames = Segment.NumDroppedFrames;
+		return Row;
+	}
+
+} // namespace OculusXRHMD
+
+#endif // #if OCULUS_STRESS_TESTS_ENABLED
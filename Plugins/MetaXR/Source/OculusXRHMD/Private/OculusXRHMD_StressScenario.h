@@ -0,0 +1,139 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+#include "OculusXRHMDPrivate.h"
+#include "OculusXRHMD_StressTester.h"
+
+#if OCULUS_STRESS_TESTS_ENABLED
+#include "Math/RandomStream.h"
+
+class IConsoleVariable;
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// FStressScenario
+	//-------------------------------------------------------------------------------------------------
+
+	// A timed script of pixel density, foveation level, stereo layer count and synthetic CPU/GPU load. Every
+	// distinct step time starts a segment; frame times, latency from the frame timeline, GPU time and dropped frames
+	// are gathered per segment, compared against the report of an earlier run and written to a CSV report.
+	//
+	// Script lines are "<seconds> <setting> <value>", '#' starts a comment:
+	//   0   pd         1.0    pixel density
+	//   0   foveation  2      EOculusXRFoveatedRenderingLevel
+	//   10  layers     8      number of extra quad layers
+	//   20  cpu        5      milliseconds of CPU spin per frame
+	//   30  gpu        4      GPU load multiplier, 0 off
+	//   40  end
+	//
+	// Pixel density is set through vr.PixelDensity, or r.Oculus.DynamicResolution.PixelDensity with adaptive pixel
+	// density, since the HMD reads it from there every frame.
+	//
+	// When simulated, nothing is applied to the HMD and frame times come from a fixed formula of the segment's
+	// settings. No rendering or plugin code runs, so this only exercises the script parsing, report and baseline
+	// comparison; a simulated run on CI can't detect a performance regression.
+	class FStressScenario
+	{
+	public:
+		struct FScenarioSettings
+		{
+			float PixelDensity = 0.0f; // 0 leaves the pixel density alone
+			int32 FoveationLevel = -1; // -1 leaves the foveation level alone
+			int32 NumLayers = 0;
+			float CPUSpinMs = 0.0f;
+			int32 GPULoad = 0;
+		};
+
+		FStressScenario(const FString& InName, bool bInSimulated);
+
+		bool LoadScript(const FString& ScriptFileName, FOutputDevice& Ar);
+		bool LoadBaseline(const FString& ReportFileName, FOutputDevice& Ar);
+
+		// Applies the due steps and gathers the last frames. Returns false once the script is over. Game thread.
+		bool Tick_GameThread(class FOculusXRHMD* pPlugin, FStressTester& StressTester);
+		// Undoes what the scenario changed on the HMD and the stress tester
+		void Stop_GameThread(class FOculusXRHMD* pPlugin, FStressTester& StressTester);
+
+		// Writes the report and prints the comparison. Returns true when no segment regressed.
+		bool Report(FOutputDevice& Ar);
+
+	private:
+		enum class ESetting : uint8
+		{
+			PixelDensity,
+			FoveationLevel,
+			NumLayers,
+			CPUSpinMs,
+			GPULoad,
+			End,
+		};
+
+		struct FStep
+		{
+			double Time;
+			ESetting Setting;
+			float Value;
+		};
+
+		struct FSegment
+		{
+			double StartTime = 0.0;
+			uint32 FirstFrameNumber = 0;
+			FScenarioSettings Settings;
+			TArray<float> FrameMs;
+			TArray<float> LatencyMs;
+			double GpuMsSum = 0.0;
+			int32 NumGpuSamples = 0;
+			uint32 NumDroppedFrames = 0;
+		};
+
+		// One row of a report, ours or the baseline's
+		struct FSegmentReport
+		{
+			float FrameMsP50 = 0.0f;
+			float FrameMsP99 = 0.0f;
+			float LatencyMsP50 = 0.0f;
+			float LatencyMsP99 = 0.0f;
+			float GpuMsMean = 0.0f;
+			uint32 NumDroppedFrames = 0;
+		};
+
+		void ApplySettings(class FOculusXRHMD* pPlugin, FStressTester& StressTester, const FScenarioSettings& NewSettings);
+		void SetNumLayers(class FOculusXRHMD* pPlugin, int32 NumLayers);
+		void GatherFrames(class FOculusXRHMD* pPlugin);
+		void SimulateFrame(float FrameBudgetMs);
+		static FSegmentReport MakeReport(FSegment& Segment);
+
+		FString Name;
+		bool bSimulated;
+		TArray<FStep> Steps;
+		TArray<FSegmentReport> Baseline;
+
+		bool bStarted;
+		double StartTime;
+		int32 NextStep;
+		FScenarioSettings Current;
+		TArray<FSegment> Segments;
+		TArray<uint32> LayerIds;
+
+		// What to restore when the scenario stops
+		IConsoleVariable* PixelDensityCVar;
+		float SavedPixelDensity;
+		int32 SavedFoveationLevel;
+		bool bSavedDynamicFoveation;
+
+		// Device sampling
+		uint32 NextFrameNumber;
+		int32 LastDroppedFrameCount;
+
+		// Simulation
+		uint32 NumSimulatedFrames;
+		FRandomStream SimulationNoise;
+	};
+
+} // namespace OculusXRHMD
+
+#endif // #if OCULUS_STRESS_TESTS_ENABLED
@@ -5,6 +5,9 @@
 
 #if OCULUS_STRESS_TESTS_ENABLED
 #include "OculusXRHMD.h"
+#include "OculusXRHMD_StressScenario.h"
+#include "Misc/Paths.h"
+#include "HAL/IConsoleManager.h"
 #include "GlobalShader.h"
 #include "UniformBuffer.h"
 #include "RHICommandList.h"
@@ -105,13 +108,76 @@ namespace OculusXRHMD
 		, CPUStartTimeInSeconds(0.)
 		, GPUStartTimeInSeconds(0.)
 		, PDStartTimeInSeconds(0.)
+		, SavedPixelDensity(1.f)
+		, bExitWhenScenarioDone(false)
+		, bStopScenarioRequested(false)
 	{
 	}
 
+	FStressTester::~FStressTester()
+	{
+	}
+
+	bool FStressTester::RunScenario(const FString& ScriptFileName, const FString& BaselineFileName, bool bSimulated, bool bExitWhenDone, FOutputDevice& Ar)
+	{
+		CheckInGameThread();
+
+		if (Scenario.IsValid())
+		{
+			Ar.Logf(TEXT("A stress scenario is already running, stop it with vr.oculus.Stress.Reset"));
+			return false;
+		}
+
+		TUniquePtr<FStressScenario> NewScenario = MakeUnique<FStressScenario>(FPaths::GetBaseFilename(ScriptFileName), bSimulated);
+		if (!NewScenario->LoadScript(ScriptFileName, Ar) || (!BaselineFileName.IsEmpty() && !NewScenario->LoadBaseline(BaselineFileName, Ar)))
+		{
+			if (bExitWhenDone)
+			{
+				FPlatformMisc::RequestExitWithStatus(false, 2);
+			}
+			return false;
+		}
+
+		Scenario = MoveTemp(NewScenario);
+		bExitWhenScenarioDone = bExitWhenDone;
+		bStopScenarioRequested = false;
+		return true;
+	}
+
+	void FStressTester::FinishScenario(FOculusXRHMD* pPlugin)
+	{
+		Scenario->Stop_GameThread(pPlugin, *this);
+		const bool bPassed = Scenario->Report(*GLog);
+		Scenario.Reset();
+		bStopScenarioRequested = false;
+
+		if (bExitWhenScenarioDone)
+		{
+			FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+		}
+	}
+
+	void FStressTester::StopPixelDensityStress()
+	{
+		if (PDStartTimeInSeconds != 0.)
+		{
+			static const auto PixelDensityCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("vr.PixelDensity"));
+			if (PixelDensityCVar)
+			{
+				PixelDensityCVar->Set(SavedPixelDensity, ECVF_SetByConsole);
+			}
+			PDStartTimeInSeconds = 0.;
+		}
+	}
+
 	// multiple masks could be set, see EStressTestMode
 	void FStressTester::SetStressMode(uint32 InStressMask)
 	{
 		check((InStressMask & (~STM__All)) == 0);
+		if ((Mode & STM_EyeBufferRealloc) && !(InStressMask & STM_EyeBufferRealloc))
+		{
+			StopPixelDensityStress();
+		}
 		Mode = InStressMask;
 
 		for (uint32 m = 1; m < STM__All; m <<= 1)
@@ -138,28 +204,40 @@ namespace OculusXRHMD
 	{
 		CheckInGameThread();
 
+		if (Scenario.IsValid() && (bStopScenarioRequested || !Scenario->Tick_GameThread(pPlugin, *this)))
+		{
+			FinishScenario(pPlugin);
+		}
+
 		if (Mode & STM_EyeBufferRealloc)
 		{
-			// Change PixelDensity every frame within MinPixelDensity..MaxPixelDensity range
+			// Change PixelDensity every frame within MinPixelDensity..MaxPixelDensity range. With r.Oculus.FixedEyeBuffer
+			// set this resizes the eye viewport instead of reallocating the eye buffers.
+			// UpdateStereoRenderingParams takes the pixel density from vr.PixelDensity, so that is what is changed.
+			static const auto PixelDensityCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("vr.PixelDensity"));
 			if (PDStartTimeInSeconds == 0.)
 			{
 				PDStartTimeInSeconds = FPlatformTime::Seconds();
+				SavedPixelDensity = PixelDensityCVar ? PixelDensityCVar->GetFloat() : 1.f;
 			}
 			else
 			{
 				const double Now = FPlatformTime::Seconds();
-				if (Now - PDStartTimeInSeconds >= PDsTimeLimitInSeconds)
+				if (PDsTimeLimitInSeconds > 0. && Now - PDStartTimeInSeconds >= PDsTimeLimitInSeconds)
 				{
-					PDStartTimeInSeconds = 0.;
+					StopPixelDensityStress();
 					Mode &= ~STM_EyeBufferRealloc;
 					UE_LOG(LogHMD, Log, TEXT("PD of EyeBuffer stress test is finished"));
 				}
 			}
 
-			const int divisor = int((MaxPixelDensity - MinPixelDensity) * 10.f);
-			float NewPD = float(uint64(FPlatformTime::Seconds() * 1000) % divisor) / 10.f + MinPixelDensity;
+			if ((Mode & STM_EyeBufferRealloc) && PixelDensityCVar)
+			{
+				const int divisor = int((MaxPixelDensity - MinPixelDensity) * 10.f);
+				float NewPD = float(uint64(FPlatformTime::Seconds() * 1000) % divisor) / 10.f + MinPixelDensity;
 
-			pPlugin->SetPixelDensity(NewPD);
+				PixelDensityCVar->Set(NewPD, ECVF_SetByConsole);
+			}
 		}
 
 		if (Mode & STM_CPUSpin)
@@ -173,7 +251,7 @@ namespace OculusXRHMD
 			else
 			{
 				const double Now = FPlatformTime::Seconds();
-				if (Now - CPUStartTimeInSeconds >= CPUsTimeLimitInSeconds)
+				if (CPUsTimeLimitInSeconds > 0. && Now - CPUStartTimeInSeconds >= CPUsTimeLimitInSeconds)
 				{
 					CPUStartTimeInSeconds = 0.;
 					Mode &= ~STM_CPUSpin;
@@ -221,7 +299,7 @@ namespace OculusXRHMD
 			else
 			{
 				const double Now = FPlatformTime::Seconds();
-				if (Now - GPUStartTimeInSeconds >= GPUsTimeLimitInSeconds)
+				if (GPUsTimeLimitInSeconds > 0. && Now - GPUStartTimeInSeconds >= GPUsTimeLimitInSeconds)
 				{
 					GPUStartTimeInSeconds = 0.;
 					Mode &= ~STM_GPU;
@@ -297,8 +375,50 @@ namespace OculusXRHMD
 	{
 		auto StressTester = FStressTester::Get();
 		StressTester->SetStressMode(0);
+		StressTester->StopScenario();
+	}
+
+	static void StressScenarioCmdHandler(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		FString ScriptFileName;
+		FString BaselineFileName;
+		bool bSimulated = false;
+		bool bExitWhenDone = false;
+
+		for (const FString& Arg : Args)
+		{
+			if (Arg.Equals(TEXT("-simulate"), ESearchCase::IgnoreCase))
+			{
+				bSimulated = true;
+			}
+			else if (Arg.Equals(TEXT("-exit"), ESearchCase::IgnoreCase))
+			{
+				bExitWhenDone = true;
+			}
+			else if (ScriptFileName.IsEmpty())
+			{
+				ScriptFileName = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), Arg);
+			}
+			else
+			{
+				BaselineFileName = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), Arg);
+			}
+		}
+
+		if (ScriptFileName.IsEmpty())
+		{
+			Ar.Logf(TEXT("Usage: vr.oculus.Stress.Scenario Script [BaselineReport] [-simulate] [-exit]"));
+			return;
+		}
+
+		FStressTester::Get()->RunScenario(ScriptFileName, BaselineFileName, bSimulated, bExitWhenDone, Ar);
 	}
 
+	static FAutoConsoleCommand CStressScenarioCmd(
+		TEXT("vr.oculus.Stress.Scenario"),
+		*NSLOCTEXT("OculusRift", "CCommandText_StressScenario", "Runs a stress scenario script and writes a CSV report of every segment to Saved/Profiling/OculusXR, comparing it against BaselineReport when given.\n -simulate synthesizes frame times from a fixed formula instead of changing the HMD, which only checks the script and report, not performance. -exit quits when done with exit code 1 if a segment regressed.\n Usage: vr.oculus.Stress.Scenario Script [BaselineReport] [-simulate] [-exit]").ToString(),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(StressScenarioCmdHandler));
+
 	static FAutoConsoleCommand CStressResetCmd(
 		TEXT("vr.oculus.Stress.Reset"),
 		*NSLOCTEXT("OculusRift", "CCommandText_StressReset", "Resets the stress tester and stops all currently running stress tests.\n Usage: vr.oculus.Stress.Reset").ToString(),
@@ -53,7 +53,15 @@ namespace OculusXRHMD
 		// sets time limit for STM_GPU mode; 0 - unlimited
 		void SetGPUsTimeLimitInSeconds(double InSeconds) { GPUsTimeLimitInSeconds = InSeconds; }
 
+		// runs a scenario script (see FStressScenario), optionally comparing it against the report of an earlier run.
+		// bSimulated synthesizes the frames instead of touching the HMD; bExitWhenDone quits with a non-zero exit
+		// code if a segment regressed.
+		bool RunScenario(const FString& ScriptFileName, const FString& BaselineFileName, bool bSimulated, bool bExitWhenDone, FOutputDevice& Ar);
+		// stops the running scenario on the next tick and writes its report
+		void StopScenario() { bStopScenarioRequested = true; }
+
 		static TSharedRef<class FStressTester, ESPMode::ThreadSafe> Get();
+		~FStressTester();
 
 		static void TickCPU_GameThread(class FOculusXRHMD* pPlugin)
 		{
@@ -67,6 +75,9 @@ namespace OculusXRHMD
 
 	protected:
 		void DoTickCPU_GameThread(class FOculusXRHMD* pPlugin);
+		void FinishScenario(class FOculusXRHMD* pPlugin);
+		// puts vr.PixelDensity back to what it was before STM_EyeBufferRealloc started
+		void StopPixelDensityStress();
 
 		FStressTester();
 
@@ -82,6 +93,11 @@ namespace OculusXRHMD
 		double CPUStartTimeInSeconds;
 		double GPUStartTimeInSeconds;
 		double PDStartTimeInSeconds;
+		float SavedPixelDensity; // vr.PixelDensity before STM_EyeBufferRealloc started
+
+		TUniquePtr<class FStressScenario> Scenario;
+		bool bExitWhenScenarioDone;
+		bool bStopScenarioRequested;
 
 		static TSharedPtr<class FStressTester, ESPMode::ThreadSafe> SharedInstance;
 	};
@@ -0,0 +1,160 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "OculusXRHMD_SwapChainPool.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+#include "OculusXRHMD_DeferredDeletionQueue.h"
+#include "HeadMountedDisplayTypes.h" // for LogHMD
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+static TAutoConsoleVariable<int32> CVarOculusSwapChainPoolBudgetMB(
+	TEXT("r.Oculus.SwapChainPool.BudgetMB"),
+	64,
+	TEXT("Megabytes of swapchains kept from removed or resized stereo layers for reuse by layers with the same description (default 64)\n")
+		TEXT("0 Destroy them right away\n"),
+	ECVF_RenderThreadSafe);
+
+namespace OculusXRHMD
+{
+
+	//-------------------------------------------------------------------------------------------------
+	// FSwapChainPoolKey
+	//-------------------------------------------------------------------------------------------------
+
+	bool FSwapChainPoolKey::operator==(const FSwapChainPoolKey& Other) const
+	{
+		return Shape == Other.Shape && Layout == Other.Layout && TextureSize.w == Other.TextureSize.w && TextureSize.h == Other.TextureSize.h && MipLevels == Other.MipLevels && SampleCount == Other.SampleCount && Format == Other.Format && LayerFlags == Other.LayerFlags && bSRGB == Other.bSRGB && bHasDepth == Other.bHasDepth && bSupportDepthComposite == Other.bSupportDepthComposite;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+	// FSwapChainPool
+	//-------------------------------------------------------------------------------------------------
+
+	// Frames a returned ovrp layer waits before it is handed out again, so the compositor is done with its last image
+	static const uint32 SwapChainPoolReuseDelay = 3;
+
+	FSwapChainPool::FSwapChainPool(FDeferredDeletionQueue* InDeferredDeletion)
+		: DeferredDeletion(InDeferredDeletion)
+		, FrameNumber(0)
+		, bClosed(false)
+	{
+	}
+
+	bool FSwapChainPool::IsPoolable(const FSwapChainPoolKey& Key)
+	{
+		switch (Key.Shape)
+		{
+			case ovrpShape_Quad:
+			case ovrpShape_Cylinder:
+			case ovrpShape_Cubemap:
+			case ovrpShape_OffcenterCubemap:
+			case ovrpShape_Equirect:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	bool FSwapChainPool::Rent_RenderThread(const FSwapChainPoolKey& Key, FPooledSwapChains& OutSwapChains)
+	{
+		CheckInRenderThread();
+
+		FScopeLock Lock(&CriticalSection);
+
+		// Most recently returned first, its textures are the likeliest to still be resident
+		for (int32 Index = Entries.Num() - 1; Index >= 0; Index--)
+		{
+			FEntry& Entry = Entries[Index];
+			if (Entry.Key == Key && FrameNumber - Entry.ReturnFrame >= SwapChainPoolReuseDelay)
+			{
+				OutSwapChains = MoveTemp(Entry.SwapChains);
+				Stats.PooledBytes -= OutSwapChains.SizeInBytes;
+				Stats.NumRented++;
+				Entries.RemoveAt(Index);
+
+				UE_LOG(LogHMD, Verbose, TEXT("Reusing pooled ovrp layer %u (%dx%d)"), OutSwapChains.OvrpLayerId, Key.TextureSize.w, Key.TextureSize.h);
+				return true;
+			}
+		}
+
+		Stats.NumMissed++;
+		return false;
+	}
+
+	void FSwapChainPool::Return(const FSwapChainPoolKey& Key, FPooledSwapChains&& SwapChains)
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		if (bClosed || CVarOculusSwapChainPoolBudgetMB.GetValueOnAnyThread() <= 0)
+		{
+			DeferredDeletion->AddOVRPLayerToDeferredDeletionQueue(SwapChains.OvrpLayerId);
+			return;
+		}
+
+		Stats.PooledBytes += SwapChains.SizeInBytes;
+		Stats.NumReturned++;
+		Entries.Add(FEntry{ Key, MoveTemp(SwapChains), FrameNumber });
+	}
+
+	void FSwapChainPool::Tick_RenderThread()
+	{
+		CheckInRenderThread();
+
+		FScopeLock Lock(&CriticalSection);
+
+		FrameNumber++;
+		bClosed = false;
+
+		const uint64 BudgetBytes = (uint64)FMath::Max(CVarOculusSwapChainPoolBudgetMB.GetValueOnRenderThread(), 0) << 20;
+		int32 NumEvicted = 0;
+		for (uint64 PooledBytes = Stats.PooledBytes; NumEvicted < Entries.Num() && PooledBytes > BudgetBytes; NumEvicted++)
+		{
+			PooledBytes -= Entries[NumEvicted].SwapChains.SizeInBytes;
+		}
+
+		Evict(NumEvicted);
+	}
+
+	void FSwapChainPool::Close_RenderThread()
+	{
+		CheckInRenderThread();
+
+		FScopeLock Lock(&CriticalSection);
+
+		bClosed = true;
+		Evict(Entries.Num());
+	}
+
+	FSwapChainPool::FStats FSwapChainPool::GetStats_RenderThread() const
+	{
+		CheckInRenderThread();
+
+		FScopeLock Lock(&CriticalSection);
+
+		FStats Result = Stats;
+		Result.NumPooled = Entries.Num();
+		return Result;
+	}
+
+	void FSwapChainPool::Evict(int32 NumEntries)
+	{
+		if (NumEntries <= 0)
+		{
+			return;
+		}
+
+		for (int32 Index = 0; Index < NumEntries; Index++)
+		{
+			Stats.PooledBytes -= Entries[Index].SwapChains.SizeInBytes;
+			DeferredDeletion->AddOVRPLayerToDeferredDeletionQueue(Entries[Index].SwapChains.OvrpLayerId);
+		}
+
+		Stats.NumEvicted += NumEntries;
+		Entries.RemoveAt(0, NumEntries);
+	}
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
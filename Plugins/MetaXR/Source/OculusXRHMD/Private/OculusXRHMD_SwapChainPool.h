@@ -0,0 +1,111 @@
+// @lint-ignore-every LICENSELINT
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+#include "OculusXRHMDPrivate.h"
+
+#if OCULUS_HMD_SUPPORTED_PLATFORMS
+#include "XRSwapChain.h"
+
+namespace OculusXRHMD
+{
+	class FDeferredDeletionQueue;
+
+	//-------------------------------------------------------------------------------------------------
+	// FSwapChainPoolKey
+	//-------------------------------------------------------------------------------------------------
+
+	// What decides the swapchains an ovrp layer gets: the fields FLayer::CanReuseResources compares, plus the
+	// texture creation flags that don't show in the ovrp layer description
+	struct FSwapChainPoolKey
+	{
+		ovrpShape Shape;
+		ovrpLayout Layout;
+		ovrpSizei TextureSize;
+		int MipLevels;
+		int SampleCount;
+		ovrpTextureFormat Format;
+		int LayerFlags;
+		bool bSRGB;
+		bool bHasDepth;
+		bool bSupportDepthComposite;
+
+		bool operator==(const FSwapChainPoolKey& Other) const;
+	};
+
+	//-------------------------------------------------------------------------------------------------
+	// FPooledSwapChains
+	//-------------------------------------------------------------------------------------------------
+
+	// An ovrp layer and the swapchains wrapping its textures. The runtime allocates the textures with the layer, so
+	// they are pooled together.
+	struct FPooledSwapChains
+	{
+		uint32 OvrpLayerId = 0;
+		FXRSwapChainPtr SwapChain;
+		FXRSwapChainPtr DepthSwapChain;
+		FXRSwapChainPtr RightSwapChain;
+		FXRSwapChainPtr RightDepthSwapChain;
+		FTexture2DRHIRef InvAlphaTexture;
+		uint64 SizeInBytes = 0;
+	};
+
+	//-------------------------------------------------------------------------------------------------
+	// FSwapChainPool
+	//-------------------------------------------------------------------------------------------------
+
+	// Keeps the ovrp layers of removed or resized stereo layers for the next layer with the same description, so
+	// toggling or resizing a layer doesn't allocate. The least recently returned layers are destroyed once the pool
+	// is over r.Oculus.SwapChainPool.BudgetMB. Eye layers aren't pooled.
+	class FSwapChainPool
+	{
+	public:
+		struct FStats
+		{
+			uint64 NumRented = 0;
+			uint64 NumMissed = 0; // rent attempts that had to allocate
+			uint64 NumReturned = 0;
+			uint64 NumEvicted = 0;
+			uint32 NumPooled = 0;
+			uint64 PooledBytes = 0;
+		};
+
+		FSwapChainPool(FDeferredDeletionQueue* InDeferredDeletion);
+
+		static bool IsPoolable(const FSwapChainPoolKey& Key);
+
+		// Hands over an ovrp layer returned with Key a few frames ago, if any. Render thread.
+		bool Rent_RenderThread(const FSwapChainPoolKey& Key, FPooledSwapChains& OutSwapChains);
+		// Takes an ovrp layer no layer uses anymore, or queues it for deletion when the pool is disabled or closed.
+		// Render or RHI thread.
+		void Return(const FSwapChainPoolKey& Key, FPooledSwapChains&& SwapChains);
+
+		// Trims the pool to the budget and reopens it. Once per frame, render thread.
+		void Tick_RenderThread();
+		// Queues everything for deletion and keeps what is returned until the next tick out of the pool. Render thread.
+		void Close_RenderThread();
+
+		FStats GetStats_RenderThread() const;
+
+	private:
+		struct FEntry
+		{
+			FSwapChainPoolKey Key;
+			FPooledSwapChains SwapChains;
+			uint32 ReturnFrame;
+		};
+
+		void Evict(int32 NumEntries);
+
+		FDeferredDeletionQueue* DeferredDeletion;
+
+		mutable FCriticalSection CriticalSection;
+		TArray<FEntry> Entries; // least recently returned first
+		uint32 FrameNumber;
+		bool bClosed;
+		FStats Stats;
+	};
+
+} // namespace OculusXRHMD
+
+#endif //OCULUS_HMD_SUPPORTED_PLATFORMS
@@ -30,7 +30,8 @@ void FOculusXRSceneModule::StartupModule()
 		return;
 	}
 
-	HMD->AddEventPollingDelegate(OculusXRHMD::FOculusXRHMDEventPollingDelegate::CreateStatic(&OculusXRScene::FOculusXRSceneEventHandling::OnPollEvent));
+	// FOculusXRSceneEventHandling doesn't handle any event type yet. Register it with
+	// AddEventPollingDelegate(EventType, ...) for each type it starts handling.
 }
 
 void FOculusXRSceneModule::ShutdownModule()
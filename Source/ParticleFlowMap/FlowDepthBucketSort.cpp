@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowDepthBucketSort.h"
+#include "FlowMapStats.h"
+#include "Async/ParallelFor.h"
+
+namespace FlowDepthBucketSort
+{
+	/** Particles per task in each of the three passes. */
+	static constexpr int32 ParticlesPerChunk = 2048;
+
+	static constexpr uint32 DeadKey = MAX_uint32;
+
+	/** Depths closer than this are clamped, so particles at or behind the camera land in the nearest bucket. */
+	static constexpr float MinDepth = 1.0f;
+}
+
+FFlowSortView FFlowSortView::Make(const FVector& Origin, const FRotator& Rotation, float HorizontalFovDegrees, float AspectRatio)
+{
+	FFlowSortView View;
+	View.Origin = Origin;
+	FRotationMatrix(Rotation).GetScaledAxes(View.Forward, View.Right, View.Up);
+	View.TanHalfFovX = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(HorizontalFovDegrees, 1.0f, 179.0f) * 0.5f));
+	View.TanHalfFovY = View.TanHalfFovX / FMath::Max(AspectRatio, UE_SMALL_NUMBER);
+	return View;
+}
+
+void FFlowDepthBucketSort::Sort(TConstArrayView<FVector4> Particles, const FFlowSortView& View, int32 TilesPerAxis, int32 NumBuckets, bool bFrontToBack, TArray<int32>& OutOrder)
+{
+	using namespace FlowDepthBucketSort;
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_Sort, EFlowMapTimer::Sort);
+
+	const int32 Num = Particles.Num();
+	TilesPerAxis = FMath::Max(TilesPerAxis, 1);
+	NumBuckets = FMath::Max(NumBuckets, 1);
+	const int32 NumKeys = TilesPerAxis * TilesPerAxis * NumBuckets;
+	const int32 NumChunks = FMath::DivideAndRoundUp(Num, ParticlesPerChunk);
+
+	Keys.SetNumUninitialized(Num, EAllowShrinking::No);
+	Depths.SetNumUninitialized(Num, EAllowShrinking::No);
+	ChunkDepthRanges.SetNumUninitialized(NumChunks, EAllowShrinking::No);
+	// The histograms become scatter offsets below, so all of them have to start from zero again, not just new ones.
+	Histograms.SetNumUninitialized(NumChunks * NumKeys, EAllowShrinking::No);
+	FMemory::Memzero(Histograms.GetData(), Histograms.Num() * Histograms.GetTypeSize());
+	OutOrder.Reset();
+
+	// Pass 1: view depth and screen tile per particle, plus the depth range of each chunk.
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		const int32 First = Chunk * ParticlesPerChunk;
+		const int32 Last = FMath::Min(First + ParticlesPerChunk, Num);
+		FVector2f Range(MAX_flt, -MAX_flt);
+		for (int32 Index = First; Index < Last; ++Index)
+		{
+			const FVector4& Particle = Particles[Index];
+			if (Particle.W < 0.0)
+			{
+				Keys[Index] = DeadKey;
+				continue;
+			}
+
+			const FVector Relative = FVector(Particle) - View.Origin;
+			const float Depth = FMath::Max(float(Relative | View.Forward), MinDepth);
+			const float ScreenX = float(Relative | View.Right) / (Depth * View.TanHalfFovX);
+			const float ScreenY = float(Relative | View.Up) / (Depth * View.TanHalfFovY);
+			const int32 TileX = FMath::Clamp(FMath::FloorToInt32((ScreenX * 0.5f + 0.5f) * TilesPerAxis), 0, TilesPerAxis - 1);
+			const int32 TileY = FMath::Clamp(FMath::FloorToInt32((0.5f - ScreenY * 0.5f) * TilesPerAxis), 0, TilesPerAxis - 1);
+
+			Keys[Index] = uint32(TileY * TilesPerAxis + TileX);
+			Depths[Index] = Depth;
+			Range.X = FMath::Min(Range.X, Depth);
+			Range.Y = FMath::Max(Range.Y, Depth);
+		}
+		ChunkDepthRanges[Chunk] = Range;
+	});
+
+	FVector2f DepthRange(MAX_flt, -MAX_flt);
+	for (const FVector2f& Range : ChunkDepthRanges)
+	{
+		DepthRange.X = FMath::Min(DepthRange.X, Range.X);
+		DepthRange.Y = FMath::Max(DepthRange.Y, Range.Y);
+	}
+	if (DepthRange.X > DepthRange.Y)
+	{
+		return;
+	}
+	const float BucketsPerUnit = NumBuckets / FMath::Max(DepthRange.Y - DepthRange.X, UE_SMALL_NUMBER);
+
+	// Pass 2: final key (tile major, then depth bucket in draw order) and a histogram per chunk.
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		const int32 First = Chunk * ParticlesPerChunk;
+		const int32 Last = FMath::Min(First + ParticlesPerChunk, Num);
+		uint32* Histogram = &Histograms[Chunk * NumKeys];
+		for (int32 Index = First; Index < Last; ++Index)
+		{
+			if (Keys[Index] == DeadKey)
+			{
+				continue;
+			}
+
+			const int32 NearToFar = FMath::Min(FMath::FloorToInt32((Depths[Index] - DepthRange.X) * BucketsPerUnit), NumBuckets - 1);
+			const int32 Bucket = bFrontToBack ? NearToFar : NumBuckets - 1 - NearToFar;
+			const uint32 Key = Keys[Index] * NumBuckets + Bucket;
+			Keys[Index] = Key;
+			++Histogram[Key];
+		}
+	});
+
+	// Exclusive prefix sum, key major and chunk minor, so the scatter is stable and each chunk writes its own ranges.
+	uint32 Total = 0;
+	for (int32 Key = 0; Key < NumKeys; ++Key)
+	{
+		for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+		{
+			uint32& Count = Histograms[Chunk * NumKeys + Key];
+			const uint32 Offset = Total;
+			Total += Count;
+			Count = Offset;
+		}
+	}
+
+	// Pass 3: scatter.
+	OutOrder.SetNumUninitialized(Total);
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		const int32 First = Chunk * ParticlesPerChunk;
+		const int32 Last = FMath::Min(First + ParticlesPerChunk, Num);
+		uint32* Offsets = &Histograms[Chunk * NumKeys];
+		for (int32 Index = First; Index < Last; ++Index)
+		{
+			if (Keys[Index] != DeadKey)
+			{
+				OutOrder[Offsets[Keys[Index]]++] = Index;
+			}
+		}
+	});
+}
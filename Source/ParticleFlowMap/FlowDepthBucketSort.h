@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Camera the particles are sorted for. */
+struct FFlowSortView
+{
+	FVector Origin = FVector::ZeroVector;
+	FVector Forward = FVector::ForwardVector;
+	FVector Right = FVector::RightVector;
+	FVector Up = FVector::UpVector;
+	float TanHalfFovX = 1.0f;
+	float TanHalfFovY = 1.0f;
+
+	static FFlowSortView Make(const FVector& Origin, const FRotator& Rotation, float HorizontalFovDegrees, float AspectRatio);
+};
+
+/**
+ * Approximate depth sort in O(n): each particle is keyed by the screen tile its centre falls in and by one of a fixed
+ * number of view-depth buckets, then placed with a parallel counting sort. Order is exact between buckets and
+ * arbitrary (but stable across frames) within one, which is enough for additive or soft translucent sprites and much
+ * cheaper than a full sort at stream particle counts. Output is grouped by tile so each screen tile's sprites are
+ * submitted together.
+ *
+ * There is no GPU version: the stream is simulated on the CPU and uploaded to Niagara as an array every frame, so the
+ * sort runs at upload time. Sorting on the GPU would need a custom Niagara data interface to hand the sorted buffer to
+ * the sprite renderer.
+ */
+class PARTICLEFLOWMAP_API FFlowDepthBucketSort
+{
+public:
+	/**
+	 * Writes the indices of the live entries of Particles (xyz world position, w < 0 marks a free slot) in draw order.
+	 * Scratch storage is kept between calls so sorting every frame does not allocate.
+	 */
+	void Sort(TConstArrayView<FVector4> Particles, const FFlowSortView& View, int32 TilesPerAxis, int32 NumBuckets, bool bFrontToBack, TArray<int32>& OutOrder);
+
+private:
+	TArray<uint32> Keys;
+	TArray<float> Depths;
+	TArray<uint32> Histograms;
+	TArray<FVector2f> ChunkDepthRanges;
+};
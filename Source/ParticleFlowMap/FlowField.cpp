@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowField.h"
+#include "ParticleFlowMap.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "TextureResource.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+
+namespace FlowMap
+{
+	static bool ReadLinearPixels(UTextureRenderTarget2D* RenderTarget, TArray<FLinearColor>& OutPixels)
+	{
+		if (!RenderTarget)
+		{
+			return false;
+		}
+
+		FTextureRenderTargetResource* Resource = RenderTarget->GameThread_GetRenderTargetResource();
+		if (!Resource || !Resource->ReadLinearColorPixels(OutPixels))
+		{
+			UE_LOG(LogParticleFlowMap, Warning, TEXT("Could not read back render target %s"), *RenderTarget->GetName());
+			return false;
+		}
+
+		return OutPixels.Num() == RenderTarget->SizeX * RenderTarget->SizeY;
+	}
+
+	/** Converts to the render target's format and queues the upload of the whole surface. */
+	static bool WriteLinearPixels(UTextureRenderTarget2D* RenderTarget, const TArray<FLinearColor>& Pixels)
+	{
+		if (!RenderTarget || Pixels.Num() != RenderTarget->SizeX * RenderTarget->SizeY)
+		{
+			return false;
+		}
+
+		FTextureRenderTargetResource* Resource = RenderTarget->GameThread_GetRenderTargetResource();
+		if (!Resource)
+		{
+			return false;
+		}
+
+		TArray<uint8> Data;
+		int32 BytesPerTexel = 0;
+		switch (RenderTarget->GetFormat())
+		{
+		case PF_B8G8R8A8:
+			BytesPerTexel = sizeof(FColor);
+			Data.SetNumUninitialized(Pixels.Num() * BytesPerTexel);
+			for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+			{
+				reinterpret_cast<FColor*>(Data.GetData())[Index] = Pixels[Index].QuantizeRound();
+			}
+			break;
+		case PF_FloatRGBA:
+			BytesPerTexel = sizeof(FFloat16Color);
+			Data.SetNumUninitialized(Pixels.Num() * BytesPerTexel);
+			for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+			{
+				reinterpret_cast<FFloat16Color*>(Data.GetData())[Index] = FFloat16Color(Pixels[Index]);
+			}
+			break;
+		case PF_A32B32G32R32F:
+			BytesPerTexel = sizeof(FLinearColor);
+			Data.SetNumUninitialized(Pixels.Num() * BytesPerTexel);
+			FMemory::Memcpy(Data.GetData(), Pixels.GetData(), Data.Num());
+			break;
+		case PF_G8:
+			BytesPerTexel = sizeof(uint8);
+			Data.SetNumUninitialized(Pixels.Num());
+			for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+			{
+				Data[Index] = uint8(FMath::Clamp(FMath::RoundToInt32(Pixels[Index].R * 255.0f), 0, 255));
+			}
+			break;
+		case PF_R16F:
+			BytesPerTexel = sizeof(FFloat16);
+			Data.SetNumUninitialized(Pixels.Num() * BytesPerTexel);
+			for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+			{
+				reinterpret_cast<FFloat16*>(Data.GetData())[Index] = FFloat16(Pixels[Index].R);
+			}
+			break;
+		case PF_R32_FLOAT:
+			BytesPerTexel = sizeof(float);
+			Data.SetNumUninitialized(Pixels.Num() * BytesPerTexel);
+			for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+			{
+				reinterpret_cast<float*>(Data.GetData())[Index] = Pixels[Index].R;
+			}
+			break;
+		default:
+			UE_LOG(LogParticleFlowMap, Warning, TEXT("Cannot write render target %s: unsupported format %s"), *RenderTarget->GetName(),
+				GetPixelFormatString(RenderTarget->GetFormat()));
+			return false;
+		}
+
+		const FUpdateTextureRegion2D Region(0, 0, 0, 0, RenderTarget->SizeX, RenderTarget->SizeY);
+		ENQUEUE_RENDER_COMMAND(FlowMapWriteRenderTarget)(
+			[Resource, Region, BytesPerTexel, Data = MoveTemp(Data)](FRHICommandListImmediate& RHICmdList)
+			{
+				if (FRHITexture* Texture = Resource->GetRenderTargetTexture())
+				{
+					RHICmdList.UpdateTexture2D(Texture, 0, Region, Region.Width * BytesPerTexel, Data.GetData());
+				}
+			});
+		return true;
+	}
+
+	bool ReadFlowField(UTextureRenderTarget2D* RenderTarget, FFlowField& OutField)
+	{
+		TArray<FLinearColor> Pixels;
+		if (!ReadLinearPixels(RenderTarget, Pixels))
+		{
+			return false;
+		}
+
+		OutField.Init(RenderTarget->SizeX, RenderTarget->SizeY, FVector2f::ZeroVector);
+		for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+		{
+			OutField.Texels[Index] = DecodeFlow(Pixels[Index]);
+		}
+		return true;
+	}
+
+	bool ReadScalarField(UTextureRenderTarget2D* RenderTarget, int32 Channel, FFlowScalarField& OutField)
+	{
+		check(Channel >= 0 && Channel < 4);
+
+		TArray<FLinearColor> Pixels;
+		if (!ReadLinearPixels(RenderTarget, Pixels))
+		{
+			return false;
+		}
+
+		OutField.Init(RenderTarget->SizeX, RenderTarget->SizeY, 0.0f);
+		for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+		{
+			OutField.Texels[Index] = Pixels[Index].Component(Channel);
+		}
+		return true;
+	}
+
+	bool WriteFlowField(UTextureRenderTarget2D* RenderTarget, const FFlowField& Field)
+	{
+		if (!RenderTarget || !Field.IsValid() || Field.Width != RenderTarget->SizeX || Field.Height != RenderTarget->SizeY)
+		{
+			return false;
+		}
+
+		TArray<FLinearColor> Pixels;
+		Pixels.SetNumUninitialized(Field.Texels.Num());
+		for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+		{
+			Pixels[Index] = EncodeFlow(Field.Texels[Index]);
+		}
+		return WriteLinearPixels(RenderTarget, Pixels);
+	}
+
+	bool WriteScalarField(UTextureRenderTarget2D* RenderTarget, int32 Channel, const FFlowScalarField& Field)
+	{
+		check(Channel >= 0 && Channel < 4);
+
+		if (!RenderTarget || !Field.IsValid() || Field.Width != RenderTarget->SizeX || Field.Height != RenderTarget->SizeY)
+		{
+			return false;
+		}
+
+		const EPixelFormat Format = RenderTarget->GetFormat();
+		const bool bSingleChannel = Format == PF_G8 || Format == PF_R16F || Format == PF_R32_FLOAT;
+
+		TArray<FLinearColor> Pixels;
+		if (bSingleChannel || !ReadLinearPixels(RenderTarget, Pixels))
+		{
+			Pixels.Init(FLinearColor::Transparent, Field.Texels.Num());
+		}
+
+		for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+		{
+			Pixels[Index].Component(Channel) = Field.Texels[Index];
+		}
+		return WriteLinearPixels(RenderTarget, Pixels);
+	}
+}
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTextureRenderTarget2D;
+
+/**
+ * CPU copy of one of the stream's baked or painted maps, stored row-major with texel centres at (X + 0.5, Y + 0.5).
+ */
+template<typename TexelType>
+struct TFlowMapGrid
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	TArray<TexelType> Texels;
+
+	void Init(int32 InWidth, int32 InHeight, const TexelType& Value)
+	{
+		Width = FMath::Max(InWidth, 0);
+		Height = FMath::Max(InHeight, 0);
+		Texels.Init(Value, Width * Height);
+	}
+
+	bool IsValid() const
+	{
+		return Width > 0 && Height > 0 && Texels.Num() == Width * Height;
+	}
+
+	int32 Index(int32 X, int32 Y) const
+	{
+		return Y * Width + X;
+	}
+
+	TexelType& At(int32 X, int32 Y)
+	{
+		return Texels[Index(X, Y)];
+	}
+
+	const TexelType& At(int32 X, int32 Y) const
+	{
+		return Texels[Index(X, Y)];
+	}
+
+	const TexelType& AtClamped(int32 X, int32 Y) const
+	{
+		return Texels[Index(FMath::Clamp(X, 0, Width - 1), FMath::Clamp(Y, 0, Height - 1))];
+	}
+
+	/** Bilinear sample with clamp addressing; UV is in [0,1] across the whole map. */
+	TexelType SampleBilinear(const FVector2f& UV) const
+	{
+		const float FX = UV.X * Width - 0.5f;
+		const float FY = UV.Y * Height - 0.5f;
+		const int32 X0 = FMath::FloorToInt32(FX);
+		const int32 Y0 = FMath::FloorToInt32(FY);
+		const float TX = FX - X0;
+		const float TY = FY - Y0;
+
+		const TexelType Top = FMath::Lerp(AtClamped(X0, Y0), AtClamped(X0 + 1, Y0), TX);
+		const TexelType Bottom = FMath::Lerp(AtClamped(X0, Y0 + 1), AtClamped(X0 + 1, Y0 + 1), TX);
+		return FMath::Lerp(Top, Bottom, TY);
+	}
+
+	/** Bilinear resample of Source to the given size; a plain copy when the sizes already match. */
+	void ResampleFrom(const TFlowMapGrid& Source, int32 InWidth, int32 InHeight)
+	{
+		if (Source.Width == InWidth && Source.Height == InHeight)
+		{
+			*this = Source;
+			return;
+		}
+
+		Init(InWidth, InHeight, TexelType());
+		for (int32 Y = 0; Y < Height; ++Y)
+		{
+			for (int32 X = 0; X < Width; ++X)
+			{
+				At(X, Y) = Source.SampleBilinear(FVector2f((X + 0.5f) / Width, (Y + 0.5f) / Height));
+			}
+		}
+	}
+};
+
+/** Flow directions in [-1,1]; the vector length is the relative speed. */
+using FFlowField = TFlowMapGrid<FVector2f>;
+
+/** Single channel maps: mask coverage, height, jump-flood distance. */
+using FFlowScalarField = TFlowMapGrid<float>;
+
+namespace FlowMap
+{
+	/** RT_Flowmap stores flow in RG remapped to [0,1], with 0.5 meaning still water. */
+	inline FVector2f DecodeFlow(const FLinearColor& Color)
+	{
+		return FVector2f(Color.R * 2.0f - 1.0f, Color.G * 2.0f - 1.0f);
+	}
+
+	inline FLinearColor EncodeFlow(const FVector2f& Flow)
+	{
+		return FLinearColor(Flow.X * 0.5f + 0.5f, Flow.Y * 0.5f + 0.5f, 0.0f, 1.0f);
+	}
+
+	/** Reads a painted flowmap back from the GPU. Blocks the game thread until the render thread has caught up. */
+	PARTICLEFLOWMAP_API bool ReadFlowField(UTextureRenderTarget2D* RenderTarget, FFlowField& OutField);
+
+	/** Reads one channel (0 = R .. 3 = A) of a render target back from the GPU. */
+	PARTICLEFLOWMAP_API bool ReadScalarField(UTextureRenderTarget2D* RenderTarget, int32 Channel, FFlowScalarField& OutField);
+
+	/**
+	 * Uploads a flow field into a render target of the same size, encoded like painted flow. Supports the 8-bit, half
+	 * and float RGBA formats; the upload is queued on the render thread.
+	 */
+	PARTICLEFLOWMAP_API bool WriteFlowField(UTextureRenderTarget2D* RenderTarget, const FFlowField& Field);
+
+	/**
+	 * Uploads a scalar field into one channel of a render target of the same size. The other channels are read back
+	 * first and kept, so this blocks on the render thread like the readers; single channel targets skip the readback.
+	 */
+	PARTICLEFLOWMAP_API bool WriteScalarField(UTextureRenderTarget2D* RenderTarget, int32 Channel, const FFlowScalarField& Field);
+}
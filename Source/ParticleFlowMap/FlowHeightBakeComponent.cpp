@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowHeightBakeComponent.h"
+#include "ParticleFlowMap.h"
+#include "FlowRiverComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "GameFramework/Actor.h"
+
+UFlowHeightBakeComponent::UFlowHeightBakeComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+	bTickInEditor = true;
+}
+
+UFlowRiverComponent* UFlowHeightBakeComponent::FindRiver() const
+{
+	return GetOwner() ? GetOwner()->FindComponentByClass<UFlowRiverComponent>() : nullptr;
+}
+
+bool UFlowHeightBakeComponent::Bake()
+{
+	UFlowRiverComponent* River = FindRiver();
+	UTextureRenderTarget2D* Target = River ? (River->HeightMap ? River->HeightMap.Get() : River->MaskMap.Get()) : nullptr;
+	if (!Target)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s needs a UFlowRiverComponent with a height or mask map to bake"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+
+	// The bake runs at the height map's size and is resampled if the mask map differs.
+	Baker = FFlowHeightBaker();
+	Baker.Initialize(Target->SizeX, Target->SizeY, FVector2f(River->Extent), River->HeightScale, TileSize);
+	BakedRiverTransform = River->GetComponentTransform();
+
+	TrackedMeshes.Reset();
+	for (const FFlowBakeInput& Input : Inputs)
+	{
+		if (!Input.Actor)
+		{
+			continue;
+		}
+
+		TArray<UStaticMeshComponent*> Components;
+		Input.Actor->GetComponents(Components);
+		for (UStaticMeshComponent* Component : Components)
+		{
+			FTrackedMesh& Tracked = TrackedMeshes.AddDefaulted_GetRef();
+			Tracked.Component = Component;
+			Tracked.Role = Input.Role;
+			if (!UpdateMesh(TrackedMeshes.Num() - 1, *River))
+			{
+				TrackedMeshes.Pop();
+			}
+		}
+	}
+
+	if (TrackedMeshes.Num() == 0)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has no static meshes to bake"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+	return BakeAndWrite(*River);
+}
+
+bool UFlowHeightBakeComponent::UpdateMesh(int32 MeshId, const UFlowRiverComponent& River)
+{
+	FTrackedMesh& Tracked = TrackedMeshes[MeshId];
+	const UStaticMeshComponent* Component = Tracked.Component.Get();
+	if (!Component || !FFlowHeightBaker::GatherStaticMesh(Component, River.GetComponentTransform(), VertexScratch, IndexScratch))
+	{
+		Baker.RemoveMesh(MeshId);
+		return false;
+	}
+
+	Tracked.Transform = Component->GetComponentTransform();
+	Baker.SetMesh(MeshId, Tracked.Role, VertexScratch, IndexScratch);
+	return true;
+}
+
+bool UFlowHeightBakeComponent::BakeAndWrite(UFlowRiverComponent& River)
+{
+	const int32 NumTiles = Baker.BakeDirtyTiles();
+	if (NumTiles == 0)
+	{
+		return true;
+	}
+
+	bool bWritten = true;
+	if (River.HeightMap)
+	{
+		FFlowScalarField Height;
+		Height.ResampleFrom(Baker.GetHeight(), River.HeightMap->SizeX, River.HeightMap->SizeY);
+		bWritten &= FlowMap::WriteScalarField(River.HeightMap, 0, Height);
+	}
+	if (bWriteMask && River.MaskMap)
+	{
+		FFlowScalarField Mask;
+		Baker.GetMask(Mask);
+		FFlowScalarField Resampled;
+		Resampled.ResampleFrom(Mask, River.MaskMap->SizeX, River.MaskMap->SizeY);
+		bWritten &= FlowMap::WriteScalarField(River.MaskMap, 0, Resampled);
+	}
+
+	UE_LOG(LogParticleFlowMap, Verbose, TEXT("%s baked %d height map tiles"), *GetNameSafe(GetOwner()), NumTiles);
+	River.MarkMapsDirty();
+	return bWritten;
+}
+
+void UFlowHeightBakeComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!bTrackMovement || !Baker.IsInitialized())
+	{
+		return;
+	}
+
+	UFlowRiverComponent* River = FindRiver();
+	if (!River)
+	{
+		return;
+	}
+
+	// Moving the river itself moves every mesh relative to it.
+	if (!River->GetComponentTransform().Equals(BakedRiverTransform))
+	{
+		Bake();
+		return;
+	}
+
+	bool bChanged = false;
+	for (int32 MeshId = 0; MeshId < TrackedMeshes.Num(); ++MeshId)
+	{
+		const UStaticMeshComponent* Component = TrackedMeshes[MeshId].Component.Get();
+		if (!Component)
+		{
+			if (Baker.HasMesh(MeshId))
+			{
+				Baker.RemoveMesh(MeshId);
+				bChanged = true;
+			}
+		}
+		else if (!Component->GetComponentTransform().Equals(TrackedMeshes[MeshId].Transform))
+		{
+			UpdateMesh(MeshId, *River);
+			bChanged = true;
+		}
+	}
+
+	if (bChanged)
+	{
+		BakeAndWrite(*River);
+	}
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "FlowHeightBaker.h"
+#include "FlowHeightBakeComponent.generated.h"
+
+class UFlowRiverComponent;
+class UStaticMeshComponent;
+
+USTRUCT(BlueprintType)
+struct PARTICLEFLOWMAP_API FFlowBakeInput
+{
+	GENERATED_BODY()
+
+	/** Every static mesh component on the actor is baked, e.g. the M_MeshLandscape terrain or a river surface. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<AActor> Actor;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	EFlowBakeRole Role = EFlowBakeRole::Terrain;
+};
+
+/**
+ * Bakes the owner's river height map (and optionally its mask) straight from the level geometry with vertical rays,
+ * instead of a scene capture. With bTrackMovement the inputs are watched, also in the editor, and only the tiles
+ * under a mesh that moved are traced again and uploaded.
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowHeightBakeComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowHeightBakeComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TArray<FFlowBakeInput> Inputs;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "8", ClampMax = "512"))
+	int32 TileSize = 64;
+
+	/** Also write river coverage, minus blockers, into the river's mask map. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bWriteMask = false;
+
+	/** Re-bake the tiles under any input mesh that moves. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bTrackMovement = false;
+
+	/** Gathers every input mesh and bakes the whole map. */
+	UFUNCTION(BlueprintCallable, CallInEditor, Category = "Flowmap")
+	bool Bake();
+
+	const FFlowHeightBaker& GetBaker() const { return Baker; }
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	struct FTrackedMesh
+	{
+		TWeakObjectPtr<UStaticMeshComponent> Component;
+		FTransform Transform;
+		EFlowBakeRole Role = EFlowBakeRole::Terrain;
+	};
+
+	UFlowRiverComponent* FindRiver() const;
+
+	/** Rebuilds a mesh's BVH from its current placement; returns false if it has no usable triangles. */
+	bool UpdateMesh(int32 MeshId, const UFlowRiverComponent& River);
+
+	/** Traces the dirty tiles and uploads the maps. */
+	bool BakeAndWrite(UFlowRiverComponent& River);
+
+	FFlowHeightBaker Baker;
+	TArray<FTrackedMesh> TrackedMeshes;
+	FTransform BakedRiverTransform;
+
+	TArray<FVector3f> VertexScratch;
+	TArray<uint32> IndexScratch;
+};
@@ -0,0 +1,387 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowHeightBaker.h"
+#include "ParticleFlowMap.h"
+#include "FlowMapStats.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+
+namespace FlowHeightBaker
+{
+	static constexpr int32 MaxLeafTriangles = 4;
+	static constexpr int32 MaxTraversalDepth = 64;
+
+	static float Cross2D(const FVector3f& A, const FVector3f& B, const FVector2f& Point)
+	{
+		return (B.X - A.X) * (Point.Y - A.Y) - (B.Y - A.Y) * (Point.X - A.X);
+	}
+
+	static bool ContainsXY(const FBox3f& Box, const FVector2f& Point)
+	{
+		return Point.X >= Box.Min.X && Point.X <= Box.Max.X && Point.Y >= Box.Min.Y && Point.Y <= Box.Max.Y;
+	}
+}
+
+void FFlowVerticalRayBVH::Build(TConstArrayView<FVector3f> Vertices, TConstArrayView<uint32> Indices)
+{
+	Nodes.Reset();
+	Triangles.Reset();
+	Bounds = FBox3f(ForceInit);
+
+	TArray<FTriangle> Source;
+	TArray<FBox3f> TriangleBounds;
+	Source.Reserve(Indices.Num() / 3);
+	TriangleBounds.Reserve(Indices.Num() / 3);
+	for (int32 Index = 0; Index + 2 < Indices.Num(); Index += 3)
+	{
+		const FTriangle Triangle{ Vertices[Indices[Index]], Vertices[Indices[Index + 1]], Vertices[Indices[Index + 2]] };
+
+		// Walls have no area seen from above and can never be hit by a vertical ray.
+		if (FMath::Abs(FlowHeightBaker::Cross2D(Triangle.A, Triangle.B, FVector2f(Triangle.C.X, Triangle.C.Y))) <= UE_SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		Source.Add(Triangle);
+		FBox3f& Box = TriangleBounds.Add_GetRef(FBox3f(ForceInit));
+		Box += Triangle.A;
+		Box += Triangle.B;
+		Box += Triangle.C;
+	}
+
+	if (Source.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<int32> Order;
+	Order.SetNumUninitialized(Source.Num());
+	for (int32 Index = 0; Index < Order.Num(); ++Index)
+	{
+		Order[Index] = Index;
+	}
+
+	Nodes.Reserve(2 * Source.Num() / FlowHeightBaker::MaxLeafTriangles + 1);
+	BuildNode(Order, TriangleBounds, 0, Order.Num());
+
+	Triangles.SetNumUninitialized(Order.Num());
+	for (int32 Index = 0; Index < Order.Num(); ++Index)
+	{
+		Triangles[Index] = Source[Order[Index]];
+	}
+	Bounds = Nodes[0].Bounds;
+}
+
+int32 FFlowVerticalRayBVH::BuildNode(TArray<int32>& Order, TArray<FBox3f>& TriangleBounds, int32 Begin, int32 End)
+{
+	const int32 NodeIndex = Nodes.AddDefaulted();
+
+	FBox3f NodeBounds(ForceInit);
+	FBox2f CentreBounds(ForceInit);
+	for (int32 Index = Begin; Index < End; ++Index)
+	{
+		const FBox3f& Box = TriangleBounds[Order[Index]];
+		NodeBounds += Box;
+		const FVector3f Centre = Box.GetCenter();
+		CentreBounds += FVector2f(Centre.X, Centre.Y);
+	}
+	Nodes[NodeIndex].Bounds = NodeBounds;
+
+	// Median split across the wider horizontal axis; the rays are vertical, so splitting in Z would never cull.
+	const FVector2f Size = CentreBounds.GetSize();
+	if (End - Begin <= FlowHeightBaker::MaxLeafTriangles || Size.GetMax() <= UE_SMALL_NUMBER)
+	{
+		Nodes[NodeIndex].Index = Begin;
+		Nodes[NodeIndex].Count = End - Begin;
+		return NodeIndex;
+	}
+
+	const int32 Axis = Size.X >= Size.Y ? 0 : 1;
+	Algo::Sort(MakeArrayView(Order.GetData() + Begin, End - Begin), [&TriangleBounds, Axis](int32 A, int32 B)
+	{
+		return TriangleBounds[A].GetCenter()[Axis] < TriangleBounds[B].GetCenter()[Axis];
+	});
+
+	const int32 Middle = Begin + (End - Begin) / 2;
+	BuildNode(Order, TriangleBounds, Begin, Middle);
+	const int32 Second = BuildNode(Order, TriangleBounds, Middle, End);
+	Nodes[NodeIndex].Index = Second;
+	Nodes[NodeIndex].Count = 0;
+	return NodeIndex;
+}
+
+bool FFlowVerticalRayBVH::TraceDown(const FVector2f& Point, float& InOutZ) const
+{
+	using namespace FlowHeightBaker;
+
+	if (Nodes.Num() == 0)
+	{
+		return false;
+	}
+
+	int32 Stack[MaxTraversalDepth];
+	int32 StackSize = 0;
+	Stack[StackSize++] = 0;
+
+	bool bHit = false;
+	while (StackSize > 0)
+	{
+		const int32 NodeIndex = Stack[--StackSize];
+		const FNode& Node = Nodes[NodeIndex];
+		if (Node.Bounds.Max.Z <= InOutZ || !ContainsXY(Node.Bounds, Point))
+		{
+			continue;
+		}
+
+		if (Node.Count > 0)
+		{
+			for (int32 Index = Node.Index; Index < Node.Index + Node.Count; ++Index)
+			{
+				const FTriangle& Triangle = Triangles[Index];
+				const float Area = Cross2D(Triangle.A, Triangle.B, FVector2f(Triangle.C.X, Triangle.C.Y));
+				const float WeightC = Cross2D(Triangle.A, Triangle.B, Point) / Area;
+				const float WeightA = Cross2D(Triangle.B, Triangle.C, Point) / Area;
+				const float WeightB = 1.0f - WeightA - WeightC;
+				if (WeightA < 0.0f || WeightB < 0.0f || WeightC < 0.0f)
+				{
+					continue;
+				}
+
+				const float Z = WeightA * Triangle.A.Z + WeightB * Triangle.B.Z + WeightC * Triangle.C.Z;
+				if (Z > InOutZ)
+				{
+					InOutZ = Z;
+					bHit = true;
+				}
+			}
+			continue;
+		}
+
+		// Pop the child that reaches higher first, so the other is more likely to be culled by its hit.
+		const int32 First = NodeIndex + 1;
+		const int32 Second = Node.Index;
+		if (StackSize + 2 > MaxTraversalDepth)
+		{
+			continue;
+		}
+		const bool bFirstHigher = Nodes[First].Bounds.Max.Z >= Nodes[Second].Bounds.Max.Z;
+		Stack[StackSize++] = bFirstHigher ? Second : First;
+		Stack[StackSize++] = bFirstHigher ? First : Second;
+	}
+	return bHit;
+}
+
+void FFlowHeightBaker::Initialize(int32 InWidth, int32 InHeight, const FVector2f& InExtent, float InHeightScale, int32 InTileSize)
+{
+	Extent = InExtent;
+	HeightScale = InHeightScale > UE_SMALL_NUMBER ? InHeightScale : 1.0f;
+	TileSize = FMath::Max(InTileSize, 8);
+	TilesX = FMath::DivideAndRoundUp(InWidth, TileSize);
+	TilesY = FMath::DivideAndRoundUp(InHeight, TileSize);
+
+	Height.Init(InWidth, InHeight, 0.0f);
+	River.Init(InWidth, InHeight, 0.0f);
+	Blockers.Init(InWidth, InHeight, 0.0f);
+	BakedTiles.Reset();
+	MarkAllDirty();
+}
+
+void FFlowHeightBaker::SetMesh(int32 MeshId, EFlowBakeRole Role, TConstArrayView<FVector3f> Vertices, TConstArrayView<uint32> Indices)
+{
+	FMesh& Mesh = Meshes.FindOrAdd(MeshId);
+	if (!Mesh.BVH.IsEmpty())
+	{
+		MarkDirty(Mesh.BVH.GetBounds());
+	}
+
+	Mesh.Role = Role;
+	Mesh.BVH.Build(Vertices, Indices);
+	if (!Mesh.BVH.IsEmpty())
+	{
+		MarkDirty(Mesh.BVH.GetBounds());
+	}
+}
+
+void FFlowHeightBaker::RemoveMesh(int32 MeshId)
+{
+	if (const FMesh* Mesh = Meshes.Find(MeshId))
+	{
+		if (!Mesh->BVH.IsEmpty())
+		{
+			MarkDirty(Mesh->BVH.GetBounds());
+		}
+		Meshes.Remove(MeshId);
+	}
+}
+
+void FFlowHeightBaker::MarkAllDirty()
+{
+	DirtyTiles.Init(true, TilesX * TilesY);
+}
+
+int32 FFlowHeightBaker::GetNumDirtyTiles() const
+{
+	return DirtyTiles.CountSetBits();
+}
+
+void FFlowHeightBaker::MarkDirty(const FBox3f& LocalBounds)
+{
+	if (!IsInitialized())
+	{
+		return;
+	}
+
+	// Local XY to texels: UV = Local / Extent + 0.5.
+	const int32 MinX = FMath::FloorToInt32((LocalBounds.Min.X / Extent.X + 0.5f) * Height.Width);
+	const int32 MinY = FMath::FloorToInt32((LocalBounds.Min.Y / Extent.Y + 0.5f) * Height.Height);
+	const int32 MaxX = FMath::FloorToInt32((LocalBounds.Max.X / Extent.X + 0.5f) * Height.Width);
+	const int32 MaxY = FMath::FloorToInt32((LocalBounds.Max.Y / Extent.Y + 0.5f) * Height.Height);
+	if (MaxX < 0 || MaxY < 0 || MinX >= Height.Width || MinY >= Height.Height)
+	{
+		return;
+	}
+
+	for (int32 TileY = FMath::Max(MinY, 0) / TileSize; TileY <= FMath::Min(MaxY, Height.Height - 1) / TileSize; ++TileY)
+	{
+		for (int32 TileX = FMath::Max(MinX, 0) / TileSize; TileX <= FMath::Min(MaxX, Height.Width - 1) / TileSize; ++TileX)
+		{
+			DirtyTiles[TileY * TilesX + TileX] = true;
+		}
+	}
+}
+
+FIntRect FFlowHeightBaker::GetTileRect(int32 Tile) const
+{
+	const FIntPoint Min((Tile % TilesX) * TileSize, (Tile / TilesX) * TileSize);
+	return FIntRect(Min, FIntPoint(FMath::Min(Min.X + TileSize, Height.Width), FMath::Min(Min.Y + TileSize, Height.Height)));
+}
+
+int32 FFlowHeightBaker::BakeDirtyTiles()
+{
+	BakedTiles.Reset();
+	if (!IsInitialized())
+	{
+		return 0;
+	}
+
+	TArray<int32> Tiles;
+	for (TConstSetBitIterator<> It(DirtyTiles); It; ++It)
+	{
+		Tiles.Add(It.GetIndex());
+		BakedTiles.Add(GetTileRect(It.GetIndex()));
+	}
+	if (Tiles.Num() == 0)
+	{
+		return 0;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_HeightBake, EFlowMapTimer::HeightBake);
+
+	// Flat view of the meshes so the workers never touch the map.
+	TArray<const FMesh*> MeshList;
+	for (const TPair<int32, FMesh>& Pair : Meshes)
+	{
+		if (!Pair.Value.BVH.IsEmpty())
+		{
+			MeshList.Add(&Pair.Value);
+		}
+	}
+
+	ParallelFor(Tiles.Num(), [this, &Tiles, &MeshList](int32 Task)
+	{
+		const FIntRect Rect = GetTileRect(Tiles[Task]);
+		for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+		{
+			for (int32 X = Rect.Min.X; X < Rect.Max.X; ++X)
+			{
+				const FVector2f Point(((X + 0.5f) / Height.Width - 0.5f) * Extent.X, ((Y + 0.5f) / Height.Height - 0.5f) * Extent.Y);
+
+				float TerrainZ = -MAX_flt;
+				float RiverZ = -MAX_flt;
+				bool bTerrain = false;
+				bool bRiver = false;
+				for (const FMesh* Mesh : MeshList)
+				{
+					if (Mesh->Role == EFlowBakeRole::Terrain)
+					{
+						bTerrain |= Mesh->BVH.TraceDown(Point, TerrainZ);
+					}
+					else if (Mesh->Role == EFlowBakeRole::River)
+					{
+						bRiver |= Mesh->BVH.TraceDown(Point, RiverZ);
+					}
+				}
+
+				const bool bRiverOnTop = bRiver && (!bTerrain || RiverZ >= TerrainZ - SurfaceTolerance);
+				const float SurfaceZ = bRiverOnTop ? RiverZ : (bTerrain ? TerrainZ : 0.0f);
+
+				// Blockers only count where they break the surface; submerged rocks leave the river as it is.
+				bool bBlocked = false;
+				for (const FMesh* Mesh : MeshList)
+				{
+					float BlockerZ = SurfaceZ;
+					if (Mesh->Role == EFlowBakeRole::Blocker && Mesh->BVH.TraceDown(Point, BlockerZ))
+					{
+						bBlocked = true;
+						break;
+					}
+				}
+
+				const int32 Index = Height.Index(X, Y);
+				Height.Texels[Index] = FMath::Max(SurfaceZ / HeightScale, 0.0f);
+				River.Texels[Index] = bRiverOnTop ? 1.0f : 0.0f;
+				Blockers.Texels[Index] = bBlocked ? 1.0f : 0.0f;
+			}
+		}
+	});
+
+	DirtyTiles.Init(false, TilesX * TilesY);
+	return Tiles.Num();
+}
+
+void FFlowHeightBaker::GetMask(FFlowScalarField& OutMask) const
+{
+	OutMask.Init(River.Width, River.Height, 0.0f);
+	for (int32 Index = 0; Index < OutMask.Texels.Num(); ++Index)
+	{
+		OutMask.Texels[Index] = River.Texels[Index] * (1.0f - Blockers.Texels[Index]);
+	}
+}
+
+bool FFlowHeightBaker::GatherStaticMesh(const UStaticMeshComponent* Component, const FTransform& RiverTransform,
+	TArray<FVector3f>& OutVertices, TArray<uint32>& OutIndices)
+{
+	OutVertices.Reset();
+	OutIndices.Reset();
+
+	const UStaticMesh* StaticMesh = Component ? Component->GetStaticMesh() : nullptr;
+	const FStaticMeshRenderData* RenderData = StaticMesh ? StaticMesh->GetRenderData() : nullptr;
+	if (!RenderData || RenderData->LODResources.Num() == 0)
+	{
+		return false;
+	}
+
+	if (!GIsEditor && !StaticMesh->bAllowCPUAccess)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s needs Allow CPU Access to be baked outside the editor"), *StaticMesh->GetName());
+		return false;
+	}
+
+	const FStaticMeshLODResources& LOD = RenderData->LODResources[0];
+	const FPositionVertexBuffer& Positions = LOD.VertexBuffers.PositionVertexBuffer;
+
+	// River-local space ignores the river's scale, like UFlowRiverComponent::MapUVToWorld.
+	const FTransform& ComponentTransform = Component->GetComponentTransform();
+	OutVertices.SetNumUninitialized(Positions.GetNumVertices());
+	for (uint32 Vertex = 0; Vertex < Positions.GetNumVertices(); ++Vertex)
+	{
+		const FVector World = ComponentTransform.TransformPosition(FVector(Positions.VertexPosition(Vertex)));
+		OutVertices[Vertex] = FVector3f(RiverTransform.InverseTransformPositionNoScale(World));
+	}
+
+	LOD.IndexBuffer.GetCopy(OutIndices);
+	return OutIndices.Num() >= 3;
+}
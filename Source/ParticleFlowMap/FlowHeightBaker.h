@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowField.h"
+#include "FlowHeightBaker.generated.h"
+
+class UStaticMeshComponent;
+
+UENUM(BlueprintType)
+enum class EFlowBakeRole : uint8
+{
+	/** Ground and banks; gives the height where there is no river surface above it. */
+	Terrain,
+	/** Water surface meshes; where they are the top surface the texel is river, at their height. */
+	River,
+	/** Rocks, piers and the like; they remove the river wherever they reach above its surface. */
+	Blocker,
+};
+
+/**
+ * Bounding volume hierarchy over one mesh's triangles, specialised for rays straight down: nodes are split in X and Y
+ * only, and traversal visits the child that reaches higher first and skips anything below the best hit so far.
+ */
+class PARTICLEFLOWMAP_API FFlowVerticalRayBVH
+{
+public:
+	/** Positions in river-local space, indices as a triangle list. */
+	void Build(TConstArrayView<FVector3f> Vertices, TConstArrayView<uint32> Indices);
+
+	bool IsEmpty() const { return Nodes.Num() == 0; }
+	const FBox3f& GetBounds() const { return Bounds; }
+	int32 GetNumTriangles() const { return Triangles.Num(); }
+
+	/** Raises InOutZ to the highest surface above Point that is higher than it; returns whether there was one. */
+	bool TraceDown(const FVector2f& Point, float& InOutZ) const;
+
+private:
+	struct FNode
+	{
+		FBox3f Bounds;
+		/** Leaves: first triangle. Inner nodes: the second child; the first child always follows its parent. */
+		int32 Index = 0;
+		/** Triangles in a leaf, 0 for inner nodes. */
+		int32 Count = 0;
+	};
+
+	struct FTriangle
+	{
+		FVector3f A, B, C;
+	};
+
+	int32 BuildNode(TArray<int32>& Order, TArray<FBox3f>& TriangleBounds, int32 Begin, int32 End);
+
+	TArray<FNode> Nodes;
+	TArray<FTriangle> Triangles;
+	FBox3f Bounds = FBox3f(ForceInit);
+};
+
+/**
+ * Bakes a river's height map, and optionally its mask and blockers, by casting one vertical ray per texel against
+ * the landscape, river and blocker meshes. Each mesh has its own BVH, so a mesh that moves only rebuilds its own tree
+ * and re-traces the tiles under its old and new footprint. Tiles are traced in parallel.
+ *
+ * Heights are local Z over HeightScale, as UFlowRiverComponent reads them; texels that hit nothing get 0.
+ */
+class PARTICLEFLOWMAP_API FFlowHeightBaker
+{
+public:
+	/** Sets the output size and river placement and marks everything dirty. */
+	void Initialize(int32 InWidth, int32 InHeight, const FVector2f& InExtent, float InHeightScale, int32 InTileSize);
+
+	bool IsInitialized() const { return Height.IsValid(); }
+
+	/** Adds or replaces a mesh; the tiles under its previous and new footprint are marked dirty. */
+	void SetMesh(int32 MeshId, EFlowBakeRole Role, TConstArrayView<FVector3f> Vertices, TConstArrayView<uint32> Indices);
+	void RemoveMesh(int32 MeshId);
+	bool HasMesh(int32 MeshId) const { return Meshes.Contains(MeshId); }
+
+	void MarkAllDirty();
+	int32 GetNumDirtyTiles() const;
+
+	/** Re-traces every dirty tile; returns how many were baked. */
+	int32 BakeDirtyTiles();
+
+	/** Height in height map units. */
+	const FFlowScalarField& GetHeight() const { return Height; }
+	/** 1 where a river surface is the top surface, 0 elsewhere. */
+	const FFlowScalarField& GetRiver() const { return River; }
+	/** 1 where a blocker reaches above the top surface. */
+	const FFlowScalarField& GetBlockers() const { return Blockers; }
+	/** River coverage with the blockers removed, the way the mask map stores it. */
+	void GetMask(FFlowScalarField& OutMask) const;
+
+	/** Tiles baked by the last BakeDirtyTiles, in texels. */
+	TConstArrayView<FIntRect> GetBakedTiles() const { return BakedTiles; }
+
+	/**
+	 * Copies LOD 0 of a static mesh component's triangles into river-local space. Needs the mesh's CPU data, which
+	 * the editor always has; cooked builds need Allow CPU Access on the mesh.
+	 */
+	static bool GatherStaticMesh(const UStaticMeshComponent* Component, const FTransform& RiverTransform,
+		TArray<FVector3f>& OutVertices, TArray<uint32>& OutIndices);
+
+	/** River surfaces up to this far (local units) below the terrain still count as on top, for coplanar meshes. */
+	static constexpr float SurfaceTolerance = 1.0f;
+
+private:
+	struct FMesh
+	{
+		EFlowBakeRole Role = EFlowBakeRole::Terrain;
+		FFlowVerticalRayBVH BVH;
+	};
+
+	void MarkDirty(const FBox3f& LocalBounds);
+	FIntRect GetTileRect(int32 Tile) const;
+
+	FVector2f Extent = FVector2f(1.0f, 1.0f);
+	float HeightScale = 1.0f;
+	int32 TileSize = 64;
+	int32 TilesX = 0;
+	int32 TilesY = 0;
+
+	TMap<int32, FMesh> Meshes;
+	TBitArray<> DirtyTiles;
+	TArray<FIntRect> BakedTiles;
+
+	FFlowScalarField Height;
+	FFlowScalarField River;
+	FFlowScalarField Blockers;
+};
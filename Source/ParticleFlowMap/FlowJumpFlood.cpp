@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowJumpFlood.h"
+#include "FlowMapStats.h"
+#include "Async/ParallelFor.h"
+
+void FlowMap::BuildJumpFlood(const FFlowScalarField& Mask, FFlowField& OutDirection, FFlowScalarField& OutDistance)
+{
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_JumpFlood, EFlowMapTimer::JumpFlood);
+
+	const int32 Width = Mask.Width;
+	const int32 Height = Mask.Height;
+	OutDirection.Init(Width, Height, FVector2f::ZeroVector);
+	OutDistance.Init(Width, Height, 0.0f);
+	if (!Mask.IsValid())
+	{
+		return;
+	}
+
+	// Nearest bank texel found so far for every texel, as a texel index.
+	const int32 NumTexels = Width * Height;
+	TArray<int32> Nearest;
+	TArray<int32> Next;
+	Nearest.SetNumUninitialized(NumTexels);
+	Next.SetNumUninitialized(NumTexels);
+	for (int32 Index = 0; Index < NumTexels; ++Index)
+	{
+		Nearest[Index] = Mask.Texels[Index] < RiverMaskThreshold ? Index : INDEX_NONE;
+	}
+
+	const FVector2f TexelSize(1.0f / Width, 1.0f / Height);
+	auto ToSeed = [Width, TexelSize](int32 X, int32 Y, int32 Seed)
+	{
+		return FVector2f(float(Seed % Width - X) * TexelSize.X, float(Seed / Width - Y) * TexelSize.Y);
+	};
+
+	TArray<int32, TInlineAllocator<16>> Steps;
+	for (int32 Step = int32(FMath::RoundUpToPowerOfTwo(uint32(FMath::Max(Width, Height)))) / 2; Step >= 1; Step /= 2)
+	{
+		Steps.Add(Step);
+	}
+	Steps.Add(1);
+
+	for (const int32 Step : Steps)
+	{
+		ParallelFor(Height, [&, Step](int32 Y)
+		{
+			for (int32 X = 0; X < Width; ++X)
+			{
+				int32 Best = Nearest[Y * Width + X];
+				float BestDistance = Best == INDEX_NONE ? MAX_flt : ToSeed(X, Y, Best).SizeSquared();
+				for (int32 DY = -1; DY <= 1; ++DY)
+				{
+					const int32 SY = Y + DY * Step;
+					if (SY < 0 || SY >= Height)
+					{
+						continue;
+					}
+					for (int32 DX = -1; DX <= 1; ++DX)
+					{
+						const int32 SX = X + DX * Step;
+						if ((DX == 0 && DY == 0) || SX < 0 || SX >= Width)
+						{
+							continue;
+						}
+
+						const int32 Seed = Nearest[SY * Width + SX];
+						if (Seed == INDEX_NONE || Seed == Best)
+						{
+							continue;
+						}
+
+						const float Distance = ToSeed(X, Y, Seed).SizeSquared();
+						if (Distance < BestDistance)
+						{
+							Best = Seed;
+							BestDistance = Distance;
+						}
+					}
+				}
+				Next[Y * Width + X] = Best;
+			}
+		});
+		Swap(Nearest, Next);
+	}
+
+	ParallelFor(Height, [&](int32 Y)
+	{
+		for (int32 X = 0; X < Width; ++X)
+		{
+			const int32 Index = Y * Width + X;
+			const int32 Seed = Nearest[Index];
+			if (Seed == INDEX_NONE)
+			{
+				OutDistance.Texels[Index] = UE_SQRT_2;
+			}
+			else if (Seed != Index)
+			{
+				const FVector2f ToBank = ToSeed(X, Y, Seed);
+				OutDistance.Texels[Index] = ToBank.Size();
+				OutDirection.Texels[Index] = ToBank.GetSafeNormal();
+			}
+		}
+	});
+}
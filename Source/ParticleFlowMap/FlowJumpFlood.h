@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowField.h"
+
+namespace FlowMap
+{
+	/** Mask values at or above this are river, below it bank. */
+	inline constexpr float RiverMaskThreshold = 0.5f;
+
+	/**
+	 * CPU version of the JumpFlood pass: for every river texel of Mask, the direction (unit length, in UV) and the UV
+	 * distance to the nearest bank texel, as RT_JumpFlood stores them in RG and B. Bank texels get zero; a mask with
+	 * no bank at all gets the map diagonal everywhere.
+	 *
+	 * Runs log2(size) passes with halving steps plus one more pass at step 1, which removes most of the errors the
+	 * coarse passes leave. Each pass is parallel over rows.
+	 */
+	PARTICLEFLOWMAP_API void BuildJumpFlood(const FFlowScalarField& Mask, FFlowField& OutDirection, FFlowScalarField& OutDistance);
+}
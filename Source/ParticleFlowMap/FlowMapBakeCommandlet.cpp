@@ -0,0 +1,564 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapBakeCommandlet.h"
+#include "ParticleFlowMap.h"
+#include "FlowField.h"
+#include "FlowHeightBakeComponent.h"
+#include "FlowJumpFlood.h"
+#include "FlowMapTileFile.h"
+#include "FlowMaskRasterComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/FileManager.h"
+#include "Hash/xxhash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Tasks/Task.h"
+#include "UObject/Package.h"
+
+#if WITH_EDITOR
+#include "AssetRegistry/AssetRegistryModule.h"
+#endif
+
+namespace FlowMapBakeCommandlet
+{
+	/** Part of every input hash; bump it when a baker's output changes so the next run bakes everything again. */
+	static constexpr uint32 BakeVersion = 1;
+
+	/** Tile size of the written files, the tile loader's default. */
+	static constexpr int32 FileTileSize = 64;
+
+	/** Size, format and file of one of the river's maps, copied off its render target. */
+	struct FBakeTarget
+	{
+		FString Path;
+		int32 Width = 0;
+		int32 Height = 0;
+		EFlowMapTexelFormat Format = EFlowMapTexelFormat::BGRA8;
+		bool bSRGB = false;
+		FLinearColor Default = FLinearColor::Black;
+
+		bool IsValid() const { return Width > 0 && Height > 0; }
+	};
+
+	struct FBakeMesh
+	{
+		EFlowBakeRole Role = EFlowBakeRole::Terrain;
+		TArray<FVector3f> Vertices;
+		TArray<uint32> Indices;
+	};
+
+	/** Everything one river's bake needs, gathered on the game thread so the bake itself touches no UObjects. */
+	struct FRiverBake
+	{
+		FString Name;
+		FVector2f Extent = FVector2f(1.0f, 1.0f);
+		float HeightScale = 1.0f;
+
+		FBakeTarget MaskTarget;
+		FBakeTarget JumpFloodTarget;
+		FBakeTarget HeightTarget;
+
+		bool bRasterMask = false;
+		int32 RasterTileSize = 64;
+		TArray<FFlowMaskShape> MaskShapes;
+
+		bool bBakeHeight = false;
+		bool bHeightWritesMask = false;
+		int32 HeightTileSize = 64;
+		TArray<FBakeMesh> HeightMeshes;
+
+		bool bWritesMask = false;
+		bool bWritesJumpFlood = false;
+		bool bWritesHeight = false;
+
+		uint64 InputHash = 0;
+	};
+
+	struct FRiverBakeResult
+	{
+		bool bSuccess = false;
+		double HeightSeconds = 0.0;
+		double MaskSeconds = 0.0;
+		double JumpFloodSeconds = 0.0;
+		double WriteSeconds = 0.0;
+		int32 NumMaps = 0;
+		int32 NumStoredTiles = 0;
+		int64 FileBytes = 0;
+		FString Error;
+
+		double GetTotalSeconds() const { return HeightSeconds + MaskSeconds + JumpFloodSeconds + WriteSeconds; }
+	};
+
+	static bool MakeTarget(const UTextureRenderTarget2D* RenderTarget, const FString& Path, FBakeTarget& OutTarget)
+	{
+		if (!RenderTarget)
+		{
+			return false;
+		}
+
+		if (!FFlowMapTileFile::GetTexelFormat(RenderTarget->GetFormat(), OutTarget.Format))
+		{
+			UE_LOG(LogParticleFlowMap, Warning, TEXT("%s uses %s, which flowmap tile files cannot store"),
+				*RenderTarget->GetName(), GetPixelFormatString(RenderTarget->GetFormat()));
+			return false;
+		}
+
+		OutTarget.Path = Path;
+		OutTarget.Width = RenderTarget->SizeX;
+		OutTarget.Height = RenderTarget->SizeY;
+		OutTarget.bSRGB = RenderTarget->IsSRGB();
+		OutTarget.Default = RenderTarget->ClearColor;
+		return OutTarget.IsValid();
+	}
+
+	static void GatherActorMeshes(const AActor* Actor, const FTransform& RiverTransform, TFunctionRef<void(TArray<FVector3f>&, TArray<uint32>&)> Add)
+	{
+		TArray<UStaticMeshComponent*> Components;
+		Actor->GetComponents(Components);
+		for (const UStaticMeshComponent* Component : Components)
+		{
+			TArray<FVector3f> Vertices;
+			TArray<uint32> Indices;
+			if (FFlowHeightBaker::GatherStaticMesh(Component, RiverTransform, Vertices, Indices))
+			{
+				Add(Vertices, Indices);
+			}
+		}
+	}
+
+	/** Fills Bake from the actor's components; returns false if the river has nothing this commandlet can bake. */
+	static bool GatherRiver(const AActor& Actor, const UFlowRiverComponent& River, const FString& LevelName, FRiverBake& Bake)
+	{
+		const FString ActorName = Actor.GetFName().ToString();
+		auto GetPath = [&LevelName, &ActorName](EFlowRiverMap Map)
+		{
+			return FPaths::Combine(FPaths::ProjectContentDir(), UFlowMapBakeCommandlet::GetBakedMapFile(LevelName, ActorName, Map));
+		};
+
+		const FTransform RiverTransform = River.GetComponentTransform();
+		Bake.Extent = FVector2f(River.Extent);
+		Bake.HeightScale = River.HeightScale;
+		MakeTarget(River.MaskMap, GetPath(EFlowRiverMap::Mask), Bake.MaskTarget);
+		MakeTarget(River.JumpFloodMap, GetPath(EFlowRiverMap::JumpFlood), Bake.JumpFloodTarget);
+		MakeTarget(River.HeightMap, GetPath(EFlowRiverMap::Height), Bake.HeightTarget);
+
+		const UFlowMaskRasterComponent* Raster = Actor.FindComponentByClass<UFlowMaskRasterComponent>();
+		if (Raster && Bake.MaskTarget.IsValid())
+		{
+			Bake.bRasterMask = true;
+			Bake.RasterTileSize = Raster->TileSize;
+			for (const FFlowBakeInput& Input : Raster->Inputs)
+			{
+				if (!Input.Actor || Input.Role == EFlowBakeRole::Terrain)
+				{
+					continue;
+				}
+				GatherActorMeshes(Input.Actor, RiverTransform, [&Bake, &Input](TArray<FVector3f>& Vertices, TArray<uint32>& Indices)
+				{
+					FFlowMaskShape& Shape = Bake.MaskShapes.AddDefaulted_GetRef();
+					Shape.bBlocker = Input.Role == EFlowBakeRole::Blocker;
+					Shape.AddTriangles(Vertices, Indices);
+				});
+			}
+
+			TArray<FVector2f> Points;
+			for (const FFlowMaskPolygon& Polygon : Raster->Polygons)
+			{
+				if (Polygon.Points.Num() < 3)
+				{
+					continue;
+				}
+				Points.Reset();
+				for (const FVector2D& Point : Polygon.Points)
+				{
+					Points.Add(FVector2f(Point));
+				}
+				FFlowMaskShape& Shape = Bake.MaskShapes.AddDefaulted_GetRef();
+				Shape.bBlocker = Polygon.bBlocker;
+				Shape.AddLoop(Points);
+			}
+		}
+
+		const UFlowHeightBakeComponent* HeightBake = Actor.FindComponentByClass<UFlowHeightBakeComponent>();
+		if (HeightBake && (Bake.HeightTarget.IsValid() || (HeightBake->bWriteMask && Bake.MaskTarget.IsValid())))
+		{
+			Bake.bBakeHeight = true;
+			Bake.bHeightWritesMask = HeightBake->bWriteMask && Bake.MaskTarget.IsValid();
+			Bake.HeightTileSize = HeightBake->TileSize;
+			for (const FFlowBakeInput& Input : HeightBake->Inputs)
+			{
+				if (!Input.Actor)
+				{
+					continue;
+				}
+				GatherActorMeshes(Input.Actor, RiverTransform, [&Bake, &Input](TArray<FVector3f>& Vertices, TArray<uint32>& Indices)
+				{
+					FBakeMesh& Mesh = Bake.HeightMeshes.AddDefaulted_GetRef();
+					Mesh.Role = Input.Role;
+					Mesh.Vertices = MoveTemp(Vertices);
+					Mesh.Indices = MoveTemp(Indices);
+				});
+			}
+			Bake.bBakeHeight = Bake.HeightMeshes.Num() > 0;
+		}
+
+		// With both components the rasterized mask is kept: it has exact coverage where the ray bake samples texel centres.
+		Bake.bWritesMask = Bake.bRasterMask || (Bake.bBakeHeight && Bake.bHeightWritesMask);
+		Bake.bWritesJumpFlood = Bake.bWritesMask && Bake.JumpFloodTarget.IsValid();
+		Bake.bWritesHeight = Bake.bBakeHeight && Bake.HeightTarget.IsValid();
+		return Bake.bWritesMask || Bake.bWritesHeight;
+	}
+
+	static void HashTarget(FXxHash64Builder& Builder, const FBakeTarget& Target)
+	{
+		Builder.Update(*Target.Path, Target.Path.Len() * sizeof(TCHAR));
+		Builder.Update(&Target.Width, sizeof(Target.Width));
+		Builder.Update(&Target.Height, sizeof(Target.Height));
+		Builder.Update(&Target.Format, sizeof(Target.Format));
+		Builder.Update(&Target.bSRGB, sizeof(Target.bSRGB));
+		Builder.Update(&Target.Default, sizeof(Target.Default));
+	}
+
+	/** Hashes the gathered geometry itself, so editing a mesh asset re-bakes the rivers that use it. */
+	static uint64 HashInputs(const FRiverBake& Bake)
+	{
+		FXxHash64Builder Builder;
+		Builder.Update(&BakeVersion, sizeof(BakeVersion));
+		Builder.Update(&Bake.Extent, sizeof(Bake.Extent));
+		Builder.Update(&Bake.HeightScale, sizeof(Bake.HeightScale));
+		HashTarget(Builder, Bake.MaskTarget);
+		HashTarget(Builder, Bake.JumpFloodTarget);
+		HashTarget(Builder, Bake.HeightTarget);
+
+		Builder.Update(&Bake.bRasterMask, sizeof(Bake.bRasterMask));
+		Builder.Update(&Bake.RasterTileSize, sizeof(Bake.RasterTileSize));
+		for (const FFlowMaskShape& Shape : Bake.MaskShapes)
+		{
+			Builder.Update(&Shape.bBlocker, sizeof(Shape.bBlocker));
+			Builder.Update(Shape.Edges.GetData(), Shape.Edges.NumBytes());
+		}
+
+		Builder.Update(&Bake.bBakeHeight, sizeof(Bake.bBakeHeight));
+		Builder.Update(&Bake.bHeightWritesMask, sizeof(Bake.bHeightWritesMask));
+		Builder.Update(&Bake.HeightTileSize, sizeof(Bake.HeightTileSize));
+		for (const FBakeMesh& Mesh : Bake.HeightMeshes)
+		{
+			Builder.Update(&Mesh.Role, sizeof(Mesh.Role));
+			Builder.Update(Mesh.Vertices.GetData(), Mesh.Vertices.NumBytes());
+			Builder.Update(Mesh.Indices.GetData(), Mesh.Indices.NumBytes());
+		}
+		return Builder.Finalize().Hash;
+	}
+
+	static bool OutputsExist(const FRiverBake& Bake)
+	{
+		IFileManager& FileManager = IFileManager::Get();
+		return (!Bake.bWritesMask || FileManager.FileExists(*Bake.MaskTarget.Path))
+			&& (!Bake.bWritesJumpFlood || FileManager.FileExists(*Bake.JumpFloodTarget.Path))
+			&& (!Bake.bWritesHeight || FileManager.FileExists(*Bake.HeightTarget.Path));
+	}
+
+	/** Runs on a worker; the bakers parallelise over tiles inside it. */
+	static FRiverBakeResult BakeRiver(const FRiverBake& Bake)
+	{
+		FRiverBakeResult Result;
+		FFlowScalarField Mask;
+		FFlowScalarField Height;
+
+		if (Bake.bBakeHeight)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			const FBakeTarget& Size = Bake.HeightTarget.IsValid() ? Bake.HeightTarget : Bake.MaskTarget;
+			FFlowHeightBaker Baker;
+			Baker.Initialize(Size.Width, Size.Height, Bake.Extent, Bake.HeightScale, Bake.HeightTileSize);
+			for (int32 MeshId = 0; MeshId < Bake.HeightMeshes.Num(); ++MeshId)
+			{
+				const FBakeMesh& Mesh = Bake.HeightMeshes[MeshId];
+				Baker.SetMesh(MeshId, Mesh.Role, Mesh.Vertices, Mesh.Indices);
+			}
+			Baker.BakeDirtyTiles();
+
+			if (Bake.bWritesHeight)
+			{
+				Height.ResampleFrom(Baker.GetHeight(), Bake.HeightTarget.Width, Bake.HeightTarget.Height);
+			}
+			if (Bake.bHeightWritesMask && !Bake.bRasterMask)
+			{
+				FFlowScalarField BakedMask;
+				Baker.GetMask(BakedMask);
+				Mask.ResampleFrom(BakedMask, Bake.MaskTarget.Width, Bake.MaskTarget.Height);
+			}
+			Result.HeightSeconds = FPlatformTime::Seconds() - StartTime;
+		}
+
+		if (Bake.bRasterMask)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			FFlowMaskRasterizer Rasterizer;
+			Rasterizer.Initialize(Bake.MaskTarget.Width, Bake.MaskTarget.Height, Bake.Extent, Bake.RasterTileSize);
+			for (int32 ShapeId = 0; ShapeId < Bake.MaskShapes.Num(); ++ShapeId)
+			{
+				FFlowMaskShape Shape = Bake.MaskShapes[ShapeId];
+				Rasterizer.SetShape(ShapeId, MoveTemp(Shape));
+			}
+			Rasterizer.RasterizeDirtyTiles();
+
+			Mask.Init(Rasterizer.GetWidth(), Rasterizer.GetHeight(), 0.0f);
+			for (int32 Index = 0; Index < Mask.Texels.Num(); ++Index)
+			{
+				Mask.Texels[Index] = Rasterizer.GetMask()[Index] / 255.0f;
+			}
+			Result.MaskSeconds = FPlatformTime::Seconds() - StartTime;
+		}
+
+		FFlowField WallDirection;
+		FFlowScalarField WallDistance;
+		if (Bake.bWritesJumpFlood)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			FFlowScalarField FloodMask;
+			FloodMask.ResampleFrom(Mask, Bake.JumpFloodTarget.Width, Bake.JumpFloodTarget.Height);
+			FlowMap::BuildJumpFlood(FloodMask, WallDirection, WallDistance);
+			Result.JumpFloodSeconds = FPlatformTime::Seconds() - StartTime;
+		}
+
+		const double WriteStartTime = FPlatformTime::Seconds();
+		TArray<FLinearColor> Pixels;
+		auto WriteMap = [&Result, &Pixels](const FBakeTarget& Target, TFunctionRef<FLinearColor(int32)> GetPixel)
+		{
+			Pixels.SetNumUninitialized(Target.Width * Target.Height);
+			for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+			{
+				Pixels[Index] = GetPixel(Index);
+			}
+
+			FFlowMapTexels Texels;
+			FFlowMapTileFile::EncodeTexels(Pixels, Target.Width, Target.Height, Target.Format, Target.bSRGB, Target.Default, Texels);
+			FFlowMapTileSaveStats Stats;
+			if (!FFlowMapTileFile::Save(Target.Path, Texels, FileTileSize, &Stats))
+			{
+				Result.Error = FString::Printf(TEXT("could not write %s"), *Target.Path);
+				return false;
+			}
+
+			++Result.NumMaps;
+			Result.NumStoredTiles += Stats.NumStoredTiles;
+			Result.FileBytes += Stats.FileSize;
+			return true;
+		};
+
+		// Channels the bake does not own keep the target's clear colour.
+		bool bWritten = true;
+		if (Bake.bWritesMask)
+		{
+			const FLinearColor& Default = Bake.MaskTarget.Default;
+			bWritten &= WriteMap(Bake.MaskTarget, [&Mask, &Default](int32 Index)
+			{
+				return FLinearColor(Mask.Texels[Index], Default.G, Default.B, Default.A);
+			});
+		}
+		if (Bake.bWritesJumpFlood && bWritten)
+		{
+			bWritten &= WriteMap(Bake.JumpFloodTarget, [&WallDirection, &WallDistance](int32 Index)
+			{
+				FLinearColor Color = FlowMap::EncodeFlow(WallDirection.Texels[Index]);
+				Color.B = WallDistance.Texels[Index];
+				return Color;
+			});
+		}
+		if (Bake.bWritesHeight && bWritten)
+		{
+			const FLinearColor& Default = Bake.HeightTarget.Default;
+			bWritten &= WriteMap(Bake.HeightTarget, [&Height, &Default](int32 Index)
+			{
+				return FLinearColor(Height.Texels[Index], Default.G, Default.B, Default.A);
+			});
+		}
+		Result.WriteSeconds = FPlatformTime::Seconds() - WriteStartTime;
+		Result.bSuccess = bWritten;
+		return Result;
+	}
+
+	static TMap<FString, uint64> LoadCache(const FString& Path)
+	{
+		TMap<FString, uint64> Cache;
+		TArray<FString> Lines;
+		FFileHelper::LoadFileToStringArray(Lines, *Path);
+		for (const FString& Line : Lines)
+		{
+			FString Key;
+			FString Hash;
+			if (Line.Split(TEXT(" "), &Key, &Hash))
+			{
+				Cache.Add(Key, FCString::Strtoui64(*Hash, nullptr, 16));
+			}
+		}
+		return Cache;
+	}
+
+	static bool SaveCache(const FString& Path, TMap<FString, uint64>& Cache)
+	{
+		Cache.KeySort(TLess<FString>());
+		TArray<FString> Lines;
+		for (const TPair<FString, uint64>& Entry : Cache)
+		{
+			Lines.Add(FString::Printf(TEXT("%s %016llx"), *Entry.Key, Entry.Value));
+		}
+		return FFileHelper::SaveStringArrayToFile(Lines, *Path);
+	}
+}
+
+UFlowMapBakeCommandlet::UFlowMapBakeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+FString UFlowMapBakeCommandlet::GetBakedMapFile(const FString& LevelName, const FString& ActorName, EFlowRiverMap Map)
+{
+	return FString::Printf(TEXT("FlowMaps/%s_%s_%s.flowtiles"), *LevelName, *ActorName, *StaticEnum<EFlowRiverMap>()->GetNameStringByValue(int64(Map)));
+}
+
+int32 UFlowMapBakeCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	using namespace FlowMapBakeCommandlet;
+
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamValues;
+	ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+	const bool bForce = Switches.Contains(TEXT("Force"));
+	const FString MapFilter = ParamValues.FindRef(TEXT("Map"));
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+	AssetRegistry.SearchAllAssets(true);
+	TArray<FAssetData> Levels;
+	AssetRegistry.GetAssetsByClass(UWorld::StaticClass()->GetClassPathName(), Levels);
+	Levels.Sort([](const FAssetData& A, const FAssetData& B) { return A.PackageName.LexicalLess(B.PackageName); });
+
+	const FString CachePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FlowMapBake"), TEXT("BakeCache.txt"));
+	TMap<FString, uint64> Cache = LoadCache(CachePath);
+
+	struct FPendingBake
+	{
+		FString Name;
+		FString CacheKey;
+		uint64 InputHash = 0;
+		UE::Tasks::TTask<FRiverBakeResult> Task;
+	};
+	TArray<FPendingBake> PendingBakes;
+
+	int32 NumLevels = 0;
+	int32 NumRivers = 0;
+	int32 NumUnchanged = 0;
+	int32 NumEmpty = 0;
+	for (const FAssetData& Level : Levels)
+	{
+		const FString PackageName = Level.PackageName.ToString();
+		const FString LevelName = Level.AssetName.ToString();
+		if (!PackageName.StartsWith(TEXT("/Game/")) || (!MapFilter.IsEmpty() && !LevelName.Contains(MapFilter)))
+		{
+			continue;
+		}
+
+		UPackage* Package = LoadPackage(nullptr, *PackageName, LOAD_None);
+		UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+		if (!World || !World->PersistentLevel)
+		{
+			UE_LOG(LogParticleFlowMap, Warning, TEXT("Could not load %s"), *PackageName);
+			continue;
+		}
+		++NumLevels;
+
+		// The world is never initialised, so bring world transforms up to date from the saved relative ones.
+		for (AActor* Actor : World->PersistentLevel->Actors)
+		{
+			if (Actor && Actor->GetRootComponent())
+			{
+				Actor->GetRootComponent()->UpdateComponentToWorld();
+			}
+		}
+
+		for (AActor* Actor : World->PersistentLevel->Actors)
+		{
+			const UFlowRiverComponent* River = Actor ? Actor->FindComponentByClass<UFlowRiverComponent>() : nullptr;
+			if (!River)
+			{
+				continue;
+			}
+			++NumRivers;
+
+			TSharedRef<FRiverBake> Bake = MakeShared<FRiverBake>();
+			Bake->Name = LevelName / Actor->GetFName().ToString();
+			if (!GatherRiver(*Actor, *River, LevelName, *Bake))
+			{
+				UE_LOG(LogParticleFlowMap, Display, TEXT("%s: no mask or height inputs, nothing to bake"), *Bake->Name);
+				++NumEmpty;
+				continue;
+			}
+
+			Bake->InputHash = HashInputs(*Bake);
+			const FString CacheKey = PackageName + TEXT(":") + Actor->GetFName().ToString();
+			const uint64* CachedHash = Cache.Find(CacheKey);
+			if (!bForce && CachedHash && *CachedHash == Bake->InputHash && OutputsExist(*Bake))
+			{
+				UE_LOG(LogParticleFlowMap, Display, TEXT("%s: unchanged, skipped"), *Bake->Name);
+				++NumUnchanged;
+				continue;
+			}
+
+			FPendingBake& Pending = PendingBakes.AddDefaulted_GetRef();
+			Pending.Name = Bake->Name;
+			Pending.CacheKey = CacheKey;
+			Pending.InputHash = Bake->InputHash;
+			Pending.Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Bake]() { return BakeRiver(*Bake); });
+		}
+
+		// The bakes own copies of everything they read, so the level can go while they run.
+		CollectGarbage(RF_NoFlags);
+	}
+
+	int32 NumBaked = 0;
+	int32 NumFailed = 0;
+	double BakeSeconds = 0.0;
+	for (FPendingBake& Pending : PendingBakes)
+	{
+		const FRiverBakeResult& Result = Pending.Task.GetResult();
+		BakeSeconds += Result.GetTotalSeconds();
+		if (!Result.bSuccess)
+		{
+			UE_LOG(LogParticleFlowMap, Error, TEXT("%s: %s"), *Pending.Name, *Result.Error);
+			Cache.Remove(Pending.CacheKey);
+			++NumFailed;
+			continue;
+		}
+
+		UE_LOG(LogParticleFlowMap, Display, TEXT("%s: %.2f s (height %.2f s, mask %.2f s, jump flood %.2f s, write %.2f s), %d maps, %d tiles, %lld bytes"),
+			*Pending.Name, Result.GetTotalSeconds(), Result.HeightSeconds, Result.MaskSeconds, Result.JumpFloodSeconds, Result.WriteSeconds,
+			Result.NumMaps, Result.NumStoredTiles, Result.FileBytes);
+		Cache.Add(Pending.CacheKey, Pending.InputHash);
+		++NumBaked;
+	}
+
+	if (!SaveCache(CachePath, Cache))
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("Could not write the bake cache to %s"), *CachePath);
+	}
+
+	UE_LOG(LogParticleFlowMap, Display, TEXT("Flowmap bake: %d rivers in %d levels; %d baked, %d unchanged, %d with nothing to bake, %d failed; %.1f s of bake work in %.1f s"),
+		NumRivers, NumLevels, NumBaked, NumUnchanged, NumEmpty, NumFailed, BakeSeconds, FPlatformTime::Seconds() - StartTime);
+	return NumFailed > 0 ? 1 : 0;
+#else
+	UE_LOG(LogParticleFlowMap, Error, TEXT("FlowMapBake needs the editor"));
+	return 1;
+#endif
+}
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "FlowRiverComponent.h"
+#include "FlowMapBakeCommandlet.generated.h"
+
+/**
+ * Re-bakes every river in the project without opening the levels by hand:
+ *
+ *	UnrealEditor-Cmd ParticleFlowMap.uproject -run=FlowMapBake [-Map=<level name filter>] [-Force]
+ *
+ * Each level under /Game is loaded in turn, and every actor with a UFlowRiverComponent (BP_Stream) has its inputs
+ * gathered on the game thread: the meshes and polygons of its UFlowMaskRasterComponent and UFlowHeightBakeComponent,
+ * the river's placement and the sizes and formats of its maps. The bakes themselves (mask, height and a CPU jump
+ * flood of the mask) run as tasks, in parallel with each other and with loading the next level. Each map is written
+ * as a tiled file that a UFlowMapTileLoaderComponent can restore at runtime.
+ *
+ * A hash of every river's inputs is kept in Saved/FlowMapBake/BakeCache.txt; rivers whose inputs did not change and
+ * whose files are still there are skipped unless -Force is given.
+ */
+UCLASS()
+class PARTICLEFLOWMAP_API UFlowMapBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UFlowMapBakeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	/** Tile file the commandlet writes a river's map to, relative to the Content directory. */
+	static FString GetBakedMapFile(const FString& LevelName, const FString& ActorName, EFlowRiverMap Map);
+};
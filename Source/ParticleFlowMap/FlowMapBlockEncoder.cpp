@@ -0,0 +1,417 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapBlockEncoder.h"
+
+#if WITH_EDITOR
+
+#include "ParticleFlowMap.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+
+namespace FlowMapBlockEncoder
+{
+	static constexpr int32 TexelsPerBlock = 16;
+	static constexpr float SmallSpeed = 1.0e-4f;
+
+	/** Palette slots of an 8 value BC4 block ordered from the high endpoint down to the low endpoint. */
+	static constexpr int32 SortedSlots[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+
+	struct FChannelEndpoints
+	{
+		int32 High = 0;
+		int32 Low = 0;
+	};
+
+	/** Decoded values of the 8 value BC4 mode, already remapped to the [-1,1] flow range. */
+	static void BuildPalette(const FChannelEndpoints& Endpoints, float OutPalette[8])
+	{
+		const float High = Endpoints.High / 255.0f;
+		const float Low = Endpoints.Low / 255.0f;
+		OutPalette[0] = High;
+		OutPalette[1] = Low;
+		for (int32 Slot = 2; Slot < 8; ++Slot)
+		{
+			OutPalette[Slot] = ((8 - Slot) * High + (Slot - 1) * Low) / 7.0f;
+		}
+		for (int32 Slot = 0; Slot < 8; ++Slot)
+		{
+			OutPalette[Slot] = OutPalette[Slot] * 2.0f - 1.0f;
+		}
+	}
+
+	/** Position of the closest palette entry in SortedSlots order. */
+	static int32 FindNearestSorted(const float Palette[8], float Value)
+	{
+		int32 Best = 0;
+		float BestDistance = MAX_flt;
+		for (int32 Position = 0; Position < 8; ++Position)
+		{
+			const float Distance = FMath::Abs(Palette[SortedSlots[Position]] - Value);
+			if (Distance < BestDistance)
+			{
+				BestDistance = Distance;
+				Best = Position;
+			}
+		}
+		return Best;
+	}
+
+	static float TexelError(const FVector2f& Source, const FVector2f& Decoded, float MagnitudeWeight)
+	{
+		const float SourceSpeed = Source.Size();
+		const float DecodedSpeed = Decoded.Size();
+
+		float Angular = 0.0f;
+		if (SourceSpeed > SmallSpeed)
+		{
+			Angular = DecodedSpeed > SmallSpeed ? 1.0f - FVector2f::DotProduct(Source, Decoded) / (SourceSpeed * DecodedSpeed) : 1.0f;
+		}
+
+		return Angular + MagnitudeWeight * FMath::Square(SourceSpeed - DecodedSpeed);
+	}
+
+	struct FBlockEncoder
+	{
+		const FVector2f* Source;
+		const float* Weights;
+		const FFlowMapEncodeSettings& Settings;
+
+		uint8 IndicesR[TexelsPerBlock];
+		uint8 IndicesG[TexelsPerBlock];
+
+		FBlockEncoder(const FVector2f* InSource, const float* InWeights, const FFlowMapEncodeSettings& InSettings)
+			: Source(InSource)
+			, Weights(InWeights)
+			, Settings(InSettings)
+		{
+		}
+
+		/**
+		 * Picks the nearest palette entry per channel, then tries the neighbouring entries of both channels jointly,
+		 * since the best direction is often not made of the two per-channel nearest values.
+		 */
+		float Evaluate(const FChannelEndpoints& R, const FChannelEndpoints& G, uint8* OutR, uint8* OutG) const
+		{
+			float PaletteR[8];
+			float PaletteG[8];
+			BuildPalette(R, PaletteR);
+			BuildPalette(G, PaletteG);
+
+			float Total = 0.0f;
+			for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+			{
+				const FVector2f& Value = Source[Texel];
+				const int32 NearestR = FindNearestSorted(PaletteR, Value.X);
+				const int32 NearestG = FindNearestSorted(PaletteG, Value.Y);
+
+				float BestError = MAX_flt;
+				int32 BestR = NearestR;
+				int32 BestG = NearestG;
+				for (int32 PositionR = FMath::Max(NearestR - 1, 0); PositionR <= FMath::Min(NearestR + 1, 7); ++PositionR)
+				{
+					for (int32 PositionG = FMath::Max(NearestG - 1, 0); PositionG <= FMath::Min(NearestG + 1, 7); ++PositionG)
+					{
+						const FVector2f Decoded(PaletteR[SortedSlots[PositionR]], PaletteG[SortedSlots[PositionG]]);
+						const float Error = TexelError(Value, Decoded, Settings.MagnitudeWeight);
+						if (Error < BestError)
+						{
+							BestError = Error;
+							BestR = PositionR;
+							BestG = PositionG;
+						}
+					}
+				}
+
+				if (OutR)
+				{
+					OutR[Texel] = SortedSlots[BestR];
+					OutG[Texel] = SortedSlots[BestG];
+				}
+				Total += Weights[Texel] * BestError;
+			}
+			return Total;
+		}
+
+		/** Local search over one channel's endpoints while the other channel is held fixed. */
+		float RefineChannel(int32 Component, FChannelEndpoints& R, FChannelEndpoints& G, float CurrentError) const
+		{
+			FChannelEndpoints& Endpoints = Component == 0 ? R : G;
+			const FChannelEndpoints Start = Endpoints;
+			FChannelEndpoints Best = Start;
+			float BestError = CurrentError;
+
+			for (int32 DeltaHigh = -Settings.SearchRadius; DeltaHigh <= Settings.SearchRadius; ++DeltaHigh)
+			{
+				for (int32 DeltaLow = -Settings.SearchRadius; DeltaLow <= Settings.SearchRadius; ++DeltaLow)
+				{
+					FChannelEndpoints Candidate;
+					Candidate.High = FMath::Clamp(Start.High + DeltaHigh, 0, 255);
+					Candidate.Low = FMath::Clamp(Start.Low + DeltaLow, 0, 255);
+					if (Candidate.High <= Candidate.Low)
+					{
+						continue;
+					}
+
+					const float Error = Component == 0 ? Evaluate(Candidate, G, nullptr, nullptr) : Evaluate(R, Candidate, nullptr, nullptr);
+					if (Error < BestError)
+					{
+						BestError = Error;
+						Best = Candidate;
+					}
+				}
+			}
+
+			Endpoints = Best;
+			return BestError;
+		}
+
+		static FChannelEndpoints InitialEndpoints(const FVector2f* Values, int32 Component)
+		{
+			int32 Min = 255;
+			int32 Max = 0;
+			for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+			{
+				const float Unorm = Values[Texel][Component] * 0.5f + 0.5f;
+				const int32 Quantized = FMath::Clamp(FMath::RoundToInt32(Unorm * 255.0f), 0, 255);
+				Min = FMath::Min(Min, Quantized);
+				Max = FMath::Max(Max, Quantized);
+			}
+
+			FChannelEndpoints Endpoints;
+			Endpoints.High = Max;
+			Endpoints.Low = Min;
+			return Endpoints;
+		}
+
+		static void WriteBC4(const FChannelEndpoints& Endpoints, const uint8* Indices, uint8* OutBlock)
+		{
+			OutBlock[0] = uint8(Endpoints.High);
+			OutBlock[1] = uint8(Endpoints.Low);
+
+			// A flat block decodes every index as endpoint 0 in either BC4 mode.
+			const bool bFlat = Endpoints.High == Endpoints.Low;
+			uint64 Bits = 0;
+			for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+			{
+				Bits |= uint64(bFlat ? 0 : Indices[Texel] & 0x7) << (3 * Texel);
+			}
+			for (int32 Byte = 0; Byte < 6; ++Byte)
+			{
+				OutBlock[2 + Byte] = uint8(Bits >> (8 * Byte));
+			}
+		}
+
+		void Encode(uint8* OutBlock)
+		{
+			FChannelEndpoints R = InitialEndpoints(Source, 0);
+			FChannelEndpoints G = InitialEndpoints(Source, 1);
+
+			const bool bFlatR = R.High == R.Low;
+			const bool bFlatG = G.High == G.Low;
+			float Error = Evaluate(R, G, nullptr, nullptr);
+
+			for (int32 Pass = 0; Pass < Settings.RefinementPasses && Error > 0.0f; ++Pass)
+			{
+				const float PassStartError = Error;
+				if (!bFlatR)
+				{
+					Error = RefineChannel(0, R, G, Error);
+				}
+				if (!bFlatG)
+				{
+					Error = RefineChannel(1, R, G, Error);
+				}
+				if (Error >= PassStartError)
+				{
+					break;
+				}
+			}
+
+			Evaluate(R, G, IndicesR, IndicesG);
+			WriteBC4(R, IndicesR, OutBlock);
+			WriteBC4(G, IndicesG, OutBlock + 8);
+		}
+	};
+
+	static void DecodeBC4(const uint8* Block, float OutValues[TexelsPerBlock])
+	{
+		const int32 Red0 = Block[0];
+		const int32 Red1 = Block[1];
+
+		float Palette[8];
+		Palette[0] = Red0 / 255.0f;
+		Palette[1] = Red1 / 255.0f;
+		if (Red0 > Red1)
+		{
+			for (int32 Slot = 2; Slot < 8; ++Slot)
+			{
+				Palette[Slot] = ((8 - Slot) * Palette[0] + (Slot - 1) * Palette[1]) / 7.0f;
+			}
+		}
+		else
+		{
+			for (int32 Slot = 2; Slot < 6; ++Slot)
+			{
+				Palette[Slot] = ((6 - Slot) * Palette[0] + (Slot - 1) * Palette[1]) / 5.0f;
+			}
+			Palette[6] = 0.0f;
+			Palette[7] = 1.0f;
+		}
+
+		uint64 Bits = 0;
+		for (int32 Byte = 0; Byte < 6; ++Byte)
+		{
+			Bits |= uint64(Block[2 + Byte]) << (8 * Byte);
+		}
+		for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+		{
+			OutValues[Texel] = Palette[(Bits >> (3 * Texel)) & 0x7];
+		}
+	}
+
+	static void DecodeBlock(const uint8* Block, FVector2f OutTexels[TexelsPerBlock])
+	{
+		float R[TexelsPerBlock];
+		float G[TexelsPerBlock];
+		DecodeBC4(Block, R);
+		DecodeBC4(Block + 8, G);
+		for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+		{
+			OutTexels[Texel] = FVector2f(R[Texel] * 2.0f - 1.0f, G[Texel] * 2.0f - 1.0f);
+		}
+	}
+
+	struct FRowStats
+	{
+		float MaxAngle = 0.0f;
+		FIntPoint WorstTexel = FIntPoint::NoneValue;
+		double WeightedAngleSum = 0.0;
+		double WeightSum = 0.0;
+	};
+}
+
+float FFlowMapBlockEncoder::AngleErrorDegrees(const FVector2f& Source, const FVector2f& Decoded)
+{
+	const float SourceSpeed = Source.Size();
+	const float DecodedSpeed = Decoded.Size();
+	if (SourceSpeed <= FlowMapBlockEncoder::SmallSpeed || DecodedSpeed <= FlowMapBlockEncoder::SmallSpeed)
+	{
+		return SourceSpeed <= FlowMapBlockEncoder::SmallSpeed ? 0.0f : 180.0f;
+	}
+
+	const float Cosine = FMath::Clamp(FVector2f::DotProduct(Source, Decoded) / (SourceSpeed * DecodedSpeed), -1.0f, 1.0f);
+	return FMath::RadiansToDegrees(FMath::Acos(Cosine));
+}
+
+bool FFlowMapBlockEncoder::EncodeBC5(const FFlowField& Field, const FFlowMapEncodeSettings& Settings, TArray<uint8>& OutBlocks, FFlowMapEncodeStats& OutStats)
+{
+	using namespace FlowMapBlockEncoder;
+
+	if (!Field.IsValid())
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 BlocksX = GetNumBlocksX(Field.Width);
+	const int32 BlocksY = GetNumBlocksY(Field.Height);
+	OutBlocks.SetNumUninitialized(BlocksX * BlocksY * BytesPerBlock);
+
+	TArray<FRowStats> RowStats;
+	RowStats.SetNum(BlocksY);
+
+	ParallelFor(BlocksY, [&](int32 BlockY)
+	{
+		FRowStats& Row = RowStats[BlockY];
+		for (int32 BlockX = 0; BlockX < BlocksX; ++BlockX)
+		{
+			FVector2f Texels[TexelsPerBlock];
+			float Weights[TexelsPerBlock];
+			for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+			{
+				Texels[Texel] = Field.AtClamped(BlockX * 4 + (Texel & 3), BlockY * 4 + (Texel >> 2));
+				Weights[Texel] = Settings.SpeedBias + Texels[Texel].Size();
+			}
+
+			uint8* Block = OutBlocks.GetData() + (BlockY * BlocksX + BlockX) * BytesPerBlock;
+			FBlockEncoder(Texels, Weights, Settings).Encode(Block);
+
+			FVector2f Decoded[TexelsPerBlock];
+			DecodeBlock(Block, Decoded);
+			for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+			{
+				const int32 X = BlockX * 4 + (Texel & 3);
+				const int32 Y = BlockY * 4 + (Texel >> 2);
+				const float Speed = Texels[Texel].Size();
+				if (X >= Field.Width || Y >= Field.Height || Speed < Settings.AngleReportMinSpeed)
+				{
+					continue;
+				}
+
+				const float Angle = AngleErrorDegrees(Texels[Texel], Decoded[Texel]);
+				Row.WeightedAngleSum += Angle * Speed;
+				Row.WeightSum += Speed;
+				if (Angle > Row.MaxAngle)
+				{
+					Row.MaxAngle = Angle;
+					Row.WorstTexel = FIntPoint(X, Y);
+				}
+			}
+		}
+	});
+
+	OutStats = FFlowMapEncodeStats();
+	double WeightedAngleSum = 0.0;
+	double WeightSum = 0.0;
+	for (const FRowStats& Row : RowStats)
+	{
+		WeightedAngleSum += Row.WeightedAngleSum;
+		WeightSum += Row.WeightSum;
+		if (Row.MaxAngle > OutStats.MaxAngleErrorDegrees)
+		{
+			OutStats.MaxAngleErrorDegrees = Row.MaxAngle;
+			OutStats.WorstTexel = Row.WorstTexel;
+		}
+	}
+	OutStats.MeanAngleErrorDegrees = WeightSum > 0.0 ? float(WeightedAngleSum / WeightSum) : 0.0f;
+	OutStats.NumBlocks = BlocksX * BlocksY;
+	OutStats.EncodeSeconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogParticleFlowMap, Log, TEXT("BC5 flowmap %dx%d: %d blocks in %.2fs, max angle error %.2f deg at (%d, %d), mean %.3f deg"),
+		Field.Width, Field.Height, OutStats.NumBlocks, OutStats.EncodeSeconds,
+		OutStats.MaxAngleErrorDegrees, OutStats.WorstTexel.X, OutStats.WorstTexel.Y, OutStats.MeanAngleErrorDegrees);
+	return true;
+}
+
+void FFlowMapBlockEncoder::DecodeBC5(const TArray<uint8>& Blocks, int32 Width, int32 Height, FFlowField& OutField)
+{
+	using namespace FlowMapBlockEncoder;
+
+	const int32 BlocksX = GetNumBlocksX(Width);
+	const int32 BlocksY = GetNumBlocksY(Height);
+	OutField.Init(Width, Height, FVector2f::ZeroVector);
+	if (Blocks.Num() < BlocksX * BlocksY * BytesPerBlock)
+	{
+		return;
+	}
+
+	ParallelFor(BlocksY, [&](int32 BlockY)
+	{
+		for (int32 BlockX = 0; BlockX < BlocksX; ++BlockX)
+		{
+			FVector2f Decoded[TexelsPerBlock];
+			DecodeBlock(Blocks.GetData() + (BlockY * BlocksX + BlockX) * BytesPerBlock, Decoded);
+			for (int32 Texel = 0; Texel < TexelsPerBlock; ++Texel)
+			{
+				const int32 X = BlockX * 4 + (Texel & 3);
+				const int32 Y = BlockY * 4 + (Texel >> 2);
+				if (X < Width && Y < Height)
+				{
+					OutField.At(X, Y) = Decoded[Texel];
+				}
+			}
+		}
+	});
+}
+
+#endif // WITH_EDITOR
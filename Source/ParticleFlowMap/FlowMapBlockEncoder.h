@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowField.h"
+
+#if WITH_EDITOR
+
+struct FFlowMapEncodeSettings
+{
+	/** Endpoint search radius in 8-bit steps around each channel's min/max. Larger is slower but finds better endpoints. */
+	int32 SearchRadius = 2;
+
+	/** Alternating R/G endpoint refinement passes per block. */
+	int32 RefinementPasses = 2;
+
+	/** Importance of a texel is SpeedBias + speed, so still water keeps some weight but fast water dominates. */
+	float SpeedBias = 0.05f;
+
+	/** Weight of the speed error relative to the angular error (1 - cos). */
+	float MagnitudeWeight = 0.25f;
+
+	/** Texels slower than this have no meaningful direction and are left out of the reported angle error. */
+	float AngleReportMinSpeed = 0.02f;
+};
+
+struct FFlowMapEncodeStats
+{
+	float MaxAngleErrorDegrees = 0.0f;
+
+	/** Speed weighted mean over the texels that count towards the angle report. */
+	float MeanAngleErrorDegrees = 0.0f;
+
+	FIntPoint WorstTexel = FIntPoint::NoneValue;
+	int32 NumBlocks = 0;
+	double EncodeSeconds = 0.0;
+};
+
+/**
+ * Block compressor for flowmaps that measures error as the angle between the painted and decoded flow direction,
+ * weighted by speed, instead of per channel RGB error. Generic encoders spend their bits evenly on both channels,
+ * which bends slow diagonal flow by several degrees and shows up as zig-zagging streams.
+ *
+ * Output is BC5 (two BC4 blocks, R then G), 16 bytes per 4x4 block, sampled exactly like RT_Flowmap's RG channels.
+ */
+class PARTICLEFLOWMAP_API FFlowMapBlockEncoder
+{
+public:
+	/** Encodes the whole field in parallel. Sizes that are not a multiple of 4 are padded by edge clamping. */
+	static bool EncodeBC5(const FFlowField& Field, const FFlowMapEncodeSettings& Settings, TArray<uint8>& OutBlocks, FFlowMapEncodeStats& OutStats);
+
+	/** Reference decoder, used for error reporting and for previews. */
+	static void DecodeBC5(const TArray<uint8>& Blocks, int32 Width, int32 Height, FFlowField& OutField);
+
+	static float AngleErrorDegrees(const FVector2f& Source, const FVector2f& Decoded);
+
+	static int32 GetNumBlocksX(int32 Width) { return (Width + 3) / 4; }
+	static int32 GetNumBlocksY(int32 Height) { return (Height + 3) / 4; }
+
+	static constexpr int32 BytesPerBlock = 16;
+};
+
+#endif // WITH_EDITOR
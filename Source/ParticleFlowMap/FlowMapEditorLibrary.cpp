@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapEditorLibrary.h"
+#include "ParticleFlowMap.h"
+#include "FlowField.h"
+#include "FlowMapBlockEncoder.h"
+#include "FlowRiverComponent.h"
+#include "Engine/Texture2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+
+#if WITH_EDITOR
+
+UTexture2D* UFlowMapEditorLibrary::CompressFlowMap(UTextureRenderTarget2D* FlowMap, int32 SearchRadius, float& MaxAngleErrorDegrees, float& MeanAngleErrorDegrees)
+{
+	MaxAngleErrorDegrees = 0.0f;
+	MeanAngleErrorDegrees = 0.0f;
+
+	FFlowField Field;
+	if (!FlowMap::ReadFlowField(FlowMap, Field))
+	{
+		return nullptr;
+	}
+
+	FFlowMapEncodeSettings Settings;
+	Settings.SearchRadius = FMath::Clamp(SearchRadius, 0, 8);
+
+	TArray<uint8> Blocks;
+	FFlowMapEncodeStats Stats;
+	if (!FFlowMapBlockEncoder::EncodeBC5(Field, Settings, Blocks, Stats))
+	{
+		return nullptr;
+	}
+	MaxAngleErrorDegrees = Stats.MaxAngleErrorDegrees;
+	MeanAngleErrorDegrees = Stats.MeanAngleErrorDegrees;
+
+	// BC5 needs whole blocks, so odd sized maps get the clamped padding the encoder already produced.
+	const int32 PaddedWidth = FFlowMapBlockEncoder::GetNumBlocksX(Field.Width) * 4;
+	const int32 PaddedHeight = FFlowMapBlockEncoder::GetNumBlocksY(Field.Height) * 4;
+	UTexture2D* Texture = UTexture2D::CreateTransient(PaddedWidth, PaddedHeight, PF_BC5, FName(*FString::Printf(TEXT("%s_BC5"), *FlowMap->GetName())));
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	Texture->SRGB = false;
+	Texture->Filter = TF_Bilinear;
+	Texture->AddressX = FlowMap->AddressX;
+	Texture->AddressY = FlowMap->AddressY;
+
+	FTexture2DMipMap& Mip = Texture->GetPlatformData()->Mips[0];
+	void* MipData = Mip.BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(MipData, Blocks.GetData(), Blocks.Num());
+	Mip.BulkData.Unlock();
+	Texture->UpdateResource();
+
+	return Texture;
+}
+
+bool UFlowMapEditorLibrary::SolveFlowMap(UFlowRiverComponent* River, const TArray<FFlowWaterSource>& Sources, const FFlowShallowWaterSettings& Settings,
+	bool& bConverged, float& MaxSpeed)
+{
+	bConverged = false;
+	MaxSpeed = 0.0f;
+	if (!River || !River->FlowMap)
+	{
+		return false;
+	}
+
+	FFlowScalarField Mask;
+	if (!FlowMap::ReadScalarField(River->MaskMap, 0, Mask))
+	{
+		return false;
+	}
+
+	// Without a height map the bed is flat and the water is driven by the sources alone.
+	FFlowScalarField HeightField;
+	if (River->HeightMap)
+	{
+		FlowMap::ReadScalarField(River->HeightMap, 0, HeightField);
+	}
+
+	const int32 Width = River->FlowMap->SizeX;
+	const int32 Height = River->FlowMap->SizeY;
+	FFlowScalarField Resampled;
+	Resampled.ResampleFrom(Mask, Width, Height);
+
+	FFlowShallowWaterResult Result;
+	if (!FFlowShallowWaterSolver::Solve(Resampled, HeightField, FVector2f(River->Extent), River->HeightScale, Sources, Settings, Result))
+	{
+		return false;
+	}
+
+	bConverged = Result.bConverged;
+	MaxSpeed = Result.MaxSpeed;
+	if (!FlowMap::WriteFlowField(River->FlowMap, Result.Flow))
+	{
+		return false;
+	}
+
+	River->MarkMapsDirty();
+	return true;
+}
+
+#endif // WITH_EDITOR
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "FlowShallowWaterSolver.h"
+#include "FlowMapEditorLibrary.generated.h"
+
+class UFlowRiverComponent;
+class UTexture2D;
+class UTextureRenderTarget2D;
+
+/**
+ * Editor utilities for the flowmap painting workflow (GM_FlowmapPaintMode).
+ */
+UCLASS()
+class PARTICLEFLOWMAP_API UFlowMapEditorLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+#if WITH_EDITOR
+	/**
+	 * Compresses a painted flowmap to BC5 using a direction-aware error metric and returns it as a transient texture
+	 * that can replace RT_Flowmap in the stream's material and Niagara parameters.
+	 * @param SearchRadius	Endpoint search radius per block, 0 only uses the channel min/max.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap|Editor")
+	static UTexture2D* CompressFlowMap(UTextureRenderTarget2D* FlowMap, int32 SearchRadius, float& MaxAngleErrorDegrees, float& MeanAngleErrorDegrees);
+
+	/**
+	 * Solves the river's steady flow from its height map and mask and writes it into its flow map, as a starting
+	 * point for brush touch-ups. The flow map keeps its size; the other maps are resampled to it.
+	 * @param bConverged	False if the solve hit MaxIterations first; the result is usable but may still be settling.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap|Editor")
+	static bool SolveFlowMap(UFlowRiverComponent* River, const TArray<FFlowWaterSource>& Sources, const FFlowShallowWaterSettings& Settings,
+		bool& bConverged, float& MaxSpeed);
+#endif
+};
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapFunctionLibrary.h"
+#include "FlowMapStats.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Kismet/KismetRenderingLibrary.h"
+#include "Materials/MaterialInterface.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+
+namespace FlowMapFunctionLibrary
+{
+	static void DrawWithGPUMarker(UObject* WorldContextObject, const TCHAR* MarkerName, UTextureRenderTarget2D* Target, UMaterialInterface* Material)
+	{
+		// The canvas draw is flushed in its own render commands; bracket them so the pass shows up as one GPU event.
+		ENQUEUE_RENDER_COMMAND(BeginFlowMapPass)([MarkerName](FRHICommandListImmediate& RHICmdList)
+		{
+			RHICmdList.PushEvent(MarkerName, FColor::Cyan);
+		});
+
+		UKismetRenderingLibrary::DrawMaterialToRenderTarget(WorldContextObject, Target, Material);
+
+		ENQUEUE_RENDER_COMMAND(EndFlowMapPass)([](FRHICommandListImmediate& RHICmdList)
+		{
+			RHICmdList.PopEvent();
+		});
+	}
+}
+
+void UFlowMapFunctionLibrary::DrawFlowMapPass(UObject* WorldContextObject, EFlowMapPass Pass, UTextureRenderTarget2D* Target, UMaterialInterface* Material)
+{
+	if (!Target || !Material)
+	{
+		return;
+	}
+
+	switch (Pass)
+	{
+	case EFlowMapPass::BrushStamp:
+	{
+		FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_BrushStamp, EFlowMapTimer::BrushStamp);
+		FlowMapFunctionLibrary::DrawWithGPUMarker(WorldContextObject, TEXT("FlowMap Brush Stamp"), Target, Material);
+		break;
+	}
+	case EFlowMapPass::JumpFlood:
+	{
+		FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_JumpFlood, EFlowMapTimer::JumpFlood);
+		FlowMapFunctionLibrary::DrawWithGPUMarker(WorldContextObject, TEXT("FlowMap Jump Flood"), Target, Material);
+		break;
+	}
+	}
+}
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "FlowMapFunctionLibrary.generated.h"
+
+class UMaterialInterface;
+class UTextureRenderTarget2D;
+
+/** Render target passes the Blueprints run, for attributing their cost in stats and captures. */
+UENUM(BlueprintType)
+enum class EFlowMapPass : uint8
+{
+	BrushStamp,
+	JumpFlood,
+};
+
+UCLASS()
+class PARTICLEFLOWMAP_API UFlowMapFunctionLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * DrawMaterialToRenderTarget, timed under STATGROUP_ParticleFlowMap and the ParticleFlowMap trace channel, with a
+	 * GPU marker around the draw. Use it for the brush stamps and jump-flood passes in BP_Paint_Pawn and BP_Stream.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap", meta = (WorldContext = "WorldContextObject"))
+	static void DrawFlowMapPass(UObject* WorldContextObject, EFlowMapPass Pass, UTextureRenderTarget2D* Target, UMaterialInterface* Material);
+};
@@ -0,0 +1,238 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapSequence.h"
+#include "ParticleFlowMap.h"
+#include "FlowMapStats.h"
+#include "Algo/BinarySearch.h"
+
+EPixelFormat UFlowMapSequence::GetPixelFormat() const
+{
+	return GetTexelFormat() == EFlowMapTexelFormat::RGBA16F ? PF_FloatRGBA : PF_B8G8R8A8;
+}
+
+bool UFlowMapSequence::IsValidSequence() const
+{
+	const int32 BytesPerTexel = FFlowMapTileFile::GetBytesPerTexel(GetTexelFormat());
+	if (Keys.Num() == 0 || Width <= 0 || Height <= 0 || TileSize <= 0 || BytesPerTexel <= 0
+		|| BaseTexels.Num() != int64(Width) * Height * BytesPerTexel)
+	{
+		return false;
+	}
+
+	// Keys were captured with the TileSize they were added with; a mismatch would index past their tile data.
+	const int32 NumTiles = GetNumTilesX() * GetNumTilesY();
+	for (const FFlowMapSequenceKey& Key : Keys)
+	{
+		if (Key.TileOffsets.Num() != Key.TileIndices.Num())
+		{
+			return false;
+		}
+
+		int64 ExpectedOffset = 0;
+		for (int32 Delta = 0; Delta < Key.TileIndices.Num(); ++Delta)
+		{
+			const int32 TileIndex = Key.TileIndices[Delta];
+			const bool bAscending = Delta == 0 || TileIndex > Key.TileIndices[Delta - 1];
+			if (TileIndex < 0 || TileIndex >= NumTiles || !bAscending || Key.TileOffsets[Delta] != ExpectedOffset)
+			{
+				return false;
+			}
+			ExpectedOffset += int64(GetTileRect(TileIndex).Area()) * BytesPerTexel;
+		}
+
+		if (ExpectedOffset != Key.TileData.Num())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+FIntRect UFlowMapSequence::GetTileRect(int32 TileIndex) const
+{
+	const FIntPoint Min((TileIndex % GetNumTilesX()) * TileSize, (TileIndex / GetNumTilesX()) * TileSize);
+	return FIntRect(Min, FIntPoint(FMath::Min(Min.X + TileSize, Width), FMath::Min(Min.Y + TileSize, Height)));
+}
+
+int32 UFlowMapSequence::GetNextKey(int32 Key) const
+{
+	if (Key + 1 < Keys.Num())
+	{
+		return Key + 1;
+	}
+	return bLooping ? 0 : Key;
+}
+
+void UFlowMapSequence::Evaluate(float Time, int32& OutKey, float& OutAlpha) const
+{
+	OutKey = 0;
+	OutAlpha = 0.0f;
+	if (Keys.Num() == 0)
+	{
+		return;
+	}
+
+	Time = bLooping ? FMath::Fmod(FMath::Max(Time, 0.0f), Duration) : FMath::Clamp(Time, 0.0f, Duration);
+	OutKey = FMath::Max(Algo::UpperBoundBy(Keys, Time, &FFlowMapSequenceKey::Time) - 1, 0);
+
+	const int32 NextKey = GetNextKey(OutKey);
+	if (NextKey == OutKey)
+	{
+		return;
+	}
+
+	const float SegmentStart = Keys[OutKey].Time;
+	const float SegmentEnd = NextKey > OutKey ? Keys[NextKey].Time : Duration + Keys[NextKey].Time;
+	OutAlpha = FMath::Clamp((Time - SegmentStart) / FMath::Max(SegmentEnd - SegmentStart, UE_SMALL_NUMBER), 0.0f, 1.0f);
+}
+
+void UFlowMapSequence::DecodeKey(int32 Key, int32 FromKey, FFlowMapSequenceTiles& OutTiles) const
+{
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_SequenceDecode, EFlowMapTimer::SequenceDecode);
+
+	OutTiles.Key = Key;
+	OutTiles.FromKey = FromKey;
+	OutTiles.Tiles.Reset();
+	OutTiles.Data.Reset();
+	if (!IsValidSequence() || !Keys.IsValidIndex(Key))
+	{
+		return;
+	}
+
+	// Tiles to rewrite: every tile for an unknown starting point, else those either key moved away from the base.
+	const FFlowMapSequenceKey& Target = Keys[Key];
+	TArray<int32> TileIndices;
+	if (Keys.IsValidIndex(FromKey))
+	{
+		TileIndices = Target.TileIndices;
+		for (int32 TileIndex : Keys[FromKey].TileIndices)
+		{
+			if (Algo::BinarySearch(Target.TileIndices, TileIndex) == INDEX_NONE)
+			{
+				TileIndices.Add(TileIndex);
+			}
+		}
+	}
+	else
+	{
+		TileIndices.SetNumUninitialized(GetNumTilesX() * GetNumTilesY());
+		for (int32 TileIndex = 0; TileIndex < TileIndices.Num(); ++TileIndex)
+		{
+			TileIndices[TileIndex] = TileIndex;
+		}
+	}
+
+	const int32 BytesPerTexel = FFlowMapTileFile::GetBytesPerTexel(GetTexelFormat());
+	OutTiles.Tiles.Reserve(TileIndices.Num());
+	for (int32 TileIndex : TileIndices)
+	{
+		const FIntRect Rect = GetTileRect(TileIndex);
+		const int32 RowBytes = Rect.Width() * BytesPerTexel;
+
+		FFlowMapSequenceTiles::FTile& Tile = OutTiles.Tiles.AddDefaulted_GetRef();
+		Tile.Rect = Rect;
+		Tile.DataOffset = OutTiles.Data.Num();
+		OutTiles.Data.AddUninitialized(RowBytes * Rect.Height());
+		uint8* Dest = OutTiles.Data.GetData() + Tile.DataOffset;
+
+		for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+		{
+			FMemory::Memcpy(Dest + (Y - Rect.Min.Y) * RowBytes, BaseTexels.GetData() + (int64(Y) * Width + Rect.Min.X) * BytesPerTexel, RowBytes);
+		}
+
+		const int32 DeltaIndex = Algo::BinarySearch(Target.TileIndices, TileIndex);
+		if (DeltaIndex != INDEX_NONE)
+		{
+			const uint8* Delta = Target.TileData.GetData() + Target.TileOffsets[DeltaIndex];
+			for (int32 Byte = 0; Byte < RowBytes * Rect.Height(); ++Byte)
+			{
+				Dest[Byte] ^= Delta[Byte];
+			}
+		}
+	}
+}
+
+#if WITH_EDITOR
+void UFlowMapSequence::ClearKeys()
+{
+	Modify();
+	Keys.Reset();
+	BaseTexels.Reset();
+	Width = 0;
+	Height = 0;
+}
+
+bool UFlowMapSequence::CanEditChange(const FProperty* InProperty) const
+{
+	if (InProperty && InProperty->GetFName() == GET_MEMBER_NAME_CHECKED(UFlowMapSequence, TileSize) && Keys.Num() > 0)
+	{
+		return false;
+	}
+	return Super::CanEditChange(InProperty);
+}
+
+bool UFlowMapSequence::AddKeyFromRenderTarget(UTextureRenderTarget2D* RenderTarget, float Time)
+{
+	FFlowMapTexels Texels;
+	if (!FFlowMapTileFile::ReadRenderTarget(RenderTarget, Texels))
+	{
+		return false;
+	}
+
+	Modify();
+	if (Keys.Num() == 0)
+	{
+		Width = Texels.Width;
+		Height = Texels.Height;
+		TexelFormat = uint32(Texels.Format);
+		BaseTexels = MoveTemp(Texels.Data);
+
+		FFlowMapSequenceKey& Key = Keys.AddDefaulted_GetRef();
+		Key.Time = Time;
+		return true;
+	}
+
+	if (Texels.Width != Width || Texels.Height != Height || Texels.Format != GetTexelFormat())
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s does not match the size or format of %s's base map"), *GetNameSafe(RenderTarget), *GetName());
+		return false;
+	}
+
+	FFlowMapSequenceKey Key;
+	Key.Time = Time;
+
+	const int32 BytesPerTexel = FFlowMapTileFile::GetBytesPerTexel(GetTexelFormat());
+	TArray<uint8> Delta;
+	for (int32 TileIndex = 0; TileIndex < GetNumTilesX() * GetNumTilesY(); ++TileIndex)
+	{
+		const FIntRect Rect = GetTileRect(TileIndex);
+		const int32 RowBytes = Rect.Width() * BytesPerTexel;
+
+		Delta.Reset();
+		bool bChanged = false;
+		for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+		{
+			const int64 RowOffset = (int64(Y) * Width + Rect.Min.X) * BytesPerTexel;
+			for (int32 Byte = 0; Byte < RowBytes; ++Byte)
+			{
+				const uint8 Difference = Texels.Data[RowOffset + Byte] ^ BaseTexels[RowOffset + Byte];
+				bChanged |= Difference != 0;
+				Delta.Add(Difference);
+			}
+		}
+
+		if (bChanged)
+		{
+			Key.TileIndices.Add(TileIndex);
+			Key.TileOffsets.Add(Key.TileData.Num());
+			Key.TileData.Append(Delta);
+		}
+	}
+
+	const int32 Insert = Algo::UpperBoundBy(Keys, Time, &FFlowMapSequenceKey::Time);
+	UE_LOG(LogParticleFlowMap, Log, TEXT("Added key %d at %.2fs to %s: %d of %d tiles changed"), Insert, Time, *GetName(),
+		Key.TileIndices.Num(), GetNumTilesX() * GetNumTilesY());
+	Keys.Insert(MoveTemp(Key), Insert);
+	return true;
+}
+#endif
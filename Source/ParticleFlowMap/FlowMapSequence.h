@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "FlowMapTileFile.h"
+#include "FlowMapSequence.generated.h"
+
+class UTextureRenderTarget2D;
+
+/** One keyframe: the tiles that differ from the sequence's base map, XOR-ed against it. */
+USTRUCT()
+struct PARTICLEFLOWMAP_API FFlowMapSequenceKey
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category = "Flowmap")
+	float Time = 0.0f;
+
+	/** Row-major tile indices (TileY * TilesX + TileX), ascending. */
+	UPROPERTY()
+	TArray<int32> TileIndices;
+
+	/** Byte offset of each tile's delta in TileData. */
+	UPROPERTY()
+	TArray<int32> TileOffsets;
+
+	/** Tile deltas, rows packed, in the sequence's texel format. XOR deltas are mostly zero and compress well on disk. */
+	UPROPERTY()
+	TArray<uint8> TileData;
+};
+
+/** Decoded texels ready for upload: a list of tile rectangles and their packed rows. */
+struct FFlowMapSequenceTiles
+{
+	struct FTile
+	{
+		FIntRect Rect;
+		int32 DataOffset = 0;
+	};
+
+	/** Key these tiles turn the target texture into, and the key it must already hold (INDEX_NONE: any). */
+	int32 Key = INDEX_NONE;
+	int32 FromKey = INDEX_NONE;
+
+	TArray<FTile> Tiles;
+	TArray<uint8> Data;
+};
+
+/**
+ * Animated flowmap for tides, floods and scripted changes: a base map plus keyframes stored as tile deltas from it.
+ * A key only costs the tiles it changes; at runtime UFlowMapSequencePlayerComponent decodes keys on a worker thread
+ * into two textures and the GPU blends between them.
+ */
+UCLASS(BlueprintType)
+class PARTICLEFLOWMAP_API UFlowMapSequence : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(VisibleAnywhere, Category = "Flowmap")
+	int32 Width = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "Flowmap")
+	int32 Height = 0;
+
+	/** Defines the layout of the captured keys, so it can only be edited while the sequence has none. */
+	UPROPERTY(EditAnywhere, Category = "Flowmap", meta = (ClampMin = "8", ClampMax = "512"))
+	int32 TileSize = 64;
+
+	/** Length of one loop; the last key blends back into the first over the remaining time. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flowmap", meta = (ClampMin = "0.01"))
+	float Duration = 10.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flowmap")
+	bool bLooping = true;
+
+	UPROPERTY(VisibleAnywhere, Category = "Flowmap")
+	TArray<FFlowMapSequenceKey> Keys;
+
+	EFlowMapTexelFormat GetTexelFormat() const { return EFlowMapTexelFormat(TexelFormat); }
+	EPixelFormat GetPixelFormat() const;
+	/** Checks the base map and that every key's tiles are laid out for the current size and TileSize. */
+	bool IsValidSequence() const;
+
+	int32 GetNumTilesX() const { return FMath::DivideAndRoundUp(Width, TileSize); }
+	int32 GetNumTilesY() const { return FMath::DivideAndRoundUp(Height, TileSize); }
+	FIntRect GetTileRect(int32 TileIndex) const;
+
+	/** Key that follows Key in playback order, wrapping when looping; the last key follows itself otherwise. */
+	int32 GetNextKey(int32 Key) const;
+
+	/** Key to blend from at Time, and the blend towards GetNextKey of it. */
+	void Evaluate(float Time, int32& OutKey, float& OutAlpha) const;
+
+	/**
+	 * Produces the tiles that turn a texture holding FromKey into Key: those either key changes relative to the base.
+	 * FromKey INDEX_NONE decodes the whole map. Only reads the asset, so it is safe on worker threads.
+	 */
+	void DecodeKey(int32 Key, int32 FromKey, FFlowMapSequenceTiles& OutTiles) const;
+
+#if WITH_EDITOR
+	/**
+	 * Captures a render target (e.g. RT_Flowmap after painting a tide state) as a key at Time. The first key also
+	 * becomes the base map; later keys must match its size and format.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap|Editor")
+	bool AddKeyFromRenderTarget(UTextureRenderTarget2D* RenderTarget, float Time);
+
+	UFUNCTION(BlueprintCallable, Category = "Flowmap|Editor")
+	void ClearKeys();
+
+	virtual bool CanEditChange(const FProperty* InProperty) const override;
+#endif
+
+private:
+	/** EFlowMapTexelFormat of BaseTexels and every key. */
+	UPROPERTY()
+	uint32 TexelFormat = 0;
+
+	UPROPERTY()
+	TArray<uint8> BaseTexels;
+};
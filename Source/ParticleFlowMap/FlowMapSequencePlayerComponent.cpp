@@ -0,0 +1,274 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapSequencePlayerComponent.h"
+#include "ParticleFlowMap.h"
+#include "FlowMapSequence.h"
+#include "FlowField.h"
+#include "FlowMapStats.h"
+#include "Async/Async.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "GameFramework/Actor.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "NiagaraComponent.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+
+namespace FlowMapSequencePlayer
+{
+	static const FName KeyAParameter(TEXT("FlowMapKeyA"));
+	static const FName KeyBParameter(TEXT("FlowMapKeyB"));
+	static const FName BlendParameter(TEXT("FlowMapKeyBlend"));
+}
+
+UFlowMapSequencePlayerComponent::UFlowMapSequencePlayerComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+}
+
+void UFlowMapSequencePlayerComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!DisplaySystem && GetOwner())
+	{
+		DisplaySystem = GetOwner()->FindComponentByClass<UNiagaraComponent>();
+	}
+
+	if (bAutoPlay)
+	{
+		Play();
+	}
+}
+
+void UFlowMapSequencePlayerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ResetSlots();
+	Super::EndPlay(EndPlayReason);
+}
+
+UTextureRenderTarget2D* UFlowMapSequencePlayerComponent::GetKeyTextureA() const
+{
+	return KeyTextures[FrontSlot];
+}
+
+UTextureRenderTarget2D* UFlowMapSequencePlayerComponent::GetKeyTextureB() const
+{
+	return KeyTextures[1 - FrontSlot];
+}
+
+void UFlowMapSequencePlayerComponent::Play()
+{
+	if (!Sequence || !Sequence->IsValidSequence())
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has no flowmap sequence with keys to play"), *GetNameSafe(GetOwner()));
+		return;
+	}
+
+	if (Sequence != PlayingSequence)
+	{
+		ResetSlots();
+		PlayingSequence = Sequence;
+		if (!CreateKeyTextures())
+		{
+			PlayingSequence = nullptr;
+			return;
+		}
+	}
+
+	bPlaying = true;
+	SetComponentTickEnabled(true);
+}
+
+void UFlowMapSequencePlayerComponent::Stop()
+{
+	bPlaying = false;
+	SetComponentTickEnabled(false);
+}
+
+void UFlowMapSequencePlayerComponent::SetPlaybackTime(float Time)
+{
+	PlaybackTime = Time;
+}
+
+void UFlowMapSequencePlayerComponent::ResetSlots()
+{
+	if (PendingDecode.IsValid())
+	{
+		PendingDecode.Wait();
+		PendingDecode.Reset();
+	}
+	ReadyTiles.Reset();
+	SlotKeys[0] = SlotKeys[1] = INDEX_NONE;
+	FrontSlot = 0;
+}
+
+bool UFlowMapSequencePlayerComponent::CreateKeyTextures()
+{
+	for (TObjectPtr<UTextureRenderTarget2D>& Texture : KeyTextures)
+	{
+		if (!Texture)
+		{
+			Texture = NewObject<UTextureRenderTarget2D>(this);
+		}
+		Texture->ClearColor = FlowMap::EncodeFlow(FVector2f::ZeroVector);
+		Texture->InitCustomFormat(PlayingSequence->Width, PlayingSequence->Height, PlayingSequence->GetPixelFormat(), true);
+		Texture->UpdateResourceImmediate(true);
+	}
+	return KeyTextures[0]->GameThread_GetRenderTargetResource() && KeyTextures[1]->GameThread_GetRenderTargetResource();
+}
+
+void UFlowMapSequencePlayerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!bPlaying || !PlayingSequence)
+	{
+		return;
+	}
+
+	PlaybackTime += DeltaTime * PlayRate;
+	if (PlayingSequence->bLooping)
+	{
+		// Keep the clock small so float precision does not drift over long sessions.
+		PlaybackTime = FMath::Fmod(PlaybackTime, PlayingSequence->Duration);
+		PlaybackTime += PlaybackTime < 0.0f ? PlayingSequence->Duration : 0.0f;
+	}
+
+	int32 Key;
+	float Alpha;
+	PlayingSequence->Evaluate(PlaybackTime, Key, Alpha);
+	const int32 NextKey = PlayingSequence->GetNextKey(Key);
+	UpdateSlots(Key, NextKey);
+
+	if (SlotKeys[FrontSlot] == Key)
+	{
+		// Until the next key is resident, hold the current one rather than blending towards stale texels.
+		BlendAlpha = SlotKeys[1 - FrontSlot] == NextKey ? Alpha : 0.0f;
+		PushParameters();
+	}
+}
+
+void UFlowMapSequencePlayerComponent::UpdateSlots(int32 Key, int32 NextKey)
+{
+	// Crossing into the next segment: the texture we were blending to becomes the one we blend from.
+	if (SlotKeys[FrontSlot] != Key && SlotKeys[1 - FrontSlot] == Key)
+	{
+		FrontSlot = 1 - FrontSlot;
+	}
+
+	if (PendingDecode.IsValid() && PendingDecode.IsReady())
+	{
+		ReadyTiles = PendingDecode.Get();
+		ReadySlot = PendingSlot;
+		PendingDecode.Reset();
+	}
+
+	const int32 AheadKey = PlayingSequence->GetNextKey(NextKey);
+	if (ReadyTiles)
+	{
+		const int32 SlotKey = SlotKeys[ReadySlot];
+		const bool bStillApplies = SlotKey == ReadyTiles->FromKey
+			&& (ReadyTiles->Key == Key || ReadyTiles->Key == NextKey || ReadyTiles->Key == AheadKey);
+		const int32 DesiredKey = ReadySlot == FrontSlot ? Key : NextKey;
+
+		if (!bStillApplies)
+		{
+			ReadyTiles.Reset();
+		}
+		else if (ReadyTiles->Key == DesiredKey || (SlotKey != Key && SlotKey != NextKey))
+		{
+			Upload(ReadySlot, ReadyTiles);
+			SlotKeys[ReadySlot] = ReadyTiles->Key;
+			ReadyTiles.Reset();
+		}
+	}
+
+	if (PendingDecode.IsValid() || ReadyTiles)
+	{
+		return;
+	}
+
+	if (SlotKeys[FrontSlot] != Key)
+	{
+		StartDecode(FrontSlot, Key);
+	}
+	else if (SlotKeys[1 - FrontSlot] != NextKey)
+	{
+		StartDecode(1 - FrontSlot, NextKey);
+	}
+	else if (AheadKey != Key && AheadKey != NextKey)
+	{
+		// Both textures are current: decode the key after next now, to drop into the front texture at the crossing.
+		StartDecode(FrontSlot, AheadKey);
+	}
+}
+
+void UFlowMapSequencePlayerComponent::StartDecode(int32 Slot, int32 Key)
+{
+	PendingSlot = Slot;
+	PendingDecode = Async(EAsyncExecution::ThreadPool, [Sequence = PlayingSequence.Get(), Key, FromKey = SlotKeys[Slot]]()
+	{
+		FDecodedTiles Tiles = MakeShared<FFlowMapSequenceTiles, ESPMode::ThreadSafe>();
+		Sequence->DecodeKey(Key, FromKey, *Tiles);
+		return Tiles;
+	});
+}
+
+void UFlowMapSequencePlayerComponent::Upload(int32 Slot, const FDecodedTiles& Tiles)
+{
+	FTextureRenderTargetResource* Resource = KeyTextures[Slot] ? KeyTextures[Slot]->GameThread_GetRenderTargetResource() : nullptr;
+	if (!Resource)
+	{
+		return;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_TileUpload, EFlowMapTimer::TileUpload);
+	FLOWMAP_INC_COUNTER(STAT_FlowMap_UploadedTiles, EFlowMapCounter::UploadedTiles, Tiles->Tiles.Num());
+
+	const int32 BytesPerTexel = FFlowMapTileFile::GetBytesPerTexel(PlayingSequence->GetTexelFormat());
+	ENQUEUE_RENDER_COMMAND(UploadFlowMapSequenceTiles)(
+		[Tiles, Resource, BytesPerTexel](FRHICommandListImmediate& RHICmdList)
+		{
+			FRHITexture* Texture = Resource->GetRenderTargetTexture();
+			if (!Texture)
+			{
+				return;
+			}
+
+			SCOPED_DRAW_EVENT(RHICmdList, FlowMapSequenceUpload);
+			SCOPED_GPU_STAT(RHICmdList, FlowMapSequenceUpload);
+
+			for (const FFlowMapSequenceTiles::FTile& Tile : Tiles->Tiles)
+			{
+				const FUpdateTextureRegion2D Region(Tile.Rect.Min.X, Tile.Rect.Min.Y, 0, 0, Tile.Rect.Width(), Tile.Rect.Height());
+				RHICmdList.UpdateTexture2D(Texture, 0, Region, Tile.Rect.Width() * BytesPerTexel, Tiles->Data.GetData() + Tile.DataOffset);
+			}
+		});
+}
+
+void UFlowMapSequencePlayerComponent::PushParameters()
+{
+	using namespace FlowMapSequencePlayer;
+
+	UTextureRenderTarget2D* KeyA = GetKeyTextureA();
+	UTextureRenderTarget2D* KeyB = GetKeyTextureB();
+
+	if (DisplaySystem)
+	{
+		DisplaySystem->SetVariableTextureRenderTarget(KeyAParameter, KeyA);
+		DisplaySystem->SetVariableTextureRenderTarget(KeyBParameter, KeyB);
+		DisplaySystem->SetVariableFloat(BlendParameter, BlendAlpha);
+	}
+
+	for (UMaterialInstanceDynamic* Material : TargetMaterials)
+	{
+		if (Material)
+		{
+			Material->SetTextureParameterValue(KeyAParameter, KeyA);
+			Material->SetTextureParameterValue(KeyBParameter, KeyB);
+			Material->SetScalarParameterValue(BlendParameter, BlendAlpha);
+		}
+	}
+}
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Async/Future.h"
+#include "FlowMapSequencePlayerComponent.generated.h"
+
+class UFlowMapSequence;
+class UMaterialInstanceDynamic;
+class UNiagaraComponent;
+class UTextureRenderTarget2D;
+struct FFlowMapSequenceTiles;
+
+/**
+ * Plays a UFlowMapSequence through two textures: one holds the key being blended from, the other the key being
+ * blended to, and materials and Niagara lerp between them by the blend parameter. Keys are decoded on a worker thread
+ * one ahead of time, and a texture is only rewritten in the tiles where its old and new keys differ.
+ *
+ * Parameters set on the display system and on TargetMaterials:
+ *	FlowMapKeyA, FlowMapKeyB	(texture)
+ *	FlowMapKeyBlend				(float) 0 shows A, 1 shows B
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowMapSequencePlayerComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowMapSequencePlayerComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UFlowMapSequence> Sequence;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	float PlayRate = 1.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bAutoPlay = true;
+
+	/** Defaults to the first Niagara component on the owner. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UNiagaraComponent> DisplaySystem;
+
+	/** Material instances (e.g. of M_WaterSurface) that sample the sequence. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TArray<TObjectPtr<UMaterialInstanceDynamic>> TargetMaterials;
+
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	void Play();
+
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	void Stop();
+
+	/** Jumps to Time; the keys around it are decoded and uploaded over the next frames. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	void SetPlaybackTime(float Time);
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	float GetPlaybackTime() const { return PlaybackTime; }
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	UTextureRenderTarget2D* GetKeyTextureA() const;
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	UTextureRenderTarget2D* GetKeyTextureB() const;
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	float GetBlendAlpha() const { return BlendAlpha; }
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	using FDecodedTiles = TSharedPtr<FFlowMapSequenceTiles, ESPMode::ThreadSafe>;
+
+	void ResetSlots();
+	bool CreateKeyTextures();
+	void UpdateSlots(int32 Key, int32 NextKey);
+	void StartDecode(int32 Slot, int32 Key);
+	void Upload(int32 Slot, const FDecodedTiles& Tiles);
+	void PushParameters();
+
+	/** Sequence the textures and any running decode belong to; kept referenced so a decode never outlives it. */
+	UPROPERTY(Transient)
+	TObjectPtr<UFlowMapSequence> PlayingSequence;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UTextureRenderTarget2D> KeyTextures[2];
+
+	/** Key each texture holds, INDEX_NONE until its first upload. */
+	int32 SlotKeys[2] = { INDEX_NONE, INDEX_NONE };
+	/** Texture holding the key being blended from; the other holds the one being blended to. */
+	int32 FrontSlot = 0;
+
+	/** At most one decode runs at a time; its result waits in ReadyTiles until the target texture is free. */
+	TFuture<FDecodedTiles> PendingDecode;
+	int32 PendingSlot = INDEX_NONE;
+	FDecodedTiles ReadyTiles;
+	int32 ReadySlot = INDEX_NONE;
+
+	float PlaybackTime = 0.0f;
+	float BlendAlpha = 0.0f;
+	bool bPlaying = false;
+};
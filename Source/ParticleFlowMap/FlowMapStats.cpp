@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapStats.h"
+#include "ParticleFlowMap.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+DEFINE_STAT(STAT_FlowMap_Spawn);
+DEFINE_STAT(STAT_FlowMap_Advection);
+DEFINE_STAT(STAT_FlowMap_JumpFlood);
+DEFINE_STAT(STAT_FlowMap_BrushStamp);
+DEFINE_STAT(STAT_FlowMap_MapCopy);
+DEFINE_STAT(STAT_FlowMap_TileUpload);
+DEFINE_STAT(STAT_FlowMap_Display);
+DEFINE_STAT(STAT_FlowMap_Sort);
+DEFINE_STAT(STAT_FlowMap_SequenceDecode);
+DEFINE_STAT(STAT_FlowMap_Trails);
+DEFINE_STAT(STAT_FlowMap_HeightBake);
+DEFINE_STAT(STAT_FlowMap_MaskRaster);
+DEFINE_STAT(STAT_FlowMap_WaterMesh);
+
+DEFINE_STAT(STAT_FlowMap_AliveParticles);
+DEFINE_STAT(STAT_FlowMap_SpawnedParticles);
+DEFINE_STAT(STAT_FlowMap_RecycledParticles);
+DEFINE_STAT(STAT_FlowMap_SkippedTiles);
+DEFINE_STAT(STAT_FlowMap_UploadedTiles);
+
+DEFINE_STAT(STAT_FlowMap_PoolMemory);
+DEFINE_STAT(STAT_FlowMap_MapMemory);
+
+DEFINE_GPU_STAT(FlowMapTileUpload);
+DEFINE_GPU_STAT(FlowMapRiverCopy);
+DEFINE_GPU_STAT(FlowMapSequenceUpload);
+
+UE_TRACE_CHANNEL_DEFINE(ParticleFlowMapChannel);
+
+namespace FlowMapStats
+{
+	static const TCHAR* TimerNames[] =
+	{
+		TEXT("SpawnMs"),
+		TEXT("AdvectionMs"),
+		TEXT("JumpFloodMs"),
+		TEXT("BrushStampMs"),
+		TEXT("MapCopyMs"),
+		TEXT("TileUploadMs"),
+		TEXT("DisplayMs"),
+		TEXT("SortMs"),
+		TEXT("SequenceDecodeMs"),
+		TEXT("TrailsMs"),
+		TEXT("HeightBakeMs"),
+		TEXT("MaskRasterMs"),
+		TEXT("WaterMeshMs"),
+	};
+	static_assert(UE_ARRAY_COUNT(TimerNames) == int32(EFlowMapTimer::Num), "One CSV column per timer");
+
+	static const TCHAR* CounterNames[] =
+	{
+		TEXT("AliveParticles"),
+		TEXT("SpawnedParticles"),
+		TEXT("RecycledParticles"),
+		TEXT("SkippedTiles"),
+		TEXT("UploadedTiles"),
+		TEXT("PoolBytes"),
+		TEXT("MapBytes"),
+	};
+	static_assert(UE_ARRAY_COUNT(CounterNames) == int32(EFlowMapCounter::Num), "One CSV column per counter");
+
+	static FAutoConsoleCommand CsvCaptureCommand(
+		TEXT("FlowMap.CsvCapture"),
+		TEXT("Writes the flow simulation's per-frame timers and counters to Saved/Profiling/FlowMap.\n")
+		TEXT("FlowMap.CsvCapture [frames] starts a capture (0 or no argument runs until stopped), FlowMap.CsvCapture stop ends it."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0].Equals(TEXT("stop"), ESearchCase::IgnoreCase))
+			{
+				FFlowMapFrameStats::Get().StopCapture();
+			}
+			else
+			{
+				FFlowMapFrameStats::Get().StartCapture(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0);
+			}
+		}));
+}
+
+FFlowMapFrameStats& FFlowMapFrameStats::Get()
+{
+	static FFlowMapFrameStats Instance;
+	return Instance;
+}
+
+FFlowMapFrameStats::FFlowMapFrameStats()
+{
+	FCoreDelegates::OnEndFrame.AddRaw(this, &FFlowMapFrameStats::EndFrame);
+}
+
+void FFlowMapFrameStats::StartCapture(int32 NumFrames)
+{
+	StopCapture();
+
+	const FString Directory = FPaths::Combine(FPaths::ProfilingDir(), TEXT("FlowMap"));
+	CapturePath = FPaths::Combine(Directory, FString::Printf(TEXT("FlowMap_%s.csv"), *FDateTime::Now().ToString()));
+	IFileManager::Get().MakeDirectory(*Directory, true);
+	CaptureFile.Reset(IFileManager::Get().CreateFileWriter(*CapturePath));
+	if (!CaptureFile)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("Could not create %s"), *CapturePath);
+		return;
+	}
+
+	FString HeaderLine = TEXT("Frame,FrameMs");
+	for (const TCHAR* Name : FlowMapStats::TimerNames)
+	{
+		HeaderLine += FString::Printf(TEXT(",%s"), Name);
+	}
+	for (const TCHAR* Name : FlowMapStats::CounterNames)
+	{
+		HeaderLine += FString::Printf(TEXT(",%s"), Name);
+	}
+	HeaderLine += LINE_TERMINATOR;
+
+	const FTCHARToUTF8 Utf8(*HeaderLine);
+	CaptureFile->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Utf8.Length());
+	FramesRemaining = NumFrames > 0 ? NumFrames : MAX_int32;
+
+	UE_LOG(LogParticleFlowMap, Display, TEXT("FlowMap CSV capture started: %s"), *CapturePath);
+}
+
+void FFlowMapFrameStats::StopCapture()
+{
+	if (CaptureFile)
+	{
+		CaptureFile->Close();
+		CaptureFile.Reset();
+		UE_LOG(LogParticleFlowMap, Display, TEXT("FlowMap CSV capture written to %s"), *CapturePath);
+	}
+	FramesRemaining = 0;
+}
+
+void FFlowMapFrameStats::EndFrame()
+{
+	++FrameNumber;
+
+	if (CaptureFile)
+	{
+		FString Line = FString::Printf(TEXT("%llu,%.3f"), FrameNumber, FApp::GetDeltaTime() * 1000.0);
+		for (const std::atomic<uint64>& Timer : Timers)
+		{
+			Line += FString::Printf(TEXT(",%.3f"), FPlatformTime::ToMilliseconds64(Timer.load(std::memory_order_relaxed)));
+		}
+		for (const std::atomic<int64>& Counter : Counters)
+		{
+			Line += FString::Printf(TEXT(",%lld"), Counter.load(std::memory_order_relaxed));
+		}
+		Line += LINE_TERMINATOR;
+
+		const FTCHARToUTF8 Utf8(*Line);
+		CaptureFile->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Utf8.Length());
+
+		if (--FramesRemaining <= 0)
+		{
+			StopCapture();
+		}
+	}
+
+	for (std::atomic<uint64>& Timer : Timers)
+	{
+		Timer.store(0, std::memory_order_relaxed);
+	}
+	for (int32 Counter = 0; Counter < int32(EFlowMapCounter::Num); ++Counter)
+	{
+		if (!IsPersistent(EFlowMapCounter(Counter)))
+		{
+			Counters[Counter].store(0, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/RealtimeGPUProfiler.h"
+#include "Trace/Trace.h"
+#include <atomic>
+
+DECLARE_STATS_GROUP(TEXT("ParticleFlowMap"), STATGROUP_ParticleFlowMap, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn"), STAT_FlowMap_Spawn, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Advection"), STAT_FlowMap_Advection, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Jump Flood Bake"), STAT_FlowMap_JumpFlood, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Brush Stamp"), STAT_FlowMap_BrushStamp, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("River Map Copy"), STAT_FlowMap_MapCopy, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tile Upload"), STAT_FlowMap_TileUpload, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Display Update"), STAT_FlowMap_Display, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Depth Bucket Sort"), STAT_FlowMap_Sort, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Sequence Key Decode"), STAT_FlowMap_SequenceDecode, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trail Record"), STAT_FlowMap_Trails, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Height Bake"), STAT_FlowMap_HeightBake, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mask Raster"), STAT_FlowMap_MaskRaster, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Water Mesh Build"), STAT_FlowMap_WaterMesh, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Alive Particles"), STAT_FlowMap_AliveParticles, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Spawned Particles"), STAT_FlowMap_SpawnedParticles, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Recycled Particles"), STAT_FlowMap_RecycledParticles, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped Tiles"), STAT_FlowMap_SkippedTiles, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Uploaded Tiles"), STAT_FlowMap_UploadedTiles, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Particle Pools"), STAT_FlowMap_PoolMemory, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("CPU Maps"), STAT_FlowMap_MapMemory, STATGROUP_ParticleFlowMap, PARTICLEFLOWMAP_API);
+
+DECLARE_GPU_STAT_NAMED_EXTERN(FlowMapTileUpload, TEXT("FlowMap Tile Upload"));
+DECLARE_GPU_STAT_NAMED_EXTERN(FlowMapRiverCopy, TEXT("FlowMap River Copy"));
+DECLARE_GPU_STAT_NAMED_EXTERN(FlowMapSequenceUpload, TEXT("FlowMap Sequence Upload"));
+
+/** Insights channel for the flow simulation; enable with -trace=cpu,ParticleFlowMap or Trace.Enable ParticleFlowMap. */
+UE_TRACE_CHANNEL_EXTERN(ParticleFlowMapChannel, PARTICLEFLOWMAP_API);
+
+/** Per-frame CPU time buckets written by FlowMap.CsvCapture. */
+enum class EFlowMapTimer : uint8
+{
+	Spawn,
+	Advection,
+	JumpFlood,
+	BrushStamp,
+	MapCopy,
+	TileUpload,
+	Display,
+	Sort,
+	SequenceDecode,
+	Trails,
+	HeightBake,
+	MaskRaster,
+	WaterMesh,
+	Num
+};
+
+/** Per-frame counters written by FlowMap.CsvCapture. */
+enum class EFlowMapCounter : uint8
+{
+	AliveParticles,
+	SpawnedParticles,
+	RecycledParticles,
+	/** Tiles left at the default texel, which are neither stored nor uploaded. */
+	SkippedTiles,
+	UploadedTiles,
+	PoolBytes,
+	MapBytes,
+	Num
+};
+
+/**
+ * Frame-level totals of the flow simulation's timers and counters, independent of the stats system so they are
+ * available in Test/Shipping-like builds on device. While a capture is running, one CSV row is written per frame.
+ */
+class PARTICLEFLOWMAP_API FFlowMapFrameStats
+{
+public:
+	static FFlowMapFrameStats& Get();
+
+	void AddTime(EFlowMapTimer Timer, uint64 Cycles) { Timers[int32(Timer)].fetch_add(Cycles, std::memory_order_relaxed); }
+	void AddCount(EFlowMapCounter Counter, int64 Value) { Counters[int32(Counter)].fetch_add(Value, std::memory_order_relaxed); }
+
+	/** Memory counters persist across frames; the others reset at the end of every frame. */
+	static bool IsPersistent(EFlowMapCounter Counter) { return Counter == EFlowMapCounter::PoolBytes || Counter == EFlowMapCounter::MapBytes; }
+
+	void StartCapture(int32 NumFrames);
+	void StopCapture();
+	bool IsCapturing() const { return CaptureFile.IsValid(); }
+
+	struct FScopedTimer
+	{
+		explicit FScopedTimer(EFlowMapTimer InTimer) : Timer(InTimer), StartCycles(FPlatformTime::Cycles64()) {}
+		~FScopedTimer() { FFlowMapFrameStats::Get().AddTime(Timer, FPlatformTime::Cycles64() - StartCycles); }
+
+		EFlowMapTimer Timer;
+		uint64 StartCycles;
+	};
+
+private:
+	FFlowMapFrameStats();
+	void EndFrame();
+
+	std::atomic<uint64> Timers[int32(EFlowMapTimer::Num)]{};
+	std::atomic<int64> Counters[int32(EFlowMapCounter::Num)]{};
+
+	TUniquePtr<FArchive> CaptureFile;
+	FString CapturePath;
+	int32 FramesRemaining = 0;
+	uint64 FrameNumber = 0;
+};
+
+/**
+ * Times a scope in the stat group, in Insights on ParticleFlowMapChannel, and in the per-frame CSV bucket. Declares
+ * scoped timers, so it can't be wrapped in a block and has to stand in a braced scope of its own.
+ */
+#define FLOWMAP_SCOPE_CYCLE_COUNTER(Stat, Timer) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, ParticleFlowMapChannel); \
+	FFlowMapFrameStats::FScopedTimer ANONYMOUS_VARIABLE(FlowMapTimer)(Timer)
+
+#define FLOWMAP_INC_COUNTER(Stat, Counter, Amount) \
+	do \
+	{ \
+		INC_DWORD_STAT_BY(Stat, Amount); \
+		FFlowMapFrameStats::Get().AddCount(Counter, Amount); \
+	} \
+	while (0)
+
+#define FLOWMAP_INC_MEMORY(Stat, Counter, Bytes) \
+	do \
+	{ \
+		INC_MEMORY_STAT_BY(Stat, Bytes); \
+		FFlowMapFrameStats::Get().AddCount(Counter, int64(Bytes)); \
+	} \
+	while (0)
+
+#define FLOWMAP_DEC_MEMORY(Stat, Counter, Bytes) \
+	do \
+	{ \
+		DEC_MEMORY_STAT_BY(Stat, Bytes); \
+		FFlowMapFrameStats::Get().AddCount(Counter, -int64(Bytes)); \
+	} \
+	while (0)
@@ -0,0 +1,348 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapTileFile.h"
+#include "ParticleFlowMap.h"
+#include "Async/MappedFileHandle.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "TextureResource.h"
+
+FFlowMapTileFile::~FFlowMapTileFile()
+{
+	// The region has to be released before the handle it was mapped from.
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+}
+
+int32 FFlowMapTileFile::GetBytesPerTexel(EFlowMapTexelFormat Format)
+{
+	switch (Format)
+	{
+	case EFlowMapTexelFormat::BGRA8:
+		return sizeof(FColor);
+	case EFlowMapTexelFormat::RGBA16F:
+		return sizeof(FFloat16Color);
+	case EFlowMapTexelFormat::R8:
+		return sizeof(uint8);
+	case EFlowMapTexelFormat::R16F:
+		return sizeof(FFloat16);
+	case EFlowMapTexelFormat::R32F:
+		return sizeof(float);
+	default:
+		return 0;
+	}
+}
+
+bool FFlowMapTileFile::GetTexelFormat(EPixelFormat PixelFormat, EFlowMapTexelFormat& OutFormat)
+{
+	switch (PixelFormat)
+	{
+	case PF_B8G8R8A8:
+		OutFormat = EFlowMapTexelFormat::BGRA8;
+		return true;
+	case PF_FloatRGBA:
+		OutFormat = EFlowMapTexelFormat::RGBA16F;
+		return true;
+	case PF_G8:
+		OutFormat = EFlowMapTexelFormat::R8;
+		return true;
+	case PF_R16F:
+		OutFormat = EFlowMapTexelFormat::R16F;
+		return true;
+	case PF_R32_FLOAT:
+		OutFormat = EFlowMapTexelFormat::R32F;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void FFlowMapTileFile::EncodeTexels(TConstArrayView<FLinearColor> Pixels, int32 Width, int32 Height, EFlowMapTexelFormat Format, bool bSRGB,
+	const FLinearColor& Default, FFlowMapTexels& OutTexels)
+{
+	check(Pixels.Num() == Width * Height);
+
+	const int32 BytesPerTexel = GetBytesPerTexel(Format);
+	auto Encode = [Format, bSRGB](const FLinearColor& Color, uint8* Out)
+	{
+		switch (Format)
+		{
+		case EFlowMapTexelFormat::BGRA8:
+			*reinterpret_cast<FColor*>(Out) = Color.ToFColor(bSRGB);
+			break;
+		case EFlowMapTexelFormat::RGBA16F:
+			*reinterpret_cast<FFloat16Color*>(Out) = FFloat16Color(Color);
+			break;
+		case EFlowMapTexelFormat::R8:
+			*Out = uint8(FMath::Clamp(FMath::RoundToInt32(Color.R * 255.0f), 0, 255));
+			break;
+		case EFlowMapTexelFormat::R16F:
+			*reinterpret_cast<FFloat16*>(Out) = FFloat16(Color.R);
+			break;
+		case EFlowMapTexelFormat::R32F:
+			*reinterpret_cast<float*>(Out) = Color.R;
+			break;
+		}
+	};
+
+	OutTexels.Width = Width;
+	OutTexels.Height = Height;
+	OutTexels.Format = Format;
+	OutTexels.Data.SetNumUninitialized(Pixels.Num() * BytesPerTexel);
+	for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+	{
+		Encode(Pixels[Index], OutTexels.Data.GetData() + Index * BytesPerTexel);
+	}
+
+	FMemory::Memzero(OutTexels.DefaultTexel);
+	Encode(Default, OutTexels.DefaultTexel);
+}
+
+bool FFlowMapTileFile::ReadRenderTarget(UTextureRenderTarget2D* RenderTarget, FFlowMapTexels& OutTexels)
+{
+	if (!RenderTarget)
+	{
+		return false;
+	}
+
+	if (!GetTexelFormat(RenderTarget->GetFormat(), OutTexels.Format)
+		|| (OutTexels.Format != EFlowMapTexelFormat::BGRA8 && OutTexels.Format != EFlowMapTexelFormat::RGBA16F))
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s uses %s, flowmap tiles support RTF_RGBA8 and RTF_RGBA16f only"),
+			*RenderTarget->GetName(), GetPixelFormatString(RenderTarget->GetFormat()));
+		return false;
+	}
+
+	FTextureRenderTargetResource* Resource = RenderTarget->GameThread_GetRenderTargetResource();
+	if (!Resource)
+	{
+		return false;
+	}
+
+	OutTexels.Width = RenderTarget->SizeX;
+	OutTexels.Height = RenderTarget->SizeY;
+	FMemory::Memzero(OutTexels.DefaultTexel);
+
+	if (OutTexels.Format == EFlowMapTexelFormat::BGRA8)
+	{
+		TArray<FColor> Pixels;
+		if (!Resource->ReadPixels(Pixels))
+		{
+			return false;
+		}
+		OutTexels.Data.SetNumUninitialized(Pixels.Num() * sizeof(FColor));
+		FMemory::Memcpy(OutTexels.Data.GetData(), Pixels.GetData(), OutTexels.Data.Num());
+
+		const FColor Default = RenderTarget->ClearColor.ToFColor(RenderTarget->IsSRGB());
+		FMemory::Memcpy(OutTexels.DefaultTexel, &Default, sizeof(Default));
+	}
+	else
+	{
+		TArray<FFloat16Color> Pixels;
+		if (!Resource->ReadFloat16Pixels(Pixels))
+		{
+			return false;
+		}
+		OutTexels.Data.SetNumUninitialized(Pixels.Num() * sizeof(FFloat16Color));
+		FMemory::Memcpy(OutTexels.Data.GetData(), Pixels.GetData(), OutTexels.Data.Num());
+
+		const FFloat16Color Default(RenderTarget->ClearColor);
+		FMemory::Memcpy(OutTexels.DefaultTexel, &Default, sizeof(Default));
+	}
+
+	return OutTexels.Data.Num() == OutTexels.Width * OutTexels.Height * GetBytesPerTexel(OutTexels.Format);
+}
+
+bool FFlowMapTileFile::Save(const FString& Filename, const FFlowMapTexels& Texels, int32 TileSize, FFlowMapTileSaveStats* OutStats)
+{
+	const int32 BytesPerTexel = GetBytesPerTexel(Texels.Format);
+	if (TileSize <= 0 || TileSize > MAX_uint16 || BytesPerTexel == 0 || Texels.Data.Num() != Texels.Width * Texels.Height * BytesPerTexel)
+	{
+		return false;
+	}
+
+	const int32 TilesX = FMath::DivideAndRoundUp(Texels.Width, TileSize);
+	const int32 TilesY = FMath::DivideAndRoundUp(Texels.Height, TileSize);
+	if (TilesX > MAX_uint16 || TilesY > MAX_uint16)
+	{
+		return false;
+	}
+
+	FFlowMapTileFileHeader Header;
+	Header.Width = Texels.Width;
+	Header.Height = Texels.Height;
+	Header.TileSize = TileSize;
+	Header.TexelFormat = uint32(Texels.Format);
+	FMemory::Memcpy(Header.DefaultTexel, Texels.DefaultTexel, sizeof(Header.DefaultTexel));
+
+	TArray<uint8> Payload;
+	TArray<FFlowMapTileEntry> Directory;
+	for (int32 TileY = 0; TileY < TilesY; ++TileY)
+	{
+		for (int32 TileX = 0; TileX < TilesX; ++TileX)
+		{
+			const int32 MinX = TileX * TileSize;
+			const int32 MinY = TileY * TileSize;
+			const int32 TileWidth = FMath::Min(TileSize, Texels.Width - MinX);
+			const int32 TileHeight = FMath::Min(TileSize, Texels.Height - MinY);
+			const int32 RowBytes = TileWidth * BytesPerTexel;
+
+			bool bIsDefault = true;
+			for (int32 Y = MinY; Y < MinY + TileHeight && bIsDefault; ++Y)
+			{
+				const uint8* Row = Texels.Data.GetData() + (int64(Y) * Texels.Width + MinX) * BytesPerTexel;
+				for (int32 X = 0; X < TileWidth; ++X)
+				{
+					if (FMemory::Memcmp(Row + X * BytesPerTexel, Texels.DefaultTexel, BytesPerTexel) != 0)
+					{
+						bIsDefault = false;
+						break;
+					}
+				}
+			}
+
+			if (bIsDefault)
+			{
+				continue;
+			}
+
+			FFlowMapTileEntry& Entry = Directory.AddDefaulted_GetRef();
+			Entry.TileX = uint16(TileX);
+			Entry.TileY = uint16(TileY);
+			Entry.Width = uint16(TileWidth);
+			Entry.Height = uint16(TileHeight);
+			Entry.DataOffset = sizeof(FFlowMapTileFileHeader) + Payload.Num();
+
+			for (int32 Y = MinY; Y < MinY + TileHeight; ++Y)
+			{
+				Payload.Append(Texels.Data.GetData() + (int64(Y) * Texels.Width + MinX) * BytesPerTexel, RowBytes);
+			}
+		}
+	}
+
+	// Keep the directory aligned so it can be viewed in place from the mapping.
+	Payload.AddZeroed(Align(Payload.Num(), alignof(FFlowMapTileEntry)) - Payload.Num());
+	Header.NumTiles = Directory.Num();
+	Header.DirectoryOffset = sizeof(FFlowMapTileFileHeader) + Payload.Num();
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Writer)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("Could not open %s for writing"), *Filename);
+		return false;
+	}
+
+	Writer->Serialize(&Header, sizeof(Header));
+	Writer->Serialize(Payload.GetData(), Payload.Num());
+	Writer->Serialize(Directory.GetData(), Directory.Num() * sizeof(FFlowMapTileEntry));
+	const bool bSuccess = Writer->Close() && !Writer->IsError();
+
+	if (OutStats)
+	{
+		OutStats->NumTiles = TilesX * TilesY;
+		OutStats->NumStoredTiles = Directory.Num();
+		OutStats->FileSize = Header.DirectoryOffset + Directory.Num() * sizeof(FFlowMapTileEntry);
+	}
+	return bSuccess;
+}
+
+TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe> FFlowMapTileFile::Open(const FString& Filename)
+{
+	TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe> File = MakeShareable(new FFlowMapTileFile());
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	File->MappedHandle.Reset(PlatformFile.OpenMapped(*Filename));
+	if (File->MappedHandle)
+	{
+		File->MappedRegion.Reset(File->MappedHandle->MapRegion());
+	}
+
+	if (File->MappedRegion)
+	{
+		File->Data = File->MappedRegion->GetMappedPtr();
+		File->Size = File->MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		// Files inside a pak cannot be mapped; stage FlowMaps as loose files to avoid this copy.
+		File->MappedHandle.Reset();
+		if (!FFileHelper::LoadFileToArray(File->LoadedData, *Filename, FILEREAD_Silent))
+		{
+			return nullptr;
+		}
+		File->Data = File->LoadedData.GetData();
+		File->Size = File->LoadedData.Num();
+	}
+
+	return File->Validate(Filename) ? File : nullptr;
+}
+
+bool FFlowMapTileFile::Validate(const FString& Filename)
+{
+	if (Size < int64(sizeof(FFlowMapTileFileHeader)))
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s is too small to be a flowmap tile file"), *Filename);
+		return false;
+	}
+
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+	const int32 BytesPerTexel = GetBytesPerTexel(GetTexelFormat());
+	if (Header.Magic != FFlowMapTileFileHeader::ExpectedMagic || Header.Version != FFlowMapTileFileHeader::CurrentVersion || BytesPerTexel == 0
+		|| Header.Width <= 0 || Header.Height <= 0 || Header.TileSize <= 0)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has an unsupported flowmap tile header"), *Filename);
+		return false;
+	}
+
+	// A map can't have more stored tiles than tiles. Bounding the count first keeps the byte counts below from overflowing.
+	const int64 MaxTiles = FMath::DivideAndRoundUp(int64(Header.Width), int64(Header.TileSize)) * FMath::DivideAndRoundUp(int64(Header.Height), int64(Header.TileSize));
+	if (int64(Header.NumTiles) > MaxTiles || Header.TileSize > MAX_uint16)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has an unsupported flowmap tile header"), *Filename);
+		return false;
+	}
+
+	const uint64 FileSize = uint64(Size);
+	const uint64 DirectoryBytes = uint64(Header.NumTiles) * sizeof(FFlowMapTileEntry);
+	if (Header.DirectoryOffset % alignof(FFlowMapTileEntry) != 0 || Header.DirectoryOffset < sizeof(FFlowMapTileFileHeader)
+		|| Header.DirectoryOffset > FileSize || DirectoryBytes > FileSize - Header.DirectoryOffset)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has a truncated tile directory"), *Filename);
+		return false;
+	}
+
+	// Payloads are written back to back between the header and the directory, so together they have to fit there too.
+	const uint64 PayloadBytes = Header.DirectoryOffset - sizeof(FFlowMapTileFileHeader);
+	uint64 TotalTileBytes = 0;
+
+	Tiles = MakeArrayView(reinterpret_cast<const FFlowMapTileEntry*>(Data + Header.DirectoryOffset), int32(Header.NumTiles));
+	for (const FFlowMapTileEntry& Tile : Tiles)
+	{
+		const uint64 TileBytes = uint64(Tile.Width) * Tile.Height * BytesPerTexel;
+		const bool bInBounds = Tile.Width <= Header.TileSize && Tile.Height <= Header.TileSize
+			&& int64(Tile.TileX) * Header.TileSize + Tile.Width <= Header.Width
+			&& int64(Tile.TileY) * Header.TileSize + Tile.Height <= Header.Height;
+		const bool bPayloadInBounds = Tile.DataOffset >= sizeof(FFlowMapTileFileHeader) && Tile.DataOffset <= Header.DirectoryOffset
+			&& TileBytes <= Header.DirectoryOffset - Tile.DataOffset && TileBytes <= PayloadBytes - TotalTileBytes;
+		if (!bInBounds || !bPayloadInBounds)
+		{
+			UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has a corrupt tile at (%d, %d)"), *Filename, Tile.TileX, Tile.TileY);
+			return false;
+		}
+		TotalTileBytes += TileBytes;
+	}
+
+	return true;
+}
+
+void FFlowMapTileFile::PrefetchTile(const FFlowMapTileEntry& Tile) const
+{
+	if (MappedRegion)
+	{
+		const int64 TileBytes = int64(Tile.Width) * Tile.Height * GetBytesPerTexel(GetTexelFormat());
+		MappedRegion->PreloadHint(Tile.DataOffset, TileBytes);
+	}
+}
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+class UTextureRenderTarget2D;
+
+enum class EFlowMapTexelFormat : uint32
+{
+	/** PF_B8G8R8A8, laid out like FColor. */
+	BGRA8 = 0,
+	/** PF_FloatRGBA, laid out like FFloat16Color. */
+	RGBA16F = 1,
+	/** Single channel maps (mask, height): PF_G8, PF_R16F and PF_R32_FLOAT. */
+	R8 = 2,
+	R16F = 3,
+	R32F = 4,
+};
+
+/**
+ * On-disk layout of a tiled flowmap (.flowtiles). Only tiles that differ from the default texel are stored, so both
+ * the file and the upload cost scale with the painted area. Tile payloads are raw texels in the render target's own
+ * format and can be uploaded straight out of a memory mapping without decoding.
+ *
+ *	[Header][tile payloads...][directory: NumTiles x FFlowMapTileEntry]
+ */
+struct FFlowMapTileFileHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4C54464D; // "MFTL"
+	static constexpr uint32 CurrentVersion = 1;
+
+	uint32 Magic = ExpectedMagic;
+	uint32 Version = CurrentVersion;
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 TileSize = 0;
+	uint32 TexelFormat = 0;
+	uint32 NumTiles = 0;
+	uint32 Reserved = 0;
+	uint8 DefaultTexel[8] = {};
+	uint64 DirectoryOffset = 0;
+};
+static_assert(sizeof(FFlowMapTileFileHeader) == 48, "Flowmap tile header layout is part of the file format");
+
+struct FFlowMapTileEntry
+{
+	uint16 TileX = 0;
+	uint16 TileY = 0;
+	/** Edge tiles are clipped to the map, so the payload is Width * Height texels. */
+	uint16 Width = 0;
+	uint16 Height = 0;
+	uint64 DataOffset = 0;
+};
+static_assert(sizeof(FFlowMapTileEntry) == 16, "Flowmap tile entry layout is part of the file format");
+
+struct FFlowMapTileSaveStats
+{
+	int32 NumTiles = 0;
+	int32 NumStoredTiles = 0;
+	int64 FileSize = 0;
+};
+
+/** Raw copy of a render target in one of the formats the tile file can store. */
+struct FFlowMapTexels
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	EFlowMapTexelFormat Format = EFlowMapTexelFormat::BGRA8;
+	TArray<uint8> Data;
+	uint8 DefaultTexel[8] = {};
+};
+
+/**
+ * Read-only view of a .flowtiles file. The file is memory mapped where the platform allows it (loose files), and read
+ * into memory otherwise. Thread safe once opened; share it with render commands so the mapping outlives the uploads.
+ */
+class PARTICLEFLOWMAP_API FFlowMapTileFile
+{
+public:
+	~FFlowMapTileFile();
+
+	/** Opens and validates a tile file. Does file IO, so call it off the game thread. */
+	static TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe> Open(const FString& Filename);
+
+	/** Writes the non-default tiles of Texels. */
+	static bool Save(const FString& Filename, const FFlowMapTexels& Texels, int32 TileSize, FFlowMapTileSaveStats* OutStats = nullptr);
+
+	static int32 GetBytesPerTexel(EFlowMapTexelFormat Format);
+	static bool GetTexelFormat(EPixelFormat PixelFormat, EFlowMapTexelFormat& OutFormat);
+
+	/**
+	 * Converts linear colours to Format, with Default as the default texel, for maps baked on the CPU. Single channel
+	 * formats keep R.
+	 */
+	static void EncodeTexels(TConstArrayView<FLinearColor> Pixels, int32 Width, int32 Height, EFlowMapTexelFormat Format, bool bSRGB,
+		const FLinearColor& Default, FFlowMapTexels& OutTexels);
+
+	/** Reads an RGBA8 or RGBA16f render target back in its native format, along with its clear colour as the default texel. */
+	static bool ReadRenderTarget(UTextureRenderTarget2D* RenderTarget, FFlowMapTexels& OutTexels);
+
+	const FFlowMapTileFileHeader& GetHeader() const { return Header; }
+	EFlowMapTexelFormat GetTexelFormat() const { return EFlowMapTexelFormat(Header.TexelFormat); }
+	TConstArrayView<FFlowMapTileEntry> GetTiles() const { return Tiles; }
+	const uint8* GetTileData(const FFlowMapTileEntry& Tile) const { return Data + Tile.DataOffset; }
+	bool IsMemoryMapped() const { return MappedRegion.IsValid(); }
+
+	/** Hints the OS to page a tile in, so the render thread does not fault on it during the upload. */
+	void PrefetchTile(const FFlowMapTileEntry& Tile) const;
+
+private:
+	FFlowMapTileFile() = default;
+	bool Validate(const FString& Filename);
+
+	FFlowMapTileFileHeader Header;
+	TConstArrayView<FFlowMapTileEntry> Tiles;
+
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray64<uint8> LoadedData;
+
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+};
@@ -0,0 +1,204 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMapTileLoaderComponent.h"
+#include "ParticleFlowMap.h"
+#include "FlowMapTileFile.h"
+#include "FlowMapStats.h"
+#include "Async/Async.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+
+UFlowMapTileLoaderComponent::UFlowMapTileLoaderComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+}
+
+FString UFlowMapTileLoaderComponent::GetTileFilePath() const
+{
+	FString RelativePath = TileFile;
+	if (RelativePath.IsEmpty())
+	{
+		const UWorld* World = GetWorld();
+		const FString LevelName = World ? FPackageName::GetShortName(UWorld::RemovePIEPrefix(World->GetOutermost()->GetName())) : TEXT("Default");
+		const FString OwnerName = GetOwner() ? GetOwner()->GetFName().ToString() : GetFName().ToString();
+		RelativePath = FString::Printf(TEXT("FlowMaps/%s_%s.flowtiles"), *LevelName, *OwnerName);
+	}
+	return FPaths::Combine(FPaths::ProjectContentDir(), RelativePath);
+}
+
+bool UFlowMapTileLoaderComponent::SaveFlowMap()
+{
+	FFlowMapTexels Texels;
+	if (!FFlowMapTileFile::ReadRenderTarget(FlowMap, Texels))
+	{
+		return false;
+	}
+
+	const FString Path = GetTileFilePath();
+	FFlowMapTileSaveStats Stats;
+	if (!FFlowMapTileFile::Save(Path, Texels, TileSize, &Stats))
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("Failed to save flowmap tiles to %s"), *Path);
+		return false;
+	}
+
+	UE_LOG(LogParticleFlowMap, Log, TEXT("Saved %d of %d flowmap tiles (%lld bytes) to %s"), Stats.NumStoredTiles, Stats.NumTiles, Stats.FileSize, *Path);
+	return true;
+}
+
+bool UFlowMapTileLoaderComponent::LoadFlowMap()
+{
+	if (!FlowMap || IsLoading())
+	{
+		return false;
+	}
+
+	PendingOpen = Async(EAsyncExecution::ThreadPool, [Path = GetTileFilePath()]()
+	{
+		TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe> File = FFlowMapTileFile::Open(Path);
+		if (File)
+		{
+			for (const FFlowMapTileEntry& Tile : File->GetTiles())
+			{
+				File->PrefetchTile(Tile);
+			}
+		}
+		return File;
+	});
+
+	SetComponentTickEnabled(true);
+	return true;
+}
+
+bool UFlowMapTileLoaderComponent::IsLoading() const
+{
+	return PendingOpen.IsValid() || UploadingFile.IsValid();
+}
+
+void UFlowMapTileLoaderComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (bLoadOnBeginPlay)
+	{
+		LoadFlowMap();
+	}
+}
+
+void UFlowMapTileLoaderComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Render commands hold their own reference to the file, so dropping ours here is safe mid-upload.
+	if (PendingOpen.IsValid())
+	{
+		PendingOpen.Wait();
+		PendingOpen.Reset();
+	}
+	UploadingFile.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UFlowMapTileLoaderComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (PendingOpen.IsValid() && PendingOpen.IsReady())
+	{
+		TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe> File = PendingOpen.Get();
+		PendingOpen.Reset();
+		if (!File)
+		{
+			UE_LOG(LogParticleFlowMap, Log, TEXT("No flowmap tiles at %s, keeping %s as is"), *GetTileFilePath(), *GetNameSafe(FlowMap));
+		}
+		else if (!BeginUpload(File))
+		{
+			UE_LOG(LogParticleFlowMap, Warning, TEXT("%s does not match the size or format of %s"), *GetTileFilePath(), *GetNameSafe(FlowMap));
+		}
+	}
+
+	if (UploadingFile)
+	{
+		UploadNextTiles();
+	}
+
+	if (!IsLoading())
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
+bool UFlowMapTileLoaderComponent::BeginUpload(const TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe>& File)
+{
+	EFlowMapTexelFormat Format;
+	const FFlowMapTileFileHeader& Header = File->GetHeader();
+	if (!FlowMap || !FFlowMapTileFile::GetTexelFormat(FlowMap->GetFormat(), Format) || Format != File->GetTexelFormat()
+		|| Header.Width != FlowMap->SizeX || Header.Height != FlowMap->SizeY)
+	{
+		return false;
+	}
+
+	// Tiles that were not saved hold the clear colour, so start from a cleared target.
+	FlowMap->UpdateResourceImmediate(true);
+
+	// Tiles left at the default value are never uploaded.
+	const int32 TotalTiles = FMath::DivideAndRoundUp(Header.Width, Header.TileSize) * FMath::DivideAndRoundUp(Header.Height, Header.TileSize);
+	FLOWMAP_INC_COUNTER(STAT_FlowMap_SkippedTiles, EFlowMapCounter::SkippedTiles, TotalTiles - File->GetTiles().Num());
+
+	UploadingFile = File;
+	NextTile = 0;
+	return true;
+}
+
+void UFlowMapTileLoaderComponent::UploadNextTiles()
+{
+	FTextureRenderTargetResource* Resource = FlowMap ? FlowMap->GameThread_GetRenderTargetResource() : nullptr;
+	if (!Resource)
+	{
+		UploadingFile.Reset();
+		return;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_TileUpload, EFlowMapTimer::TileUpload);
+
+	const int32 NumTiles = UploadingFile->GetTiles().Num();
+	const int32 FirstTile = NextTile;
+	const int32 LastTile = FMath::Min(FirstTile + TilesPerFrame, NumTiles);
+	NextTile = LastTile;
+	FLOWMAP_INC_COUNTER(STAT_FlowMap_UploadedTiles, EFlowMapCounter::UploadedTiles, LastTile - FirstTile);
+
+	ENQUEUE_RENDER_COMMAND(UploadFlowMapTiles)(
+		[File = UploadingFile, Resource, FirstTile, LastTile](FRHICommandListImmediate& RHICmdList)
+		{
+			FRHITexture* Texture = Resource->GetRenderTargetTexture();
+			if (!Texture)
+			{
+				return;
+			}
+
+			SCOPED_DRAW_EVENT(RHICmdList, FlowMapTileUpload);
+			SCOPED_GPU_STAT(RHICmdList, FlowMapTileUpload);
+
+			const int32 TileSize = File->GetHeader().TileSize;
+			const int32 BytesPerTexel = FFlowMapTileFile::GetBytesPerTexel(File->GetTexelFormat());
+			for (int32 TileIndex = FirstTile; TileIndex < LastTile; ++TileIndex)
+			{
+				const FFlowMapTileEntry& Tile = File->GetTiles()[TileIndex];
+				const FUpdateTextureRegion2D Region(Tile.TileX * TileSize, Tile.TileY * TileSize, 0, 0, Tile.Width, Tile.Height);
+				RHICmdList.UpdateTexture2D(Texture, 0, Region, Tile.Width * BytesPerTexel, File->GetTileData(Tile));
+			}
+		});
+
+	if (NextTile >= NumTiles)
+	{
+		UE_LOG(LogParticleFlowMap, Verbose, TEXT("Restored %d flowmap tiles into %s (%s)"), NumTiles, *GetNameSafe(FlowMap),
+			UploadingFile->IsMemoryMapped() ? TEXT("mapped") : TEXT("loaded"));
+		UploadingFile.Reset();
+	}
+}
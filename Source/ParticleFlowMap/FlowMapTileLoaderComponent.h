@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Async/Future.h"
+#include "FlowMapTileLoaderComponent.generated.h"
+
+class FFlowMapTileFile;
+class UTextureRenderTarget2D;
+
+/**
+ * Saves a painted flowmap as a tiled delta file and restores it when the level starts, so BP_Stream begins with its
+ * river already painted. The file is opened and paged in on a worker thread, then a few tiles are uploaded per frame
+ * so loading never stalls the game thread.
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowMapTileLoaderComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowMapTileLoaderComponent();
+
+	/** The painted flowmap, usually RT_Flowmap, or a map baked by the FlowMapBake commandlet. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UTextureRenderTarget2D> FlowMap;
+
+	/**
+	 * Tile file relative to the project Content directory. Empty uses FlowMaps/<Level>_<Actor>.flowtiles; baked maps
+	 * are written to FlowMaps/<Level>_<Actor>_<Map>.flowtiles.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FString TileFile;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "8", ClampMax = "512"))
+	int32 TileSize = 64;
+
+	/** Upload budget; each tile is one small texture update on the render thread. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "1"))
+	int32 TilesPerFrame = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bLoadOnBeginPlay = true;
+
+	/** Writes the non-default tiles of FlowMap to TileFile. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	bool SaveFlowMap();
+
+	/** Starts restoring FlowMap from TileFile; returns false if a load is already running. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	bool LoadFlowMap();
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	bool IsLoading() const;
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	FString GetTileFilePath() const;
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	bool BeginUpload(const TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe>& File);
+	void UploadNextTiles();
+
+	TFuture<TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe>> PendingOpen;
+	TSharedPtr<FFlowMapTileFile, ESPMode::ThreadSafe> UploadingFile;
+	int32 NextTile = 0;
+};
@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMaskRasterComponent.h"
+#include "ParticleFlowMap.h"
+#include "FlowRiverComponent.h"
+#include "FlowMapStats.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "GameFramework/Actor.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+
+UFlowMaskRasterComponent::UFlowMaskRasterComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+	bTickInEditor = true;
+}
+
+UFlowRiverComponent* UFlowMaskRasterComponent::FindRiver() const
+{
+	return GetOwner() ? GetOwner()->FindComponentByClass<UFlowRiverComponent>() : nullptr;
+}
+
+bool UFlowMaskRasterComponent::Rasterize()
+{
+	UFlowRiverComponent* River = FindRiver();
+	if (!River || !River->MaskMap)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s needs a UFlowRiverComponent with a mask map to rasterize"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+
+	Rasterizer = FFlowMaskRasterizer();
+	Rasterizer.Initialize(River->MaskMap->SizeX, River->MaskMap->SizeY, FVector2f(River->Extent), TileSize);
+	RasterizedRiverTransform = River->GetComponentTransform();
+
+	TrackedMeshes.Reset();
+	for (const FFlowBakeInput& Input : Inputs)
+	{
+		if (!Input.Actor || Input.Role == EFlowBakeRole::Terrain)
+		{
+			continue;
+		}
+
+		TArray<UStaticMeshComponent*> Components;
+		Input.Actor->GetComponents(Components);
+		for (UStaticMeshComponent* Component : Components)
+		{
+			FTrackedMesh& Tracked = TrackedMeshes.AddDefaulted_GetRef();
+			Tracked.Component = Component;
+			Tracked.bBlocker = Input.Role == EFlowBakeRole::Blocker;
+			if (!UpdateMesh(TrackedMeshes.Num() - 1, *River))
+			{
+				TrackedMeshes.Pop();
+			}
+		}
+	}
+
+	NumPolygonShapes = 0;
+	RefreshPolygons();
+	return RasterizeAndWrite(*River);
+}
+
+void UFlowMaskRasterComponent::RefreshPolygons()
+{
+	if (!Rasterizer.IsInitialized())
+	{
+		return;
+	}
+
+	for (int32 Index = Polygons.Num(); Index < NumPolygonShapes; ++Index)
+	{
+		Rasterizer.RemoveShape(GetPolygonShapeId(Index));
+	}
+	NumPolygonShapes = Polygons.Num();
+
+	TArray<FVector2f> Points;
+	for (int32 Index = 0; Index < Polygons.Num(); ++Index)
+	{
+		Points.Reset();
+		for (const FVector2D& Point : Polygons[Index].Points)
+		{
+			Points.Add(FVector2f(Point));
+		}
+
+		FFlowMaskShape Shape;
+		Shape.bBlocker = Polygons[Index].bBlocker;
+		if (Points.Num() >= 3)
+		{
+			Shape.AddLoop(Points);
+		}
+		Rasterizer.SetShape(GetPolygonShapeId(Index), MoveTemp(Shape));
+	}
+}
+
+bool UFlowMaskRasterComponent::UpdateMesh(int32 MeshIndex, const UFlowRiverComponent& River)
+{
+	FTrackedMesh& Tracked = TrackedMeshes[MeshIndex];
+	const UStaticMeshComponent* Component = Tracked.Component.Get();
+	if (!Component || !FFlowHeightBaker::GatherStaticMesh(Component, River.GetComponentTransform(), VertexScratch, IndexScratch))
+	{
+		Rasterizer.RemoveShape(MeshIndex);
+		return false;
+	}
+
+	Tracked.Transform = Component->GetComponentTransform();
+	FFlowMaskShape Shape;
+	Shape.bBlocker = Tracked.bBlocker;
+	Shape.AddTriangles(VertexScratch, IndexScratch);
+	Rasterizer.SetShape(MeshIndex, MoveTemp(Shape));
+	return true;
+}
+
+bool UFlowMaskRasterComponent::RasterizeAndWrite(UFlowRiverComponent& River)
+{
+	if (Rasterizer.RasterizeDirtyTiles() == 0)
+	{
+		return true;
+	}
+
+	UTextureRenderTarget2D* MaskMap = River.MaskMap;
+	if (!MaskMap || MaskMap->SizeX != Rasterizer.GetWidth() || MaskMap->SizeY != Rasterizer.GetHeight())
+	{
+		return false;
+	}
+
+	// R8 targets take the changed tiles as they are; other formats are converted and written whole.
+	if (MaskMap->GetFormat() != PF_G8)
+	{
+		FFlowScalarField Mask;
+		Mask.Init(Rasterizer.GetWidth(), Rasterizer.GetHeight(), 0.0f);
+		for (int32 Index = 0; Index < Mask.Texels.Num(); ++Index)
+		{
+			Mask.Texels[Index] = Rasterizer.GetMask()[Index] / 255.0f;
+		}
+		const bool bWritten = FlowMap::WriteScalarField(MaskMap, 0, Mask);
+		River.MarkMapsDirty();
+		return bWritten;
+	}
+
+	FTextureRenderTargetResource* Resource = MaskMap->GameThread_GetRenderTargetResource();
+	if (!Resource)
+	{
+		return false;
+	}
+
+	// Pack the tiles so the render command owns its data.
+	TArray<FIntRect> Tiles(Rasterizer.GetRasterizedTiles());
+	TArray<uint8> Data;
+	for (const FIntRect& Tile : Tiles)
+	{
+		for (int32 Y = Tile.Min.Y; Y < Tile.Max.Y; ++Y)
+		{
+			Data.Append(Rasterizer.GetMask().GetData() + Y * Rasterizer.GetWidth() + Tile.Min.X, Tile.Width());
+		}
+	}
+	FLOWMAP_INC_COUNTER(STAT_FlowMap_UploadedTiles, EFlowMapCounter::UploadedTiles, Tiles.Num());
+
+	ENQUEUE_RENDER_COMMAND(UploadFlowMaskTiles)(
+		[Resource, Tiles = MoveTemp(Tiles), Data = MoveTemp(Data)](FRHICommandListImmediate& RHICmdList)
+		{
+			FRHITexture* Texture = Resource->GetRenderTargetTexture();
+			if (!Texture)
+			{
+				return;
+			}
+
+			SCOPED_DRAW_EVENT(RHICmdList, FlowMapTileUpload);
+			SCOPED_GPU_STAT(RHICmdList, FlowMapTileUpload);
+
+			int32 Offset = 0;
+			for (const FIntRect& Tile : Tiles)
+			{
+				const FUpdateTextureRegion2D Region(Tile.Min.X, Tile.Min.Y, 0, 0, Tile.Width(), Tile.Height());
+				RHICmdList.UpdateTexture2D(Texture, 0, Region, Tile.Width(), Data.GetData() + Offset);
+				Offset += Tile.Area();
+			}
+		});
+
+	River.MarkMapsDirty();
+	return true;
+}
+
+void UFlowMaskRasterComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!bTrackMovement || !Rasterizer.IsInitialized())
+	{
+		return;
+	}
+
+	UFlowRiverComponent* River = FindRiver();
+	if (!River)
+	{
+		return;
+	}
+
+	if (!River->GetComponentTransform().Equals(RasterizedRiverTransform))
+	{
+		Rasterize();
+		return;
+	}
+
+	for (int32 MeshIndex = 0; MeshIndex < TrackedMeshes.Num(); ++MeshIndex)
+	{
+		const UStaticMeshComponent* Component = TrackedMeshes[MeshIndex].Component.Get();
+		if (!Component)
+		{
+			Rasterizer.RemoveShape(MeshIndex);
+		}
+		else if (!Component->GetComponentTransform().Equals(TrackedMeshes[MeshIndex].Transform))
+		{
+			UpdateMesh(MeshIndex, *River);
+		}
+	}
+
+	if (Rasterizer.GetNumDirtyTiles() > 0)
+	{
+		RasterizeAndWrite(*River);
+	}
+}
+
+#if WITH_EDITOR
+void UFlowMaskRasterComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (PropertyChangedEvent.GetMemberPropertyName() == GET_MEMBER_NAME_CHECKED(UFlowMaskRasterComponent, Polygons) && Rasterizer.IsInitialized())
+	{
+		RefreshPolygons();
+		if (UFlowRiverComponent* River = FindRiver())
+		{
+			RasterizeAndWrite(*River);
+		}
+	}
+}
+#endif
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "FlowHeightBakeComponent.h"
+#include "FlowMaskRasterizer.h"
+#include "FlowMaskRasterComponent.generated.h"
+
+class UFlowRiverComponent;
+class UStaticMeshComponent;
+
+/** Hand-drawn mask shape in the river component's space (world units, map centre at the origin). */
+USTRUCT(BlueprintType)
+struct PARTICLEFLOWMAP_API FFlowMaskPolygon
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TArray<FVector2D> Points;
+
+	/** Cut the shape out of the river instead of adding it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bBlocker = false;
+};
+
+/**
+ * Builds the owner's river mask on the CPU instead of capturing the scene with M_CaptureRiver and M_CaptureBlockers:
+ * river meshes and polygons are filled, blocker meshes and polygons cut out, as seen from above, with anti-aliased
+ * edges. Only the tiles under a changed shape are rasterized and uploaded again, so it is cheap enough to run on
+ * every edit, and needs no GPU.
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowMaskRasterComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowMaskRasterComponent();
+
+	/** River and Blocker inputs are drawn from their static meshes' footprints; Terrain inputs are ignored. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TArray<FFlowBakeInput> Inputs;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TArray<FFlowMaskPolygon> Polygons;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "8", ClampMax = "512"))
+	int32 TileSize = 64;
+
+	/** Re-rasterize the tiles under any input mesh that moves. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bTrackMovement = false;
+
+	/** Gathers every input and rasterizes the whole mask into the river's mask map. */
+	UFUNCTION(BlueprintCallable, CallInEditor, Category = "Flowmap")
+	bool Rasterize();
+
+	/** Re-reads Polygons after they were changed at runtime and updates the tiles under them. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	void RefreshPolygons();
+
+	const FFlowMaskRasterizer& GetRasterizer() const { return Rasterizer; }
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	struct FTrackedMesh
+	{
+		TWeakObjectPtr<UStaticMeshComponent> Component;
+		FTransform Transform;
+		bool bBlocker = false;
+	};
+
+	UFlowRiverComponent* FindRiver() const;
+	bool UpdateMesh(int32 MeshIndex, const UFlowRiverComponent& River);
+
+	/** Rasterizes the dirty tiles and uploads them. */
+	bool RasterizeAndWrite(UFlowRiverComponent& River);
+
+	/** Polygons use negative shape ids, meshes their index in TrackedMeshes. */
+	static int32 GetPolygonShapeId(int32 PolygonIndex) { return -1 - PolygonIndex; }
+
+	FFlowMaskRasterizer Rasterizer;
+	TArray<FTrackedMesh> TrackedMeshes;
+	int32 NumPolygonShapes = 0;
+	FTransform RasterizedRiverTransform;
+
+	TArray<FVector3f> VertexScratch;
+	TArray<uint32> IndexScratch;
+};
@@ -0,0 +1,362 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowMaskRasterizer.h"
+#include "FlowMapStats.h"
+#include "Async/ParallelFor.h"
+
+namespace FlowMaskRasterizer
+{
+	/**
+	 * Deposits the signed area a line sweeps to its right into Area (row stride Stride, Rows rows), the accumulation
+	 * scheme of font rasterizers. Coordinates are in tile texels; X must be >= 0 and leave one spare column on the right.
+	 */
+	static void AccumulateLine(FVector2f P0, FVector2f P1, float* Area, int32 Stride, int32 Rows)
+	{
+		if (P0.Y == P1.Y)
+		{
+			return;
+		}
+
+		float Direction = 1.0f;
+		if (P0.Y > P1.Y)
+		{
+			Swap(P0, P1);
+			Direction = -1.0f;
+		}
+
+		const float DxDy = (P1.X - P0.X) / (P1.Y - P0.Y);
+		float X = P0.X;
+		if (P0.Y < 0.0f)
+		{
+			X -= P0.Y * DxDy;
+		}
+
+		const int32 FirstRow = FMath::Max(FMath::FloorToInt32(P0.Y), 0);
+		const int32 EndRow = FMath::Min(FMath::CeilToInt32(P1.Y), Rows);
+		for (int32 Y = FirstRow; Y < EndRow; ++Y)
+		{
+			float* Row = Area + Y * Stride;
+			const float Dy = FMath::Min(float(Y + 1), P1.Y) - FMath::Max(float(Y), P0.Y);
+			const float XNext = X + DxDy * Dy;
+			const float D = Dy * Direction;
+
+			const float X0 = FMath::Min(X, XNext);
+			const float X1 = FMath::Max(X, XNext);
+			const float X0Floor = FMath::FloorToFloat(X0);
+			const int32 X0i = int32(X0Floor);
+			const int32 X1i = FMath::CeilToInt32(X1);
+
+			if (X1i <= X0i + 1)
+			{
+				// Within one texel: split by the mean X.
+				const float Fraction = 0.5f * (X + XNext) - X0Floor;
+				Row[X0i] += D - D * Fraction;
+				Row[X0i + 1] += D * Fraction;
+			}
+			else
+			{
+				// Across several texels: a trapezoid per texel, triangles at both ends.
+				const float InvWidth = 1.0f / (X1 - X0);
+				const float X0Fraction = X0 - X0Floor;
+				const float StartArea = 0.5f * InvWidth * FMath::Square(1.0f - X0Fraction);
+				const float X1Fraction = X1 - X1i + 1.0f;
+				const float EndArea = 0.5f * InvWidth * FMath::Square(X1Fraction);
+
+				Row[X0i] += D * StartArea;
+				if (X1i == X0i + 2)
+				{
+					Row[X0i + 1] += D * (1.0f - StartArea - EndArea);
+				}
+				else
+				{
+					const float SecondArea = InvWidth * (1.5f - X0Fraction);
+					Row[X0i + 1] += D * (SecondArea - StartArea);
+					for (int32 Column = X0i + 2; Column < X1i - 1; ++Column)
+					{
+						Row[Column] += D * InvWidth;
+					}
+					const float BeforeEnd = SecondArea + (X1i - X0i - 3) * InvWidth;
+					Row[X1i - 1] += D * (1.0f - BeforeEnd - EndArea);
+				}
+				Row[X1i] += D * EndArea;
+			}
+
+			X = XNext;
+		}
+	}
+
+	/**
+	 * Accumulates the part of a line inside a tile TileWidth texels wide. Parts left of the tile become a vertical line
+	 * on its left border, which covers the tile's rows exactly as the whole part would; parts right of it are dropped.
+	 */
+	static void AccumulateClipped(const FVector2f& P0, const FVector2f& P1, float TileWidth, float* Area, int32 Stride, int32 Rows)
+	{
+		if (P0.X >= TileWidth && P1.X >= TileWidth)
+		{
+			return;
+		}
+
+		// Split at the tile's left and right borders.
+		float Cuts[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		int32 NumCuts = 1;
+		if (P0.X != P1.X)
+		{
+			for (const float Border : { 0.0f, TileWidth })
+			{
+				const float T = (Border - P0.X) / (P1.X - P0.X);
+				if (T > 0.0f && T < 1.0f)
+				{
+					Cuts[NumCuts++] = T;
+				}
+			}
+			if (NumCuts == 3 && Cuts[1] > Cuts[2])
+			{
+				Swap(Cuts[1], Cuts[2]);
+			}
+		}
+		Cuts[NumCuts] = 1.0f;
+
+		for (int32 Piece = 0; Piece < NumCuts; ++Piece)
+		{
+			const FVector2f A = FMath::Lerp(P0, P1, Cuts[Piece]);
+			const FVector2f B = FMath::Lerp(P0, P1, Cuts[Piece + 1]);
+			const float MidX = 0.5f * (A.X + B.X);
+			if (MidX >= TileWidth)
+			{
+				continue;
+			}
+			if (MidX <= 0.0f)
+			{
+				AccumulateLine(FVector2f(0.0f, A.Y), FVector2f(0.0f, B.Y), Area, Stride, Rows);
+			}
+			else
+			{
+				AccumulateLine(FVector2f(FMath::Clamp(A.X, 0.0f, TileWidth), A.Y), FVector2f(FMath::Clamp(B.X, 0.0f, TileWidth), B.Y), Area, Stride, Rows);
+			}
+		}
+	}
+}
+
+void FFlowMaskShape::AddLoop(TConstArrayView<FVector2f> Points)
+{
+	for (int32 Index = 0; Index < Points.Num(); ++Index)
+	{
+		Edges.Add(Points[Index]);
+		Edges.Add(Points[(Index + 1) % Points.Num()]);
+		Bounds += Points[Index];
+	}
+}
+
+void FFlowMaskShape::AddTriangles(TConstArrayView<FVector3f> Vertices, TConstArrayView<uint32> Indices)
+{
+	for (int32 Index = 0; Index + 2 < Indices.Num(); Index += 3)
+	{
+		const FVector2f A(Vertices[Indices[Index]].X, Vertices[Indices[Index]].Y);
+		FVector2f B(Vertices[Indices[Index + 1]].X, Vertices[Indices[Index + 1]].Y);
+		FVector2f C(Vertices[Indices[Index + 2]].X, Vertices[Indices[Index + 2]].Y);
+
+		const float Area = FVector2f::CrossProduct(B - A, C - A);
+		if (FMath::Abs(Area) <= UE_SMALL_NUMBER)
+		{
+			continue;
+		}
+		if (Area < 0.0f)
+		{
+			Swap(B, C);
+		}
+
+		Edges.Append({ A, B, B, C, C, A });
+		Bounds += A;
+		Bounds += B;
+		Bounds += C;
+	}
+}
+
+void FFlowMaskRasterizer::Initialize(int32 InWidth, int32 InHeight, const FVector2f& InExtent, int32 InTileSize)
+{
+	Width = FMath::Max(InWidth, 0);
+	Height = FMath::Max(InHeight, 0);
+	Extent = InExtent;
+	TileSize = FMath::Max(InTileSize, 8);
+	TilesX = FMath::DivideAndRoundUp(Width, TileSize);
+	TilesY = FMath::DivideAndRoundUp(Height, TileSize);
+
+	Mask.SetNumZeroed(Width * Height);
+	RasterizedTiles.Reset();
+	MarkAllDirty();
+}
+
+void FFlowMaskRasterizer::SetShape(int32 ShapeId, FFlowMaskShape&& Shape)
+{
+	if (const FFlowMaskShape* Previous = Shapes.Find(ShapeId))
+	{
+		MarkDirty(Previous->Bounds);
+	}
+	MarkDirty(Shape.Bounds);
+	Shapes.Add(ShapeId, MoveTemp(Shape));
+}
+
+void FFlowMaskRasterizer::RemoveShape(int32 ShapeId)
+{
+	if (const FFlowMaskShape* Previous = Shapes.Find(ShapeId))
+	{
+		MarkDirty(Previous->Bounds);
+		Shapes.Remove(ShapeId);
+	}
+}
+
+void FFlowMaskRasterizer::MarkAllDirty()
+{
+	DirtyTiles.Init(true, TilesX * TilesY);
+}
+
+int32 FFlowMaskRasterizer::GetNumDirtyTiles() const
+{
+	return DirtyTiles.CountSetBits();
+}
+
+void FFlowMaskRasterizer::MarkDirty(const FBox2f& LocalBounds)
+{
+	if (!IsInitialized() || !LocalBounds.bIsValid)
+	{
+		return;
+	}
+
+	// One texel of margin for the anti-aliased edge.
+	const int32 MinX = FMath::FloorToInt32((LocalBounds.Min.X / Extent.X + 0.5f) * Width) - 1;
+	const int32 MinY = FMath::FloorToInt32((LocalBounds.Min.Y / Extent.Y + 0.5f) * Height) - 1;
+	const int32 MaxX = FMath::FloorToInt32((LocalBounds.Max.X / Extent.X + 0.5f) * Width) + 1;
+	const int32 MaxY = FMath::FloorToInt32((LocalBounds.Max.Y / Extent.Y + 0.5f) * Height) + 1;
+	if (MaxX < 0 || MaxY < 0 || MinX >= Width || MinY >= Height)
+	{
+		return;
+	}
+
+	for (int32 TileY = FMath::Max(MinY, 0) / TileSize; TileY <= FMath::Min(MaxY, Height - 1) / TileSize; ++TileY)
+	{
+		for (int32 TileX = FMath::Max(MinX, 0) / TileSize; TileX <= FMath::Min(MaxX, Width - 1) / TileSize; ++TileX)
+		{
+			DirtyTiles[TileY * TilesX + TileX] = true;
+		}
+	}
+}
+
+FIntRect FFlowMaskRasterizer::GetTileRect(int32 Tile) const
+{
+	const FIntPoint Min((Tile % TilesX) * TileSize, (Tile / TilesX) * TileSize);
+	return FIntRect(Min, FIntPoint(FMath::Min(Min.X + TileSize, Width), FMath::Min(Min.Y + TileSize, Height)));
+}
+
+int32 FFlowMaskRasterizer::RasterizeDirtyTiles()
+{
+	RasterizedTiles.Reset();
+	if (!IsInitialized())
+	{
+		return 0;
+	}
+
+	TArray<int32> Tiles;
+	for (TConstSetBitIterator<> It(DirtyTiles); It; ++It)
+	{
+		Tiles.Add(It.GetIndex());
+		RasterizedTiles.Add(GetTileRect(It.GetIndex()));
+	}
+	if (Tiles.Num() == 0)
+	{
+		return 0;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_MaskRaster, EFlowMapTimer::MaskRaster);
+
+	// Every edge in texel space, binned by the tile rows it spans (compressed rows, like the obstacle grid).
+	TexelEdges.Reset();
+	EdgeIsBlocker.Reset();
+	const FVector2f ToTexels(Width / Extent.X, Height / Extent.Y);
+	const FVector2f Centre(Width * 0.5f, Height * 0.5f);
+	for (const TPair<int32, FFlowMaskShape>& Pair : Shapes)
+	{
+		for (const FVector2f& Point : Pair.Value.Edges)
+		{
+			TexelEdges.Add(Point * ToTexels + Centre);
+		}
+		for (int32 Edge = 0; Edge < Pair.Value.Edges.Num() / 2; ++Edge)
+		{
+			EdgeIsBlocker.Add(Pair.Value.bBlocker ? 1 : 0);
+		}
+	}
+
+	const int32 NumEdges = TexelEdges.Num() / 2;
+	auto ForEachTileRow = [this](const FVector2f& P0, const FVector2f& P1, auto&& Callback)
+	{
+		const int32 First = FMath::Max(FMath::FloorToInt32(FMath::Min(P0.Y, P1.Y)) / TileSize, 0);
+		const int32 Last = FMath::Min(FMath::FloorToInt32(FMath::Max(P0.Y, P1.Y)) / TileSize, TilesY - 1);
+		for (int32 TileRow = First; TileRow <= Last; ++TileRow)
+		{
+			Callback(TileRow);
+		}
+	};
+
+	TArray<int32> RowStart;
+	RowStart.SetNumZeroed(TilesY + 1);
+	for (int32 Edge = 0; Edge < NumEdges; ++Edge)
+	{
+		ForEachTileRow(TexelEdges[Edge * 2], TexelEdges[Edge * 2 + 1], [&RowStart](int32 TileRow) { ++RowStart[TileRow + 1]; });
+	}
+	for (int32 TileRow = 0; TileRow < TilesY; ++TileRow)
+	{
+		RowStart[TileRow + 1] += RowStart[TileRow];
+	}
+	TArray<int32> RowEdges;
+	RowEdges.SetNumUninitialized(RowStart[TilesY]);
+	TArray<int32> RowFill(RowStart);
+	for (int32 Edge = 0; Edge < NumEdges; ++Edge)
+	{
+		ForEachTileRow(TexelEdges[Edge * 2], TexelEdges[Edge * 2 + 1], [&RowEdges, &RowFill, Edge](int32 TileRow) { RowEdges[RowFill[TileRow]++] = Edge; });
+	}
+
+	ParallelFor(Tiles.Num(), [this, &Tiles, &RowStart, &RowEdges](int32 Task)
+	{
+		const int32 TileRow = Tiles[Task] / TilesX;
+		const TConstArrayView<int32> Edges(RowEdges.GetData() + RowStart[TileRow], RowStart[TileRow + 1] - RowStart[TileRow]);
+
+		TArray<float> RiverArea;
+		TArray<float> BlockerArea;
+		RasterizeTile(GetTileRect(Tiles[Task]), Edges, RiverArea, BlockerArea);
+	});
+
+	DirtyTiles.Init(false, TilesX * TilesY);
+	return Tiles.Num();
+}
+
+void FFlowMaskRasterizer::RasterizeTile(const FIntRect& Rect, TConstArrayView<int32> RowEdges, TArray<float>& RiverArea, TArray<float>& BlockerArea)
+{
+	// Two spare columns: AccumulateLine writes one past the rightmost texel it touches.
+	const int32 Stride = Rect.Width() + 2;
+	const int32 Rows = Rect.Height();
+	RiverArea.SetNumZeroed(Stride * Rows);
+	BlockerArea.SetNumZeroed(Stride * Rows);
+
+	const FVector2f Origin(Rect.Min);
+	const float TileWidth = float(Rect.Width());
+	for (const int32 Edge : RowEdges)
+	{
+		const FVector2f P0 = TexelEdges[Edge * 2] - Origin;
+		const FVector2f P1 = TexelEdges[Edge * 2 + 1] - Origin;
+		float* Area = EdgeIsBlocker[Edge] ? BlockerArea.GetData() : RiverArea.GetData();
+		FlowMaskRasterizer::AccumulateClipped(P0, P1, TileWidth, Area, Stride, Rows);
+	}
+
+	for (int32 Y = 0; Y < Rows; ++Y)
+	{
+		float RiverSum = 0.0f;
+		float BlockerSum = 0.0f;
+		uint8* Out = Mask.GetData() + (Rect.Min.Y + Y) * Width + Rect.Min.X;
+		for (int32 X = 0; X < Rect.Width(); ++X)
+		{
+			RiverSum += RiverArea[Y * Stride + X];
+			BlockerSum += BlockerArea[Y * Stride + X];
+			const float Coverage = FMath::Min(FMath::Abs(RiverSum), 1.0f) * (1.0f - FMath::Min(FMath::Abs(BlockerSum), 1.0f));
+			Out[X] = uint8(FMath::RoundToInt32(Coverage * 255.0f));
+		}
+	}
+}
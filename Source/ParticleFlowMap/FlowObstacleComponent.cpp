@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowObstacleComponent.h"
+#include "FlowRiverSubsystem.h"
+#include "Engine/World.h"
+
+UFlowObstacleComponent::UFlowObstacleComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+}
+
+void UFlowObstacleComponent::GetSegment(FVector& OutStart, FVector& OutEnd) const
+{
+	const FVector Center = GetComponentLocation();
+	const FVector Offset = Shape == EFlowObstacleShape::Capsule ? GetForwardVector() * HalfLength : FVector::ZeroVector;
+	OutStart = Center - Offset;
+	OutEnd = Center + Offset;
+}
+
+void UFlowObstacleComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	PreviousLocation = GetComponentLocation();
+	if (UFlowRiverSubsystem* Subsystem = UWorld::GetSubsystem<UFlowRiverSubsystem>(GetWorld()))
+	{
+		Subsystem->RegisterObstacle(this);
+	}
+}
+
+void UFlowObstacleComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFlowRiverSubsystem* Subsystem = UWorld::GetSubsystem<UFlowRiverSubsystem>(GetWorld()))
+	{
+		Subsystem->UnregisterObstacle(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UFlowObstacleComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const FVector Location = GetComponentLocation();
+	Velocity = DeltaTime > UE_SMALL_NUMBER ? (Location - PreviousLocation) / DeltaTime : FVector::ZeroVector;
+	PreviousLocation = Location;
+}
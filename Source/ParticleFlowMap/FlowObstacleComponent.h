@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "FlowObstacleComponent.generated.h"
+
+UENUM(BlueprintType)
+enum class EFlowObstacleShape : uint8
+{
+	Sphere,
+	/** Segment along the component's X axis, e.g. a controller or a forearm. */
+	Capsule,
+};
+
+/**
+ * Moving body that pushes the stream's particles aside and drags a wake behind it, without touching the mask or the
+ * jump-flood map. Attach one to BP_Paint_Pawn's motion controllers or to tracked hand bones; every UFlowStreamComponent
+ * in the world picks it up through UFlowRiverSubsystem.
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowObstacleComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowObstacleComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	EFlowObstacleShape Shape = EFlowObstacleShape::Sphere;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	float Radius = 8.0f;
+
+	/** Half the capsule's segment length, not counting the rounded ends. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0", EditCondition = "Shape == EFlowObstacleShape::Capsule"))
+	float HalfLength = 10.0f;
+
+	/** Turn off to keep the obstacle registered but inert, e.g. while the hand is not tracked. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bAffectsWater = true;
+
+	/** World space segment; both ends are the same point for a sphere. */
+	void GetSegment(FVector& OutStart, FVector& OutEnd) const;
+
+	/** World velocity measured over the last tick. */
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	FVector GetObstacleVelocity() const { return Velocity; }
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	FVector PreviousLocation = FVector::ZeroVector;
+	FVector Velocity = FVector::ZeroVector;
+};
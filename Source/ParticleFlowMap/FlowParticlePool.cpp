@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowParticlePool.h"
+#include "FlowMapStats.h"
+
+void FFlowParticleFreeList::Reset(int32 Capacity)
+{
+	Next = MakeUnique<std::atomic<uint32>[]>(FMath::Max(Capacity, 1));
+	for (int32 Index = 0; Index < Capacity; ++Index)
+	{
+		Next[Index].store(Index + 1 < Capacity ? uint32(Index + 1) : EmptyIndex, std::memory_order_relaxed);
+	}
+
+	Head.store(MakeHead(0, Capacity > 0 ? 0 : EmptyIndex), std::memory_order_release);
+	NumFree.store(Capacity, std::memory_order_release);
+}
+
+void FFlowParticleFreeList::Push(int32 Index)
+{
+	uint64 OldHead = Head.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Next[Index].store(GetIndex(OldHead), std::memory_order_relaxed);
+		const uint64 NewHead = MakeHead(GetTag(OldHead) + 1, uint32(Index));
+		if (Head.compare_exchange_weak(OldHead, NewHead, std::memory_order_release, std::memory_order_relaxed))
+		{
+			break;
+		}
+	}
+	NumFree.fetch_add(1, std::memory_order_relaxed);
+}
+
+int32 FFlowParticleFreeList::Pop()
+{
+	uint64 OldHead = Head.load(std::memory_order_acquire);
+	for (;;)
+	{
+		const uint32 Index = GetIndex(OldHead);
+		if (Index == EmptyIndex)
+		{
+			return INDEX_NONE;
+		}
+
+		const uint64 NewHead = MakeHead(GetTag(OldHead) + 1, Next[Index].load(std::memory_order_relaxed));
+		if (Head.compare_exchange_weak(OldHead, NewHead, std::memory_order_acquire, std::memory_order_acquire))
+		{
+			NumFree.fetch_sub(1, std::memory_order_relaxed);
+			return int32(Index);
+		}
+	}
+}
+
+FFlowParticlePool::~FFlowParticlePool()
+{
+	FLOWMAP_DEC_MEMORY(STAT_FlowMap_PoolMemory, EFlowMapCounter::PoolBytes, TrackedBytes);
+}
+
+void FFlowParticlePool::Initialize(int32 InCapacity)
+{
+	Capacity = FMath::Max(InCapacity, 0);
+
+	Position.SetNumZeroed(Capacity);
+	Velocity.SetNumZeroed(Capacity);
+	Height.SetNumZeroed(Capacity);
+	Age.SetNumZeroed(Capacity);
+	Lifetime.SetNumZeroed(Capacity);
+	Alive.SetNumZeroed(Capacity);
+	Generation.SetNumZeroed(Capacity);
+
+	FreeList.Reset(Capacity);
+
+	const int64 Bytes = Position.GetAllocatedSize() + Velocity.GetAllocatedSize() + Height.GetAllocatedSize() + Age.GetAllocatedSize()
+		+ Lifetime.GetAllocatedSize() + Alive.GetAllocatedSize() + Generation.GetAllocatedSize() + int64(Capacity) * sizeof(uint32);
+	FLOWMAP_DEC_MEMORY(STAT_FlowMap_PoolMemory, EFlowMapCounter::PoolBytes, TrackedBytes);
+	FLOWMAP_INC_MEMORY(STAT_FlowMap_PoolMemory, EFlowMapCounter::PoolBytes, Bytes);
+	TrackedBytes = Bytes;
+}
+
+int32 FFlowParticlePool::Spawn()
+{
+	const int32 Index = FreeList.Pop();
+	if (Index != INDEX_NONE)
+	{
+		Alive[Index] = 1;
+		Age[Index] = 0.0f;
+		++Generation[Index];
+	}
+	return Index;
+}
+
+void FFlowParticlePool::Kill(int32 Index)
+{
+	check(Alive[Index]);
+	Alive[Index] = 0;
+	FreeList.Push(Index);
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Lock-free stack of free slot indices (a Treiber stack over an index array). The head carries a generation tag so a
+ * slot that is popped and pushed back between another thread's read and its compare-exchange cannot corrupt the list.
+ */
+class PARTICLEFLOWMAP_API FFlowParticleFreeList
+{
+public:
+	/** Not thread safe. Fills the list with every index, lowest index on top. */
+	void Reset(int32 Capacity);
+
+	void Push(int32 Index);
+
+	/** Returns INDEX_NONE when the list is empty. */
+	int32 Pop();
+
+	int32 Num() const { return NumFree.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr uint32 EmptyIndex = MAX_uint32;
+
+	static uint64 MakeHead(uint32 Tag, uint32 Index) { return (uint64(Tag) << 32) | Index; }
+	static uint32 GetTag(uint64 Head) { return uint32(Head >> 32); }
+	static uint32 GetIndex(uint64 Head) { return uint32(Head); }
+
+	std::atomic<uint64> Head{ MakeHead(0, EmptyIndex) };
+	std::atomic<int32> NumFree{ 0 };
+	TUniquePtr<std::atomic<uint32>[]> Next;
+};
+
+/**
+ * Fixed-capacity particle storage for the stream. Slots never move: a dead particle's slot goes onto the free list and
+ * is refilled in place by the next spawn, so there is no compaction pass, memory use is constant, and renderers that
+ * address particles by slot (see UFlowStreamComponent) keep a stable layout.
+ *
+ * Kill() may be called concurrently from the simulation's worker tasks, as long as each slot is killed by one thread.
+ */
+class PARTICLEFLOWMAP_API FFlowParticlePool
+{
+public:
+	~FFlowParticlePool();
+
+	void Initialize(int32 InCapacity);
+
+	int32 GetCapacity() const { return Capacity; }
+	int32 GetNumAlive() const { return Capacity - FreeList.Num(); }
+	bool IsAlive(int32 Index) const { return Alive[Index] != 0; }
+
+	/** Claims a free slot and marks it alive; the caller fills in its attributes. Returns INDEX_NONE when full. */
+	int32 Spawn();
+	void Kill(int32 Index);
+
+	/** Position in the river's map UV space. */
+	TArray<FVector2f> Position;
+	TArray<FVector2f> Velocity;
+	/** World height above the river component, sampled from the height map. */
+	TArray<float> Height;
+	TArray<float> Age;
+	TArray<float> Lifetime;
+	TArray<uint8> Alive;
+	/** Bumped every time the slot is reused, so per-slot side data (e.g. trails) can tell a new particle apart. */
+	TArray<uint32> Generation;
+
+private:
+	int32 Capacity = 0;
+	FFlowParticleFreeList FreeList;
+	int64 TrackedBytes = 0;
+};
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowRiverComponent.h"
+#include "FlowRiverSubsystem.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/World.h"
+
+UFlowRiverComponent::UFlowRiverComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UFlowRiverComponent::MarkMapsDirty()
+{
+	bMapsDirty = true;
+}
+
+UTextureRenderTarget2D* UFlowRiverComponent::GetMap(EFlowRiverMap Map) const
+{
+	switch (Map)
+	{
+	case EFlowRiverMap::Mask:
+		return MaskMap;
+	case EFlowRiverMap::Flow:
+		return FlowMap;
+	case EFlowRiverMap::JumpFlood:
+		return JumpFloodMap;
+	case EFlowRiverMap::Height:
+		return HeightMap;
+	default:
+		return nullptr;
+	}
+}
+
+FVector2f UFlowRiverComponent::WorldToMapUV(const FVector& WorldPosition) const
+{
+	const FVector Local = GetComponentTransform().InverseTransformPositionNoScale(WorldPosition);
+	return FVector2f(Local.X / Extent.X + 0.5, Local.Y / Extent.Y + 0.5);
+}
+
+FVector UFlowRiverComponent::MapUVToWorld(const FVector2f& UV, float Height) const
+{
+	const FVector Local((UV.X - 0.5) * Extent.X, (UV.Y - 0.5) * Extent.Y, Height);
+	return GetComponentTransform().TransformPositionNoScale(Local);
+}
+
+void UFlowRiverComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UFlowRiverSubsystem* Subsystem = UWorld::GetSubsystem<UFlowRiverSubsystem>(GetWorld()))
+	{
+		Subsystem->RegisterRiver(this);
+	}
+}
+
+void UFlowRiverComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFlowRiverSubsystem* Subsystem = UWorld::GetSubsystem<UFlowRiverSubsystem>(GetWorld()))
+	{
+		Subsystem->UnregisterRiver(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
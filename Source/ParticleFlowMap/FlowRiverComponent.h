@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "FlowRiverComponent.generated.h"
+
+class UNiagaraComponent;
+class UTextureRenderTarget2D;
+
+UENUM(BlueprintType)
+enum class EFlowRiverMap : uint8
+{
+	Mask,
+	Flow,
+	JumpFlood,
+	Height,
+	Num UMETA(Hidden)
+};
+
+/**
+ * Describes one river (BP_Stream) to the rest of the flow simulation: where its maps live in the world and which
+ * render targets hold them. Rivers register with UFlowRiverSubsystem, which packs them into shared texture arrays so
+ * a single batched emitter can simulate every river in the level.
+ *
+ * The component's location is the centre of the mapped area and its yaw rotates the map; Extent is the world size
+ * covered by the maps.
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowRiverComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowRiverComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UTextureRenderTarget2D> MaskMap;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UTextureRenderTarget2D> FlowMap;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UTextureRenderTarget2D> JumpFloodMap;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UTextureRenderTarget2D> HeightMap;
+
+	/** World size covered by the maps. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FVector2D Extent = FVector2D(5000.0, 5000.0);
+
+	/** World units of height per unit stored in HeightMap. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	float HeightScale = 1000.0f;
+
+	/** Share of the batched emitter's spawn budget given to this river. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	float SpawnWeight = 1.0f;
+
+	/** Simulate through the level's batched emitter and deactivate the owner's own Niagara components. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Batching")
+	bool bUseBatchedSimulation = false;
+
+	/** Keep re-copying the maps into the batch every frame, e.g. while painting. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Batching")
+	bool bMapsChangeEveryFrame = false;
+
+	/** Call after painting or re-baking so the batch picks up the new maps. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	void MarkMapsDirty();
+
+	/** Slot in the batched texture arrays, or INDEX_NONE when not batched. */
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	int32 GetRiverIndex() const { return RiverIndex; }
+
+	UTextureRenderTarget2D* GetMap(EFlowRiverMap Map) const;
+
+	/** Maps a world position to the river's [0,1] map UV. */
+	FVector2f WorldToMapUV(const FVector& WorldPosition) const;
+	FVector MapUVToWorld(const FVector2f& UV, float Height = 0.0f) const;
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	friend class UFlowRiverSubsystem;
+
+	int32 RiverIndex = INDEX_NONE;
+	bool bMapsDirty = true;
+};
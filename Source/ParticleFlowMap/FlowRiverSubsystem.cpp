@@ -0,0 +1,337 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowRiverSubsystem.h"
+#include "ParticleFlowMap.h"
+#include "FlowMapStats.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/TextureRenderTarget2DArray.h"
+#include "GameFramework/Actor.h"
+#include "NiagaraComponent.h"
+#include "NiagaraDataInterfaceArrayFunctionLibrary.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+
+namespace FlowRiverSubsystem
+{
+	static const FName MapArrayParameters[] =
+	{
+		TEXT("RiverMaskMaps"),
+		TEXT("RiverFlowMaps"),
+		TEXT("RiverJumpFloodMaps"),
+		TEXT("RiverHeightMaps"),
+	};
+	static_assert(UE_ARRAY_COUNT(MapArrayParameters) == int32(EFlowRiverMap::Num), "One Niagara parameter per river map");
+
+	static const FName TransformsParameter(TEXT("RiverTransforms"));
+	static const FName ParamsParameter(TEXT("RiverParams"));
+	static const FName CountParameter(TEXT("RiverCount"));
+
+	struct FMapCopy
+	{
+		FTextureRenderTargetResource* Source = nullptr;
+		FTextureResource* Dest = nullptr;
+		int32 Slice = 0;
+		FIntPoint Size = FIntPoint::ZeroValue;
+	};
+}
+
+void UFlowRiverSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	MapArrays.SetNum(int32(EFlowRiverMap::Num));
+}
+
+void UFlowRiverSubsystem::Deinitialize()
+{
+	Rivers.Reset();
+	Obstacles.Reset();
+	MapArrays.Reset();
+	BatchedSystem.Reset();
+
+	Super::Deinitialize();
+}
+
+TStatId UFlowRiverSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFlowRiverSubsystem, STATGROUP_Tickables);
+}
+
+void UFlowRiverSubsystem::RegisterRiver(UFlowRiverComponent* River)
+{
+	if (!River || River->RiverIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	// Reuse the lowest free slot so indices stay small and stable for the rivers that remain.
+	int32 Slot = Rivers.IndexOfByPredicate([](const TWeakObjectPtr<UFlowRiverComponent>& Entry) { return !Entry.IsValid(); });
+	if (Slot == INDEX_NONE)
+	{
+		if (Rivers.Num() >= MaxBatchedRivers)
+		{
+			UE_LOG(LogParticleFlowMap, Warning, TEXT("More than %d rivers in the level, %s will not be batched"), MaxBatchedRivers, *GetNameSafe(River->GetOwner()));
+			return;
+		}
+		Slot = Rivers.Add(nullptr);
+	}
+
+	Rivers[Slot] = River;
+	River->RiverIndex = Slot;
+	River->bMapsDirty = true;
+
+	if (BatchedSystem.IsValid())
+	{
+		DeactivateRiverSystems(River);
+	}
+}
+
+void UFlowRiverSubsystem::UnregisterRiver(UFlowRiverComponent* River)
+{
+	if (!River || !Rivers.IsValidIndex(River->RiverIndex) || Rivers[River->RiverIndex] != River)
+	{
+		return;
+	}
+
+	Rivers[River->RiverIndex].Reset();
+	River->RiverIndex = INDEX_NONE;
+
+	while (Rivers.Num() > 0 && !Rivers.Last().IsValid())
+	{
+		Rivers.Pop(EAllowShrinking::No);
+	}
+}
+
+void UFlowRiverSubsystem::RegisterObstacle(UFlowObstacleComponent* Obstacle)
+{
+	if (Obstacle)
+	{
+		Obstacles.AddUnique(Obstacle);
+	}
+}
+
+void UFlowRiverSubsystem::UnregisterObstacle(UFlowObstacleComponent* Obstacle)
+{
+	Obstacles.RemoveAllSwap([Obstacle](const TWeakObjectPtr<UFlowObstacleComponent>& Entry) { return !Entry.IsValid() || Entry == Obstacle; });
+}
+
+void UFlowRiverSubsystem::BindBatchedSystem(UNiagaraComponent* NiagaraComponent)
+{
+	BatchedSystem = NiagaraComponent;
+	if (!NiagaraComponent)
+	{
+		return;
+	}
+
+	for (const TWeakObjectPtr<UFlowRiverComponent>& River : Rivers)
+	{
+		if (River.IsValid())
+		{
+			DeactivateRiverSystems(River.Get());
+		}
+	}
+
+	// Arrays may already exist; make sure the new system sees them and the current river table right away.
+	for (int32 MapIndex = 0; MapIndex < MapArrays.Num(); ++MapIndex)
+	{
+		NiagaraComponent->SetVariableTextureRenderTarget(FlowRiverSubsystem::MapArrayParameters[MapIndex], MapArrays[MapIndex]);
+	}
+	PushParameters();
+}
+
+void UFlowRiverSubsystem::DeactivateRiverSystems(UFlowRiverComponent* River) const
+{
+	AActor* Owner = River->GetOwner();
+	if (!River->bUseBatchedSimulation || !Owner)
+	{
+		return;
+	}
+
+	TInlineComponentArray<UNiagaraComponent*> NiagaraComponents(Owner);
+	for (UNiagaraComponent* NiagaraComponent : NiagaraComponents)
+	{
+		if (NiagaraComponent != BatchedSystem.Get())
+		{
+			NiagaraComponent->Deactivate();
+		}
+	}
+}
+
+UTextureRenderTarget2DArray* UFlowRiverSubsystem::GetMapArray(EFlowRiverMap Map) const
+{
+	return MapArrays.IsValidIndex(int32(Map)) ? MapArrays[int32(Map)] : nullptr;
+}
+
+void UFlowRiverSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Rivers.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 MapIndex = 0; MapIndex < int32(EFlowRiverMap::Num); ++MapIndex)
+	{
+		if (UpdateMapArray(EFlowRiverMap(MapIndex)))
+		{
+			for (const TWeakObjectPtr<UFlowRiverComponent>& River : Rivers)
+			{
+				if (River.IsValid())
+				{
+					River->bMapsDirty = true;
+				}
+			}
+		}
+	}
+
+	CopyDirtyMaps();
+	PushParameters();
+}
+
+bool UFlowRiverSubsystem::UpdateMapArray(EFlowRiverMap Map)
+{
+	// Every river shares the array's size and format; the first river that has the map decides them.
+	UTextureRenderTarget2D* Reference = nullptr;
+	for (const TWeakObjectPtr<UFlowRiverComponent>& River : Rivers)
+	{
+		if (River.IsValid() && (Reference = River->GetMap(Map)) != nullptr)
+		{
+			break;
+		}
+	}
+	if (!Reference)
+	{
+		return false;
+	}
+
+	const int32 Slices = int32(FMath::Min(FMath::RoundUpToPowerOfTwo(uint32(FMath::Max(Rivers.Num(), 4))), uint32(MaxBatchedRivers)));
+	TObjectPtr<UTextureRenderTarget2DArray>& Array = MapArrays[int32(Map)];
+	if (Array && Array->SizeX == Reference->SizeX && Array->SizeY == Reference->SizeY && Array->Slices >= Rivers.Num()
+		&& Array->GetFormat() == Reference->GetFormat())
+	{
+		return false;
+	}
+
+	Array = NewObject<UTextureRenderTarget2DArray>(this, NAME_None, RF_Transient);
+	Array->ClearColor = Reference->ClearColor;
+	Array->AddressX = Reference->AddressX;
+	Array->AddressY = Reference->AddressY;
+	Array->Init(Reference->SizeX, Reference->SizeY, Slices, Reference->GetFormat());
+	Array->UpdateResourceImmediate(true);
+
+	if (UNiagaraComponent* NiagaraComponent = BatchedSystem.Get())
+	{
+		NiagaraComponent->SetVariableTextureRenderTarget(FlowRiverSubsystem::MapArrayParameters[int32(Map)], Array);
+	}
+	return true;
+}
+
+void UFlowRiverSubsystem::CopyDirtyMaps()
+{
+	using namespace FlowRiverSubsystem;
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_MapCopy, EFlowMapTimer::MapCopy);
+
+	TArray<FMapCopy> Copies;
+	for (const TWeakObjectPtr<UFlowRiverComponent>& RiverPtr : Rivers)
+	{
+		UFlowRiverComponent* River = RiverPtr.Get();
+		if (!River || !River->bMapsDirty)
+		{
+			continue;
+		}
+
+		for (int32 MapIndex = 0; MapIndex < int32(EFlowRiverMap::Num); ++MapIndex)
+		{
+			UTextureRenderTarget2D* Source = River->GetMap(EFlowRiverMap(MapIndex));
+			UTextureRenderTarget2DArray* Dest = MapArrays[MapIndex];
+			if (!Source || !Dest)
+			{
+				continue;
+			}
+
+			if (Source->SizeX != Dest->SizeX || Source->SizeY != Dest->SizeY || Source->GetFormat() != Dest->GetFormat())
+			{
+				UE_LOG(LogParticleFlowMap, Warning, TEXT("%s does not match the size or format of the other rivers' maps and is skipped"), *Source->GetName());
+				continue;
+			}
+
+			FMapCopy& Copy = Copies.AddDefaulted_GetRef();
+			Copy.Source = Source->GameThread_GetRenderTargetResource();
+			Copy.Dest = Dest->GetResource();
+			Copy.Slice = River->RiverIndex;
+			Copy.Size = FIntPoint(Source->SizeX, Source->SizeY);
+		}
+
+		River->bMapsDirty = River->bMapsChangeEveryFrame;
+	}
+
+	if (Copies.Num() == 0)
+	{
+		return;
+	}
+
+	ENQUEUE_RENDER_COMMAND(CopyRiverMapsToBatch)(
+		[Copies = MoveTemp(Copies)](FRHICommandListImmediate& RHICmdList)
+		{
+			SCOPED_DRAW_EVENT(RHICmdList, FlowMapRiverCopy);
+			SCOPED_GPU_STAT(RHICmdList, FlowMapRiverCopy);
+
+			for (const FMapCopy& Copy : Copies)
+			{
+				FRHITexture* Source = Copy.Source ? Copy.Source->GetRenderTargetTexture() : nullptr;
+				FRHITexture* Dest = Copy.Dest ? Copy.Dest->TextureRHI.GetReference() : nullptr;
+				if (!Source || !Dest)
+				{
+					continue;
+				}
+
+				FRHICopyTextureInfo CopyInfo;
+				CopyInfo.Size = FIntVector(Copy.Size.X, Copy.Size.Y, 1);
+				CopyInfo.DestSliceIndex = Copy.Slice;
+				CopyInfo.NumSlices = 1;
+
+				RHICmdList.Transition({
+					FRHITransitionInfo(Source, ERHIAccess::SRVMask, ERHIAccess::CopySrc),
+					FRHITransitionInfo(Dest, ERHIAccess::SRVMask, ERHIAccess::CopyDest) });
+				RHICmdList.CopyTexture(Source, Dest, CopyInfo);
+				RHICmdList.Transition({
+					FRHITransitionInfo(Source, ERHIAccess::CopySrc, ERHIAccess::SRVMask),
+					FRHITransitionInfo(Dest, ERHIAccess::CopyDest, ERHIAccess::SRVMask) });
+			}
+		});
+}
+
+void UFlowRiverSubsystem::PushParameters()
+{
+	using namespace FlowRiverSubsystem;
+
+	UNiagaraComponent* NiagaraComponent = BatchedSystem.Get();
+	if (!NiagaraComponent)
+	{
+		return;
+	}
+
+	TArray<FVector4> Transforms;
+	TArray<FVector4> Params;
+	Transforms.SetNumZeroed(Rivers.Num());
+	Params.SetNumZeroed(Rivers.Num());
+	for (int32 Slot = 0; Slot < Rivers.Num(); ++Slot)
+	{
+		if (const UFlowRiverComponent* River = Rivers[Slot].Get())
+		{
+			const FVector Location = River->GetComponentLocation();
+			const double Yaw = FMath::DegreesToRadians(River->GetComponentRotation().Yaw);
+			Transforms[Slot] = FVector4(Location.X, Location.Y, Location.Z, Yaw);
+
+			const float SpawnWeight = River->bUseBatchedSimulation ? River->SpawnWeight : 0.0f;
+			Params[Slot] = FVector4(River->Extent.X, River->Extent.Y, River->HeightScale, SpawnWeight);
+		}
+	}
+
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector4(NiagaraComponent, TransformsParameter, Transforms);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector4(NiagaraComponent, ParamsParameter, Params);
+	NiagaraComponent->SetVariableInt(CountParameter, Rivers.Num());
+}
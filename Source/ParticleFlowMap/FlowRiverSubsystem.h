@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlowRiverComponent.h"
+#include "FlowRiverSubsystem.generated.h"
+
+class UFlowObstacleComponent;
+class UNiagaraComponent;
+class UTextureRenderTarget2DArray;
+
+/**
+ * Registry of every river in the world. Each river gets a stable slot, and its maps are copied into one texture array
+ * per map kind, so a single batched emitter can sample any river by index instead of running one NS_ParticleStream
+ * (with its own samplers and dispatch) per BP_Stream.
+ *
+ * The batched Niagara system reads these user parameters:
+ *	RiverMaskMaps, RiverFlowMaps, RiverJumpFloodMaps, RiverHeightMaps	(Render Target 2D Array)
+ *	RiverTransforms	(Vector4 array)	location xyz, yaw in radians
+ *	RiverParams		(Vector4 array)	extent xy, height scale, spawn weight (0 for free slots)
+ *	RiverCount		(int)
+ * Particles carry their river's slot in a RiverIndex attribute and use it as the array slice.
+ */
+UCLASS()
+class PARTICLEFLOWMAP_API UFlowRiverSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Upper bound on array slices; GPUs and memory on Quest allow far more, but a level never needs them. */
+	static constexpr int32 MaxBatchedRivers = 32;
+
+	void RegisterRiver(UFlowRiverComponent* River);
+	void UnregisterRiver(UFlowRiverComponent* River);
+
+	/** Makes NiagaraComponent the level's batched emitter and hands it every batched river. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	void BindBatchedSystem(UNiagaraComponent* NiagaraComponent);
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	UTextureRenderTarget2DArray* GetMapArray(EFlowRiverMap Map) const;
+
+	/** Number of slots in use, including free slots below the highest registered river. */
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	int32 GetNumRiverSlots() const { return Rivers.Num(); }
+
+	UFlowRiverComponent* GetRiver(int32 RiverIndex) const { return Rivers.IsValidIndex(RiverIndex) ? Rivers[RiverIndex].Get() : nullptr; }
+
+	/** Dynamic obstacles every stream in the world reacts to. */
+	void RegisterObstacle(UFlowObstacleComponent* Obstacle);
+	void UnregisterObstacle(UFlowObstacleComponent* Obstacle);
+	const TArray<TWeakObjectPtr<UFlowObstacleComponent>>& GetObstacles() const { return Obstacles; }
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	bool UpdateMapArray(EFlowRiverMap Map);
+	void CopyDirtyMaps();
+	void PushParameters();
+	void DeactivateRiverSystems(UFlowRiverComponent* River) const;
+
+	TArray<TWeakObjectPtr<UFlowRiverComponent>> Rivers;
+	TArray<TWeakObjectPtr<UFlowObstacleComponent>> Obstacles;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UTextureRenderTarget2DArray>> MapArrays;
+
+	TWeakObjectPtr<UNiagaraComponent> BatchedSystem;
+};
@@ -0,0 +1,477 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowShallowWaterSolver.h"
+
+#if WITH_EDITOR
+
+#include "ParticleFlowMap.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+
+namespace FlowShallowWater
+{
+	static constexpr float WorldUnitsPerMetre = 100.0f;
+
+	/** Faces always conduct as if this deep (metres), so a drained texel can still fill up again. */
+	static constexpr float MinFaceDepth = 1.0e-3f;
+
+	/** Depth (metres) below which the velocity is computed as if this deep, so thin films near the banks stay finite. */
+	static constexpr float MinVelocityDepth = 0.01f;
+
+	static constexpr float ManningExponent = 5.0f / 3.0f;
+
+	/** One resolution of the solve. Texel arrays are row-major; Cx[I] is the face to the right of texel I, Cy[I] the one below. */
+	struct FLevel
+	{
+		int32 Width = 0;
+		int32 Height = 0;
+		/** Texel size in metres. */
+		float CellX = 1.0f;
+		float CellY = 1.0f;
+
+		TArray<float> Bed;
+		/** 1 for river texels, 0 elsewhere; float so the conductance pass can multiply it in. */
+		TArray<float> Wet;
+		/** Source discharge per texel, cubic metres per second. */
+		TArray<float> Inflow;
+		/** Texels whose surface is held at the bed: sinks and open edges. */
+		TArray<uint8> Fixed;
+		/** Water surface elevation, metres. */
+		TArray<float> Surface;
+		TArray<float> Cx;
+		TArray<float> Cy;
+
+		void Init(int32 InWidth, int32 InHeight)
+		{
+			Width = InWidth;
+			Height = InHeight;
+			const int32 Num = Width * Height;
+			Bed.SetNumZeroed(Num);
+			Wet.SetNumZeroed(Num);
+			Inflow.SetNumZeroed(Num);
+			Fixed.SetNumZeroed(Num);
+			Surface.SetNumZeroed(Num);
+			Cx.SetNumZeroed(Num);
+			Cy.SetNumZeroed(Num);
+		}
+	};
+
+	static float GetFaceConductance(float SurfaceA, float SurfaceB, float BedA, float BedB, float Wet, float FaceScale, float InvCell, float MinSlope)
+	{
+		const float Depth = FMath::Max(FMath::Max(SurfaceA, SurfaceB) - FMath::Max(BedA, BedB), MinFaceDepth);
+		const float Slope = FMath::Max(FMath::Abs(SurfaceA - SurfaceB) * InvCell, MinSlope);
+		return Wet * FaceScale * FMath::Pow(Depth, ManningExponent) * FMath::InvSqrt(Slope);
+	}
+
+	/**
+	 * Manning discharge through a face is (1/n) h^5/3 S^-1/2 * dEta / Cell * FaceWidth, with h the upwind depth over the
+	 * higher bed and S the surface slope; the conductance is everything but dEta. Four faces at a time per row.
+	 */
+	static void UpdateConductances(FLevel& Level, const FFlowShallowWaterSettings& Settings)
+	{
+		const int32 Width = Level.Width;
+		const int32 Height = Level.Height;
+		const float FaceScaleX = Level.CellY / (Level.CellX * Settings.Roughness);
+		const float FaceScaleY = Level.CellX / (Level.CellY * Settings.Roughness);
+		const float InvCellX = 1.0f / Level.CellX;
+		const float InvCellY = 1.0f / Level.CellY;
+
+		ParallelFor(Height, [&Level, &Settings, Width, Height, FaceScaleX, FaceScaleY, InvCellX, InvCellY](int32 Y)
+		{
+			const float* Surface = Level.Surface.GetData();
+			const float* Bed = Level.Bed.GetData();
+			const float* Wet = Level.Wet.GetData();
+			float* Cx = Level.Cx.GetData();
+			float* Cy = Level.Cy.GetData();
+			const int32 Row = Y * Width;
+
+			const VectorRegister4Float MinDepth = VectorSetFloat1(MinFaceDepth);
+			const VectorRegister4Float MinSlope = VectorSetFloat1(Settings.MinSlope);
+			const VectorRegister4Float Exponent = VectorSetFloat1(ManningExponent);
+
+			auto FaceVector = [&](int32 A, int32 B, const VectorRegister4Float& FaceScale, const VectorRegister4Float& InvCell)
+			{
+				const VectorRegister4Float SurfaceA = VectorLoad(Surface + A);
+				const VectorRegister4Float SurfaceB = VectorLoad(Surface + B);
+				const VectorRegister4Float Depth = VectorMax(VectorSubtract(VectorMax(SurfaceA, SurfaceB), VectorMax(VectorLoad(Bed + A), VectorLoad(Bed + B))), MinDepth);
+				const VectorRegister4Float Slope = VectorMax(VectorMultiply(VectorAbs(VectorSubtract(SurfaceA, SurfaceB)), InvCell), MinSlope);
+				const VectorRegister4Float Both = VectorMultiply(VectorLoad(Wet + A), VectorLoad(Wet + B));
+				return VectorMultiply(VectorMultiply(FaceScale, Both), VectorMultiply(VectorPow(Depth, Exponent), VectorReciprocalSqrt(Slope)));
+			};
+
+			// Horizontal faces: texel X and X + 1; the last column has none.
+			const VectorRegister4Float ScaleX = VectorSetFloat1(FaceScaleX);
+			const VectorRegister4Float InvX = VectorSetFloat1(InvCellX);
+			int32 X = 0;
+			for (; X + 4 < Width; X += 4)
+			{
+				VectorStore(FaceVector(Row + X, Row + X + 1, ScaleX, InvX), Cx + Row + X);
+			}
+			for (; X < Width - 1; ++X)
+			{
+				const int32 A = Row + X;
+				Cx[A] = GetFaceConductance(Surface[A], Surface[A + 1], Bed[A], Bed[A + 1], Wet[A] * Wet[A + 1], FaceScaleX, InvCellX, Settings.MinSlope);
+			}
+			Cx[Row + Width - 1] = 0.0f;
+
+			// Vertical faces: row Y and Y + 1; the last row has none.
+			if (Y == Height - 1)
+			{
+				FMemory::Memzero(Cy + Row, Width * sizeof(float));
+				return;
+			}
+
+			const VectorRegister4Float ScaleY = VectorSetFloat1(FaceScaleY);
+			const VectorRegister4Float InvY = VectorSetFloat1(InvCellY);
+			X = 0;
+			for (; X + 4 <= Width; X += 4)
+			{
+				VectorStore(FaceVector(Row + X, Row + X + Width, ScaleY, InvY), Cy + Row + X);
+			}
+			for (; X < Width; ++X)
+			{
+				const int32 A = Row + X;
+				Cy[A] = GetFaceConductance(Surface[A], Surface[A + Width], Bed[A], Bed[A + Width], Wet[A] * Wet[A + Width], FaceScaleY, InvCellY, Settings.MinSlope);
+			}
+		});
+	}
+
+	/**
+	 * One Gauss-Seidel pass over the tiles of one colour of a checkerboard. The stencil only reaches the four edge
+	 * neighbours, which lie in tiles of the other colour, so all tiles of a colour can be relaxed in place concurrently.
+	 */
+	static void SweepTiles(FLevel& Level, const FFlowShallowWaterSettings& Settings, int32 Color, TArray<float>& TileChange)
+	{
+		const int32 TileSize = Settings.TileSize;
+		const int32 TilesX = FMath::DivideAndRoundUp(Level.Width, TileSize);
+		const int32 TilesY = FMath::DivideAndRoundUp(Level.Height, TileSize);
+
+		ParallelFor(TilesX * TilesY, [&Level, &Settings, &TileChange, TileSize, TilesX, Color](int32 Tile)
+		{
+			const int32 TileX = Tile % TilesX;
+			const int32 TileY = Tile / TilesX;
+			if (((TileX + TileY) & 1) != Color)
+			{
+				return;
+			}
+
+			const int32 Width = Level.Width;
+			float* Surface = Level.Surface.GetData();
+			float MaxChange = TileChange[Tile];
+
+			const int32 MaxY = FMath::Min((TileY + 1) * TileSize, Level.Height);
+			const int32 MaxX = FMath::Min((TileX + 1) * TileSize, Width);
+			for (int32 Y = TileY * TileSize; Y < MaxY; ++Y)
+			{
+				for (int32 X = TileX * TileSize; X < MaxX; ++X)
+				{
+					const int32 Index = Y * Width + X;
+					if (Level.Wet[Index] == 0.0f || Level.Fixed[Index])
+					{
+						continue;
+					}
+
+					const float Left = X > 0 ? Level.Cx[Index - 1] : 0.0f;
+					const float Right = Level.Cx[Index];
+					const float Up = Y > 0 ? Level.Cy[Index - Width] : 0.0f;
+					const float Down = Level.Cy[Index];
+					const float Sum = Left + Right + Up + Down;
+					if (Sum <= UE_SMALL_NUMBER)
+					{
+						continue;
+					}
+
+					float Balance = Level.Inflow[Index];
+					Balance += Left > 0.0f ? Left * Surface[Index - 1] : 0.0f;
+					Balance += Right > 0.0f ? Right * Surface[Index + 1] : 0.0f;
+					Balance += Up > 0.0f ? Up * Surface[Index - Width] : 0.0f;
+					Balance += Down > 0.0f ? Down * Surface[Index + Width] : 0.0f;
+
+					const float Current = Surface[Index];
+					const float Relaxed = FMath::Max(Current + Settings.Relaxation * (Balance / Sum - Current), Level.Bed[Index]);
+					MaxChange = FMath::Max(MaxChange, FMath::Abs(Relaxed - Current));
+					Surface[Index] = Relaxed;
+				}
+			}
+			TileChange[Tile] = MaxChange;
+		});
+	}
+
+	/** Runs iterations until the surface settles; returns the iterations taken. */
+	static int32 Relax(FLevel& Level, const FFlowShallowWaterSettings& Settings, bool& bOutConverged, float& OutChange)
+	{
+		const int32 NumTiles = FMath::DivideAndRoundUp(Level.Width, Settings.TileSize) * FMath::DivideAndRoundUp(Level.Height, Settings.TileSize);
+		TArray<float> TileChange;
+
+		bOutConverged = false;
+		OutChange = 0.0f;
+		int32 Iteration = 0;
+		while (Iteration < Settings.MaxIterations && !bOutConverged)
+		{
+			++Iteration;
+			UpdateConductances(Level, Settings);
+
+			TileChange.Init(0.0f, NumTiles);
+			for (int32 Sweep = 0; Sweep < Settings.SweepsPerIteration; ++Sweep)
+			{
+				SweepTiles(Level, Settings, 0, TileChange);
+				SweepTiles(Level, Settings, 1, TileChange);
+			}
+
+			OutChange = 0.0f;
+			for (float Change : TileChange)
+			{
+				OutChange = FMath::Max(OutChange, Change);
+			}
+			bOutConverged = OutChange <= Settings.Tolerance;
+		}
+		return Iteration;
+	}
+
+	static void BuildFinestLevel(const FFlowScalarField& Mask, const FFlowScalarField& Height, const FVector2f& Extent, float HeightScale,
+		TConstArrayView<FFlowWaterSource> Sources, const FFlowShallowWaterSettings& Settings, FLevel& Level)
+	{
+		Level.Init(Mask.Width, Mask.Height);
+		Level.CellX = Extent.X / (Mask.Width * WorldUnitsPerMetre);
+		Level.CellY = Extent.Y / (Mask.Height * WorldUnitsPerMetre);
+
+		const bool bHasHeight = Height.IsValid();
+		for (int32 Y = 0; Y < Mask.Height; ++Y)
+		{
+			for (int32 X = 0; X < Mask.Width; ++X)
+			{
+				const int32 Index = Mask.Index(X, Y);
+				const FVector2f UV((X + 0.5f) / Mask.Width, (Y + 0.5f) / Mask.Height);
+				Level.Bed[Index] = bHasHeight ? Height.SampleBilinear(UV) * HeightScale / WorldUnitsPerMetre : 0.0f;
+				Level.Wet[Index] = Mask.Texels[Index] >= Settings.MaskThreshold ? 1.0f : 0.0f;
+
+				const bool bEdge = X == 0 || Y == 0 || X == Mask.Width - 1 || Y == Mask.Height - 1;
+				Level.Fixed[Index] = Settings.bOpenEdges && bEdge && Level.Wet[Index] != 0.0f;
+			}
+		}
+
+		// Spread each source over the river texels of its disc; one that misses the river entirely is reported.
+		TArray<int32> DiscTexels;
+		for (const FFlowWaterSource& Source : Sources)
+		{
+			const FVector2f Centre(float(Source.Position.X) * Mask.Width, float(Source.Position.Y) * Mask.Height);
+			const FVector2f Radius(FMath::Max(Source.Radius * Mask.Width / Extent.X, 0.5f), FMath::Max(Source.Radius * Mask.Height / Extent.Y, 0.5f));
+
+			DiscTexels.Reset();
+			const int32 MinX = FMath::Max(FMath::FloorToInt32(Centre.X - Radius.X), 0);
+			const int32 MaxX = FMath::Min(FMath::CeilToInt32(Centre.X + Radius.X), Mask.Width - 1);
+			const int32 MinY = FMath::Max(FMath::FloorToInt32(Centre.Y - Radius.Y), 0);
+			const int32 MaxY = FMath::Min(FMath::CeilToInt32(Centre.Y + Radius.Y), Mask.Height - 1);
+			for (int32 Y = MinY; Y <= MaxY; ++Y)
+			{
+				for (int32 X = MinX; X <= MaxX; ++X)
+				{
+					const FVector2f Offset = (FVector2f(X + 0.5f, Y + 0.5f) - Centre) / Radius;
+					if (Offset.SizeSquared() <= 1.0f && Level.Wet[Mask.Index(X, Y)] != 0.0f)
+					{
+						DiscTexels.Add(Mask.Index(X, Y));
+					}
+				}
+			}
+
+			if (DiscTexels.Num() == 0)
+			{
+				UE_LOG(LogParticleFlowMap, Warning, TEXT("Shallow water %s at (%.3f, %.3f) does not touch the river mask and is ignored"),
+					Source.Type == EFlowWaterSourceType::Sink ? TEXT("sink") : TEXT("source"), Source.Position.X, Source.Position.Y);
+				continue;
+			}
+
+			for (int32 Index : DiscTexels)
+			{
+				if (Source.Type == EFlowWaterSourceType::Sink)
+				{
+					Level.Fixed[Index] = 1;
+				}
+				else
+				{
+					Level.Inflow[Index] += Source.Discharge / DiscTexels.Num();
+				}
+			}
+		}
+	}
+
+	/** Half resolution: a coarse texel is river if any of its children is, so narrow channels stay connected. */
+	static void Downsample(const FLevel& Fine, FLevel& Coarse)
+	{
+		Coarse.Init(FMath::DivideAndRoundUp(Fine.Width, 2), FMath::DivideAndRoundUp(Fine.Height, 2));
+		Coarse.CellX = Fine.CellX * 2.0f;
+		Coarse.CellY = Fine.CellY * 2.0f;
+
+		for (int32 Y = 0; Y < Coarse.Height; ++Y)
+		{
+			for (int32 X = 0; X < Coarse.Width; ++X)
+			{
+				const int32 Index = Y * Coarse.Width + X;
+				float WetBed = 0.0f;
+				float AnyBed = 0.0f;
+				int32 NumWet = 0;
+				int32 NumChildren = 0;
+				for (int32 ChildY = Y * 2; ChildY < FMath::Min(Y * 2 + 2, Fine.Height); ++ChildY)
+				{
+					for (int32 ChildX = X * 2; ChildX < FMath::Min(X * 2 + 2, Fine.Width); ++ChildX)
+					{
+						const int32 Child = ChildY * Fine.Width + ChildX;
+						++NumChildren;
+						AnyBed += Fine.Bed[Child];
+						if (Fine.Wet[Child] != 0.0f)
+						{
+							++NumWet;
+							WetBed += Fine.Bed[Child];
+							Coarse.Inflow[Index] += Fine.Inflow[Child];
+							Coarse.Fixed[Index] |= Fine.Fixed[Child];
+						}
+					}
+				}
+
+				Coarse.Wet[Index] = NumWet > 0 ? 1.0f : 0.0f;
+				Coarse.Bed[Index] = NumWet > 0 ? WetBed / NumWet : AnyBed / NumChildren;
+			}
+		}
+	}
+
+	static void InitSurface(FLevel& Level, float InitialDepth)
+	{
+		for (int32 Index = 0; Index < Level.Surface.Num(); ++Index)
+		{
+			const bool bFilled = Level.Wet[Index] != 0.0f && !Level.Fixed[Index];
+			Level.Surface[Index] = Level.Bed[Index] + (bFilled ? InitialDepth : 0.0f);
+		}
+	}
+
+	/** Seeds the finer level with the coarse depths, laid over its own bed. */
+	static void Upsample(const FLevel& Coarse, FLevel& Fine, float InitialDepth)
+	{
+		ParallelFor(Fine.Height, [&Coarse, &Fine, InitialDepth](int32 Y)
+		{
+			for (int32 X = 0; X < Fine.Width; ++X)
+			{
+				const int32 Index = Y * Fine.Width + X;
+				const int32 Parent = (Y / 2) * Coarse.Width + X / 2;
+				const bool bFilled = Fine.Wet[Index] != 0.0f && !Fine.Fixed[Index];
+				const float Depth = FMath::Max(Coarse.Surface[Parent] - Coarse.Bed[Parent], InitialDepth);
+				Fine.Surface[Index] = Fine.Bed[Index] + (bFilled ? Depth : 0.0f);
+			}
+		});
+	}
+
+	/** Depth-averaged velocity from the mean discharge through each texel's opposite faces. */
+	static float WriteResult(const FLevel& Level, const FFlowShallowWaterSettings& Settings, FFlowShallowWaterResult& OutResult)
+	{
+		const int32 Width = Level.Width;
+		OutResult.Flow.Init(Width, Level.Height, FVector2f::ZeroVector);
+		OutResult.Depth.Init(Width, Level.Height, 0.0f);
+
+		TArray<float> RowMaxSpeed;
+		RowMaxSpeed.SetNumZeroed(Level.Height);
+		ParallelFor(Level.Height, [&Level, &Settings, &OutResult, &RowMaxSpeed, Width](int32 Y)
+		{
+			const float* Surface = Level.Surface.GetData();
+			for (int32 X = 0; X < Width; ++X)
+			{
+				const int32 Index = Y * Width + X;
+				if (Level.Wet[Index] == 0.0f)
+				{
+					continue;
+				}
+
+				const float InLeft = X > 0 ? Level.Cx[Index - 1] * (Surface[Index - 1] - Surface[Index]) : 0.0f;
+				const float OutRight = X < Width - 1 ? Level.Cx[Index] * (Surface[Index] - Surface[Index + 1]) : 0.0f;
+				const float InUp = Y > 0 ? Level.Cy[Index - Width] * (Surface[Index - Width] - Surface[Index]) : 0.0f;
+				const float OutDown = Y < Level.Height - 1 ? Level.Cy[Index] * (Surface[Index] - Surface[Index + Width]) : 0.0f;
+
+				const float Depth = FMath::Max(Surface[Index] - Level.Bed[Index], 0.0f);
+				const FVector2f Discharge(0.5f * (InLeft + OutRight) / Level.CellY, 0.5f * (InUp + OutDown) / Level.CellX);
+				const FVector2f Velocity = Discharge / FMath::Max(Depth, MinVelocityDepth) * WorldUnitsPerMetre;
+
+				OutResult.Depth.Texels[Index] = Depth;
+				OutResult.Flow.Texels[Index] = (Velocity / Settings.SpeedForFullFlow).GetClampedToMaxSize(1.0f);
+				RowMaxSpeed[Y] = FMath::Max(RowMaxSpeed[Y], Velocity.Size());
+			}
+		});
+
+		float MaxSpeed = 0.0f;
+		for (float Speed : RowMaxSpeed)
+		{
+			MaxSpeed = FMath::Max(MaxSpeed, Speed);
+		}
+		return MaxSpeed;
+	}
+}
+
+bool FFlowShallowWaterSolver::Solve(const FFlowScalarField& Mask, const FFlowScalarField& Height, const FVector2f& Extent, float HeightScale,
+	TConstArrayView<FFlowWaterSource> Sources, const FFlowShallowWaterSettings& Settings, FFlowShallowWaterResult& OutResult)
+{
+	using namespace FlowShallowWater;
+
+	OutResult = FFlowShallowWaterResult();
+	if (!Mask.IsValid() || Extent.X <= 0.0f || Extent.Y <= 0.0f || Settings.Roughness <= 0.0f || Settings.TileSize <= 0)
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<FLevel> Levels;
+	BuildFinestLevel(Mask, Height, Extent, HeightScale, Sources, Settings, Levels.AddDefaulted_GetRef());
+
+	// Water needs both somewhere to come from and somewhere to go, or there is no steady state.
+	float TotalInflow = 0.0f;
+	bool bHasOutflow = false;
+	for (int32 Index = 0; Index < Levels[0].Inflow.Num(); ++Index)
+	{
+		TotalInflow += Levels[0].Inflow[Index];
+		bHasOutflow |= Levels[0].Fixed[Index] != 0;
+	}
+	if (TotalInflow <= 0.0f || !bHasOutflow)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("Shallow water solve needs at least one source and one sink or open edge on the river mask"));
+		return false;
+	}
+
+	while (FMath::Min(Levels.Last().Width, Levels.Last().Height) >= Settings.CoarsestSize * 2)
+	{
+		FLevel Coarse;
+		Downsample(Levels.Last(), Coarse);
+		Levels.Add(MoveTemp(Coarse));
+	}
+
+	InitSurface(Levels.Last(), Settings.InitialDepth);
+	for (int32 LevelIndex = Levels.Num() - 1; LevelIndex >= 0; --LevelIndex)
+	{
+		FLevel& Level = Levels[LevelIndex];
+		if (LevelIndex < Levels.Num() - 1)
+		{
+			Upsample(Levels[LevelIndex + 1], Level, Settings.InitialDepth);
+		}
+
+		bool bConverged = false;
+		float Change = 0.0f;
+		const int32 Iterations = Relax(Level, Settings, bConverged, Change);
+		UE_LOG(LogParticleFlowMap, Verbose, TEXT("Shallow water level %dx%d: %d iterations, last change %.2e m%s"),
+			Level.Width, Level.Height, Iterations, Change, bConverged ? TEXT("") : TEXT(" (not converged)"));
+
+		if (LevelIndex == 0)
+		{
+			OutResult.Iterations = Iterations;
+			OutResult.bConverged = bConverged;
+			OutResult.FinalChange = Change;
+		}
+	}
+
+	// Faces for the final surface, so the velocities match it exactly.
+	UpdateConductances(Levels[0], Settings);
+	OutResult.MaxSpeed = WriteResult(Levels[0], Settings, OutResult);
+	OutResult.SolveSeconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogParticleFlowMap, Log, TEXT("Shallow water solve %dx%d: %d levels, %d iterations at full size%s, max speed %.0f, %.2fs"),
+		Mask.Width, Mask.Height, Levels.Num(), OutResult.Iterations, OutResult.bConverged ? TEXT("") : TEXT(" (not converged)"),
+		OutResult.MaxSpeed, OutResult.SolveSeconds);
+	return true;
+}
+
+#endif // WITH_EDITOR
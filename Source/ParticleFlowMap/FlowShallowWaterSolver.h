@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowField.h"
+#include "FlowShallowWaterSolver.generated.h"
+
+UENUM(BlueprintType)
+enum class EFlowWaterSourceType : uint8
+{
+	/** Adds Discharge over its disc. */
+	Source,
+	/** Free outflow: the surface is held at the bed, so whatever reaches the disc leaves the river. */
+	Sink,
+};
+
+USTRUCT(BlueprintType)
+struct PARTICLEFLOWMAP_API FFlowWaterSource
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	EFlowWaterSourceType Type = EFlowWaterSourceType::Source;
+
+	/** Centre in map UV. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FVector2D Position = FVector2D(0.5, 0.5);
+
+	/** World units. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	float Radius = 100.0f;
+
+	/** Cubic metres per second; ignored by sinks. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0", EditCondition = "Type == EFlowWaterSourceType::Source"))
+	float Discharge = 1.0f;
+};
+
+USTRUCT(BlueprintType)
+struct PARTICLEFLOWMAP_API FFlowShallowWaterSettings
+{
+	GENERATED_BODY()
+
+	/** Mask coverage from which a texel is part of the river. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0.01", ClampMax = "0.99"))
+	float MaskThreshold = 0.5f;
+
+	/** Manning roughness of the river bed (s/m^1/3): about 0.03 for a clean channel, 0.05 and up for rocky streams. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0.005"))
+	float Roughness = 0.035f;
+
+	/** Depth (metres) the river starts with everywhere, so the solve has somewhere to begin. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0.001"))
+	float InitialDepth = 0.05f;
+
+	/** Slope below which water is treated as this steep, keeping still pools well conditioned. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0.000001"))
+	float MinSlope = 1.0e-4f;
+
+	/** River texels on the map border drain freely, like a sink; for rivers that run off the map. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bOpenEdges = true;
+
+	/** Water speed (world units per second) written as a flow vector of length 1; match the stream's FlowSpeed. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "1"))
+	float SpeedForFullFlow = 300.0f;
+
+	/** Largest change of the water surface (metres) in one iteration at which the flow counts as steady. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Solver", meta = (ClampMin = "0"))
+	float Tolerance = 1.0e-4f;
+
+	/** Iterations per resolution level before giving up on convergence. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Solver", meta = (ClampMin = "1"))
+	int32 MaxIterations = 400;
+
+	/** Red-black sweeps per iteration between conductance updates. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Solver", meta = (ClampMin = "1", ClampMax = "32"))
+	int32 SweepsPerIteration = 4;
+
+	/** Over-relaxation of the sweeps; above 1 converges faster, too high oscillates. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Solver", meta = (ClampMin = "0.5", ClampMax = "1.95"))
+	float Relaxation = 1.3f;
+
+	/** The solve starts at half resolution steps down to about this size, and each level seeds the next finer one. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Solver", meta = (ClampMin = "8"))
+	int32 CoarsestSize = 64;
+
+	/** Texels per side of the red-black tiles. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Solver", meta = (ClampMin = "4", ClampMax = "256"))
+	int32 TileSize = 32;
+};
+
+#if WITH_EDITOR
+
+struct FFlowShallowWaterResult
+{
+	/** Flow vectors in [-1,1], the layout FlowMap::WriteFlowField expects; zero outside the river. */
+	FFlowField Flow;
+	/** Steady water depth in metres. */
+	FFlowScalarField Depth;
+
+	/** Iterations at the finest level. */
+	int32 Iterations = 0;
+	bool bConverged = false;
+	/** Surface change in the last iteration, metres. */
+	float FinalChange = 0.0f;
+	/** World units per second. */
+	float MaxSpeed = 0.0f;
+	double SolveSeconds = 0.0;
+};
+
+/**
+ * Steady-state shallow-water solver for authoring flowmaps from terrain. Uses the diffusive-wave form of the
+ * depth-averaged equations: the discharge across each texel face follows Manning's law down the slope of the water
+ * surface, and the steady surface is where every texel's in- and outflow balance its sources. That is a non-linear
+ * Poisson problem, solved by freezing the face conductances (computed four texels at a time with SIMD), running
+ * red-black Gauss-Seidel sweeps over tiles in parallel, and repeating until the surface stops moving. The solve runs
+ * coarse to fine so the water finds its course on a small grid before the full resolution refines it.
+ *
+ * World units are taken to be centimetres; depths, discharges and roughness are SI.
+ */
+class PARTICLEFLOWMAP_API FFlowShallowWaterSolver
+{
+public:
+	/**
+	 * @param Mask		River coverage; its size is the output size.
+	 * @param Height	Height map in [0,1] units, resampled to the mask size; an invalid field gives a flat bed.
+	 * @param Extent	World size covered by the maps.
+	 */
+	static bool Solve(const FFlowScalarField& Mask, const FFlowScalarField& Height, const FVector2f& Extent, float HeightScale,
+		TConstArrayView<FFlowWaterSource> Sources, const FFlowShallowWaterSettings& Settings, FFlowShallowWaterResult& OutResult);
+};
+
+#endif // WITH_EDITOR
@@ -0,0 +1,224 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowStreamComponent.h"
+#include "ParticleFlowMap.h"
+#include "FlowRiverComponent.h"
+#include "FlowRiverSubsystem.h"
+#include "FlowObstacleComponent.h"
+#include "FlowMapStats.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Engine/GameViewportClient.h"
+#include "GameFramework/Actor.h"
+#include "Kismet/GameplayStatics.h"
+#include "NiagaraComponent.h"
+#include "NiagaraDataInterfaceArrayFunctionLibrary.h"
+
+UFlowStreamComponent::UFlowStreamComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+}
+
+void UFlowStreamComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (AActor* Owner = GetOwner())
+	{
+		River = Owner->FindComponentByClass<UFlowRiverComponent>();
+		if (!DisplaySystem)
+		{
+			DisplaySystem = Owner->FindComponentByClass<UNiagaraComponent>();
+		}
+	}
+
+	RestartSimulation();
+}
+
+bool UFlowStreamComponent::RestartSimulation()
+{
+	if (!River)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has no UFlowRiverComponent to simulate"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+
+	FFlowStreamMaps Maps;
+	if (!FlowMap::ReadFlowField(River->FlowMap, Maps.Flow) || !FlowMap::ReadScalarField(River->MaskMap, 0, Maps.Mask))
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s needs a flow map and a mask map to simulate"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+
+	// The jump-flood and height maps are optional; without them particles neither avoid banks nor follow slopes.
+	if (River->JumpFloodMap)
+	{
+		FlowMap::ReadFlowField(River->JumpFloodMap, Maps.WallDirection);
+		FlowMap::ReadScalarField(River->JumpFloodMap, 2, Maps.WallDistance);
+	}
+	if (River->HeightMap)
+	{
+		FlowMap::ReadScalarField(River->HeightMap, 0, Maps.Height);
+	}
+
+	Maps.Extent = FVector2f(River->Extent);
+	Maps.HeightScale = River->HeightScale;
+	Simulation.Initialize(Settings, MoveTemp(Maps));
+
+	DisplayParticles.SetNumZeroed(Settings.Capacity);
+	SortedParticles.SetNumZeroed(Settings.Capacity);
+
+	Trails.Reset();
+	if (bRecordTrails)
+	{
+		Trails.Initialize(Settings.Capacity, TrailLength, bQuantizeTrails);
+	}
+	FramesSinceTrailRecord = 0;
+	return true;
+}
+
+int32 UFlowStreamComponent::GetNumAliveParticles() const
+{
+	return Simulation.GetPool().GetNumAlive();
+}
+
+void UFlowStreamComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!Simulation.IsInitialized())
+	{
+		return;
+	}
+
+	GatherObstacles();
+	Simulation.Tick(DeltaTime);
+	FLOWMAP_INC_COUNTER(STAT_FlowMap_AliveParticles, EFlowMapCounter::AliveParticles, Simulation.GetPool().GetNumAlive());
+	PushToDisplay();
+
+	// Every slot writes one column per recorded frame; skipped frames upload nothing.
+	if (Trails.IsInitialized() && ++FramesSinceTrailRecord >= TrailRecordInterval)
+	{
+		FramesSinceTrailRecord = 0;
+		Trails.Record(Simulation.GetPool(), Simulation.GetMaps().HeightScale);
+		PushTrailsToDisplay();
+	}
+}
+
+void UFlowStreamComponent::GatherObstacles()
+{
+	ObstacleScratch.Reset();
+
+	const UFlowRiverSubsystem* Subsystem = UWorld::GetSubsystem<UFlowRiverSubsystem>(GetWorld());
+	if (Subsystem && River)
+	{
+		const FTransform& RiverTransform = River->GetComponentTransform();
+		for (const TWeakObjectPtr<UFlowObstacleComponent>& Entry : Subsystem->GetObstacles())
+		{
+			const UFlowObstacleComponent* Obstacle = Entry.Get();
+			if (!Obstacle || !Obstacle->bAffectsWater)
+			{
+				continue;
+			}
+
+			FVector Start, End;
+			Obstacle->GetSegment(Start, End);
+			FFlowStreamObstacle& Local = ObstacleScratch.AddDefaulted_GetRef();
+			Local.Start = FVector3f(RiverTransform.InverseTransformPositionNoScale(Start));
+			Local.End = FVector3f(RiverTransform.InverseTransformPositionNoScale(End));
+			Local.Radius = Obstacle->Radius;
+			Local.Velocity = FVector3f(RiverTransform.InverseTransformVectorNoScale(Obstacle->GetObstacleVelocity()));
+		}
+	}
+
+	Simulation.SetObstacles(ObstacleScratch);
+}
+
+void UFlowStreamComponent::PushToDisplay()
+{
+	if (!DisplaySystem || !River)
+	{
+		return;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_Display, EFlowMapTimer::Display);
+
+	const FFlowParticlePool& Pool = Simulation.GetPool();
+	for (int32 Index = 0; Index < Pool.GetCapacity(); ++Index)
+	{
+		if (Pool.IsAlive(Index))
+		{
+			const FVector World = River->MapUVToWorld(Pool.Position[Index], Pool.Height[Index]);
+			DisplayParticles[Index] = FVector4(World, Pool.Age[Index] / Pool.Lifetime[Index]);
+		}
+		else
+		{
+			DisplayParticles[Index].W = -1.0;
+		}
+	}
+
+	const bool bSorted = SortMode != EFlowStreamSortMode::None && SortDisplayParticles();
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector4(DisplaySystem, ParticlesParameter, bSorted ? SortedParticles : DisplayParticles);
+}
+
+bool UFlowStreamComponent::SortDisplayParticles()
+{
+	const APlayerCameraManager* Camera = UGameplayStatics::GetPlayerCameraManager(this, 0);
+	if (!Camera)
+	{
+		return false;
+	}
+
+	float AspectRatio = 1.0f;
+	if (GEngine && GEngine->GameViewport)
+	{
+		FVector2D ViewportSize;
+		GEngine->GameViewport->GetViewportSize(ViewportSize);
+		AspectRatio = ViewportSize.Y > 0.0 ? float(ViewportSize.X / ViewportSize.Y) : 1.0f;
+	}
+
+	const FFlowSortView View = FFlowSortView::Make(Camera->GetCameraLocation(), Camera->GetCameraRotation(), Camera->GetFOVAngle(), AspectRatio);
+	DepthSort.Sort(DisplayParticles, View, SortScreenTiles, SortDepthBuckets, SortMode == EFlowStreamSortMode::BucketedFrontToBack, SortOrder);
+
+	int32 Entry = 0;
+	for (const int32 Index : SortOrder)
+	{
+		SortedParticles[Entry++] = DisplayParticles[Index];
+	}
+	for (; Entry < SortedParticles.Num(); ++Entry)
+	{
+		SortedParticles[Entry].W = -1.0;
+	}
+	return true;
+}
+
+void UFlowStreamComponent::PushTrailsToDisplay()
+{
+	if (!DisplaySystem || !River)
+	{
+		return;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_Display, EFlowMapTimer::Display);
+
+	// Map space to world: packed heights are a fraction of the height scale, unpacked ones are world units.
+	const FVector Origin = River->MapUVToWorld(FVector2f(0.0f, 0.0f));
+	const float HeightUnit = Trails.IsQuantized() ? Simulation.GetMaps().HeightScale : 1.0f;
+	DisplaySystem->SetVariableVec3(TEXT("StreamTrailOrigin"), Origin);
+	DisplaySystem->SetVariableVec3(TEXT("StreamTrailAxisU"), River->MapUVToWorld(FVector2f(1.0f, 0.0f)) - Origin);
+	DisplaySystem->SetVariableVec3(TEXT("StreamTrailAxisV"), River->MapUVToWorld(FVector2f(0.0f, 1.0f)) - Origin);
+	DisplaySystem->SetVariableVec3(TEXT("StreamTrailAxisH"), River->MapUVToWorld(FVector2f(0.0f, 0.0f), HeightUnit) - Origin);
+	DisplaySystem->SetVariableInt(TEXT("StreamTrailHead"), Trails.GetHead());
+	DisplaySystem->SetVariableInt(TEXT("StreamTrailLength"), Trails.GetLength());
+
+	if (Trails.IsQuantized())
+	{
+		UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayInt32(DisplaySystem, TrailsPackedParameter, Trails.GetPackedPoints());
+	}
+	else
+	{
+		UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector4(DisplaySystem, TrailsParameter, Trails.GetPoints());
+	}
+}
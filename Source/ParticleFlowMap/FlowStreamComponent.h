@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "FlowStreamSimulation.h"
+#include "FlowDepthBucketSort.h"
+#include "FlowTrailHistory.h"
+#include "FlowStreamComponent.generated.h"
+
+class UFlowRiverComponent;
+class UNiagaraComponent;
+
+UENUM(BlueprintType)
+enum class EFlowStreamSortMode : uint8
+{
+	/** Entries stay in pool slot order. */
+	None,
+	/** Approximate back-to-front order by view-depth bucket, for alpha-blended sprites. */
+	BucketedBackToFront,
+	/** Approximate front-to-back order, for sprites that can reject covered pixels early. */
+	BucketedFrontToBack,
+};
+
+/**
+ * Runs the stream on the CPU using the owner's UFlowRiverComponent maps and feeds the result to a Niagara system as a
+ * fixed-size array, one entry per pool slot. The display emitter spawns Capacity particles once and reads its entry
+ * by execution index, so nothing is spawned, killed or compacted on the Niagara side either.
+ *
+ * Array layout (Vector4 array user parameter named by ParticlesParameter): world position xyz, normalized age in w,
+ * or w < 0 for free slots. With a sort mode set, live particles come first in draw order and the free entries follow,
+ * so the sprite renderer can draw unsorted and still blend in roughly the right order.
+ *
+ * With trails recorded, each slot also has TrailLength past positions in a ring (see FFlowTrailHistory) that a ribbon
+ * emitter with one ribbon per slot reads directly: point I of slot S, counting back from the newest, is at entry
+ * S * StreamTrailLength + (StreamTrailHead - I) mod StreamTrailLength, and decodes to world space as
+ * StreamTrailOrigin + x * StreamTrailAxisU + y * StreamTrailAxisV + z * StreamTrailAxisH. Trail entries are by slot
+ * whatever the sort mode.
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowStreamComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowStreamComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FFlowStreamSettings Settings;
+
+	/** System that draws the pool; defaults to the first Niagara component on the owner. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UNiagaraComponent> DisplaySystem;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FName ParticlesParameter = TEXT("StreamParticles");
+
+	/** Order of the display array; set NS_ParticleStream's sprite renderer to unsorted when using a bucketed mode. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Sorting")
+	EFlowStreamSortMode SortMode = EFlowStreamSortMode::None;
+
+	/** View-depth buckets between the nearest and farthest particle; more buckets give a closer to exact order. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Sorting", meta = (ClampMin = "1", ClampMax = "1024", EditCondition = "SortMode != EFlowStreamSortMode::None"))
+	int32 SortDepthBuckets = 64;
+
+	/** Screen is split into this many tiles per axis, and sprites are submitted tile by tile. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Sorting", meta = (ClampMin = "1", ClampMax = "16", EditCondition = "SortMode != EFlowStreamSortMode::None"))
+	int32 SortScreenTiles = 4;
+
+	/** Keep a short position history per particle for ribbon or streak renderers. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Trails")
+	bool bRecordTrails = false;
+
+	/** Points kept per particle, newest included. Memory is Capacity * TrailLength points. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Trails", meta = (ClampMin = "2", ClampMax = "64", EditCondition = "bRecordTrails"))
+	int32 TrailLength = 16;
+
+	/** A point is recorded every this many frames, for longer streaks at the same cost. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Trails", meta = (ClampMin = "1", EditCondition = "bRecordTrails"))
+	int32 TrailRecordInterval = 1;
+
+	/**
+	 * Store each point in one int32 (11-bit map U and V, 10-bit height) in the TrailsPackedParameter array instead of
+	 * a Vector4 in TrailsParameter; a quarter of the upload, with steps of 1/2047 of the map size.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Trails", meta = (EditCondition = "bRecordTrails"))
+	bool bQuantizeTrails = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Trails", meta = (EditCondition = "bRecordTrails && !bQuantizeTrails"))
+	FName TrailsParameter = TEXT("StreamTrails");
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Trails", meta = (EditCondition = "bRecordTrails && bQuantizeTrails"))
+	FName TrailsPackedParameter = TEXT("StreamTrailsPacked");
+
+	/** Reads the river's maps back from the GPU and restarts the simulation with an empty pool. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	bool RestartSimulation();
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	int32 GetNumAliveParticles() const;
+
+	/** Mean integration substeps per particle in the last step, to tune the adaptive integrator. */
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	float GetAverageSubsteps() const { return Simulation.GetAverageSubsteps(); }
+
+	const FFlowStreamSimulation& GetSimulation() const { return Simulation; }
+
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	void PushToDisplay();
+
+	/** Uploads the trail ring and the parameters to index and decode it. */
+	void PushTrailsToDisplay();
+
+	/** Hands the world's obstacles to the simulation in the river's local space. */
+	void GatherObstacles();
+
+	/** Reorders DisplayParticles for SortMode; returns false if there is no view to sort for. */
+	bool SortDisplayParticles();
+
+	UPROPERTY(Transient)
+	TObjectPtr<UFlowRiverComponent> River;
+
+	FFlowStreamSimulation Simulation;
+
+	/** Reused every frame so the display upload does not allocate. */
+	TArray<FVector4> DisplayParticles;
+	TArray<FVector4> SortedParticles;
+	TArray<int32> SortOrder;
+	TArray<FFlowStreamObstacle> ObstacleScratch;
+	FFlowDepthBucketSort DepthSort;
+
+	FFlowTrailHistory Trails;
+	/** Frames since the last trail point was recorded. */
+	int32 FramesSinceTrailRecord = 0;
+};
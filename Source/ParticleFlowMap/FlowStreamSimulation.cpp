@@ -0,0 +1,447 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowStreamSimulation.h"
+#include "FlowMapStats.h"
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+
+namespace FlowStreamSimulation
+{
+	/** Slots per worker task; big enough to amortise scheduling, small enough to balance dead and live runs. */
+	static constexpr int32 SlotsPerTask = 512;
+
+	struct FTaskStats
+	{
+		int32 Substeps = 0;
+		int32 Particles = 0;
+		int32 Recycled = 0;
+	};
+
+	static int64 GetMapBytes(const FFlowStreamMaps& Maps)
+	{
+		return Maps.Flow.Texels.GetAllocatedSize() + Maps.Mask.Texels.GetAllocatedSize() + Maps.WallDirection.Texels.GetAllocatedSize()
+			+ Maps.WallDistance.Texels.GetAllocatedSize() + Maps.Height.Texels.GetAllocatedSize();
+	}
+}
+
+FFlowStreamSimulation::~FFlowStreamSimulation()
+{
+	FLOWMAP_DEC_MEMORY(STAT_FlowMap_MapMemory, EFlowMapCounter::MapBytes, FlowStreamSimulation::GetMapBytes(Maps));
+}
+
+void FFlowEmissionSampler::Build(const FFlowScalarField& Mask, float Threshold, const FBox2f& SourceRegion)
+{
+	Cdf.Reset();
+	Texels.Reset();
+	Width = Mask.Width;
+	Height = Mask.Height;
+	if (!Mask.IsValid())
+	{
+		return;
+	}
+
+	const int32 MinX = FMath::Clamp(FMath::FloorToInt32(SourceRegion.Min.X * Width), 0, Width - 1);
+	const int32 MinY = FMath::Clamp(FMath::FloorToInt32(SourceRegion.Min.Y * Height), 0, Height - 1);
+	const int32 MaxX = FMath::Clamp(FMath::CeilToInt32(SourceRegion.Max.X * Width), MinX + 1, Width);
+	const int32 MaxY = FMath::Clamp(FMath::CeilToInt32(SourceRegion.Max.Y * Height), MinY + 1, Height);
+
+	float Total = 0.0f;
+	for (int32 Y = MinY; Y < MaxY; ++Y)
+	{
+		for (int32 X = MinX; X < MaxX; ++X)
+		{
+			const float Coverage = Mask.At(X, Y);
+			if (Coverage >= Threshold)
+			{
+				Total += Coverage;
+				Cdf.Add(Total);
+				Texels.Add(Mask.Index(X, Y));
+			}
+		}
+	}
+}
+
+FVector2f FFlowEmissionSampler::Sample(FRandomStream& Random) const
+{
+	check(IsValid());
+
+	const float Target = Random.FRand() * Cdf.Last();
+	const int32 Entry = FMath::Min(Algo::UpperBound(Cdf, Target), Cdf.Num() - 1);
+	const int32 Texel = Texels[Entry];
+	const float X = (Texel % Width) + Random.FRand();
+	const float Y = (Texel / Width) + Random.FRand();
+	return FVector2f(X / Width, Y / Height);
+}
+
+void FFlowStreamSimulation::Initialize(const FFlowStreamSettings& InSettings, FFlowStreamMaps&& InMaps)
+{
+	Settings = InSettings;
+	FLOWMAP_DEC_MEMORY(STAT_FlowMap_MapMemory, EFlowMapCounter::MapBytes, FlowStreamSimulation::GetMapBytes(Maps));
+	Maps = MoveTemp(InMaps);
+	FLOWMAP_INC_MEMORY(STAT_FlowMap_MapMemory, EFlowMapCounter::MapBytes, FlowStreamSimulation::GetMapBytes(Maps));
+	Pool.Initialize(Settings.Capacity);
+	Random.Initialize(0x5EED);
+	TimeAccumulator = 0.0f;
+	SpawnAccumulator = 0.0f;
+
+	UVPerWorldUnit = FVector2f(1.0f / FMath::Max(Maps.Extent.X, UE_SMALL_NUMBER), 1.0f / FMath::Max(Maps.Extent.Y, UE_SMALL_NUMBER));
+
+	const FBox2f SourceRegion(FVector2f(Settings.SourceMin), FVector2f(Settings.SourceMax));
+	EmissionSampler.Build(Maps.Mask, Settings.MaskThreshold, SourceRegion);
+}
+
+void FFlowStreamSimulation::Tick(float DeltaTime)
+{
+	if (!IsInitialized())
+	{
+		return;
+	}
+
+	TimeAccumulator += DeltaTime;
+	if (Settings.Integrator == EFlowStreamIntegrator::AdaptiveRK23)
+	{
+		// The adaptive integrator picks its own substeps, so the whole tick is one step and substeps can grow past the
+		// fixed step where the flow is smooth.
+		Step(FMath::Min(TimeAccumulator, Settings.FixedTimeStep * Settings.MaxStepsPerTick));
+		TimeAccumulator = 0.0f;
+		return;
+	}
+
+	int32 Steps = 0;
+	while (TimeAccumulator >= Settings.FixedTimeStep && Steps < Settings.MaxStepsPerTick)
+	{
+		Step(Settings.FixedTimeStep);
+		TimeAccumulator -= Settings.FixedTimeStep;
+		++Steps;
+	}
+	TimeAccumulator = FMath::Min(TimeAccumulator, Settings.FixedTimeStep);
+}
+
+void FFlowStreamSimulation::SetObstacles(TConstArrayView<FFlowStreamObstacle> InObstacles)
+{
+	Obstacles.Reset();
+	ObstacleCellStart.Reset();
+	ObstacleCellItems.Reset();
+	if (!IsInitialized())
+	{
+		return;
+	}
+
+	const FVector2f WorldPerUV(1.0f / UVPerWorldUnit.X, 1.0f / UVPerWorldUnit.Y);
+	const float Influence = Settings.ObstacleInfluenceDistance;
+	for (const FFlowStreamObstacle& Obstacle : InObstacles)
+	{
+		// Skip bodies held above the water: compare the lowest end with the surface height under it.
+		const FVector3f& Lowest = Obstacle.Start.Z < Obstacle.End.Z ? Obstacle.Start : Obstacle.End;
+		const FVector2f LowestUV = FVector2f(Lowest.X, Lowest.Y) * UVPerWorldUnit + FVector2f(0.5f, 0.5f);
+		const float Surface = Maps.Height.IsValid() ? Maps.Height.SampleBilinear(LowestUV) * Maps.HeightScale : 0.0f;
+		if (Lowest.Z - Obstacle.Radius > Surface + Influence)
+		{
+			continue;
+		}
+
+		Obstacles.Add({ FVector2f(Obstacle.Start.X, Obstacle.Start.Y), FVector2f(Obstacle.End.X, Obstacle.End.Y), Obstacle.Radius,
+			FVector2f(Obstacle.Velocity.X, Obstacle.Velocity.Y) });
+	}
+	if (Obstacles.Num() == 0)
+	{
+		return;
+	}
+
+	// Bin each obstacle's influence bounds into the grid in two passes: count per cell, then fill.
+	const FVector2f CellsPerWorldUnit = UVPerWorldUnit * float(ObstacleGridSize);
+	auto GetCellRange = [&](const FObstacle& Obstacle, FIntPoint& OutMin, FIntPoint& OutMax)
+	{
+		const float Reach = Obstacle.Radius + Influence;
+		const FVector2f Min = Obstacle.Start.ComponentMin(Obstacle.End) - FVector2f(Reach, Reach) + WorldPerUV * 0.5f;
+		const FVector2f Max = Obstacle.Start.ComponentMax(Obstacle.End) + FVector2f(Reach, Reach) + WorldPerUV * 0.5f;
+		OutMin = FIntPoint(FMath::Clamp(FMath::FloorToInt32(Min.X * CellsPerWorldUnit.X), 0, ObstacleGridSize - 1), FMath::Clamp(FMath::FloorToInt32(Min.Y * CellsPerWorldUnit.Y), 0, ObstacleGridSize - 1));
+		OutMax = FIntPoint(FMath::Clamp(FMath::FloorToInt32(Max.X * CellsPerWorldUnit.X), 0, ObstacleGridSize - 1), FMath::Clamp(FMath::FloorToInt32(Max.Y * CellsPerWorldUnit.Y), 0, ObstacleGridSize - 1));
+	};
+
+	ObstacleCellStart.SetNumZeroed(ObstacleGridSize * ObstacleGridSize + 1);
+	for (const FObstacle& Obstacle : Obstacles)
+	{
+		FIntPoint Min, Max;
+		GetCellRange(Obstacle, Min, Max);
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				++ObstacleCellStart[Y * ObstacleGridSize + X + 1];
+			}
+		}
+	}
+	for (int32 Cell = 1; Cell < ObstacleCellStart.Num(); ++Cell)
+	{
+		ObstacleCellStart[Cell] += ObstacleCellStart[Cell - 1];
+	}
+
+	ObstacleCellItems.SetNumUninitialized(ObstacleCellStart.Last());
+	TArray<int32, TInlineAllocator<ObstacleGridSize * ObstacleGridSize>> Cursor(ObstacleCellStart.GetData(), ObstacleGridSize * ObstacleGridSize);
+	for (int32 Index = 0; Index < Obstacles.Num(); ++Index)
+	{
+		FIntPoint Min, Max;
+		GetCellRange(Obstacles[Index], Min, Max);
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				ObstacleCellItems[Cursor[Y * ObstacleGridSize + X]++] = Index;
+			}
+		}
+	}
+}
+
+FVector2f FFlowStreamSimulation::SampleObstacleVelocity(const FVector2f& Local, float* OutClearance) const
+{
+	FVector2f Result = FVector2f::ZeroVector;
+	float Clearance = MAX_flt;
+
+	const FVector2f UV = Local * UVPerWorldUnit + FVector2f(0.5f, 0.5f);
+	const int32 CellX = FMath::Clamp(FMath::FloorToInt32(UV.X * ObstacleGridSize), 0, ObstacleGridSize - 1);
+	const int32 CellY = FMath::Clamp(FMath::FloorToInt32(UV.Y * ObstacleGridSize), 0, ObstacleGridSize - 1);
+	const int32 Cell = CellY * ObstacleGridSize + CellX;
+
+	const float Influence = Settings.ObstacleInfluenceDistance;
+	for (int32 Item = ObstacleCellStart[Cell]; Item < ObstacleCellStart[Cell + 1]; ++Item)
+	{
+		const FObstacle& Obstacle = Obstacles[ObstacleCellItems[Item]];
+
+		const FVector2f Segment = Obstacle.End - Obstacle.Start;
+		const float SegmentLengthSquared = Segment.SizeSquared();
+		const float T = SegmentLengthSquared > UE_SMALL_NUMBER ? FMath::Clamp(((Local - Obstacle.Start) | Segment) / SegmentLengthSquared, 0.0f, 1.0f) : 0.0f;
+		const FVector2f Offset = Local - (Obstacle.Start + Segment * T);
+		const float Distance = Offset.Size();
+		const float Gap = Distance - Obstacle.Radius;
+		Clearance = FMath::Min(Clearance, Gap);
+		if (Gap >= Influence)
+		{
+			continue;
+		}
+
+		// Quadratic falloff to zero at the edge of the influence band, full strength at and inside the surface.
+		const float Falloff = FMath::Square(1.0f - FMath::Max(Gap, 0.0f) / Influence);
+		const FVector2f Away = Distance > UE_SMALL_NUMBER ? Offset / Distance : FVector2f::ZeroVector;
+		Result += (Away * Settings.ObstacleRepelSpeed + Obstacle.Velocity * Settings.ObstacleWakeStrength) * Falloff;
+	}
+
+	if (OutClearance)
+	{
+		*OutClearance = Clearance;
+	}
+	return Result;
+}
+
+FVector2f FFlowStreamSimulation::SampleVelocity(const FVector2f& UV) const
+{
+	FVector2f Velocity = Maps.Flow.SampleBilinear(UV) * Settings.FlowSpeed;
+
+	if (Maps.WallDistance.IsValid() && Settings.WallRepelDistance > 0.0f)
+	{
+		const float WallDistance = Maps.WallDistance.SampleBilinear(UV) / UVPerWorldUnit.X;
+		if (WallDistance < Settings.WallRepelDistance)
+		{
+			const FVector2f ToWall = Maps.WallDirection.SampleBilinear(UV).GetSafeNormal();
+			Velocity -= ToWall * (Settings.WallRepelSpeed * (1.0f - WallDistance / Settings.WallRepelDistance));
+		}
+	}
+
+	if (Obstacles.Num() > 0)
+	{
+		Velocity += SampleObstacleVelocity((UV - FVector2f(0.5f, 0.5f)) / UVPerWorldUnit);
+	}
+
+	return Velocity * UVPerWorldUnit;
+}
+
+float FFlowStreamSimulation::GetStepLimit(const FVector2f& UV, float Speed) const
+{
+	float Limit = MAX_flt;
+	if (Speed <= UE_SMALL_NUMBER)
+	{
+		return Limit;
+	}
+
+	if (Maps.WallDistance.IsValid())
+	{
+		Limit = FMath::Min(Limit, Settings.WallStepFraction * Maps.WallDistance.SampleBilinear(UV) / Speed);
+	}
+
+	// Obstacles are not in the maps, so keep substeps short while passing one, as for the banks.
+	if (Obstacles.Num() > 0)
+	{
+		float Clearance = MAX_flt;
+		SampleObstacleVelocity((UV - FVector2f(0.5f, 0.5f)) / UVPerWorldUnit, &Clearance);
+		if (Clearance < Settings.ObstacleInfluenceDistance)
+		{
+			const float ClearanceUV = FMath::Max(Clearance, 0.25f * Settings.ObstacleInfluenceDistance) * UVPerWorldUnit.X;
+			Limit = FMath::Min(Limit, Settings.WallStepFraction * ClearanceUV / Speed);
+		}
+	}
+
+	// Central differences one texel apart; the largest velocity change per UV unit bounds how far a step may go
+	// before the velocity it was evaluated with stops being representative.
+	const FVector2f TexelSize(1.0f / Maps.Flow.Width, 1.0f / Maps.Flow.Height);
+	const FVector2f DX = Maps.Flow.SampleBilinear(UV + FVector2f(TexelSize.X, 0.0f)) - Maps.Flow.SampleBilinear(UV - FVector2f(TexelSize.X, 0.0f));
+	const FVector2f DY = Maps.Flow.SampleBilinear(UV + FVector2f(0.0f, TexelSize.Y)) - Maps.Flow.SampleBilinear(UV - FVector2f(0.0f, TexelSize.Y));
+	const float FlowToUV = Settings.FlowSpeed * UVPerWorldUnit.X;
+	const float Gradient = FMath::Max(DX.Size() / (2.0f * TexelSize.X), DY.Size() / (2.0f * TexelSize.Y)) * FlowToUV;
+	if (Gradient > UE_SMALL_NUMBER)
+	{
+		Limit = FMath::Min(Limit, Settings.GradientStepFraction / Gradient);
+	}
+
+	return Limit;
+}
+
+int32 FFlowStreamSimulation::AdvectAdaptive(FVector2f& UV, FVector2f& OutVelocity, float DeltaTime, int32 MaxSubsteps) const
+{
+	const float MinStep = DeltaTime / MaxSubsteps;
+	const float MaxStep = FMath::Max(Settings.MaxAdaptiveStep, MinStep);
+	const FVector2f WorldPerUV(1.0f / UVPerWorldUnit.X, 1.0f / UVPerWorldUnit.Y);
+
+	float Time = 0.0f;
+	float Step = FMath::Min(DeltaTime, MaxStep);
+	int32 Substeps = 0;
+	FVector2f K1 = SampleVelocity(UV);
+
+	while (Time < DeltaTime && Substeps < MaxSubsteps)
+	{
+		// The step limit wins over the MinStep floor, and over finishing the step in one go when out of substeps. Near
+		// a bank or obstacle the particle then stops short and loses the rest of the step instead of tunnelling through.
+		const float Remaining = DeltaTime - Time;
+		const float Limit = GetStepLimit(UV, K1.Size());
+		const bool bLastSubstep = Substeps == MaxSubsteps - 1;
+		Step = FMath::Min3(bLastSubstep ? Remaining : FMath::Max(Step, MinStep), Limit, Remaining);
+		++Substeps;
+
+		// Bogacki-Shampine: third order solution with an embedded second order one for the error estimate.
+		const FVector2f K2 = SampleVelocity(UV + K1 * (0.5f * Step));
+		const FVector2f K3 = SampleVelocity(UV + K2 * (0.75f * Step));
+		const FVector2f Third = UV + (K1 * (2.0f / 9.0f) + K2 * (1.0f / 3.0f) + K3 * (4.0f / 9.0f)) * Step;
+		const FVector2f K4 = SampleVelocity(Third);
+		const FVector2f Second = UV + (K1 * (7.0f / 24.0f) + K2 * 0.25f + K3 * (1.0f / 3.0f) + K4 * 0.125f) * Step;
+
+		const float Error = ((Third - Second) * WorldPerUV).Size();
+		const float Scale = Error > UE_SMALL_NUMBER ? 0.9f * FMath::Pow(Settings.ErrorTolerance / Error, 1.0f / 3.0f) : 4.0f;
+
+		if (bLastSubstep || Error <= Settings.ErrorTolerance || Step <= MinStep)
+		{
+			UV = Third;
+			Time += Step;
+			K1 = K4;
+			Step = FMath::Min(Step * FMath::Clamp(Scale, 0.2f, 4.0f), MaxStep);
+		}
+		else
+		{
+			Step *= FMath::Clamp(Scale, 0.2f, 0.9f);
+		}
+	}
+
+	OutVelocity = K1;
+	return Substeps;
+}
+
+void FFlowStreamSimulation::Step(float DeltaTime)
+{
+	using namespace FlowStreamSimulation;
+
+	{
+		FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_Advection, EFlowMapTimer::Advection);
+
+		const int32 Capacity = Pool.GetCapacity();
+		const int32 NumTasks = FMath::DivideAndRoundUp(Capacity, SlotsPerTask);
+		const bool bAdaptive = Settings.Integrator == EFlowStreamIntegrator::AdaptiveRK23;
+		const float FixedSteps = DeltaTime / Settings.FixedTimeStep;
+		const int32 MaxSubsteps = FMath::Max(FMath::RoundToInt32(FixedSteps * Settings.MaxSubsteps), 1);
+
+		TArray<FTaskStats, TInlineAllocator<64>> TaskStats;
+		TaskStats.SetNum(NumTasks);
+
+		ParallelFor(NumTasks, [this, DeltaTime, Capacity, bAdaptive, MaxSubsteps, &TaskStats](int32 Task)
+		{
+			const int32 First = Task * SlotsPerTask;
+			const int32 Last = FMath::Min(First + SlotsPerTask, Capacity);
+			FTaskStats& Stats = TaskStats[Task];
+			for (int32 Index = First; Index < Last; ++Index)
+			{
+				if (!Pool.IsAlive(Index))
+				{
+					continue;
+				}
+
+				FVector2f& UV = Pool.Position[Index];
+				if (bAdaptive)
+				{
+					Stats.Substeps += AdvectAdaptive(UV, Pool.Velocity[Index], DeltaTime, MaxSubsteps);
+				}
+				else
+				{
+					const FVector2f Velocity = SampleVelocity(UV);
+					UV += Velocity * DeltaTime;
+					Pool.Velocity[Index] = Velocity;
+					Stats.Substeps += 1;
+				}
+				Stats.Particles += 1;
+				Pool.Age[Index] += DeltaTime;
+
+				const bool bOutside = UV.X < 0.0f || UV.Y < 0.0f || UV.X > 1.0f || UV.Y > 1.0f;
+				if (bOutside || Pool.Age[Index] >= Pool.Lifetime[Index] || Maps.Mask.SampleBilinear(UV) < Settings.MaskThreshold)
+				{
+					Pool.Kill(Index);
+					Stats.Recycled += 1;
+					continue;
+				}
+
+				Pool.Height[Index] = Maps.Height.IsValid() ? Maps.Height.SampleBilinear(UV) * Maps.HeightScale : 0.0f;
+			}
+		});
+
+		FTaskStats Total;
+		for (const FTaskStats& Stats : TaskStats)
+		{
+			Total.Substeps += Stats.Substeps;
+			Total.Particles += Stats.Particles;
+			Total.Recycled += Stats.Recycled;
+		}
+		AverageSubsteps = Total.Particles > 0 && FixedSteps > 0.0f ? float(Total.Substeps) / (Total.Particles * FixedSteps) : 1.0f;
+		FLOWMAP_INC_COUNTER(STAT_FlowMap_RecycledParticles, EFlowMapCounter::RecycledParticles, Total.Recycled);
+	}
+
+	Emit(DeltaTime);
+}
+
+void FFlowStreamSimulation::Emit(float DeltaTime)
+{
+	if (!EmissionSampler.IsValid())
+	{
+		return;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_Spawn, EFlowMapTimer::Spawn);
+
+	SpawnAccumulator += Settings.SpawnRate * DeltaTime;
+	const int32 NumToSpawn = FMath::FloorToInt32(SpawnAccumulator);
+	SpawnAccumulator -= NumToSpawn;
+
+	int32 Spawned = 0;
+	for (; Spawned < NumToSpawn; ++Spawned)
+	{
+		const int32 Index = Pool.Spawn();
+		if (Index == INDEX_NONE)
+		{
+			// Pool is full; drop the backlog instead of bursting once slots free up.
+			SpawnAccumulator = 0.0f;
+			break;
+		}
+
+		const FVector2f UV = EmissionSampler.Sample(Random);
+		Pool.Position[Index] = UV;
+		Pool.Velocity[Index] = FVector2f::ZeroVector;
+		Pool.Height[Index] = Maps.Height.IsValid() ? Maps.Height.SampleBilinear(UV) * Maps.HeightScale : 0.0f;
+		Pool.Lifetime[Index] = Settings.Lifetime * Random.FRandRange(0.75f, 1.0f);
+	}
+
+	FLOWMAP_INC_COUNTER(STAT_FlowMap_SpawnedParticles, EFlowMapCounter::SpawnedParticles, Spawned);
+}
@@ -0,0 +1,224 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowField.h"
+#include "FlowParticlePool.h"
+#include "FlowStreamSimulation.generated.h"
+
+UENUM(BlueprintType)
+enum class EFlowStreamIntegrator : uint8
+{
+	/** One forward Euler step per particle per fixed step. */
+	FixedStep,
+	/** Bogacki-Shampine RK3 with an embedded RK2 error estimate, limited by bank distance and flow gradient. */
+	AdaptiveRK23,
+};
+
+USTRUCT(BlueprintType)
+struct PARTICLEFLOWMAP_API FFlowStreamSettings
+{
+	GENERATED_BODY()
+
+	/** Fixed size of the particle pool. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "1"))
+	int32 Capacity = 4096;
+
+	/** Particles per second spawned at the source while the pool has free slots. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	float SpawnRate = 400.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0.1"))
+	float Lifetime = 20.0f;
+
+	/** World units per second for a flowmap vector of length 1. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	float FlowSpeed = 300.0f;
+
+	/** Mask coverage below which a particle has left the river and is recycled. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0", ClampMax = "1"))
+	float MaskThreshold = 0.5f;
+
+	/** Particles closer than this (world units) to a bank are pushed away from it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	float WallRepelDistance = 40.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	float WallRepelSpeed = 150.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0.001"))
+	float FixedTimeStep = 1.0f / 72.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Integration")
+	EFlowStreamIntegrator Integrator = EFlowStreamIntegrator::FixedStep;
+
+	/** Position error per substep (world units) the adaptive integrator aims for. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Integration", meta = (ClampMin = "0.001", EditCondition = "Integrator == EFlowStreamIntegrator::AdaptiveRK23"))
+	float ErrorTolerance = 0.5f;
+
+	/** A substep may cover at most this fraction of the distance to the nearest bank, so particles cannot tunnel. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Integration", meta = (ClampMin = "0.05", ClampMax = "1", EditCondition = "Integrator == EFlowStreamIntegrator::AdaptiveRK23"))
+	float WallStepFraction = 0.5f;
+
+	/** A substep may change the sampled velocity by at most about this fraction, from the local flow gradient. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Integration", meta = (ClampMin = "0.05", EditCondition = "Integrator == EFlowStreamIntegrator::AdaptiveRK23"))
+	float GradientStepFraction = 0.5f;
+
+	/** Substeps the adaptive integrator may take per fixed step of simulated time. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Integration", meta = (ClampMin = "1", EditCondition = "Integrator == EFlowStreamIntegrator::AdaptiveRK23"))
+	int32 MaxSubsteps = 8;
+
+	/** Longest substep (seconds) the adaptive integrator takes on smooth flow, which may span several fixed steps. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Integration", meta = (ClampMin = "0.001", EditCondition = "Integrator == EFlowStreamIntegrator::AdaptiveRK23"))
+	float MaxAdaptiveStep = 0.05f;
+
+	/** Steps taken at most per tick; simulation time is dropped beyond this rather than spiralling. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "1"))
+	int32 MaxStepsPerTick = 4;
+
+	/** Distance (world units) beyond an obstacle's surface over which it still pushes and drags particles. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Obstacles", meta = (ClampMin = "1"))
+	float ObstacleInfluenceDistance = 30.0f;
+
+	/** Speed particles are pushed away from an obstacle's surface at. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Obstacles")
+	float ObstacleRepelSpeed = 200.0f;
+
+	/** Share of an obstacle's own velocity passed on to the water around it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap|Obstacles", meta = (ClampMin = "0"))
+	float ObstacleWakeStrength = 0.6f;
+
+	/** Map UV rectangle particles are spawned in, usually the top of the river. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FVector2D SourceMin = FVector2D(0.0, 0.0);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FVector2D SourceMax = FVector2D(1.0, 1.0);
+};
+
+/** CPU copies of a river's maps, in the layout the simulation samples. */
+struct FFlowStreamMaps
+{
+	FFlowField Flow;
+	FFlowScalarField Mask;
+	/** Jump-flood map: RG is the direction to the nearest bank, B the distance to it in UV units. */
+	FFlowField WallDirection;
+	FFlowScalarField WallDistance;
+	FFlowScalarField Height;
+
+	/** World size of the map area and the height map scale, from UFlowRiverComponent. */
+	FVector2f Extent = FVector2f(1.0f, 1.0f);
+	float HeightScale = 1.0f;
+
+	bool IsValid() const { return Flow.IsValid() && Mask.IsValid(); }
+};
+
+/** Sphere or capsule in the river's local space: world units, origin at the map centre, Z up from the river plane. */
+struct FFlowStreamObstacle
+{
+	FVector3f Start = FVector3f::ZeroVector;
+	FVector3f End = FVector3f::ZeroVector;
+	float Radius = 0.0f;
+	/** World units per second. */
+	FVector3f Velocity = FVector3f::ZeroVector;
+};
+
+/** Importance sampler over the river mask inside the source rectangle. */
+class PARTICLEFLOWMAP_API FFlowEmissionSampler
+{
+public:
+	void Build(const FFlowScalarField& Mask, float Threshold, const FBox2f& SourceRegion);
+	bool IsValid() const { return Cdf.Num() > 0; }
+
+	/** Returns a jittered UV inside a source texel, picked proportionally to its mask coverage. */
+	FVector2f Sample(FRandomStream& Random) const;
+
+private:
+	TArray<float> Cdf;
+	TArray<int32> Texels;
+	int32 Width = 0;
+	int32 Height = 0;
+};
+
+/**
+ * Native version of the NS_ParticleStream update: particles follow the flowmap, are pushed off the banks by the
+ * jump-flood map and ride the height map, and are recycled when they leave the mask or expire. Dynamic obstacles are
+ * evaluated analytically on top of the maps, so moving hands and controllers never require a re-bake.
+ */
+class PARTICLEFLOWMAP_API FFlowStreamSimulation
+{
+public:
+	~FFlowStreamSimulation();
+
+	void Initialize(const FFlowStreamSettings& InSettings, FFlowStreamMaps&& InMaps);
+	bool IsInitialized() const { return Maps.IsValid() && Pool.GetCapacity() > 0; }
+
+	/**
+	 * Replaces the obstacle set for the following steps. Obstacles that do not reach the water surface are dropped,
+	 * and the rest are binned into a coarse grid so each particle only tests the few near it.
+	 */
+	void SetObstacles(TConstArrayView<FFlowStreamObstacle> InObstacles);
+
+	int32 GetNumActiveObstacles() const { return Obstacles.Num(); }
+
+	/**
+	 * Advances by whole fixed steps, carrying the remainder over to the next tick. The adaptive integrator instead
+	 * advances the whole tick in one step, up to MaxStepsPerTick fixed steps, and picks its own substeps.
+	 */
+	void Tick(float DeltaTime);
+
+	const FFlowParticlePool& GetPool() const { return Pool; }
+	const FFlowStreamSettings& GetSettings() const { return Settings; }
+	const FFlowStreamMaps& GetMaps() const { return Maps; }
+
+	/** Mean substeps per live particle per fixed step of simulated time; always 1 in fixed-step mode. */
+	float GetAverageSubsteps() const { return AverageSubsteps; }
+
+private:
+	void Step(float DeltaTime);
+	void Emit(float DeltaTime);
+
+	FVector2f SampleVelocity(const FVector2f& UV) const;
+
+	/** Repulsion and wake from nearby obstacles (world units per second) at a river-local position. */
+	FVector2f SampleObstacleVelocity(const FVector2f& Local, float* OutClearance = nullptr) const;
+
+	/**
+	 * Integrates one particle over DeltaTime in at most MaxSubsteps substeps, with error and stability control;
+	 * returns the substeps taken.
+	 */
+	int32 AdvectAdaptive(FVector2f& UV, FVector2f& OutVelocity, float DeltaTime, int32 MaxSubsteps) const;
+
+	/** Largest substep the bank distance and flow gradient allow at UV, for a particle moving at Speed (UV/s). */
+	float GetStepLimit(const FVector2f& UV, float Speed) const;
+
+	FFlowStreamSettings Settings;
+	FFlowStreamMaps Maps;
+	FFlowParticlePool Pool;
+	FFlowEmissionSampler EmissionSampler;
+	FRandomStream Random;
+
+	struct FObstacle
+	{
+		FVector2f Start;
+		FVector2f End;
+		float Radius;
+		FVector2f Velocity;
+	};
+
+	/** Cells per axis of the obstacle grid laid over the map. */
+	static constexpr int32 ObstacleGridSize = 16;
+
+	TArray<FObstacle> Obstacles;
+	/** Obstacle indices per cell, in compressed rows: cell C owns ObstacleCellItems[ObstacleCellStart[C] .. ObstacleCellStart[C + 1]). */
+	TArray<int32> ObstacleCellStart;
+	TArray<int32> ObstacleCellItems;
+
+	/** World to UV scale per axis. */
+	FVector2f UVPerWorldUnit = FVector2f(1.0f, 1.0f);
+
+	float TimeAccumulator = 0.0f;
+	float SpawnAccumulator = 0.0f;
+	float AverageSubsteps = 1.0f;
+};
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowTrailHistory.h"
+#include "FlowParticlePool.h"
+#include "FlowMapStats.h"
+#include "Async/ParallelFor.h"
+
+namespace FlowTrailHistory
+{
+	static constexpr int32 SlotsPerTask = 1024;
+
+	static constexpr uint32 UVBits = 11;
+	static constexpr uint32 HeightBits = 10;
+	static constexpr uint32 UVMax = (1u << UVBits) - 1;
+	static constexpr uint32 HeightMax = (1u << HeightBits) - 1;
+
+	/** Quantized U is capped one step short of the maximum so no valid point can equal InvalidPackedPoint. */
+	static constexpr uint32 UMaxValid = UVMax - 1;
+}
+
+FFlowTrailHistory::~FFlowTrailHistory()
+{
+	FLOWMAP_DEC_MEMORY(STAT_FlowMap_PoolMemory, EFlowMapCounter::PoolBytes, TrackedBytes);
+}
+
+uint32 FFlowTrailHistory::PackPoint(const FVector2f& UV, float NormalizedHeight)
+{
+	using namespace FlowTrailHistory;
+
+	const uint32 U = uint32(FMath::Clamp(FMath::RoundToInt32(UV.X * UVMax), 0, int32(UMaxValid)));
+	const uint32 V = uint32(FMath::Clamp(FMath::RoundToInt32(UV.Y * UVMax), 0, int32(UVMax)));
+	const uint32 H = uint32(FMath::Clamp(FMath::RoundToInt32(NormalizedHeight * HeightMax), 0, int32(HeightMax)));
+	return U | (V << UVBits) | (H << (2 * UVBits));
+}
+
+FVector3f FFlowTrailHistory::UnpackPoint(uint32 Packed)
+{
+	using namespace FlowTrailHistory;
+
+	return FVector3f(
+		float(Packed & UVMax) / UVMax,
+		float((Packed >> UVBits) & UVMax) / UVMax,
+		float(Packed >> (2 * UVBits)) / HeightMax);
+}
+
+void FFlowTrailHistory::Initialize(int32 InCapacity, int32 InLength, bool bInQuantize)
+{
+	Capacity = FMath::Max(InCapacity, 0);
+	Length = FMath::Max(InLength, 2);
+	bQuantize = bInQuantize;
+	Head = 0;
+
+	SlotGenerations.Init(MAX_uint32, Capacity);
+	PackedPoints.Reset();
+	Points.Reset();
+	if (bQuantize)
+	{
+		PackedPoints.Init(int32(InvalidPackedPoint), Capacity * Length);
+	}
+	else
+	{
+		Points.Init(FVector4(0.0, 0.0, 0.0, -1.0), Capacity * Length);
+	}
+
+	const int64 Bytes = SlotGenerations.GetAllocatedSize() + PackedPoints.GetAllocatedSize() + Points.GetAllocatedSize();
+	FLOWMAP_DEC_MEMORY(STAT_FlowMap_PoolMemory, EFlowMapCounter::PoolBytes, TrackedBytes);
+	FLOWMAP_INC_MEMORY(STAT_FlowMap_PoolMemory, EFlowMapCounter::PoolBytes, Bytes);
+	TrackedBytes = Bytes;
+}
+
+void FFlowTrailHistory::Reset()
+{
+	FLOWMAP_DEC_MEMORY(STAT_FlowMap_PoolMemory, EFlowMapCounter::PoolBytes, TrackedBytes);
+	TrackedBytes = 0;
+	Capacity = 0;
+	Length = 0;
+	Head = 0;
+	SlotGenerations.Empty();
+	PackedPoints.Empty();
+	Points.Empty();
+}
+
+void FFlowTrailHistory::Record(const FFlowParticlePool& Pool, float HeightScale)
+{
+	if (!IsInitialized() || Pool.GetCapacity() != Capacity)
+	{
+		return;
+	}
+
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_Trails, EFlowMapTimer::Trails);
+
+	Head = (Head + 1) % Length;
+	const float HeightToUnit = HeightScale > UE_SMALL_NUMBER ? 1.0f / HeightScale : 0.0f;
+
+	ParallelFor(FMath::DivideAndRoundUp(Capacity, FlowTrailHistory::SlotsPerTask), [this, &Pool, HeightToUnit](int32 Task)
+	{
+		const int32 First = Task * FlowTrailHistory::SlotsPerTask;
+		const int32 Last = FMath::Min(First + FlowTrailHistory::SlotsPerTask, Capacity);
+		for (int32 Slot = First; Slot < Last; ++Slot)
+		{
+			const int32 Row = Slot * Length;
+			const bool bAlive = Pool.IsAlive(Slot);
+			const bool bNewParticle = bAlive && SlotGenerations[Slot] != Pool.Generation[Slot];
+			SlotGenerations[Slot] = bAlive ? Pool.Generation[Slot] : SlotGenerations[Slot];
+
+			// Fill the whole row for a new particle, otherwise just the head column.
+			const int32 FirstColumn = bNewParticle ? 0 : Head;
+			const int32 LastColumn = bNewParticle ? Length - 1 : Head;
+
+			if (bQuantize)
+			{
+				const int32 Packed = bAlive ? int32(PackPoint(Pool.Position[Slot], Pool.Height[Slot] * HeightToUnit)) : int32(InvalidPackedPoint);
+				for (int32 Column = FirstColumn; Column <= LastColumn; ++Column)
+				{
+					PackedPoints[Row + Column] = Packed;
+				}
+			}
+			else
+			{
+				const FVector4 Point = bAlive ? FVector4(Pool.Position[Slot].X, Pool.Position[Slot].Y, Pool.Height[Slot], 1.0) : FVector4(0.0, 0.0, 0.0, -1.0);
+				for (int32 Column = FirstColumn; Column <= LastColumn; ++Column)
+				{
+					Points[Row + Column] = Point;
+				}
+			}
+		}
+	});
+}
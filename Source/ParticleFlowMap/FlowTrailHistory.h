@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FFlowParticlePool;
+
+/**
+ * Fixed-length position history for every pool slot, kept as a ring: each recorded frame writes one column for all
+ * slots and advances the shared head, so nothing is ever shifted or compacted. Slot S's points live at
+ * [S * Length, (S + 1) * Length), the newest at column GetHead() and older ones at decreasing columns, wrapping.
+ *
+ * Points are stored in river map space (UV and height) so renderers can decode them with the river's axes.
+ * Quantized points pack U and V in 11 bits each and height (relative to the height scale) in 10 bits; unquantized
+ * points are (U, V, height in world units, 1). Free slots write InvalidPackedPoint or a negative w at the head.
+ */
+class PARTICLEFLOWMAP_API FFlowTrailHistory
+{
+public:
+	static constexpr uint32 InvalidPackedPoint = MAX_uint32;
+
+	~FFlowTrailHistory();
+
+	void Initialize(int32 InCapacity, int32 InLength, bool bInQuantize);
+	void Reset();
+
+	bool IsInitialized() const { return Length > 0; }
+	int32 GetLength() const { return Length; }
+	int32 GetHead() const { return Head; }
+	bool IsQuantized() const { return bQuantize; }
+
+	/**
+	 * Writes every slot's current position into the next column. A particle new to its slot since the last record
+	 * has its whole history filled with its spawn point, so its trail starts collapsed instead of linking to the
+	 * previous occupant.
+	 */
+	void Record(const FFlowParticlePool& Pool, float HeightScale);
+
+	const TArray<int32>& GetPackedPoints() const { return PackedPoints; }
+	const TArray<FVector4>& GetPoints() const { return Points; }
+
+	static uint32 PackPoint(const FVector2f& UV, float NormalizedHeight);
+	static FVector3f UnpackPoint(uint32 Packed);
+
+private:
+	int32 Capacity = 0;
+	int32 Length = 0;
+	int32 Head = 0;
+	bool bQuantize = true;
+
+	/** Pool generation each slot's history belongs to. */
+	TArray<uint32> SlotGenerations;
+	TArray<int32> PackedPoints;
+	TArray<FVector4> Points;
+	int64 TrackedBytes = 0;
+};
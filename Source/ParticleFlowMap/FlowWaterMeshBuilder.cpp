@@ -0,0 +1,793 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowWaterMeshBuilder.h"
+#include "ParticleFlowMap.h"
+#include "FlowMapStats.h"
+
+namespace FlowWaterMesh
+{
+	static uint64 MakeEdgeKey(int32 A, int32 B)
+	{
+		return A < B ? (uint64(A) << 32) | uint32(B) : (uint64(B) << 32) | uint32(A);
+	}
+
+	static float Orient(const FVector2f& A, const FVector2f& B, const FVector2f& C)
+	{
+		return (B - A) ^ (C - A);
+	}
+
+	/** Inclusive of the edges, for either winding. */
+	static bool IsInTriangle(const FVector2f& P, const FVector2f& A, const FVector2f& B, const FVector2f& C)
+	{
+		const float D0 = Orient(A, B, P);
+		const float D1 = Orient(B, C, P);
+		const float D2 = Orient(C, A, P);
+		const bool bAnyNegative = D0 < 0.0f || D1 < 0.0f || D2 < 0.0f;
+		const bool bAnyPositive = D0 > 0.0f || D1 > 0.0f || D2 > 0.0f;
+		return !(bAnyNegative && bAnyPositive);
+	}
+
+	static bool IsInLoop(const FVector2f& P, const TArray<FVector2f>& Loop)
+	{
+		bool bInside = false;
+		for (int32 Index = 0, Prev = Loop.Num() - 1; Index < Loop.Num(); Prev = Index++)
+		{
+			const FVector2f& A = Loop[Index];
+			const FVector2f& B = Loop[Prev];
+			if ((A.Y > P.Y) != (B.Y > P.Y) && P.X < A.X + (P.Y - A.Y) * (B.X - A.X) / (B.Y - A.Y))
+			{
+				bInside = !bInside;
+			}
+		}
+		return bInside;
+	}
+
+	/** Positive when D lies inside the circumcircle of the counter-clockwise triangle ABC. */
+	static double InCircle(const FVector2f& A, const FVector2f& B, const FVector2f& C, const FVector2f& D)
+	{
+		const double ADX = A.X - D.X, ADY = A.Y - D.Y;
+		const double BDX = B.X - D.X, BDY = B.Y - D.Y;
+		const double CDX = C.X - D.X, CDY = C.Y - D.Y;
+		return (ADX * ADX + ADY * ADY) * (BDX * CDY - CDX * BDY)
+			+ (BDX * BDX + BDY * BDY) * (CDX * ADY - ADX * CDY)
+			+ (CDX * CDX + CDY * CDY) * (ADX * BDY - BDX * ADY);
+	}
+
+	static float PointSegmentDistanceSquared(const FVector2f& P, const FVector2f& A, const FVector2f& B)
+	{
+		const FVector2f AB = B - A;
+		const float LengthSquared = AB.SizeSquared();
+		const float T = LengthSquared > 0.0f ? FMath::Clamp(((P - A) | AB) / LengthSquared, 0.0f, 1.0f) : 0.0f;
+		return FVector2f::DistSquared(P, A + AB * T);
+	}
+
+	/**
+	 * Splices a clockwise hole into a counter-clockwise ring through a bridge from the hole's rightmost vertex to a
+	 * ring vertex it can see (Eberly, "Triangulation by Ear Clipping"). The bridge vertices appear twice in the ring.
+	 */
+	static bool MergeHole(const TArray<FVector2f>& Vertices, TArray<int32>& Ring, const TArray<int32>& Hole)
+	{
+		int32 HoleStart = 0;
+		for (int32 Index = 1; Index < Hole.Num(); ++Index)
+		{
+			if (Vertices[Hole[Index]].X > Vertices[Hole[HoleStart]].X)
+			{
+				HoleStart = Index;
+			}
+		}
+		const FVector2f M = Vertices[Hole[HoleStart]];
+
+		// Closest ring edge hit by a ray from M towards +X.
+		float HitX = MAX_flt;
+		int32 HitEdge = INDEX_NONE;
+		for (int32 Index = 0; Index < Ring.Num(); ++Index)
+		{
+			const FVector2f& A = Vertices[Ring[Index]];
+			const FVector2f& B = Vertices[Ring[(Index + 1) % Ring.Num()]];
+			if ((A.Y > M.Y) == (B.Y > M.Y))
+			{
+				continue;
+			}
+			const float X = A.X + (M.Y - A.Y) * (B.X - A.X) / (B.Y - A.Y);
+			if (X >= M.X && X < HitX)
+			{
+				HitX = X;
+				HitEdge = Index;
+			}
+		}
+		if (HitEdge == INDEX_NONE)
+		{
+			return false;
+		}
+
+		const int32 EdgeEnd = (HitEdge + 1) % Ring.Num();
+		int32 Bridge = Vertices[Ring[HitEdge]].X > Vertices[Ring[EdgeEnd]].X ? HitEdge : EdgeEnd;
+		const FVector2f Hit(HitX, M.Y);
+		const FVector2f Candidate = Vertices[Ring[Bridge]];
+
+		// A reflex ring vertex inside (M, Hit, Candidate) hides the candidate; use the one closest in angle to the ray.
+		float BestAngle = MAX_flt;
+		for (int32 Index = 0; Index < Ring.Num(); ++Index)
+		{
+			const FVector2f& P = Vertices[Ring[Index]];
+			if (Index == Bridge || P == Candidate)
+			{
+				continue;
+			}
+			const FVector2f& Prev = Vertices[Ring[(Index + Ring.Num() - 1) % Ring.Num()]];
+			const FVector2f& Next = Vertices[Ring[(Index + 1) % Ring.Num()]];
+			if (Orient(Prev, P, Next) >= 0.0f || !IsInTriangle(P, M, Hit, Candidate))
+			{
+				continue;
+			}
+			const float Angle = FMath::Abs(FMath::Atan2(P.Y - M.Y, P.X - M.X));
+			if (Angle < BestAngle)
+			{
+				BestAngle = Angle;
+				Bridge = Index;
+			}
+		}
+
+		TArray<int32> Merged;
+		Merged.Reserve(Ring.Num() + Hole.Num() + 2);
+		Merged.Append(Ring.GetData(), Bridge + 1);
+		for (int32 Offset = 0; Offset <= Hole.Num(); ++Offset)
+		{
+			Merged.Add(Hole[(HoleStart + Offset) % Hole.Num()]);
+		}
+		Merged.Add(Ring[Bridge]);
+		Merged.Append(Ring.GetData() + Bridge + 1, Ring.Num() - Bridge - 1);
+		Ring = MoveTemp(Merged);
+		return true;
+	}
+
+	/** Ear clips a counter-clockwise ring that may touch itself at bridge vertices. */
+	static void EarClip(const TArray<FVector2f>& Vertices, TArray<int32>& Ring, TArray<FIntVector3>& OutTriangles)
+	{
+		int32 Start = 0;
+		while (Ring.Num() > 3)
+		{
+			const int32 Num = Ring.Num();
+			int32 Clipped = INDEX_NONE;
+			int32 Flattest = 0;
+			float FlattestArea = MAX_flt;
+
+			for (int32 Attempt = 0; Attempt < Num && Clipped == INDEX_NONE; ++Attempt)
+			{
+				const int32 I1 = (Start + Attempt) % Num;
+				const int32 I0 = (I1 + Num - 1) % Num;
+				const int32 I2 = (I1 + 1) % Num;
+				const FVector2f& A = Vertices[Ring[I0]];
+				const FVector2f& B = Vertices[Ring[I1]];
+				const FVector2f& C = Vertices[Ring[I2]];
+
+				const float Area = Orient(A, B, C);
+				if (FMath::Abs(Area) < FlattestArea)
+				{
+					FlattestArea = FMath::Abs(Area);
+					Flattest = I1;
+				}
+				if (Area <= 0.0f)
+				{
+					continue;
+				}
+
+				bool bIsEar = true;
+				for (int32 Other = 0; Other < Num && bIsEar; ++Other)
+				{
+					const FVector2f& P = Vertices[Ring[Other]];
+					if (Other == I0 || Other == I1 || Other == I2 || P == A || P == B || P == C)
+					{
+						continue;
+					}
+					bIsEar = !IsInTriangle(P, A, B, C);
+				}
+
+				if (bIsEar)
+				{
+					OutTriangles.Add(FIntVector3(Ring[I0], Ring[I1], Ring[I2]));
+					Clipped = I1;
+				}
+			}
+
+			// Nothing clips on a numerically degenerate outline: drop the flattest vertex and carry on.
+			const int32 Removed = Clipped != INDEX_NONE ? Clipped : Flattest;
+			Ring.RemoveAt(Removed);
+			Start = Removed % Ring.Num();
+		}
+
+		if (Ring.Num() == 3 && Orient(Vertices[Ring[0]], Vertices[Ring[1]], Vertices[Ring[2]]) > 0.0f)
+		{
+			OutTriangles.Add(FIntVector3(Ring[0], Ring[1], Ring[2]));
+		}
+	}
+
+	/** Lawson flips until no interior edge violates the Delaunay condition, or MaxPasses is reached. */
+	static void FlipToDelaunay(const TArray<FVector2f>& Vertices, TArray<FIntVector3>& Triangles, int32 MaxPasses)
+	{
+		TMap<uint64, FIntPoint> EdgeTriangles;
+		TBitArray<> Touched;
+
+		for (int32 Pass = 0; Pass < MaxPasses; ++Pass)
+		{
+			// Each edge maps to (triangle * 3 + local edge) for the triangles on either side.
+			EdgeTriangles.Reset();
+			for (int32 Triangle = 0; Triangle < Triangles.Num(); ++Triangle)
+			{
+				for (int32 Edge = 0; Edge < 3; ++Edge)
+				{
+					const uint64 Key = MakeEdgeKey(Triangles[Triangle][Edge], Triangles[Triangle][(Edge + 1) % 3]);
+					FIntPoint& Sides = EdgeTriangles.FindOrAdd(Key, FIntPoint(INDEX_NONE, INDEX_NONE));
+					(Sides.X == INDEX_NONE ? Sides.X : Sides.Y) = Triangle * 3 + Edge;
+				}
+			}
+
+			Touched.Init(false, Triangles.Num());
+			int32 NumFlips = 0;
+			for (const TPair<uint64, FIntPoint>& Pair : EdgeTriangles)
+			{
+				if (Pair.Value.Y == INDEX_NONE)
+				{
+					continue;
+				}
+				const int32 T1 = Pair.Value.X / 3, E1 = Pair.Value.X % 3;
+				const int32 T2 = Pair.Value.Y / 3, E2 = Pair.Value.Y % 3;
+				if (Touched[T1] || Touched[T2])
+				{
+					continue;
+				}
+
+				const int32 A = Triangles[T1][E1];
+				const int32 B = Triangles[T1][(E1 + 1) % 3];
+				const int32 C = Triangles[T1][(E1 + 2) % 3];
+				const int32 D = Triangles[T2][(E2 + 2) % 3];
+				if (InCircle(Vertices[A], Vertices[B], Vertices[C], Vertices[D]) <= 0.0
+					|| Orient(Vertices[A], Vertices[D], Vertices[C]) <= 0.0f
+					|| Orient(Vertices[D], Vertices[B], Vertices[C]) <= 0.0f)
+				{
+					continue;
+				}
+
+				Triangles[T1] = FIntVector3(A, D, C);
+				Triangles[T2] = FIntVector3(D, B, C);
+				Touched[T1] = true;
+				Touched[T2] = true;
+				++NumFlips;
+			}
+
+			if (NumFlips == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	/** Chamfer (3-4) distance from every wet texel to the nearest dry one, in texels. Outside the map counts as dry. */
+	static void BuildBankDistance(const FFlowScalarField& Mask, float Threshold, FFlowScalarField& OutDistance)
+	{
+		const float Orthogonal = 1.0f;
+		const float Diagonal = 1.3333f;
+		OutDistance.Init(Mask.Width, Mask.Height, 0.0f);
+
+		auto Get = [&OutDistance](int32 X, int32 Y)
+		{
+			return X >= 0 && Y >= 0 && X < OutDistance.Width && Y < OutDistance.Height ? OutDistance.At(X, Y) : 0.0f;
+		};
+
+		for (int32 Y = 0; Y < Mask.Height; ++Y)
+		{
+			for (int32 X = 0; X < Mask.Width; ++X)
+			{
+				if (Mask.At(X, Y) >= Threshold)
+				{
+					OutDistance.At(X, Y) = FMath::Min(
+						FMath::Min(Get(X - 1, Y) + Orthogonal, Get(X, Y - 1) + Orthogonal),
+						FMath::Min(Get(X - 1, Y - 1) + Diagonal, Get(X + 1, Y - 1) + Diagonal));
+				}
+			}
+		}
+		for (int32 Y = Mask.Height - 1; Y >= 0; --Y)
+		{
+			for (int32 X = Mask.Width - 1; X >= 0; --X)
+			{
+				float& Distance = OutDistance.At(X, Y);
+				if (Distance > 0.0f)
+				{
+					Distance = FMath::Min(Distance, FMath::Min(
+						FMath::Min(Get(X + 1, Y) + Orthogonal, Get(X, Y + 1) + Orthogonal),
+						FMath::Min(Get(X + 1, Y + 1) + Diagonal, Get(X - 1, Y + 1) + Diagonal)));
+				}
+			}
+		}
+	}
+
+	/** Target edge length and surface height, both in world units, over the river's local plane. */
+	struct FSizeField
+	{
+		const FFlowScalarField* Height = nullptr;
+		FFlowScalarField BankDistance;
+		FVector2f Extent;
+		float HeightScale = 1.0f;
+		float WorldPerTexel = 1.0f;
+		const FFlowWaterMeshSettings* Settings = nullptr;
+
+		FVector2f ToUV(const FVector2f& Local) const
+		{
+			return FVector2f(Local.X / Extent.X + 0.5f, Local.Y / Extent.Y + 0.5f);
+		}
+
+		float GetBankDistance(const FVector2f& Local) const
+		{
+			return BankDistance.SampleBilinear(ToUV(Local)) * WorldPerTexel;
+		}
+
+		float GetSurfaceHeight(const FVector2f& Local) const
+		{
+			return Height->IsValid() ? Height->SampleBilinear(ToUV(Local)) * HeightScale : 0.0f;
+		}
+
+		/** Height change per world unit along X and Y. */
+		FVector2f GetSlope(const FVector2f& Local) const
+		{
+			if (!Height->IsValid())
+			{
+				return FVector2f::ZeroVector;
+			}
+			const FVector2f StepX(Extent.X / Height->Width, 0.0f);
+			const FVector2f StepY(0.0f, Extent.Y / Height->Height);
+			return FVector2f(
+				(GetSurfaceHeight(Local + StepX) - GetSurfaceHeight(Local - StepX)) / (2.0f * StepX.X),
+				(GetSurfaceHeight(Local + StepY) - GetSurfaceHeight(Local - StepY)) / (2.0f * StepY.Y));
+		}
+
+		float GetTargetEdgeLength(const FVector2f& Local) const
+		{
+			if (GetSlope(Local).Size() >= Settings->WaterfallSlope && Height->IsValid())
+			{
+				return Settings->BankEdgeLength;
+			}
+			const float Alpha = FMath::Clamp(GetBankDistance(Local) / Settings->BankFalloffDistance, 0.0f, 1.0f);
+			return FMath::Lerp(Settings->BankEdgeLength, FMath::Max(Settings->OpenWaterEdgeLength, Settings->BankEdgeLength), Alpha);
+		}
+	};
+
+	/**
+	 * One pass of longest-edge bisection: edges longer than the target at their midpoint are split, and any triangle
+	 * with a split edge also splits its longest edge so repeated passes do not produce slivers. Midpoints are shared
+	 * through the edge map, so the mesh stays conforming. Returns false when nothing needed splitting.
+	 */
+	static bool RefinePass(TArray<FVector2f>& Vertices, TArray<FIntVector3>& Triangles, const FSizeField& SizeField, int32 MaxVertices)
+	{
+		TMap<uint64, int32> Midpoints;
+		auto MarkEdge = [&Vertices, &Midpoints, MaxVertices](int32 A, int32 B)
+		{
+			const uint64 Key = MakeEdgeKey(A, B);
+			if (!Midpoints.Contains(Key) && Vertices.Num() < MaxVertices)
+			{
+				Midpoints.Add(Key, Vertices.Add((Vertices[A] + Vertices[B]) * 0.5f));
+				return true;
+			}
+			return false;
+		};
+
+		for (const FIntVector3& Triangle : Triangles)
+		{
+			for (int32 Edge = 0; Edge < 3; ++Edge)
+			{
+				const int32 A = Triangle[Edge];
+				const int32 B = Triangle[(Edge + 1) % 3];
+				const FVector2f Midpoint = (Vertices[A] + Vertices[B]) * 0.5f;
+				if (FVector2f::Distance(Vertices[A], Vertices[B]) > SizeField.GetTargetEdgeLength(Midpoint))
+				{
+					MarkEdge(A, B);
+				}
+			}
+		}
+		if (Midpoints.Num() == 0)
+		{
+			return false;
+		}
+
+		auto GetLongestEdge = [&Vertices](const FIntVector3& Triangle)
+		{
+			int32 Longest = 0;
+			float LongestLength = -1.0f;
+			for (int32 Edge = 0; Edge < 3; ++Edge)
+			{
+				const float Length = FVector2f::DistSquared(Vertices[Triangle[Edge]], Vertices[Triangle[(Edge + 1) % 3]]);
+				if (Length > LongestLength)
+				{
+					LongestLength = Length;
+					Longest = Edge;
+				}
+			}
+			return Longest;
+		};
+
+		for (bool bChanged = true; bChanged;)
+		{
+			bChanged = false;
+			for (const FIntVector3& Triangle : Triangles)
+			{
+				const int32 Longest = GetLongestEdge(Triangle);
+				const bool bAnySplit = Midpoints.Contains(MakeEdgeKey(Triangle[0], Triangle[1]))
+					|| Midpoints.Contains(MakeEdgeKey(Triangle[1], Triangle[2]))
+					|| Midpoints.Contains(MakeEdgeKey(Triangle[2], Triangle[0]));
+				if (bAnySplit)
+				{
+					bChanged |= MarkEdge(Triangle[Longest], Triangle[(Longest + 1) % 3]);
+				}
+			}
+		}
+
+		TArray<FIntVector3> Refined;
+		Refined.Reserve(Triangles.Num() * 2);
+		for (const FIntVector3& Triangle : Triangles)
+		{
+			// Rotate so the edge being bisected is V0-V1: the longest one, unless the vertex budget ran out before
+			// closure could mark it, in which case any split edge keeps the mesh conforming.
+			int32 SplitEdge = GetLongestEdge(Triangle);
+			for (int32 Edge = 0; Edge < 3 && !Midpoints.Contains(MakeEdgeKey(Triangle[SplitEdge], Triangle[(SplitEdge + 1) % 3])); ++Edge)
+			{
+				SplitEdge = Edge;
+			}
+			const int32 V0 = Triangle[SplitEdge];
+			const int32 V1 = Triangle[(SplitEdge + 1) % 3];
+			const int32 V2 = Triangle[(SplitEdge + 2) % 3];
+
+			const int32* M01 = Midpoints.Find(MakeEdgeKey(V0, V1));
+			if (!M01)
+			{
+				Refined.Add(Triangle);
+				continue;
+			}
+
+			if (const int32* M20 = Midpoints.Find(MakeEdgeKey(V2, V0)))
+			{
+				Refined.Add(FIntVector3(V0, *M01, *M20));
+				Refined.Add(FIntVector3(*M20, *M01, V2));
+			}
+			else
+			{
+				Refined.Add(FIntVector3(V0, *M01, V2));
+			}
+
+			if (const int32* M12 = Midpoints.Find(MakeEdgeKey(V1, V2)))
+			{
+				Refined.Add(FIntVector3(*M01, V1, *M12));
+				Refined.Add(FIntVector3(*M01, *M12, V2));
+			}
+			else
+			{
+				Refined.Add(FIntVector3(*M01, V1, V2));
+			}
+		}
+		Triangles = MoveTemp(Refined);
+		return true;
+	}
+}
+
+void FFlowWaterMeshBuilder::ExtractContours(const FFlowScalarField& Mask, float Threshold, TArray<TArray<FVector2f>>& OutLoops)
+{
+	OutLoops.Reset();
+	if (!Mask.IsValid())
+	{
+		return;
+	}
+
+	const int32 Width = Mask.Width;
+	const int32 Height = Mask.Height;
+
+	// Samples outside the map read as dry so every contour closes.
+	auto Sample = [&Mask](int32 X, int32 Y)
+	{
+		return X >= 0 && Y >= 0 && X < Mask.Width && Y < Mask.Height ? Mask.At(X, Y) : 0.0f;
+	};
+
+	// Crossings are keyed by the grid edge they lie on, which both neighbouring cells share.
+	auto EdgeKey = [Width](int32 X, int32 Y, bool bVertical)
+	{
+		return ((uint64(Y + 1) * uint64(Width + 2) + uint64(X + 1)) << 1) | (bVertical ? 1 : 0);
+	};
+
+	TMap<uint64, FVector2f> Crossings;
+	TMap<uint64, uint64> NextCrossing;
+
+	for (int32 Y = -1; Y < Height; ++Y)
+	{
+		for (int32 X = -1; X < Width; ++X)
+		{
+			// Cell corners are texel centres, counter-clockwise from (X, Y).
+			const int32 CornerX[4] = { X, X + 1, X + 1, X };
+			const int32 CornerY[4] = { Y, Y, Y + 1, Y + 1 };
+			float Value[4];
+			bool bWet[4];
+			int32 NumWet = 0;
+			for (int32 Corner = 0; Corner < 4; ++Corner)
+			{
+				Value[Corner] = Sample(CornerX[Corner], CornerY[Corner]);
+				bWet[Corner] = Value[Corner] >= Threshold;
+				NumWet += bWet[Corner] ? 1 : 0;
+			}
+			if (NumWet == 0 || NumWet == 4)
+			{
+				continue;
+			}
+
+			// Walk the cell's edges counter-clockwise; the contour alternately leaves and re-enters the water.
+			uint64 Keys[4];
+			bool bLeaves[4];
+			int32 NumCrossings = 0;
+			for (int32 Edge = 0; Edge < 4; ++Edge)
+			{
+				const int32 A = Edge;
+				const int32 B = (Edge + 1) % 4;
+				if (bWet[A] == bWet[B])
+				{
+					continue;
+				}
+
+				const uint64 Key = EdgeKey(FMath::Min(CornerX[A], CornerX[B]), FMath::Min(CornerY[A], CornerY[B]), (Edge & 1) != 0);
+				if (!Crossings.Contains(Key))
+				{
+					const float T = (Threshold - Value[A]) / (Value[B] - Value[A]);
+					Crossings.Add(Key, FVector2f(FMath::Lerp(float(CornerX[A]), float(CornerX[B]), T) + 0.5f,
+						FMath::Lerp(float(CornerY[A]), float(CornerY[B]), T) + 0.5f));
+				}
+				Keys[NumCrossings] = Key;
+				bLeaves[NumCrossings] = bWet[A];
+				++NumCrossings;
+			}
+
+			// Each segment runs from where the contour leaves the water to where it re-enters, keeping water on its
+			// left. Saddles join the wet corners when the cell centre is wet, otherwise the dry ones.
+			const bool bCentreWet = (Value[0] + Value[1] + Value[2] + Value[3]) * 0.25f >= Threshold;
+			const int32 PairStep = NumCrossings == 4 && !bCentreWet ? 3 : 1;
+			for (int32 Index = 0; Index < NumCrossings; ++Index)
+			{
+				if (bLeaves[Index])
+				{
+					NextCrossing.Add(Keys[Index], Keys[(Index + PairStep) % NumCrossings]);
+				}
+			}
+		}
+	}
+
+	TSet<uint64> Visited;
+	Visited.Reserve(Crossings.Num());
+	for (const TPair<uint64, uint64>& Start : NextCrossing)
+	{
+		if (Visited.Contains(Start.Key))
+		{
+			continue;
+		}
+
+		TArray<FVector2f>& Loop = OutLoops.AddDefaulted_GetRef();
+		for (const uint64* Key = &Start.Key; Key && !Visited.Contains(*Key); Key = NextCrossing.Find(*Key))
+		{
+			Visited.Add(*Key);
+			Loop.Add(Crossings[*Key]);
+		}
+	}
+}
+
+void FFlowWaterMeshBuilder::SimplifyLoop(TArray<FVector2f>& Loop, float Tolerance)
+{
+	const int32 Num = Loop.Num();
+	if (Num <= 3 || Tolerance <= 0.0f)
+	{
+		return;
+	}
+
+	// Split the loop at its first vertex and the vertex farthest from it, then simplify each half as a polyline.
+	int32 Far = 0;
+	float FarDistance = -1.0f;
+	for (int32 Index = 1; Index < Num; ++Index)
+	{
+		const float Distance = FVector2f::DistSquared(Loop[0], Loop[Index]);
+		if (Distance > FarDistance)
+		{
+			FarDistance = Distance;
+			Far = Index;
+		}
+	}
+
+	TBitArray<> Keep(false, Num);
+	Keep[0] = true;
+	Keep[Far] = true;
+
+	const float ToleranceSquared = Tolerance * Tolerance;
+	TArray<FIntPoint, TInlineAllocator<64>> Ranges = { FIntPoint(0, Far), FIntPoint(Far, Num) };
+	while (Ranges.Num() > 0)
+	{
+		const FIntPoint Range = Ranges.Pop(EAllowShrinking::No);
+		const FVector2f& A = Loop[Range.X];
+		const FVector2f& B = Loop[Range.Y % Num];
+
+		int32 Worst = INDEX_NONE;
+		float WorstDistance = ToleranceSquared;
+		for (int32 Index = Range.X + 1; Index < Range.Y; ++Index)
+		{
+			const float Distance = FlowWaterMesh::PointSegmentDistanceSquared(Loop[Index], A, B);
+			if (Distance > WorstDistance)
+			{
+				WorstDistance = Distance;
+				Worst = Index;
+			}
+		}
+
+		if (Worst != INDEX_NONE)
+		{
+			Keep[Worst] = true;
+			Ranges.Add(FIntPoint(Range.X, Worst));
+			Ranges.Add(FIntPoint(Worst, Range.Y));
+		}
+	}
+
+	TArray<FVector2f> Simplified;
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		if (Keep[Index])
+		{
+			Simplified.Add(Loop[Index]);
+		}
+	}
+	Loop = MoveTemp(Simplified);
+}
+
+float FFlowWaterMeshBuilder::GetSignedArea(const TArray<FVector2f>& Loop)
+{
+	float Area = 0.0f;
+	for (int32 Index = 0, Prev = Loop.Num() - 1; Index < Loop.Num(); Prev = Index++)
+	{
+		Area += Loop[Prev] ^ Loop[Index];
+	}
+	return Area * 0.5f;
+}
+
+bool FFlowWaterMeshBuilder::Build(const FFlowScalarField& Mask, const FFlowScalarField& Height, const FVector2f& Extent, float HeightScale,
+	const FFlowWaterMeshSettings& Settings, FFlowWaterMesh& OutMesh)
+{
+	FLOWMAP_SCOPE_CYCLE_COUNTER(STAT_FlowMap_WaterMesh, EFlowMapTimer::WaterMesh);
+
+	OutMesh = FFlowWaterMesh();
+	if (!Mask.IsValid() || Extent.X <= 0.0f || Extent.Y <= 0.0f)
+	{
+		return false;
+	}
+
+	TArray<TArray<FVector2f>> Loops;
+	ExtractContours(Mask, Settings.MaskThreshold, Loops);
+
+	// Simplify in texels, then move everything into the river's local plane so lengths and angles are in world units.
+	const FVector2f WorldPerTexel(Extent.X / Mask.Width, Extent.Y / Mask.Height);
+	TArray<TArray<FVector2f>> Outers;
+	TArray<TArray<FVector2f>> Holes;
+	for (TArray<FVector2f>& Loop : Loops)
+	{
+		SimplifyLoop(Loop, Settings.SimplifyTolerance);
+		const float Area = GetSignedArea(Loop);
+		if (Loop.Num() < 3 || FMath::Abs(Area) < Settings.MinLoopArea)
+		{
+			continue;
+		}
+
+		for (FVector2f& Point : Loop)
+		{
+			Point = FVector2f(Point.X * WorldPerTexel.X - Extent.X * 0.5f, Point.Y * WorldPerTexel.Y - Extent.Y * 0.5f);
+		}
+		(Area > 0.0f ? Outers : Holes).Add(MoveTemp(Loop));
+	}
+
+	// Each island belongs to the smallest wet area around it.
+	TArray<TArray<int32>> HolesPerOuter;
+	HolesPerOuter.SetNum(Outers.Num());
+	for (int32 Hole = 0; Hole < Holes.Num(); ++Hole)
+	{
+		int32 Owner = INDEX_NONE;
+		float OwnerArea = MAX_flt;
+		for (int32 Outer = 0; Outer < Outers.Num(); ++Outer)
+		{
+			const float Area = GetSignedArea(Outers[Outer]);
+			if (Area < OwnerArea && FlowWaterMesh::IsInLoop(Holes[Hole][0], Outers[Outer]))
+			{
+				Owner = Outer;
+				OwnerArea = Area;
+			}
+		}
+		if (Owner != INDEX_NONE)
+		{
+			HolesPerOuter[Owner].Add(Hole);
+		}
+	}
+
+	TArray<FVector2f> Vertices;
+	TArray<FIntVector3> Triangles;
+	for (int32 Outer = 0; Outer < Outers.Num(); ++Outer)
+	{
+		TArray<int32> Ring;
+		for (const FVector2f& Point : Outers[Outer])
+		{
+			Ring.Add(Vertices.Add(Point));
+		}
+
+		TArray<TArray<int32>> HoleRings;
+		for (int32 Hole : HolesPerOuter[Outer])
+		{
+			TArray<int32>& HoleRing = HoleRings.AddDefaulted_GetRef();
+			for (const FVector2f& Point : Holes[Hole])
+			{
+				HoleRing.Add(Vertices.Add(Point));
+			}
+		}
+
+		// Bridge islands right to left so each bridge sees the ring as already merged.
+		auto GetMaxX = [&Vertices](const TArray<int32>& HoleRing)
+		{
+			float MaxX = -MAX_flt;
+			for (int32 Index : HoleRing)
+			{
+				MaxX = FMath::Max(MaxX, Vertices[Index].X);
+			}
+			return MaxX;
+		};
+		HoleRings.Sort([&GetMaxX](const TArray<int32>& A, const TArray<int32>& B) { return GetMaxX(A) > GetMaxX(B); });
+		for (const TArray<int32>& HoleRing : HoleRings)
+		{
+			FlowWaterMesh::MergeHole(Vertices, Ring, HoleRing);
+		}
+
+		FlowWaterMesh::EarClip(Vertices, Ring, Triangles);
+	}
+
+	if (Triangles.Num() == 0)
+	{
+		return false;
+	}
+	OutMesh.NumOutlineVertices = Vertices.Num();
+
+	FlowWaterMesh::FSizeField SizeField;
+	FlowWaterMesh::BuildBankDistance(Mask, Settings.MaskThreshold, SizeField.BankDistance);
+	SizeField.Height = &Height;
+	SizeField.Extent = Extent;
+	SizeField.HeightScale = HeightScale;
+	SizeField.WorldPerTexel = (WorldPerTexel.X + WorldPerTexel.Y) * 0.5f;
+	SizeField.Settings = &Settings;
+
+	const int32 MaxFlipPasses = 8;
+	FlowWaterMesh::FlipToDelaunay(Vertices, Triangles, MaxFlipPasses);
+	for (int32 Pass = 0; Pass < Settings.MaxRefinePasses; ++Pass)
+	{
+		if (!FlowWaterMesh::RefinePass(Vertices, Triangles, SizeField, Settings.MaxVertices))
+		{
+			break;
+		}
+		FlowWaterMesh::FlipToDelaunay(Vertices, Triangles, MaxFlipPasses);
+	}
+
+	OutMesh.Positions.Reserve(Vertices.Num());
+	OutMesh.Normals.Reserve(Vertices.Num());
+	OutMesh.UVs.Reserve(Vertices.Num());
+	OutMesh.BankFactors.Reserve(Vertices.Num());
+	for (const FVector2f& Vertex : Vertices)
+	{
+		const FVector2f Slope = SizeField.GetSlope(Vertex);
+		OutMesh.Positions.Add(FVector3f(Vertex.X, Vertex.Y, SizeField.GetSurfaceHeight(Vertex)));
+		OutMesh.Normals.Add(FVector3f(-Slope.X, -Slope.Y, 1.0f).GetSafeNormal());
+		OutMesh.UVs.Add(SizeField.ToUV(Vertex));
+		OutMesh.BankFactors.Add(FMath::Clamp(SizeField.GetBankDistance(Vertex) / Settings.BankFalloffDistance, 0.0f, 1.0f));
+	}
+
+	// Triangles are counter-clockwise seen from +Z, which is front facing upwards in the engine's winding convention.
+	OutMesh.Indices.Reserve(Triangles.Num() * 3);
+	for (const FIntVector3& Triangle : Triangles)
+	{
+		OutMesh.Indices.Add(Triangle.X);
+		OutMesh.Indices.Add(Triangle.Y);
+		OutMesh.Indices.Add(Triangle.Z);
+	}
+
+	UE_LOG(LogParticleFlowMap, Verbose, TEXT("Water mesh: %d outline vertices, %d vertices, %d triangles"),
+		OutMesh.NumOutlineVertices, OutMesh.Positions.Num(), OutMesh.GetNumTriangles());
+	return true;
+}
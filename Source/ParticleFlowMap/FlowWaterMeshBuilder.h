@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowField.h"
+#include "FlowWaterMeshBuilder.generated.h"
+
+USTRUCT(BlueprintType)
+struct PARTICLEFLOWMAP_API FFlowWaterMeshSettings
+{
+	GENERATED_BODY()
+
+	/** Mask coverage the outline follows. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0.01", ClampMax = "0.99"))
+	float MaskThreshold = 0.5f;
+
+	/** How far (texels) the simplified outline may stray from the marching-squares contour. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	float SimplifyTolerance = 0.75f;
+
+	/** Islands and puddles smaller than this many texels are dropped. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	float MinLoopArea = 16.0f;
+
+	/** Target triangle edge length (world units) along the banks and down waterfalls. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "1"))
+	float BankEdgeLength = 60.0f;
+
+	/** Target edge length in open water, reached BankFalloffDistance away from the nearest bank. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "1"))
+	float OpenWaterEdgeLength = 400.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "1"))
+	float BankFalloffDistance = 500.0f;
+
+	/** Height map slope (rise over run) from which the surface is meshed at bank density, for waterfalls and rapids. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	float WaterfallSlope = 0.35f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "0"))
+	int32 MaxRefinePasses = 12;
+
+	/** Refinement stops once the mesh reaches this many vertices. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap", meta = (ClampMin = "3"))
+	int32 MaxVertices = 65535;
+};
+
+/** Water surface in the river's local space: X and Y in world units around the map centre, Z from the height map. */
+struct FFlowWaterMesh
+{
+	TArray<FVector3f> Positions;
+	TArray<FVector3f> Normals;
+	/** Map UV, so the surface material can sample the flowmap directly. */
+	TArray<FVector2f> UVs;
+	/** 0 on the banks rising to 1 at BankFalloffDistance, for shore foam and fades. */
+	TArray<float> BankFactors;
+	/** Triangle list in the engine's front-face winding, facing +Z. */
+	TArray<int32> Indices;
+
+	/** Vertices on the simplified outline, before refinement. */
+	int32 NumOutlineVertices = 0;
+
+	int32 GetNumTriangles() const { return Indices.Num() / 3; }
+};
+
+/**
+ * Builds a water surface that covers only the wet part of a river mask: marching squares extract the outline,
+ * Douglas-Peucker simplifies it, islands are bridged into their banks and the polygon is ear clipped, then edges are
+ * bisected until they are short enough for their distance to the bank and the local slope, with Delaunay edge flips
+ * after each stage to keep triangles well shaped.
+ */
+class PARTICLEFLOWMAP_API FFlowWaterMeshBuilder
+{
+public:
+	/**
+	 * @param Mask		River coverage, usually the R channel of RT_StreamMask.
+	 * @param Height	Optional height map in [0,1] units; an invalid field gives a flat surface.
+	 * @param Extent	World size covered by the maps.
+	 */
+	static bool Build(const FFlowScalarField& Mask, const FFlowScalarField& Height, const FVector2f& Extent, float HeightScale,
+		const FFlowWaterMeshSettings& Settings, FFlowWaterMesh& OutMesh);
+
+	/** Closed contours at Threshold in texel coordinates; wet areas are counter-clockwise, islands clockwise. */
+	static void ExtractContours(const FFlowScalarField& Mask, float Threshold, TArray<TArray<FVector2f>>& OutLoops);
+
+	/** Douglas-Peucker simplification of a closed loop. */
+	static void SimplifyLoop(TArray<FVector2f>& Loop, float Tolerance);
+
+	static float GetSignedArea(const TArray<FVector2f>& Loop);
+};
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FlowWaterMeshComponent.h"
+#include "ParticleFlowMap.h"
+#include "FlowRiverComponent.h"
+#include "GameFramework/Actor.h"
+#include "Materials/MaterialInterface.h"
+
+UFlowWaterMeshComponent::UFlowWaterMeshComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetCastShadow(false);
+}
+
+void UFlowWaterMeshComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (bBuildOnBeginPlay)
+	{
+		BuildFromRiver();
+	}
+}
+
+bool UFlowWaterMeshComponent::BuildFromRiver()
+{
+	const UFlowRiverComponent* River = GetOwner() ? GetOwner()->FindComponentByClass<UFlowRiverComponent>() : nullptr;
+	if (!River)
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s has no UFlowRiverComponent to build a water surface for"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+
+	FFlowScalarField Mask;
+	if (!FlowMap::ReadScalarField(River->MaskMap, 0, Mask))
+	{
+		UE_LOG(LogParticleFlowMap, Warning, TEXT("%s needs a mask map to build a water surface"), *GetNameSafe(GetOwner()));
+		return false;
+	}
+
+	FFlowScalarField Height;
+	if (River->HeightMap)
+	{
+		FlowMap::ReadScalarField(River->HeightMap, 0, Height);
+	}
+
+	FFlowWaterMesh Mesh;
+	if (!FFlowWaterMeshBuilder::Build(Mask, Height, FVector2f(River->Extent), River->HeightScale, Settings, Mesh))
+	{
+		ClearAllMeshSections();
+		NumWaterTriangles = 0;
+		return false;
+	}
+
+	// The builder works in the river's space; this component may sit anywhere on the actor.
+	const FTransform RiverToLocal = River->GetComponentTransform().GetRelativeTransform(GetComponentTransform());
+
+	TArray<FVector> Vertices;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UV0;
+	TArray<FLinearColor> Colors;
+	TArray<FProcMeshTangent> Tangents;
+	Vertices.Reserve(Mesh.Positions.Num());
+	Normals.Reserve(Mesh.Positions.Num());
+	UV0.Reserve(Mesh.Positions.Num());
+	Colors.Reserve(Mesh.Positions.Num());
+	Tangents.Reserve(Mesh.Positions.Num());
+	for (int32 Index = 0; Index < Mesh.Positions.Num(); ++Index)
+	{
+		Vertices.Add(RiverToLocal.TransformPosition(FVector(Mesh.Positions[Index])));
+		Normals.Add(RiverToLocal.TransformVectorNoScale(FVector(Mesh.Normals[Index])));
+		UV0.Add(FVector2D(Mesh.UVs[Index]));
+		Colors.Add(FLinearColor(Mesh.BankFactors[Index], 0.0f, 0.0f, 1.0f));
+		Tangents.Add(FProcMeshTangent(RiverToLocal.TransformVectorNoScale(FVector::ForwardVector), false));
+	}
+
+	CreateMeshSection_LinearColor(0, Vertices, Mesh.Indices, Normals, UV0, Colors, Tangents, false);
+	if (WaterMaterial)
+	{
+		SetMaterial(0, WaterMaterial);
+	}
+
+	NumWaterTriangles = Mesh.GetNumTriangles();
+	return true;
+}
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+#include "FlowWaterMeshBuilder.h"
+#include "FlowWaterMeshComponent.generated.h"
+
+class UFlowRiverComponent;
+class UMaterialInterface;
+
+/**
+ * Water surface fitted to the owner's river mask, replacing the uniform SM_WaterPlane50k: only wet texels are
+ * covered, with dense triangles along the banks and down waterfalls and large ones in open water.
+ *
+ * UV0 is the river's map UV, so M_WaterSurface can keep sampling the flowmap; vertex colour R is the bank factor
+ * (0 at the shore, 1 in open water). Use "Create StaticMesh" in the details panel to bake the result into an asset.
+ */
+UCLASS(ClassGroup = (Flowmap), meta = (BlueprintSpawnableComponent))
+class PARTICLEFLOWMAP_API UFlowWaterMeshComponent : public UProceduralMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFlowWaterMeshComponent(const FObjectInitializer& ObjectInitializer);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	FFlowWaterMeshSettings Settings;
+
+	/** Usually M_WaterSurface. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	TObjectPtr<UMaterialInterface> WaterMaterial;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Flowmap")
+	bool bBuildOnBeginPlay = true;
+
+	/** Reads the river's mask and height maps back from the GPU and rebuilds the surface, e.g. after painting. */
+	UFUNCTION(BlueprintCallable, Category = "Flowmap")
+	bool BuildFromRiver();
+
+	UFUNCTION(BlueprintPure, Category = "Flowmap")
+	int32 GetNumWaterTriangles() const { return NumWaterTriangles; }
+
+	virtual void BeginPlay() override;
+
+private:
+	int32 NumWaterTriangles = 0;
+};
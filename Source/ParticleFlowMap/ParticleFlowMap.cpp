@@ -3,4 +3,6 @@
 #include "ParticleFlowMap.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogParticleFlowMap);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ParticleFlowMap, "ParticleFlowMap" );
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+#include "FlowDepthBucketSort.h"
+#include "Math/RandomStream.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** More than one sort chunk, so the per-chunk histograms and offsets are exercised. */
+	const int32 TestNumParticles = 5000;
+
+	/** Random positions in front of the view, every seventh entry a free slot. */
+	TArray<FVector4> MakeTestParticles(int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		TArray<FVector4> Particles;
+		Particles.SetNumUninitialized(TestNumParticles);
+		for (int32 Index = 0; Index < TestNumParticles; ++Index)
+		{
+			const FVector Position(Random.FRandRange(100.0f, 5000.0f), Random.FRandRange(-2000.0f, 2000.0f), Random.FRandRange(-2000.0f, 2000.0f));
+			Particles[Index] = FVector4(Position, Index % 7 == 0 ? -1.0f : 1.0f);
+		}
+		return Particles;
+	}
+} // namespace
+
+BEGIN_DEFINE_SPEC(FFlowDepthBucketSortSpec, TEXT("ParticleFlowMap.DepthBucketSort"), EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FFlowDepthBucketSort Sorter;
+FFlowSortView View;
+
+void TestIsPermutationOfLiveParticles(const TArray<FVector4>& Particles, const TArray<int32>& Order);
+END_DEFINE_SPEC(FFlowDepthBucketSortSpec)
+
+void FFlowDepthBucketSortSpec::TestIsPermutationOfLiveParticles(const TArray<FVector4>& Particles, const TArray<int32>& Order)
+{
+	int32 NumLive = 0;
+	for (const FVector4& Particle : Particles)
+	{
+		NumLive += Particle.W >= 0.0 ? 1 : 0;
+	}
+	TestEqual(TEXT("Every live particle is drawn"), Order.Num(), NumLive);
+
+	TBitArray<> Seen(false, Particles.Num());
+	for (int32 Index : Order)
+	{
+		if (!TestTrue(TEXT("Index is in range"), Particles.IsValidIndex(Index)))
+		{
+			return;
+		}
+		TestTrue(TEXT("Index is a live particle"), Particles[Index].W >= 0.0);
+		TestFalse(TEXT("Index is drawn once"), Seen[Index]);
+		Seen[Index] = true;
+	}
+}
+
+void FFlowDepthBucketSortSpec::Define()
+{
+	BeforeEach([this] {
+		Sorter = FFlowDepthBucketSort();
+		View = FFlowSortView::Make(FVector::ZeroVector, FRotator::ZeroRotator, 90.0f, 16.0f / 9.0f);
+	});
+
+	It(TEXT("Orders every live particle once"), [this] {
+		const TArray<FVector4> Particles = MakeTestParticles(1);
+		TArray<int32> Order;
+		Sorter.Sort(Particles, View, 4, 16, false, Order);
+		TestIsPermutationOfLiveParticles(Particles, Order);
+	});
+
+	It(TEXT("Orders every live particle once when the sorter is reused"), [this] {
+		TArray<int32> Order;
+		const TArray<FVector4> FirstParticles = MakeTestParticles(1);
+		Sorter.Sort(FirstParticles, View, 4, 16, false, Order);
+		TestIsPermutationOfLiveParticles(FirstParticles, Order);
+
+		const TArray<FVector4> SecondParticles = MakeTestParticles(2);
+		Sorter.Sort(SecondParticles, View, 4, 16, true, Order);
+		TestIsPermutationOfLiveParticles(SecondParticles, Order);
+	});
+
+	It(TEXT("Draws back to front across buckets"), [this] {
+		const TArray<FVector4> Particles = MakeTestParticles(3);
+		TArray<int32> Order;
+		Sorter.Sort(Particles, View, 1, 8, false, Order);
+
+		// One tile, so the order is by bucket only: depths may only fall by more than a bucket's width.
+		const float BucketDepth = (5000.0f - 100.0f) / 8.0f;
+		for (int32 Position = 1; Position < Order.Num(); ++Position)
+		{
+			TestTrue(TEXT("Farther particles come first"), Particles[Order[Position]].X <= Particles[Order[Position - 1]].X + BucketDepth);
+		}
+	});
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS